@@ -0,0 +1,481 @@
+#include "batchrender.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QAnimationDriver>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickGraphicsDevice>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickRenderTarget>
+#include <QQuickWindow>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+#include <limits>
+
+/*
+    A batch rendering mode for the application, started with --batch=FILE,
+    for generating thumbnails and report images from the same QML and
+    QQuickRhiItem code as the interactive view, without a window system.
+
+    FILE is a JSON array of jobs, each rendering a QML scene with a set of
+    properties into an image sequence:
+
+    [
+        { "source": "qrc:/thumbnail.qml", "size": [ 512, 512 ], "frames": 30, "fps": 30,
+          "properties": { "message": "Report 1" }, "output": "report1-%1.png" },
+        { "source": "file:///data/chart.qml", "size": [ 1920, 1080 ] }
+    ]
+
+    The root object must be an item, it is resized to the job's size, the
+    properties are set when it is created. "frames" defaults to 1, "fps",
+    which sets the step of the animations between frames, to 60. "output"
+    is relative to the output directory, %1 becomes the frame number, the
+    default is the index of the job followed by the frame number, as PNG.
+
+    The jobs are taken from a shared queue by a number of threads, one per
+    core unless --batch-threads=N is given. Each thread has its own
+    QQmlEngine, QQuickRenderControl and offscreen QRhi, and animations
+    driven by a fixed step, so that the images do not depend on the timing.
+    Each frame's texture is read back, and the pixels are handed to a
+    thread pool that converts and encodes them, while the thread goes on
+    with the next frame.
+
+    The QQuickRhiItem frame scheduler's upload budget and deferred
+    initialization are disabled, so that each frame, including the first,
+    has all of the renderers' content, whatever the environment says.
+
+    --batch-output=DIR sets the output directory, without it the images are
+    read back but not encoded, for timing the rendering alone.
+    --batch-backend=gl renders with OpenGL, which is software rendering on
+    a server without a GPU with Mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE=1).
+    The default, null, only exercises the CPU side of Qt Quick and the
+    renderers, its images are empty.
+
+    The throughput, in frames per second over all threads and per thread,
+    is printed at the end. The return value is non-zero when a job failed.
+ */
+
+namespace {
+
+struct Job
+{
+    QUrl source;
+    QVariantMap properties;
+    QSize size;
+    int frames = 1;
+    int fps = 60;
+    QString output;
+};
+
+class JobQueue
+{
+public:
+    explicit JobQueue(const QList<Job> &jobs) : m_jobs(jobs) { }
+
+    bool take(Job *job, int *index)
+    {
+        const int i = m_next.fetch_add(1);
+        if (i >= m_jobs.count())
+            return false;
+        *job = m_jobs[i];
+        *index = i;
+        return true;
+    }
+
+private:
+    const QList<Job> m_jobs;
+    std::atomic<int> m_next { 0 };
+};
+
+// Converts and encodes read back frames on the global thread pool, with a
+// bound on the frames waiting, so that fast renderers cannot run out of
+// memory.
+class Encoder
+{
+public:
+    explicit Encoder(int maxPending) : m_pending(maxPending) { }
+
+    void write(const QByteArray &pixels, const QSize &size, bool mirror, const QString &fileName)
+    {
+        m_pending.acquire();
+        QThreadPool::globalInstance()->start([this, pixels, size, mirror, fileName] {
+            const QImage wrapper(reinterpret_cast<const uchar *>(pixels.constData()), size.width(), size.height(),
+                                 QImage::Format_RGBA8888_Premultiplied);
+            const QImage image = mirror ? wrapper.mirrored() : wrapper;
+            QImageWriter writer(fileName);
+            if (!writer.write(image)) {
+                qWarning("Batch: failed to write %s: %s", qPrintable(fileName), qPrintable(writer.errorString()));
+                ++m_failures;
+            }
+            m_pending.release();
+        });
+    }
+
+    int waitForDone()
+    {
+        QThreadPool::globalInstance()->waitForDone();
+        return m_failures;
+    }
+
+private:
+    QSemaphore m_pending;
+    std::atomic<int> m_failures { 0 };
+};
+
+// animations advance by the frame interval of the job, not by the clock
+class StepAnimationDriver : public QAnimationDriver
+{
+public:
+    void setInterval(qint64 interval) { m_interval = interval; }
+
+    void advance() override
+    {
+        m_elapsed += m_interval;
+        advanceAnimation();
+    }
+
+    qint64 elapsed() const override { return m_elapsed; }
+
+private:
+    qint64 m_interval = 16;
+    qint64 m_elapsed = 0;
+};
+
+class BatchWorker : public QThread
+{
+public:
+    BatchWorker(JobQueue *queue, Encoder *encoder, const QString &outputDir, QRhi::Implementation backend,
+                QOffscreenSurface *fallbackSurface)
+        : m_queue(queue),
+          m_encoder(encoder),
+          m_outputDir(outputDir),
+          m_backend(backend),
+          m_fallbackSurface(fallbackSurface)
+    {
+    }
+
+    int frameCount() const { return m_frameCount; }
+    int failureCount() const { return m_failureCount; }
+    QByteArray deviceName() const { return m_deviceName; }
+
+protected:
+    void run() override;
+
+private:
+    bool ensureRenderTarget(const QSize &size);
+    void releaseRenderTarget();
+    bool renderJob(const Job &job, int index);
+
+    JobQueue *m_queue;
+    Encoder *m_encoder;
+    QString m_outputDir;
+    QRhi::Implementation m_backend;
+    QOffscreenSurface *m_fallbackSurface;
+    int m_frameCount = 0;
+    int m_failureCount = 0;
+    QByteArray m_deviceName;
+
+    // only touched on the thread
+    QRhi *m_rhi = nullptr;
+    StepAnimationDriver *m_animationDriver = nullptr;
+    QQmlEngine *m_engine = nullptr;
+    QQuickRenderControl *m_renderControl = nullptr;
+    QQuickWindow *m_window = nullptr;
+    QRhiTexture *m_texture = nullptr;
+    QRhiRenderBuffer *m_depthStencil = nullptr;
+    QRhiTextureRenderTarget *m_rt = nullptr;
+    QRhiRenderPassDescriptor *m_rp = nullptr;
+};
+
+void BatchWorker::run()
+{
+    if (m_backend == QRhi::OpenGLES2) {
+#if QT_CONFIG(opengl)
+        QRhiGles2InitParams params;
+        params.format = QSurfaceFormat::defaultFormat();
+        params.fallbackSurface = m_fallbackSurface;
+        m_rhi = QRhi::create(QRhi::OpenGLES2, &params);
+#endif
+    } else {
+        QRhiNullInitParams params;
+        m_rhi = QRhi::create(QRhi::Null, &params);
+    }
+    if (!m_rhi) {
+        qWarning("Batch: failed to create a QRhi");
+        m_failureCount = 1;
+        return;
+    }
+    m_deviceName = m_rhi->driverInfo().deviceName;
+
+    // the timer driving the animations is per thread
+    m_animationDriver = new StepAnimationDriver;
+    m_animationDriver->install();
+
+    m_engine = new QQmlEngine;
+    m_renderControl = new QQuickRenderControl;
+    m_window = new QQuickWindow(m_renderControl);
+    m_window->setGraphicsDevice(QQuickGraphicsDevice::fromRhi(m_rhi));
+    if (!m_renderControl->initialize()) {
+        qWarning("Batch: failed to initialize QQuickRenderControl");
+        m_failureCount = 1;
+    } else {
+        Job job;
+        int index;
+        while (m_queue->take(&job, &index)) {
+            if (!renderJob(job, index))
+                ++m_failureCount;
+        }
+    }
+
+    // the scenegraph goes first, with the QRhi resources of the items
+    delete m_renderControl;
+    delete m_window;
+    delete m_engine;
+    releaseRenderTarget();
+    m_animationDriver->uninstall();
+    delete m_animationDriver;
+    delete m_rhi;
+}
+
+bool BatchWorker::ensureRenderTarget(const QSize &size)
+{
+    if (m_texture && m_texture->pixelSize() == size)
+        return true;
+
+    releaseRenderTarget();
+    m_texture = m_rhi->newTexture(QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+    m_depthStencil = m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, size, 1);
+    if (!m_texture->create() || !m_depthStencil->create()) {
+        qWarning("Batch: failed to create a texture of size %dx%d", size.width(), size.height());
+        return false;
+    }
+    QRhiTextureRenderTargetDescription desc { QRhiColorAttachment(m_texture) };
+    desc.setDepthStencilBuffer(m_depthStencil);
+    m_rt = m_rhi->newTextureRenderTarget(desc);
+    m_rp = m_rt->newCompatibleRenderPassDescriptor();
+    m_rt->setRenderPassDescriptor(m_rp);
+    if (!m_rt->create()) {
+        qWarning("Batch: failed to create a render target of size %dx%d", size.width(), size.height());
+        return false;
+    }
+    m_window->setRenderTarget(QQuickRenderTarget::fromRhiRenderTarget(m_rt));
+    return true;
+}
+
+void BatchWorker::releaseRenderTarget()
+{
+    delete m_rt;
+    m_rt = nullptr;
+    delete m_rp;
+    m_rp = nullptr;
+    delete m_depthStencil;
+    m_depthStencil = nullptr;
+    delete m_texture;
+    m_texture = nullptr;
+}
+
+bool BatchWorker::renderJob(const Job &job, int index)
+{
+    QQmlComponent component(m_engine, job.source);
+    if (component.isLoading()) {
+        QEventLoop loop;
+        QObject::connect(&component, &QQmlComponent::statusChanged, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    if (!component.isReady()) {
+        qWarning("Batch: failed to load %s: %s", qPrintable(job.source.toString()), qPrintable(component.errorString()));
+        return false;
+    }
+    QScopedPointer<QObject> object(component.createWithInitialProperties(job.properties, m_engine->rootContext()));
+    QQuickItem *root = qobject_cast<QQuickItem *>(object.data());
+    if (!root) {
+        qWarning("Batch: the root object of %s is not an item", qPrintable(job.source.toString()));
+        return false;
+    }
+    if (!ensureRenderTarget(job.size)) {
+        // the window may still refer to the previous render target
+        m_window->setRenderTarget(QQuickRenderTarget());
+        return false;
+    }
+
+    m_window->setGeometry(0, 0, job.size.width(), job.size.height());
+    m_window->contentItem()->setSize(job.size);
+    root->setParentItem(m_window->contentItem());
+    root->setSize(job.size);
+    m_animationDriver->setInterval(1000 / job.fps);
+
+    QString pattern = job.output.isEmpty() ? QString::number(index) + QLatin1String("-%1.png") : job.output;
+    if (!pattern.contains(QLatin1String("%1"))) {
+        const QFileInfo fi(pattern);
+        pattern = fi.path() + QLatin1Char('/') + fi.completeBaseName() + QLatin1String("-%1.") + fi.suffix();
+    }
+
+    const bool mirror = m_rhi->isYUpInFramebuffer();
+    for (int frame = 0; frame < job.frames; ++frame) {
+        // timers, image loading, and the items' update requests
+        QCoreApplication::processEvents();
+        m_animationDriver->advance();
+
+        m_renderControl->polishItems();
+        m_renderControl->beginFrame();
+        m_renderControl->sync();
+        m_renderControl->render();
+        // Offscreen frames complete in endFrame(), the readback is done by
+        // then, and the pixels move on to the encoder.
+        QRhiReadbackResult readback;
+        readback.completed = [this, &readback, &pattern, frame, mirror] {
+            if (m_outputDir.isEmpty())
+                return;
+            const QString fileName = QDir(m_outputDir).filePath(pattern.arg(frame, 4, 10, QLatin1Char('0')));
+            m_encoder->write(readback.data, readback.pixelSize, mirror, fileName);
+        };
+        QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+        rub->readBackTexture({ m_texture }, &readback);
+        m_renderControl->commandBuffer()->resourceUpdate(rub);
+        m_renderControl->endFrame();
+        ++m_frameCount;
+    }
+
+    root->setParentItem(nullptr);
+    return true;
+}
+
+QString stringArgument(const QStringList &args, const QString &name, const QString &defaultValue = QString())
+{
+    for (const QString &arg : args) {
+        if (arg.startsWith(name))
+            return arg.mid(name.size());
+    }
+    return defaultValue;
+}
+
+bool loadJobs(const QString &fileName, QList<Job> *jobs)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("Batch: failed to open %s", qPrintable(fileName));
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &error);
+    if (!doc.isArray()) {
+        qWarning("Batch: %s is not a JSON array of jobs: %s", qPrintable(fileName), qPrintable(error.errorString()));
+        return false;
+    }
+    // relative sources are relative to the job file
+    const QUrl base = QUrl::fromLocalFile(QFileInfo(fileName).absoluteFilePath());
+    const QJsonArray array = doc.array();
+    for (const QJsonValue &v : array) {
+        const QJsonObject o = v.toObject();
+        Job job;
+        job.source = base.resolved(QUrl(o.value(QLatin1String("source")).toString()));
+        job.properties = o.value(QLatin1String("properties")).toObject().toVariantMap();
+        const QJsonArray size = o.value(QLatin1String("size")).toArray();
+        job.size = QSize(size.at(0).toInt(), size.at(1).toInt());
+        job.frames = o.value(QLatin1String("frames")).toInt(1);
+        job.fps = o.value(QLatin1String("fps")).toInt(60);
+        job.output = o.value(QLatin1String("output")).toString();
+        if (job.source.isEmpty() || job.size.isEmpty() || job.frames <= 0 || job.fps <= 0) {
+            qWarning("Batch: job %d in %s needs a source, a size, and positive frames and fps",
+                     int(jobs->count()), qPrintable(fileName));
+            return false;
+        }
+        jobs->append(job);
+    }
+    return true;
+}
+
+} // namespace
+
+int runBatchRender(const QStringList &args)
+{
+    QList<Job> jobs;
+    if (!loadJobs(stringArgument(args, QLatin1String("--batch=")), &jobs))
+        return 1;
+
+    const QString backendName = stringArgument(args, QLatin1String("--batch-backend="), QLatin1String("null"));
+    QRhi::Implementation backend;
+    if (backendName == QLatin1String("null")) {
+        backend = QRhi::Null;
+        QQuickWindow::setGraphicsApi(QSGRendererInterface::Null);
+    } else if (backendName == QLatin1String("gl")) {
+        backend = QRhi::OpenGLES2;
+        QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL);
+    } else {
+        qWarning("Batch: unknown backend %s, use null or gl", qPrintable(backendName));
+        return 1;
+    }
+
+    const QString outputDir = stringArgument(args, QLatin1String("--batch-output="));
+    if (!outputDir.isEmpty() && !QDir().mkpath(outputDir)) {
+        qWarning("Batch: failed to create %s", qPrintable(outputDir));
+        return 1;
+    }
+
+    // Each frame is read back, so it has to be complete: the renderers'
+    // uploads are not spread over frames and their initialization is not
+    // deferred. The frame schedulers read these when they are created.
+    qputenv("QSG_RHIITEM_UPLOAD_BUDGET", QByteArray::number(std::numeric_limits<quint64>::max()));
+    qunsetenv("QSG_RHIITEM_INIT_BUDGET");
+
+    int threadCount = stringArgument(args, QLatin1String("--batch-threads=")).toInt();
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    threadCount = qMin(threadCount, int(jobs.count()));
+
+    JobQueue queue(jobs);
+    Encoder encoder(2 * QThread::idealThreadCount());
+    QList<QOffscreenSurface *> fallbackSurfaces;
+    QList<BatchWorker *> workers;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < threadCount; ++i) {
+        // created on the GUI thread, used by the OpenGL context of the worker
+        QOffscreenSurface *fallbackSurface = nullptr;
+#if QT_CONFIG(opengl)
+        if (backend == QRhi::OpenGLES2)
+            fallbackSurface = QRhiGles2InitParams::newFallbackSurface();
+#endif
+        fallbackSurfaces.append(fallbackSurface);
+        workers.append(new BatchWorker(&queue, &encoder, outputDir, backend, fallbackSurface));
+        workers.last()->start();
+    }
+
+    int frames = 0;
+    int failures = 0;
+    for (BatchWorker *worker : std::as_const(workers)) {
+        worker->wait();
+        frames += worker->frameCount();
+        failures += worker->failureCount();
+    }
+    failures += encoder.waitForDone();
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const double seconds = elapsed / 1000000000.0;
+    qDebug("batch: %d jobs, %d frames on %d threads (%s, %s) in %.3f s: %.2f frames/s, %.2f frames/s per thread%s",
+           int(jobs.count()), frames, threadCount, qPrintable(backendName),
+           workers.isEmpty() ? "" : workers.first()->deviceName().constData(),
+           seconds, frames / seconds, frames / seconds / qMax(1, threadCount),
+           failures ? "  FAIL" : "");
+    for (int i = 0; i < workers.count(); ++i)
+        qDebug("  thread %d: %d frames", i, workers[i]->frameCount());
+
+    qDeleteAll(workers);
+    qDeleteAll(fallbackSurfaces);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+#ifndef BATCHRENDER_H
+#define BATCHRENDER_H
+
+class QStringList;
+
+int runBatchRender(const QStringList &args);
+
+#endif
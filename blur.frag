@@ -0,0 +1,30 @@
+#version 440
+
+layout(location = 0) in vec2 v_texcoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform effect {
+    vec2 texelSize;
+    int flipY;
+};
+
+layout(binding = 1) uniform sampler2D source;
+
+layout(std140, binding = 2) uniform params {
+    vec2 direction;
+    float radius;
+};
+
+void main()
+{
+    // 9 taps of a separable gaussian, run once horizontally and once vertically
+    const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+    vec2 step = direction * texelSize * radius;
+    vec4 c = texture(source, v_texcoord) * weights[0];
+    for (int i = 1; i < 5; ++i) {
+        c += texture(source, v_texcoord + step * float(i)) * weights[i];
+        c += texture(source, v_texcoord - step * float(i)) * weights[i];
+    }
+    fragColor = c;
+}
@@ -1,65 +1,54 @@
 #include "customrhiitem.h"
 #include "cube.h"
+#include "rhiitemcapture.h"
+#include "rhiitempipelinecache.h"
 #include <QFile>
+#include <QMouseEvent>
 #include <QPainter>
 
 static const QSize CUBE_TEX_SIZE(512, 512);
 
+using TestUniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Mat4, QQuickRhiItemStd140::Int>;
+static_assert(offsetof(TestUniforms, mvp) == TestUniformsLayout::offset<0>);
+static_assert(offsetof(TestUniforms, flip) == TestUniformsLayout::offset<1>);
+static_assert(sizeof(TestUniforms) == TestUniformsLayout::size);
+
 void TestRenderer::initialize(QRhi *rhi, QRhiTexture *outputTexture)
 {
     m_rhi = rhi;
     m_output = outputTexture;
 
-    if (!m_ds) {
-        m_ds.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, m_output->pixelSize()));
-        m_ds->create();
-    } else if (m_ds->pixelSize() != m_output->pixelSize()) {
-        m_ds->setPixelSize(m_output->pixelSize());
-        m_ds->create();
-    }
-
-    if (!m_rt) {
-        m_rt.reset(m_rhi->newTextureRenderTarget({ { m_output }, m_ds.data() }));
-        m_rp.reset(m_rt->newCompatibleRenderPassDescriptor());
-        m_rt->setRenderPassDescriptor(m_rp.data());
-        m_rt->create();
-    }
-
-    if (!scene.vbuf) {
-        initScene();
-        updateCubeTexture();
+    // The depth buffer and the render target follow the output texture via
+    // the graph, also when a recycled renderer gets a different one.
+    if (!m_graph) {
+        m_graph.reset(new QQuickRhiItemRenderGraph);
+        const int depth = m_graph->addDepthStencil("depth");
+        m_cubePass = m_graph->addPass({ "cube", {}, { QQuickRhiItemRenderGraph::Output }, depth, Qt::transparent,
+                                        [this](QRhiRenderPassDescriptor *rp) { initScene(rp); },
+                                        [this](QQuickRhiItemCommandRecorder &cb, const QSize &pixelSize) { drawCube(cb, pixelSize); } });
     }
+    m_graph->initialize(m_rhi, m_output);
 
     const QSize outputSize = m_output->pixelSize();
     scene.mvp = m_rhi->clipSpaceCorrMatrix();
     scene.mvp.perspective(45.0f, outputSize.width() / (float) outputSize.height(), 0.01f, 1000.0f);
     scene.mvp.translate(0, 0, -4);
-    updateMvp();
+    scene.mvpDirty = true;
 }
 
 void TestRenderer::updateMvp()
 {
-    QMatrix4x4 mvp = scene.mvp * QMatrix4x4(QQuaternion::fromEulerAngles(itemData.cubeRotation).toRotationMatrix());
-    if (!scene.resourceUpdates)
-        scene.resourceUpdates = m_rhi->nextResourceUpdateBatch();
-    scene.resourceUpdates->updateDynamicBuffer(scene.ubuf.data(), 0, 64, mvp.constData());
+    const QVector3D rotation = itemData.cubeRotation + itemData.latchedDragRotation;
+    scene.uniforms.set(&TestUniforms::mvp, scene.mvp * QMatrix4x4(QQuaternion::fromEulerAngles(rotation).toRotationMatrix()));
 }
 
 void TestRenderer::updateCubeTexture()
 {
-    QImage image(CUBE_TEX_SIZE, QImage::Format_RGBA8888);
-    const QRect r(QPoint(0, 0), CUBE_TEX_SIZE);
-    QPainter p(&image);
-    p.fillRect(r, QGradient::DeepBlue);
-    QFont font;
-    font.setPointSize(24);
-    p.setFont(font);
-    p.drawText(r, itemData.message);
-    p.end();
-
-    if (!scene.resourceUpdates)
-        scene.resourceUpdates = m_rhi->nextResourceUpdateBatch();
-    scene.resourceUpdates->uploadTexture(scene.cubeTex.data(), image);
+    // Only the vertex data of the text changes, the background is a static
+    // texture and the glyphs are in the atlas. The texture is then rendered
+    // in render().
+    scene.text->setText(itemData.message);
+    scene.cubeTexDirty = true;
 }
 
 static QShader getShader(const QString &name)
@@ -71,23 +60,97 @@ static QShader getShader(const QString &name)
     return QShader();
 }
 
-void TestRenderer::initScene()
+static void registerPipeline()
+{
+    QQuickRhiItemPipelineCache::GraphicsPipelineDescription desc;
+    desc.setup = [](QRhi *, QRhiGraphicsPipeline *ps) {
+        ps->setDepthTest(true);
+        ps->setDepthWrite(true);
+        ps->setDepthOp(QRhiGraphicsPipeline::Less);
+        ps->setCullMode(QRhiGraphicsPipeline::Back);
+        ps->setFrontFace(QRhiGraphicsPipeline::CCW);
+        QShader vs = getShader(QLatin1String(":/texture.vert.qsb"));
+        Q_ASSERT(vs.isValid());
+        QShader fs = getShader(QLatin1String(":/texture.frag.qsb"));
+        Q_ASSERT(fs.isValid());
+        ps->setShaderStages({
+            { QRhiShaderStage::Vertex, vs },
+            { QRhiShaderStage::Fragment, fs }
+        });
+        QRhiVertexInputLayout inputLayout;
+        inputLayout.setBindings({
+            { 3 * sizeof(float) },
+            { 2 * sizeof(float) }
+        });
+        inputLayout.setAttributes({
+            { 0, 0, QRhiVertexInputAttribute::Float3, 0 },
+            { 1, 1, QRhiVertexInputAttribute::Float2, 0 }
+        });
+        ps->setVertexInputLayout(inputLayout);
+    };
+    desc.bindingLayout = {
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, nullptr),
+        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, nullptr, nullptr)
+    };
+    // the cube pass renders into the output texture, with a depth buffer
+    desc.colorFormat = QRhiTexture::RGBA8;
+    desc.depthStencil = true;
+    QQuickRhiItemPipelineCache::registerGraphicsPipeline("TestRenderer", desc);
+}
+Q_CONSTRUCTOR_FUNCTION(registerPipeline)
+
+void TestRenderer::initScene(QRhiRenderPassDescriptor *rp)
 {
+    // the pipeline is shared by all test items, and usually prewarmed
+    scene.ps = QQuickRhiItemPipelineCache::get(m_rhi)->graphicsPipeline("TestRenderer", rp);
+    if (scene.vbuf) {
+        // a rebuild of the graph, the render pass only changes with the
+        // format of the output, and the other resources not at all
+        return;
+    }
+
     scene.vbuf.reset(m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(cube)));
     scene.vbuf->create();
 
     scene.resourceUpdates = m_rhi->nextResourceUpdateBatch();
     scene.resourceUpdates->uploadStaticBuffer(scene.vbuf.data(), cube);
 
-    scene.ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, 68));
+    scene.ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, scene.uniforms.size()));
     scene.ubuf->create();
+    scene.uniforms.markAllDirty();
 
-    const qint32 flip = m_rhi->isYUpInFramebuffer() ? 1 : 0;
-    scene.resourceUpdates->updateDynamicBuffer(scene.ubuf.data(), 64, 4, &flip);
+    scene.uniforms.set(&TestUniforms::flip, m_rhi->isYUpInFramebuffer() ? 1 : 0);
 
-    scene.cubeTex.reset(m_rhi->newTexture(QRhiTexture::RGBA8, CUBE_TEX_SIZE));
+    scene.backgroundTex.reset(m_rhi->newTexture(QRhiTexture::RGBA8, CUBE_TEX_SIZE, 1, QRhiTexture::UsedAsTransferSource));
+    scene.backgroundTex->create();
+    uploadBackground();
+
+    scene.cubeTex.reset(m_rhi->newTexture(QRhiTexture::RGBA8, CUBE_TEX_SIZE, 1, QRhiTexture::RenderTarget));
     scene.cubeTex->create();
 
+    // the text is drawn over a copy of the background
+    QRhiColorAttachment cubeTexColor(scene.cubeTex.data());
+    scene.cubeTexRt.reset(m_rhi->newTextureRenderTarget({ cubeTexColor }, QRhiTextureRenderTarget::PreserveColorContents));
+    scene.cubeTexRp.reset(scene.cubeTexRt->newCompatibleRenderPassDescriptor());
+    scene.cubeTexRt->setRenderPassDescriptor(scene.cubeTexRp.data());
+    scene.cubeTexRt->create();
+
+    scene.text.reset(new QQuickRhiItemText(m_rhi));
+    QFont font;
+    font.setPointSize(24);
+    scene.text->setFont(font);
+    scene.text->setColor(Qt::black);
+    scene.text->create(scene.cubeTexRp.data());
+    // Rendering into the texture must produce the same layout as uploading
+    // an image would, that is, with the top row at the start of the data.
+    // With OpenGL that is the bottom of the framebuffer.
+    QMatrix4x4 textMatrix = m_rhi->clipSpaceCorrMatrix();
+    if (m_rhi->isYUpInFramebuffer())
+        textMatrix.ortho(0, CUBE_TEX_SIZE.width(), 0, CUBE_TEX_SIZE.height(), -1, 1);
+    else
+        textMatrix.ortho(0, CUBE_TEX_SIZE.width(), CUBE_TEX_SIZE.height(), 0, -1, 1);
+    scene.text->setMatrix(textMatrix);
+
     scene.sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
                                                QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
     scene.sampler->create();
@@ -99,33 +162,39 @@ void TestRenderer::initScene()
     });
     scene.srb->create();
 
-    scene.ps.reset(m_rhi->newGraphicsPipeline());
-    scene.ps->setDepthTest(true);
-    scene.ps->setDepthWrite(true);
-    scene.ps->setDepthOp(QRhiGraphicsPipeline::Less);
-    scene.ps->setCullMode(QRhiGraphicsPipeline::Back);
-    scene.ps->setFrontFace(QRhiGraphicsPipeline::CCW);
-    QShader vs = getShader(QLatin1String(":/texture.vert.qsb"));
-    Q_ASSERT(vs.isValid());
-    QShader fs = getShader(QLatin1String(":/texture.frag.qsb"));
-    Q_ASSERT(fs.isValid());
-    scene.ps->setShaderStages({
-        { QRhiShaderStage::Vertex, vs },
-        { QRhiShaderStage::Fragment, fs }
-    });
-    QRhiVertexInputLayout inputLayout;
-    inputLayout.setBindings({
-        { 3 * sizeof(float) },
-        { 2 * sizeof(float) }
-    });
-    inputLayout.setAttributes({
-        { 0, 0, QRhiVertexInputAttribute::Float3, 0 },
-        { 1, 1, QRhiVertexInputAttribute::Float2, 0 }
-    });
-    scene.ps->setVertexInputLayout(inputLayout);
-    scene.ps->setShaderResourceBindings(scene.srb.data());
-    scene.ps->setRenderPassDescriptor(m_rp.data());
-    scene.ps->create();
+    updateCubeTexture();
+}
+
+void TestRenderer::uploadBackground()
+{
+    // 1 MB per item, spread over multiple frames when many items start up
+    // at the same time
+    QImage image(CUBE_TEX_SIZE, QImage::Format_RGBA8888);
+    QPainter p(&image);
+    p.fillRect(QRect(QPoint(0, 0), CUBE_TEX_SIZE), QGradient::DeepBlue);
+    p.end();
+    scheduleTextureUpload(scene.backgroundTex.data(), QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(image)));
+}
+
+void TestRenderer::textureUploaded(QRhiTexture *texture)
+{
+    if (texture == scene.backgroundTex.data()) {
+        scene.backgroundReady = true;
+        scene.cubeTexDirty = true;
+        update();
+    }
+}
+
+void TestRenderer::reset()
+{
+    // a pending upload is dropped together with the previous item's node,
+    // or still pending when the item was reused with its node
+    if (scene.backgroundTex && !scene.backgroundReady) {
+        cancelTextureUploads(scene.backgroundTex.data());
+        uploadBackground();
+    }
+    // the channel belongs to the previous item
+    itemData.dragRotation = QQuickRhiItemChannel<QVector3D>();
 }
 
 void TestRenderer::synchronize(QQuickRhiItem *rhiItem)
@@ -133,7 +202,13 @@ void TestRenderer::synchronize(QQuickRhiItem *rhiItem)
     TestRhiItem *item = static_cast<TestRhiItem *>(rhiItem);
     if (item->cubeRotation() != itemData.cubeRotation) {
         itemData.cubeRotation = item->cubeRotation();
-        updateMvp();
+        scene.mvpDirty = true;
+    }
+    if (!itemData.dragRotation.isValid()) {
+        // a new renderer, or a recycled one after reset()
+        itemData.dragRotation = item->dragRotation;
+        itemData.latchedDragRotation = item->currentDragRotation();
+        scene.mvpDirty = true;
     }
     if (item->message() != itemData.message) {
         itemData.message = item->message();
@@ -143,29 +218,88 @@ void TestRenderer::synchronize(QQuickRhiItem *rhiItem)
         itemData.transparentBackground = item->transparentBackground();
 }
 
-void TestRenderer::render(QRhiCommandBuffer *cb)
+void TestRenderer::prepare()
+{
+    // runs on a worker thread, no QRhi calls here
+    if (scene.mvpDirty)
+        updateMvp();
+}
+
+void TestRenderer::render(QRhiCommandBuffer *commandBuffer)
 {
+    QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+
     QRhiResourceUpdateBatch *rub = scene.resourceUpdates;
     if (rub)
         scene.resourceUpdates = nullptr;
 
+    // late latch: the newest drag rotation, published after the prepare phase
+    // or even after synchronize(), is applied to this frame
+    if (itemData.dragRotation.takeLatest()) {
+        itemData.latchedDragRotation = itemData.dragRotation.latest();
+        updateMvp();
+    }
+
+    scene.mvpDirty = false;
+    if (scene.uniforms.isDirty()) {
+        if (!rub)
+            rub = m_rhi->nextResourceUpdateBatch();
+        scene.uniforms.commit(rub, scene.ubuf.data());
+    }
+
+    if (scene.cubeTexDirty && scene.backgroundReady) {
+        scene.cubeTexDirty = false;
+        if (!rub)
+            rub = m_rhi->nextResourceUpdateBatch();
+        rub->copyTexture(scene.cubeTex.data(), scene.backgroundTex.data());
+        scene.text->prepare(rub);
+        cb.beginPass(scene.cubeTexRt.data(), Qt::transparent, { 1.0f, 0 }, rub);
+        scene.text->draw(cb, QRhiViewport(0, 0, CUBE_TEX_SIZE.width(), CUBE_TEX_SIZE.height()));
+        cb.endPass();
+        rub = nullptr;
+    }
+
     const QColor clearColor = itemData.transparentBackground ? Qt::transparent
                                                              : QColor::fromRgbF(0.4f, 0.7f, 0.0f, 1.0f);
+    m_graph->setClearColor(m_cubePass, clearColor);
+    m_graph->render(cb, rub);
+}
 
-    cb->beginPass(m_rt.data(), clearColor, { 1.0f, 0 }, rub);
+void TestRenderer::drawCube(QQuickRhiItemCommandRecorder &cb, const QSize &pixelSize)
+{
+    // nothing to texture the cube with until the background is uploaded
+    if (!scene.backgroundReady || !scene.ps)
+        return;
 
-    cb->setGraphicsPipeline(scene.ps.data());
-    const QSize outputSize = m_output->pixelSize();
-    cb->setViewport(QRhiViewport(0, 0, outputSize.width(), outputSize.height()));
-    cb->setShaderResources();
+    cb.setGraphicsPipeline(scene.ps);
+    cb.setViewport(QRhiViewport(0, 0, pixelSize.width(), pixelSize.height()));
+    cb.setShaderResources(scene.srb.data());
     const QRhiCommandBuffer::VertexInput vbufBindings[] = {
         { scene.vbuf.data(), 0 },
         { scene.vbuf.data(), quint32(36 * 3 * sizeof(float)) }
     };
-    cb->setVertexInput(0, 2, vbufBindings);
-    cb->draw(36);
+    cb.setVertexInput(0, 2, vbufBindings);
+    cb.draw(36);
+}
+
+TestRhiItem::TestRhiItem(QQuickItem *parent)
+    : QQuickRhiItem(parent)
+{
+    setAcceptedMouseButtons(Qt::LeftButton);
+}
 
-    cb->endPass();
+void TestRhiItem::mousePressEvent(QMouseEvent *event)
+{
+    m_dragPos = event->position();
+}
+
+void TestRhiItem::mouseMoveEvent(QMouseEvent *event)
+{
+    const QPointF delta = event->position() - m_dragPos;
+    m_dragPos = event->position();
+    m_dragRotation += QVector3D(delta.y(), delta.x(), 0) * 0.5f;
+    // no update(), publishing schedules a render without a sync
+    dragRotation.publish(m_dragRotation);
 }
 
 void TestRhiItem::setCubeRotation(const QVector3D &v)
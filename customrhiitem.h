@@ -2,40 +2,67 @@
 #define CUSTOMRHIITEM_H
 
 #include "rhiitem.h"
+#include "rhiitemchannel.h"
+#include "rhiitemrendergraph.h"
+#include "rhiitemtext.h"
+#include "rhiitemuniformblock.h"
 #include <QtGui/private/qrhi_p.h>
 
+class QQuickRhiItemCommandRecorder;
+
+// the uniform block of texture.vert and texture.frag
+struct TestUniforms
+{
+    QQuickRhiItemStd140::Mat4 mvp;
+    QQuickRhiItemStd140::Int flip;
+};
+
 class TestRenderer : public QQuickRhiItemRenderer
 {
 public:
     void initialize(QRhi *rhi, QRhiTexture *outputTexture) override;
     void synchronize(QQuickRhiItem *item) override;
+    void prepare() override;
     void render(QRhiCommandBuffer *cb) override;
+    void reset() override;
+    void textureUploaded(QRhiTexture *texture) override;
 
 private:
     QRhi *m_rhi = nullptr;
     QRhiTexture *m_output = nullptr;
-    QScopedPointer<QRhiRenderBuffer> m_ds;
-    QScopedPointer<QRhiTextureRenderTarget> m_rt;
-    QScopedPointer<QRhiRenderPassDescriptor> m_rp;
+    QScopedPointer<QQuickRhiItemRenderGraph> m_graph;
+    int m_cubePass = -1;
 
     struct {
         QRhiResourceUpdateBatch *resourceUpdates = nullptr;
         QScopedPointer<QRhiBuffer> vbuf;
         QScopedPointer<QRhiBuffer> ubuf;
+        QQuickRhiItemUniformBlock<TestUniforms> uniforms;
         QScopedPointer<QRhiShaderResourceBindings> srb;
-        QScopedPointer<QRhiGraphicsPipeline> ps;
+        QRhiGraphicsPipeline *ps = nullptr; // owned by the pipeline cache
         QScopedPointer<QRhiSampler> sampler;
+        QScopedPointer<QRhiTexture> backgroundTex;
         QScopedPointer<QRhiTexture> cubeTex;
+        QScopedPointer<QRhiTextureRenderTarget> cubeTexRt;
+        QScopedPointer<QRhiRenderPassDescriptor> cubeTexRp;
+        QScopedPointer<QQuickRhiItemText> text;
+        bool backgroundReady = false;
+        bool cubeTexDirty = true;
         QMatrix4x4 mvp;
+        bool mvpDirty = true;
     } scene;
 
     struct {
         QVector3D cubeRotation;
+        QQuickRhiItemChannel<QVector3D> dragRotation;
+        QVector3D latchedDragRotation;
         QString message;
         bool transparentBackground = false;
     } itemData;
 
-    void initScene();
+    void initScene(QRhiRenderPassDescriptor *rp);
+    void drawCube(QQuickRhiItemCommandRecorder &cb, const QSize &pixelSize);
+    void uploadBackground();
     void updateMvp();
     void updateCubeTexture();
 };
@@ -50,6 +77,8 @@ class TestRhiItem : public QQuickRhiItem
     Q_PROPERTY(bool transparentBackground READ transparentBackground WRITE setTransparentBackground NOTIFY transparentBackgroundChanged)
 
 public:
+    TestRhiItem(QQuickItem *parent = nullptr);
+
     QQuickRhiItemRenderer *createRenderer() override { return new TestRenderer; }
 
     QVector3D cubeRotation() const { return m_cubeRotation; }
@@ -61,6 +90,16 @@ public:
     bool transparentBackground() const { return m_transparentBackground; }
     void setTransparentBackground(bool b);
 
+    // The rotation applied by dragging with the mouse, on top of
+    // cubeRotation. Published on every move event and latched by the
+    // renderer right before recording, without a synchronize().
+    QQuickRhiItemChannel<QVector3D> dragRotation { this };
+    QVector3D currentDragRotation() const { return m_dragRotation; }
+
+protected:
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
 signals:
     void cubeRotationChanged();
     void messageChanged();
@@ -70,6 +109,8 @@ private:
     QVector3D m_cubeRotation;
     QString m_message;
     bool m_transparentBackground;
+    QPointF m_dragPos;
+    QVector3D m_dragRotation;
 };
 
 #endif
@@ -0,0 +1,22 @@
+#version 440
+
+layout(location = 0) out vec2 v_texcoord;
+
+layout(std140, binding = 0) uniform effect {
+    vec2 texelSize;
+    int flipY;
+};
+
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+    // one triangle covering the viewport
+    vec2 pos = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    v_texcoord = pos;
+    // the top row of the source is at the start of its data, as is the top
+    // row of the output
+    if (flipY != 0)
+        v_texcoord.y = 1.0 - v_texcoord.y;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 440
+
+layout(location = 0) in vec2 v_pixel;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    vec2 center;
+    float scale;
+    int maxIterations;
+    vec2 outputSize;
+    int flipY;
+};
+
+// keep in sync with fractal.comp
+vec4 fractalColor(vec2 pixel)
+{
+    vec2 c = center + (pixel - 0.5 * outputSize) * vec2(scale, -scale);
+    vec2 z = vec2(0.0);
+    int i = 0;
+    for (; i < maxIterations && dot(z, z) < 16.0; ++i)
+        z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
+    if (i == maxIterations)
+        return vec4(0.0, 0.0, 0.0, 1.0);
+    // smooth iteration count
+    float t = (float(i) + 1.0 - log2(log2(dot(z, z)) * 0.5)) / float(maxIterations);
+    return vec4(0.5 + 0.5 * cos(6.2832 * (t * 4.0 + vec3(0.0, 0.33, 0.67))), 1.0);
+}
+
+void main()
+{
+    fragColor = fractalColor(v_pixel);
+}
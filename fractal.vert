@@ -0,0 +1,25 @@
+#version 440
+
+layout(location = 0) out vec2 v_pixel;
+
+layout(std140, binding = 0) uniform buf {
+    vec2 center;
+    float scale;
+    int maxIterations;
+    vec2 outputSize;
+    int flipY;
+};
+
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+    // one triangle covering the viewport, with the same pixel rows as
+    // fractal.comp writes
+    vec2 pos = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    v_pixel = pos;
+    if (flipY != 0)
+        v_pixel.y = 1.0 - v_pixel.y;
+    v_pixel *= outputSize;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
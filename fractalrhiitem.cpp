@@ -0,0 +1,210 @@
+#include "fractalrhiitem.h"
+#include "rhiitemcapture.h"
+#include <QFile>
+
+/*
+    A Mandelbrot set view, computed per pixel. With computeOutput enabled,
+    and where compute is supported, fractal.comp writes the output texture
+    directly as a storage image. Otherwise fractal.frag computes the same
+    pixels in a full-screen triangle, so both paths give the same image.
+
+    The contents are preserved between renders, and only the damage region
+    is redrawn, which is empty unless the view changed. The raster path
+    restricts the triangle to it with scissors, the compute path writes the
+    whole texture.
+ */
+
+static const int LOCAL_SIZE = 16; // fractal.comp
+
+using FractalUniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Vec2, QQuickRhiItemStd140::Float,
+                                                          QQuickRhiItemStd140::Int, QQuickRhiItemStd140::Vec2,
+                                                          QQuickRhiItemStd140::Int>;
+static_assert(offsetof(FractalUniforms, center) == FractalUniformsLayout::offset<0>);
+static_assert(offsetof(FractalUniforms, scale) == FractalUniformsLayout::offset<1>);
+static_assert(offsetof(FractalUniforms, maxIterations) == FractalUniformsLayout::offset<2>);
+static_assert(offsetof(FractalUniforms, outputSize) == FractalUniformsLayout::offset<3>);
+static_assert(offsetof(FractalUniforms, flipY) == FractalUniformsLayout::offset<4>);
+
+static QShader getShader(const QString &name)
+{
+    QFile f(name);
+    if (f.open(QIODevice::ReadOnly))
+        return QShader::fromSerialized(f.readAll());
+
+    return QShader();
+}
+
+void FractalRenderer::initialize(QRhi *rhi, QRhiTexture *outputTexture)
+{
+    m_rhi = rhi;
+    m_output = outputTexture;
+    m_compute = computeOutput();
+
+    if (!scene.ubuf) {
+        scene.ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, scene.uniforms.size()));
+        scene.ubuf->create();
+        // y = -1 in NDC is the first row of the framebuffer with OpenGL and
+        // Vulkan, but the last one with Direct 3D and Metal
+        scene.uniforms.set(&FractalUniforms::flipY, m_rhi->isYUpInNDC() != m_rhi->isYUpInFramebuffer() ? 1 : 0);
+    }
+    const QSize size = m_output->pixelSize();
+    scene.uniforms.set(&FractalUniforms::outputSize, QQuickRhiItemStd140::Vec2 { { float(size.width()), float(size.height()) } });
+
+    if (m_compute)
+        initCompute();
+    else
+        initRaster();
+}
+
+void FractalRenderer::initCompute()
+{
+    // the image binding refers to the texture, which may be a new one
+    if (!scene.computeSrb)
+        scene.computeSrb.reset(m_rhi->newShaderResourceBindings());
+    scene.computeSrb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, scene.ubuf.data()),
+        QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, m_output, 0)
+    });
+    scene.computeSrb->create();
+
+    if (!scene.computePs) {
+        scene.computePs.reset(m_rhi->newComputePipeline());
+        QShader cs = getShader(QLatin1String(":/fractal.comp.qsb"));
+        Q_ASSERT(cs.isValid());
+        scene.computePs->setShaderStage({ QRhiShaderStage::Compute, cs });
+        scene.computePs->setShaderResourceBindings(scene.computeSrb.data());
+        scene.computePs->create();
+    }
+}
+
+void FractalRenderer::initRaster()
+{
+    // toggling preserveContents keeps the texture, but needs other load flags
+    const bool preserve = preserveContents();
+    if (!scene.rt || scene.rtPreserve != preserve) {
+        scene.rt.reset(m_rhi->newTextureRenderTarget({ m_output }, preserve ? QRhiTextureRenderTarget::PreserveColorContents
+                                                                            : QRhiTextureRenderTarget::Flags()));
+        scene.rp.reset(scene.rt->newCompatibleRenderPassDescriptor());
+        scene.rt->setRenderPassDescriptor(scene.rp.data());
+        scene.rtPreserve = preserve;
+        if (scene.ps) {
+            scene.ps->setRenderPassDescriptor(scene.rp.data());
+            scene.ps->create();
+        }
+    } else {
+        scene.rt->setDescription({ m_output });
+    }
+    scene.rt->create();
+
+    if (scene.ps)
+        return;
+
+    scene.srb.reset(m_rhi->newShaderResourceBindings());
+    scene.srb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, scene.ubuf.data())
+    });
+    scene.srb->create();
+
+    scene.ps.reset(m_rhi->newGraphicsPipeline());
+    scene.ps->setFlags(QRhiGraphicsPipeline::UsesScissor);
+    QShader vs = getShader(QLatin1String(":/fractal.vert.qsb"));
+    Q_ASSERT(vs.isValid());
+    QShader fs = getShader(QLatin1String(":/fractal.frag.qsb"));
+    Q_ASSERT(fs.isValid());
+    scene.ps->setShaderStages({
+        { QRhiShaderStage::Vertex, vs },
+        { QRhiShaderStage::Fragment, fs }
+    });
+    scene.ps->setShaderResourceBindings(scene.srb.data());
+    scene.ps->setRenderPassDescriptor(scene.rp.data());
+    scene.ps->create();
+}
+
+void FractalRenderer::synchronize(QQuickRhiItem *rhiItem)
+{
+    FractalRhiItem *item = static_cast<FractalRhiItem *>(rhiItem);
+    itemData.center = item->center();
+    itemData.zoom = item->zoom();
+    itemData.maxIterations = item->maxIterations();
+}
+
+void FractalRenderer::render(QRhiCommandBuffer *commandBuffer)
+{
+    const QRegion damage = damageRegion();
+    if (damage.isEmpty())
+        return;
+
+    QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+    const QSize size = m_output->pixelSize();
+
+    // the height of the item spans 3 units at zoom 1
+    scene.uniforms.set(&FractalUniforms::center, QQuickRhiItemStd140::Vec2 { { float(itemData.center.x()), float(itemData.center.y()) } });
+    scene.uniforms.set(&FractalUniforms::scale, float(3.0 / (itemData.zoom * size.height())));
+    scene.uniforms.set(&FractalUniforms::maxIterations, itemData.maxIterations);
+
+    QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+    scene.uniforms.commit(rub, scene.ubuf.data());
+
+    if (m_compute) {
+        cb.beginComputePass(rub);
+        cb.setComputePipeline(scene.computePs.data());
+        cb.setShaderResources();
+        cb.dispatch((size.width() + LOCAL_SIZE - 1) / LOCAL_SIZE, (size.height() + LOCAL_SIZE - 1) / LOCAL_SIZE, 1);
+        cb.endComputePass();
+    } else {
+        cb.beginPass(scene.rt.data(), Qt::black, { 1.0f, 0 }, rub);
+        cb.setGraphicsPipeline(scene.ps.data());
+        cb.setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+        cb.setShaderResources();
+        for (const QRect &r : damage) {
+            const int y = m_rhi->isYUpInFramebuffer() ? size.height() - r.bottom() - 1 : r.y();
+            cb.setScissor({ r.x(), y, r.width(), r.height() });
+            cb.draw(3);
+        }
+        cb.endPass();
+    }
+}
+
+FractalRhiItem::FractalRhiItem(QQuickItem *parent)
+    : QQuickRhiItem(parent)
+{
+    setComputeOutput(true);
+    setPreserveContents(true);
+}
+
+void FractalRhiItem::invalidate()
+{
+    // a new texture is entirely damaged anyway, whatever its size
+    addDirtyRect(QRect(QPoint(0, 0), effectiveTextureSize()));
+}
+
+void FractalRhiItem::setCenter(const QPointF &c)
+{
+    if (m_center == c)
+        return;
+
+    m_center = c;
+    emit centerChanged();
+    invalidate();
+}
+
+void FractalRhiItem::setZoom(qreal z)
+{
+    if (qFuzzyCompare(m_zoom, z) || z <= 0)
+        return;
+
+    m_zoom = z;
+    emit zoomChanged();
+    invalidate();
+}
+
+void FractalRhiItem::setMaxIterations(int n)
+{
+    n = qMax(1, n);
+    if (m_maxIterations == n)
+        return;
+
+    m_maxIterations = n;
+    emit maxIterationsChanged();
+    invalidate();
+}
@@ -0,0 +1,91 @@
+#ifndef FRACTALRHIITEM_H
+#define FRACTALRHIITEM_H
+
+#include "rhiitem.h"
+#include "rhiitemuniformblock.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QPointF>
+
+// the uniform block of fractal.comp, fractal.vert and fractal.frag
+struct FractalUniforms
+{
+    QQuickRhiItemStd140::Vec2 center;
+    QQuickRhiItemStd140::Float scale; // per output pixel
+    QQuickRhiItemStd140::Int maxIterations;
+    QQuickRhiItemStd140::Vec2 outputSize;
+    QQuickRhiItemStd140::Int flipY;
+};
+
+class FractalRenderer : public QQuickRhiItemRenderer
+{
+public:
+    void initialize(QRhi *rhi, QRhiTexture *outputTexture) override;
+    void synchronize(QQuickRhiItem *item) override;
+    void render(QRhiCommandBuffer *cb) override;
+
+private:
+    void initCompute();
+    void initRaster();
+
+    QRhi *m_rhi = nullptr;
+    QRhiTexture *m_output = nullptr;
+    bool m_compute = false;
+
+    struct {
+        QScopedPointer<QRhiBuffer> ubuf;
+        QQuickRhiItemUniformBlock<FractalUniforms> uniforms;
+        // computeOutput
+        QScopedPointer<QRhiShaderResourceBindings> computeSrb;
+        QScopedPointer<QRhiComputePipeline> computePs;
+        // the fallback, a full-screen triangle
+        QScopedPointer<QRhiTextureRenderTarget> rt;
+        bool rtPreserve = false; // created with PreserveColorContents
+        QScopedPointer<QRhiRenderPassDescriptor> rp;
+        QScopedPointer<QRhiShaderResourceBindings> srb;
+        QScopedPointer<QRhiGraphicsPipeline> ps;
+    } scene;
+
+    struct {
+        QPointF center;
+        qreal zoom = 1.0;
+        int maxIterations = 0;
+    } itemData;
+};
+
+class FractalRhiItem : public QQuickRhiItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(FractalRhiItem)
+
+    Q_PROPERTY(QPointF center READ center WRITE setCenter NOTIFY centerChanged)
+    Q_PROPERTY(qreal zoom READ zoom WRITE setZoom NOTIFY zoomChanged)
+    Q_PROPERTY(int maxIterations READ maxIterations WRITE setMaxIterations NOTIFY maxIterationsChanged)
+
+public:
+    FractalRhiItem(QQuickItem *parent = nullptr);
+
+    QQuickRhiItemRenderer *createRenderer() override { return new FractalRenderer; }
+
+    QPointF center() const { return m_center; }
+    void setCenter(const QPointF &c);
+
+    qreal zoom() const { return m_zoom; }
+    void setZoom(qreal z);
+
+    int maxIterations() const { return m_maxIterations; }
+    void setMaxIterations(int n);
+
+signals:
+    void centerChanged();
+    void zoomChanged();
+    void maxIterationsChanged();
+
+private:
+    void invalidate();
+
+    QPointF m_center = QPointF(-0.5, 0.0);
+    qreal m_zoom = 1.0;
+    int m_maxIterations = 256;
+};
+
+#endif
@@ -1,8 +1,20 @@
+#include "batchrender.h"
 #include <QGuiApplication>
 #include <QQuickView>
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        if (!qstrncmp(argv[i], "--batch=", 8)) {
+            // the backend is chosen per worker thread, see batchrender.cpp
+            if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            qputenv("QT_QUICK_CONTROLS_STYLE", "Basic");
+            QGuiApplication app(argc, argv);
+            return runBatchRender(app.arguments());
+        }
+    }
+
     qputenv("QSG_INFO", "1");
     qputenv("QT_QUICK_CONTROLS_STYLE", "Basic");
     QGuiApplication app(argc, argv);
@@ -52,6 +52,16 @@ Item {
             text: "Mirror vertically"
             checked: false
         }
+        CheckBox {
+            id: cbEffects
+            text: "Blur and tone map"
+            checked: false
+        }
+        CheckBox {
+            id: cbAsync
+            text: "Render on a separate thread"
+            checked: false
+        }
     }
 
     Rectangle {
@@ -95,6 +105,32 @@ Item {
         transparentBackground: cbTrans.checked
         alphaBlending: cbBlend.checked
         mirrorVertically: cbFlip.checked
+        asyncRendering: cbAsync.checked
+
+        effects: [
+            RhiItemEffect {
+                fragmentShader: "qrc:/blur.frag.qsb"
+                enabled: cbEffects.checked
+                property vector2d direction: Qt.vector2d(1, 0)
+                property real radius: 1.5
+            },
+            RhiItemEffect {
+                fragmentShader: "qrc:/blur.frag.qsb"
+                enabled: cbEffects.checked
+                property vector2d direction: Qt.vector2d(0, 1)
+                property real radius: 1.5
+            },
+            RhiItemEffect {
+                fragmentShader: "qrc:/tonemap.frag.qsb"
+                enabled: cbEffects.checked
+                property real exposure: 1.5
+                SequentialAnimation on exposure {
+                    loops: Animation.Infinite
+                    NumberAnimation { to: 4.0; duration: 2000 }
+                    NumberAnimation { to: 1.5; duration: 2000 }
+                }
+            }
+        ]
 
         explicitTextureWidth: cbFixedSize.checked ? 128 : 0
         explicitTextureHeight: cbFixedSize.checked ? 128 : 0
@@ -102,6 +138,70 @@ Item {
         onEffectiveTextureSizeChanged: console.log("TestRhiItem is rendering to a texture of pixel size " + effectiveTextureSize)
     }
 
+    RhiItemView {
+        anchors.right: parent.right
+        anchors.top: parent.top
+        anchors.margins: 4
+        width: renderer.width / 5
+        height: renderer.height / 5
+        source: renderer
+    }
+
+    // delegates are pooled and reused while scrolling, their renderers are
+    // recycled instead of being created again
+    ListView {
+        id: previews
+        anchors.left: parent.left
+        anchors.top: parent.top
+        anchors.topMargin: 120
+        anchors.bottom: plot.top
+        anchors.margins: 4
+        width: 120
+        spacing: 4
+        clip: true
+        reuseItems: true
+        model: 1000
+        delegate: TestRhiItem {
+            id: preview
+            required property int index
+            width: ListView.view.width
+            height: 90
+            rendererRecycling: true
+            cubeRotation.x: 30
+            cubeRotation.y: index * 15
+            message: "Row " + index
+            ListView.onPooled: preview.pooled()
+            ListView.onReused: preview.reused()
+        }
+    }
+
+    PlotRhiItem {
+        id: plot
+        anchors.left: parent.left
+        anchors.bottom: parent.bottom
+        anchors.margins: 4
+        width: 400
+        height: 90
+        lineColor: "darkblue"
+        visibleSamples: 1000000
+        testSignalRate: 1000000
+    }
+
+    FractalRhiItem {
+        anchors.right: parent.right
+        anchors.bottom: parent.bottom
+        anchors.margins: 4
+        width: 160
+        height: 90
+        computeOutput: true
+        center: Qt.point(-0.743643, 0.131825)
+        SequentialAnimation on zoom {
+            loops: Animation.Infinite
+            NumberAnimation { from: 1; to: 2000; duration: 10000; easing.type: Easing.InExpo }
+            NumberAnimation { to: 1; duration: 10000; easing.type: Easing.OutExpo }
+        }
+    }
+
     SequentialAnimation {
         PauseAnimation { duration: 3000 }
         ParallelAnimation {
@@ -0,0 +1,14 @@
+#version 440
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clipSpaceCorr;
+    vec4 window;
+    vec4 color;
+};
+
+void main()
+{
+    fragColor = vec4(color.rgb * color.a, color.a);
+}
@@ -0,0 +1,17 @@
+#version 440
+
+layout(location = 0) in float slot;
+layout(location = 1) in float value;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clipSpaceCorr;
+    vec4 window; // first slot, sample count, minimum value, maximum value
+    vec4 color;
+};
+
+void main()
+{
+    float x = (slot - window.x) / max(window.y - 1.0, 1.0) * 2.0 - 1.0;
+    float y = (value - window.z) / (window.w - window.z) * 2.0 - 1.0;
+    gl_Position = clipSpaceCorr * vec4(x, y, 0.0, 1.0);
+}
@@ -0,0 +1,268 @@
+#include "plotrhiitem.h"
+#include "rhiitemcapture.h"
+#include <QFile>
+#include <QtMath>
+
+// The slot indices are stored as floats, which are exact up to 2^24.
+static const int MAX_VISIBLE_SAMPLES = 1 << 23;
+
+using PlotUniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Mat4, QQuickRhiItemStd140::Vec4,
+                                                       QQuickRhiItemStd140::Vec4>;
+static_assert(offsetof(PlotUniforms, clipSpaceCorr) == PlotUniformsLayout::offset<0>);
+static_assert(offsetof(PlotUniforms, window) == PlotUniformsLayout::offset<1>);
+static_assert(offsetof(PlotUniforms, color) == PlotUniformsLayout::offset<2>);
+static_assert(sizeof(PlotUniforms) == PlotUniformsLayout::size);
+
+void PlotRenderer::initialize(QRhi *rhi, QRhiTexture *outputTexture)
+{
+    m_rhi = rhi;
+    m_output = outputTexture;
+
+    if (!m_rt) {
+        m_rt.reset(m_rhi->newTextureRenderTarget({ m_output }));
+        m_rp.reset(m_rt->newCompatibleRenderPassDescriptor());
+        m_rt->setRenderPassDescriptor(m_rp.data());
+    } else {
+        m_rt->setDescription({ m_output });
+    }
+    m_rt->create();
+
+    if (!scene.ps)
+        initScene();
+}
+
+static QShader getShader(const QString &name)
+{
+    QFile f(name);
+    if (f.open(QIODevice::ReadOnly))
+        return QShader::fromSerialized(f.readAll());
+
+    return QShader();
+}
+
+void PlotRenderer::initScene()
+{
+    scene.ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, scene.uniforms.size()));
+    scene.ubuf->create();
+    scene.uniforms.markAllDirty();
+    scene.uniforms.set(&PlotUniforms::clipSpaceCorr, m_rhi->clipSpaceCorrMatrix());
+
+    scene.srb.reset(m_rhi->newShaderResourceBindings());
+    scene.srb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, scene.ubuf.data())
+    });
+    scene.srb->create();
+
+    scene.ps.reset(m_rhi->newGraphicsPipeline());
+    scene.ps->setTopology(QRhiGraphicsPipeline::LineStrip);
+    QRhiGraphicsPipeline::TargetBlend premulAlphaBlend;
+    premulAlphaBlend.enable = true;
+    scene.ps->setTargetBlends({ premulAlphaBlend });
+    QShader vs = getShader(QLatin1String(":/plot.vert.qsb"));
+    Q_ASSERT(vs.isValid());
+    QShader fs = getShader(QLatin1String(":/plot.frag.qsb"));
+    Q_ASSERT(fs.isValid());
+    scene.ps->setShaderStages({
+        { QRhiShaderStage::Vertex, vs },
+        { QRhiShaderStage::Fragment, fs }
+    });
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({
+        { sizeof(float) },
+        { sizeof(float) }
+    });
+    inputLayout.setAttributes({
+        { 0, 0, QRhiVertexInputAttribute::Float, 0 },
+        { 1, 1, QRhiVertexInputAttribute::Float, 0 }
+    });
+    scene.ps->setVertexInputLayout(inputLayout);
+    scene.ps->setShaderResourceBindings(scene.srb.data());
+    scene.ps->setRenderPassDescriptor(m_rp.data());
+    scene.ps->create();
+}
+
+void PlotRenderer::createStream(QRhiResourceUpdateBatch *rub)
+{
+    const quint32 capacity = quint32(itemData.visibleSamples);
+
+    scene.values.reset(new QQuickRhiItemStreamBuffer(m_rhi, sizeof(float), capacity));
+    if (!scene.values->create()) {
+        scene.values.reset();
+        return;
+    }
+
+    // The x coordinate comes from a second vertex buffer holding the slot
+    // indices, so only the values need to be streamed.
+    QList<float> indices(2 * capacity);
+    for (quint32 i = 0; i < 2 * capacity; ++i)
+        indices[i] = float(i);
+    scene.slotIndices.reset(m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, 2 * capacity * sizeof(float)));
+    scene.slotIndices->create();
+    rub->uploadStaticBuffer(scene.slotIndices.data(), indices.constData());
+}
+
+void PlotRenderer::synchronize(QQuickRhiItem *rhiItem)
+{
+    PlotRhiItem *item = static_cast<PlotRhiItem *>(rhiItem);
+
+    // swapping hands over the new samples without copying them, and gives
+    // the (cleared) storage of the previous ones back to the item
+    if (itemData.samples.isEmpty()) {
+        item->swapPendingSamples(itemData.samples);
+    } else {
+        QList<float> more;
+        item->swapPendingSamples(more);
+        itemData.samples.append(more);
+    }
+
+    itemData.visibleSamples = item->visibleSamples();
+    itemData.minimumValue = item->minimumValue();
+    itemData.maximumValue = item->maximumValue();
+    itemData.lineColor = item->lineColor();
+}
+
+void PlotRenderer::render(QRhiCommandBuffer *commandBuffer)
+{
+    QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+    QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+
+    if (!scene.values || scene.values->capacity() != quint32(itemData.visibleSamples))
+        createStream(rub);
+
+    if (scene.values && !itemData.samples.isEmpty())
+        scene.values->append(rub, itemData.samples.constData(), quint32(itemData.samples.count()));
+    itemData.samples.clear();
+
+    const quint32 count = scene.values ? scene.values->available() : 0;
+    const quint32 first = scene.values ? scene.values->firstElement(count) : 0;
+    scene.uniforms.set(&PlotUniforms::window, QQuickRhiItemStd140::Vec4(float(first), float(count),
+                                                                        float(itemData.minimumValue), float(itemData.maximumValue)));
+    scene.uniforms.set(&PlotUniforms::color, QQuickRhiItemStd140::Vec4(float(itemData.lineColor.redF()), float(itemData.lineColor.greenF()),
+                                                                       float(itemData.lineColor.blueF()), float(itemData.lineColor.alphaF())));
+    scene.uniforms.commit(rub, scene.ubuf.data());
+
+    cb.beginPass(m_rt.data(), Qt::transparent, { 1.0f, 0 }, rub);
+
+    if (count > 1) {
+        cb.setGraphicsPipeline(scene.ps.data());
+        const QSize outputSize = m_output->pixelSize();
+        cb.setViewport(QRhiViewport(0, 0, outputSize.width(), outputSize.height()));
+        cb.setShaderResources();
+        const QRhiCommandBuffer::VertexInput vbufBindings[] = {
+            { scene.slotIndices.data(), 0 },
+            { scene.values->buffer(), 0 }
+        };
+        cb.setVertexInput(0, 2, vbufBindings);
+        // the whole visible window is contiguous, regardless of wrapping
+        cb.draw(count, 1, first, 0);
+    }
+
+    cb.endPass();
+}
+
+PlotRhiItem::PlotRhiItem(QQuickItem *parent)
+    : QQuickRhiItem(parent)
+{
+    m_testSignalTimer.setInterval(16);
+    connect(&m_testSignalTimer, &QTimer::timeout, this, &PlotRhiItem::generateTestSignal);
+}
+
+void PlotRhiItem::setVisibleSamples(int n)
+{
+    n = qBound(2, n, MAX_VISIBLE_SAMPLES);
+    if (m_visibleSamples == n)
+        return;
+
+    m_visibleSamples = n;
+    emit visibleSamplesChanged();
+    update();
+}
+
+void PlotRhiItem::setMinimumValue(qreal v)
+{
+    if (m_minimumValue == v)
+        return;
+
+    m_minimumValue = v;
+    emit minimumValueChanged();
+    update();
+}
+
+void PlotRhiItem::setMaximumValue(qreal v)
+{
+    if (m_maximumValue == v)
+        return;
+
+    m_maximumValue = v;
+    emit maximumValueChanged();
+    update();
+}
+
+void PlotRhiItem::setLineColor(const QColor &c)
+{
+    if (m_lineColor == c)
+        return;
+
+    m_lineColor = c;
+    emit lineColorChanged();
+    update();
+}
+
+void PlotRhiItem::setTestSignalRate(int samplesPerSecond)
+{
+    if (m_testSignalRate == samplesPerSecond)
+        return;
+
+    m_testSignalRate = samplesPerSecond;
+    if (m_testSignalRate > 0) {
+        m_testSignalCount = 0;
+        m_testSignalClock.start();
+        m_testSignalTimer.start();
+    } else {
+        m_testSignalTimer.stop();
+    }
+    emit testSignalRateChanged();
+}
+
+void PlotRhiItem::appendSamples(const float *samples, qsizetype count)
+{
+    // only the last visibleSamples are ever shown, no point in keeping more
+    // when the renderer is not picking them up, e.g. while hidden
+    if (count > m_visibleSamples) {
+        samples += count - m_visibleSamples;
+        count = m_visibleSamples;
+    }
+    const qsizetype excess = m_pendingSamples.count() + count - m_visibleSamples;
+    if (excess > 0)
+        m_pendingSamples.remove(0, excess);
+
+    const qsizetype oldCount = m_pendingSamples.count();
+    m_pendingSamples.resize(oldCount + count);
+    std::copy(samples, samples + count, m_pendingSamples.data() + oldCount);
+    update();
+}
+
+void PlotRhiItem::appendSamples(const QList<float> &samples)
+{
+    appendSamples(samples.constData(), samples.count());
+}
+
+void PlotRhiItem::generateTestSignal()
+{
+    const quint64 target = quint64(m_testSignalClock.nsecsElapsed() / 1000000000.0 * m_testSignalRate);
+    const qsizetype count = qsizetype(qMin<quint64>(target - m_testSignalCount, quint64(m_visibleSamples)));
+    if (count <= 0)
+        return;
+
+    QList<float> samples(count);
+    const double dt = 1.0 / m_testSignalRate;
+    double t = (target - count) * dt;
+    for (qsizetype i = 0; i < count; ++i, t += dt) {
+        m_noise = m_noise * 1664525u + 1013904223u;
+        const float noise = (m_noise >> 8) / float(1 << 24) - 0.5f;
+        samples[i] = float(0.6 * qSin(2 * M_PI * 0.5 * t) + 0.25 * qSin(2 * M_PI * 13.0 * t)) + 0.1f * noise;
+    }
+    m_testSignalCount = target;
+
+    appendSamples(samples);
+}
@@ -0,0 +1,112 @@
+#ifndef PLOTRHIITEM_H
+#define PLOTRHIITEM_H
+
+#include "rhiitem.h"
+#include "rhiitemstreambuffer.h"
+#include "rhiitemuniformblock.h"
+#include <QColor>
+#include <QElapsedTimer>
+#include <QTimer>
+
+// the uniform block of plot.vert and plot.frag
+struct PlotUniforms
+{
+    QQuickRhiItemStd140::Mat4 clipSpaceCorr;
+    QQuickRhiItemStd140::Vec4 window; // first, count, min, max
+    QQuickRhiItemStd140::Vec4 color;
+};
+
+class PlotRenderer : public QQuickRhiItemRenderer
+{
+public:
+    void initialize(QRhi *rhi, QRhiTexture *outputTexture) override;
+    void synchronize(QQuickRhiItem *item) override;
+    void render(QRhiCommandBuffer *cb) override;
+
+private:
+    QRhi *m_rhi = nullptr;
+    QRhiTexture *m_output = nullptr;
+    QScopedPointer<QRhiTextureRenderTarget> m_rt;
+    QScopedPointer<QRhiRenderPassDescriptor> m_rp;
+
+    struct {
+        QScopedPointer<QQuickRhiItemStreamBuffer> values;
+        QScopedPointer<QRhiBuffer> slotIndices;
+        QScopedPointer<QRhiBuffer> ubuf;
+        QQuickRhiItemUniformBlock<PlotUniforms> uniforms;
+        QScopedPointer<QRhiShaderResourceBindings> srb;
+        QScopedPointer<QRhiGraphicsPipeline> ps;
+    } scene;
+
+    struct {
+        QList<float> samples; // new since the last render()
+        int visibleSamples = 0;
+        qreal minimumValue = 0;
+        qreal maximumValue = 0;
+        QColor lineColor;
+    } itemData;
+
+    void initScene();
+    void createStream(QRhiResourceUpdateBatch *rub);
+};
+
+class PlotRhiItem : public QQuickRhiItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(PlotRhiItem)
+
+    Q_PROPERTY(int visibleSamples READ visibleSamples WRITE setVisibleSamples NOTIFY visibleSamplesChanged)
+    Q_PROPERTY(qreal minimumValue READ minimumValue WRITE setMinimumValue NOTIFY minimumValueChanged)
+    Q_PROPERTY(qreal maximumValue READ maximumValue WRITE setMaximumValue NOTIFY maximumValueChanged)
+    Q_PROPERTY(QColor lineColor READ lineColor WRITE setLineColor NOTIFY lineColorChanged)
+    Q_PROPERTY(int testSignalRate READ testSignalRate WRITE setTestSignalRate NOTIFY testSignalRateChanged)
+
+public:
+    PlotRhiItem(QQuickItem *parent = nullptr);
+
+    QQuickRhiItemRenderer *createRenderer() override { return new PlotRenderer; }
+
+    int visibleSamples() const { return m_visibleSamples; }
+    void setVisibleSamples(int n);
+
+    qreal minimumValue() const { return m_minimumValue; }
+    void setMinimumValue(qreal v);
+
+    qreal maximumValue() const { return m_maximumValue; }
+    void setMaximumValue(qreal v);
+
+    QColor lineColor() const { return m_lineColor; }
+    void setLineColor(const QColor &c);
+
+    int testSignalRate() const { return m_testSignalRate; }
+    void setTestSignalRate(int samplesPerSecond);
+
+    void appendSamples(const float *samples, qsizetype count);
+    Q_INVOKABLE void appendSamples(const QList<float> &samples);
+
+    // for the renderer, hands over the samples appended since the last call
+    void swapPendingSamples(QList<float> &other) { m_pendingSamples.swap(other); }
+
+signals:
+    void visibleSamplesChanged();
+    void minimumValueChanged();
+    void maximumValueChanged();
+    void lineColorChanged();
+    void testSignalRateChanged();
+
+private:
+    void generateTestSignal();
+
+    int m_visibleSamples = 100000;
+    qreal m_minimumValue = -1.0;
+    qreal m_maximumValue = 1.0;
+    QColor m_lineColor = Qt::white;
+    int m_testSignalRate = 0;
+    QList<float> m_pendingSamples;
+    QTimer m_testSignalTimer;
+    QElapsedTimer m_testSignalClock;
+    quint64 m_testSignalCount = 0;
+    quint32 m_noise = 1;
+};
+
+#endif
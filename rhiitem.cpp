@@ -1,6 +1,19 @@
 #include "rhiitem_p.h"
+#include "rhiitemasync_p.h"
+#include "rhiitemcapture.h"
+#include "rhiitemeffect_p.h"
+#include "rhiitemscheduler_p.h"
+#include "rhiitemtexturepool.h"
+#include "rhiitemtrace_p.h"
 #include <QtGui/private/qrhi_p.h>
 #include <private/qsgplaintexture_p.h>
+#include <QSGTextureMaterial>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QOffscreenSurface>
+#include <QThreadPool>
 
 /*!
     \class QQuickRhiItem
@@ -33,6 +46,11 @@
     Using queued connections or events for communication between item and
     renderer is also possible.
 
+    For large amounts of data that is produced continuously, possibly on
+    other threads, QQuickRhiItemChannel offers a lock-free way to hand the
+    newest snapshot of the data to the renderer, without involving
+    synchronize() and without blocking the GUI thread for copying.
+
     To render into the 2D texture that is implicitly created and managed by the
     QQuickRhiItem, the user should subclass the QQuickRhiItemRenderer class and
     reimplement its render() function. An instance of the QQuickRhiItemRenderer
@@ -46,6 +64,20 @@
     directly in \l {ShaderEffect}{ShaderEffects} and other classes that consume
     texture providers, without involving an additional render pass.
 
+    Post-processing, such as blur or tone mapping, can be added via the
+    \l effects list, without wrapping the item in ShaderEffects or enabling
+    \c layer.enabled, both of which add textures and Qt Quick render passes.
+
+    To analyze frame timing, set the \c QSG_RHIITEM_TRACE environment variable
+    to a file name. The begin and end of the item's updatePaintNode(), the
+    node synchronization, texture recreation, the renderer's initialize(),
+    synchronize() and render(), the submission of the scheduled texture
+    uploads, and the item's own resource updates, i.e. the mipmap
+    generation, are then recorded per thread, together with the item's
+    objectName, and written to the file as a Chrome trace (viewable in
+    Perfetto) when the application exits. The resource update batches the
+    renderer submits itself are part of its render().
+
     An example of a basic QQuickRhiItem implementation could be the following:
 
     \code
@@ -184,12 +216,50 @@
     \sa QQuickRhiItem
  */
 
+/*
+    Adds the resources the renderer had created while in scope to the
+    resourceAllocationCount of the stats. All QRhiResource objects take their
+    globalResourceId() from one counter, so the number of ids handed out in
+    between is the number of resources created, on the QRhi directly or via
+    QQuickRhiItemTexturePool and QQuickRhiItemPipelineCache misses, while
+    hits create none. The counter is read with a resource that is never
+    created natively, which costs no more than a small allocation.
+
+    The counter is process-wide, resources created by other threads in the
+    meantime, such as the render threads of other windows, are counted as
+    well. The benchmarks use the basic render loop, where this cannot happen.
+ */
+class QQuickRhiItemAllocationScope
+{
+public:
+    QQuickRhiItemAllocationScope(QRhi *rhi, QQuickRhiItem::Stats *stats)
+        : m_rhi(rhi), m_stats(stats), m_id(probeId())
+    { }
+    ~QQuickRhiItemAllocationScope() { m_stats->resourceAllocationCount += probeId() - m_id - 1; }
+
+private:
+    quint64 probeId() const
+    {
+        QScopedPointer<QRhiSampler> probe(m_rhi->newSampler(QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+                                                            QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+        return probe->globalResourceId();
+    }
+
+    QRhi *m_rhi;
+    QQuickRhiItem::Stats *m_stats;
+    quint64 m_id;
+};
+
 QQuickRhiItemNode::QQuickRhiItemNode(QQuickRhiItem *item)
-    : m_item(item)
+    : m_item(item),
+      m_rendererType(item->metaObject()),
+      m_stats(QQuickRhiItemPrivate::get(item)->stats)
 {
     m_window = m_item->window();
     Q_ASSERT(m_window);
     connect(m_window, &QQuickWindow::beforeRendering, this, &QQuickRhiItemNode::render);
+    m_scheduler = QQuickRhiItemFrameScheduler::get(m_window);
+    m_scheduler->registerNode(this);
     connect(m_window, &QQuickWindow::screenChanged, this, [this]() {
         if (m_window->effectiveDevicePixelRatio() != m_dpr)
             m_item->update();
@@ -198,51 +268,148 @@ QQuickRhiItemNode::QQuickRhiItemNode(QQuickRhiItem *item)
 
 QQuickRhiItemNode::~QQuickRhiItemNode()
 {
-    delete m_renderer;
+    waitForPrepare();
+    if (m_scheduler)
+        m_scheduler->unregisterNode(this);
+
+    // m_item may be gone already, only use what was captured in sync()
+    if (m_async) {
+        // the renderer belongs to the worker's QRhi, it is not recycled
+        releaseRenderer();
+    } else if (m_renderer && m_rendererRecycling && m_rhi) {
+        m_renderer->data = nullptr;
+        QQuickRhiItemRendererPool::get(m_rhi)->stash(m_rendererType, m_item, m_renderer);
+    } else {
+        delete m_renderer;
+    }
     delete m_sgWrapperTexture;
+    delete m_placeholderTexture;
     releaseNativeTexture();
 }
 
+/*
+    Destroys the renderer, as it cannot move between synchronous and
+    asynchronous rendering. A new one is created in updatePaintNode().
+ */
+void QQuickRhiItemNode::releaseRenderer()
+{
+    waitForPrepare();
+    if (m_async) {
+        QObject::disconnect(m_asyncResyncConnection);
+        // the worker deletes the renderer, the render thread does not wait
+        // for the frame in progress
+        m_async.take()->release();
+        if (m_scheduler)
+            m_scheduler->cancelUploads(this, m_texture);
+        m_asyncShared.reset();
+        m_asyncUploadPending = false;
+        m_asyncUploaded = false;
+    } else {
+        delete m_renderer;
+    }
+    m_renderer = nullptr;
+    m_rendererInitialized = false;
+}
+
+void QQuickRhiItemNode::resetRenderer()
+{
+    // the item is reused while the previous frame's prepare() may still run
+    waitForPrepare();
+    m_renderer->reset();
+}
+
 QSGTexture *QQuickRhiItemNode::texture() const
 {
     return m_sgWrapperTexture;
 }
 
-void QQuickRhiItemNode::createNativeTexture()
+/*
+    Returns a texture of the current size and flags, without replacing
+    m_texture, or null when creating it fails.
+ */
+QRhiTexture *QQuickRhiItemNode::createNativeTexture(bool mipmap, bool computeOutput)
 {
-    Q_ASSERT(!m_texture);
     Q_ASSERT(!m_pixelSize.isEmpty());
 
-    m_texture = m_rhi->newTexture(QRhiTexture::RGBA8, m_pixelSize, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
-    if (!m_texture->create()) {
+    // Items are often created and destroyed in rapid succession, e.g. as
+    // ListView delegates, so textures are recycled via the per-QRhi pool.
+    QRhiTexture::Flags flags = QRhiTexture::UsedAsTransferSource;
+    flags |= computeOutput ? QRhiTexture::UsedWithLoadStore : QRhiTexture::RenderTarget;
+    if (mipmap)
+        flags |= QRhiTexture::MipMapped | QRhiTexture::UsedWithGenerateMips;
+    QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::get(m_rhi);
+    const quint64 misses = pool->stats().misses;
+    QRhiTexture *texture = pool->acquireTexture(QRhiTexture::RGBA8, m_pixelSize, flags);
+    if (!texture) {
         qWarning("Failed to create QQuickRhiItem texture of size %dx%d", m_pixelSize.width(), m_pixelSize.height());
-        delete m_texture;
-        m_texture = nullptr;
+        return nullptr;
     }
+
+    ++m_stats.textureCreateCount;
+    m_stats.resourceAllocationCount += pool->stats().misses - misses;
+    return texture;
 }
 
 void QQuickRhiItemNode::releaseNativeTexture()
 {
     if (m_texture) {
-        m_texture->deleteLater();
+        if (m_scheduler)
+            m_scheduler->cancelUploads(this, m_texture);
+        m_asyncUploadPending = false;
+        if (QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::find(m_rhi))
+            pool->releaseTexture(m_texture);
+        else
+            delete m_texture;
         m_texture = nullptr;
     }
 }
 
-void QQuickRhiItemNode::sync()
+bool QQuickRhiItemNode::resolveRhi()
 {
     if (!m_rhi) {
         QSGRendererInterface *rif = m_window->rendererInterface();
         m_rhi = static_cast<QRhi *>(rif->getResource(m_window, QSGRendererInterface::RhiResource));
         if (!m_rhi) {
             qWarning("No QRhi found for window %p, QQuickRhiItem will not be functional", m_window);
-            return;
+            return false;
         }
     }
+    return true;
+}
+
+QQuickRhiItemRenderer *QQuickRhiItemNode::takeRecycledRenderer()
+{
+    if (!resolveRhi())
+        return nullptr;
+
+    return QQuickRhiItemRendererPool::get(m_rhi)->take(m_rendererType, m_item);
+}
+
+void QQuickRhiItemNode::sync()
+{
+    if (QQuickRhiItemTrace::isEnabled())
+        m_traceName = QQuickRhiItemTrace::itemName(m_item);
+    QQuickRhiItemTraceScope traceScope("QQuickRhiItemNode::sync", m_traceName);
 
+    // a prepare() launched for a frame whose render() did not happen must
+    // not overlap with synchronize()
+    waitForPrepare();
+
+    if (!resolveRhi())
+        return;
+
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+
+    // the item sees the stats up to the previous frame
+    QQuickRhiItemPrivate::get(m_item)->stats = m_stats;
+
+    m_rendererRecycling = m_item->rendererRecycling();
+    m_channels = QQuickRhiItemPrivate::get(m_item)->channels;
+
+    m_dpr = m_window->effectiveDevicePixelRatio();
     QSize newSize(m_item->explicitTextureWidth(), m_item->explicitTextureHeight());
     if (newSize.isEmpty()) {
-        m_dpr = m_window->effectiveDevicePixelRatio();
         const int minTexSize = m_rhi->resourceLimit(QRhi::TextureSizeMin);
         newSize = QSize(qMax<int>(minTexSize, m_item->width()),
                         qMax<int>(minTexSize, m_item->height())) * m_dpr;
@@ -254,31 +421,126 @@ void QQuickRhiItemNode::sync()
         m_pixelSize = newSize;
     }
 
+    // Without compute support the renderer gets a render target texture,
+    // as if computeOutput was not set.
+    bool computeOutput = m_item->computeOutput();
+    if (computeOutput && !m_rhi->isFeatureSupported(QRhi::Compute)) {
+        if (!m_computeOutputWarned) {
+            qWarning("QQuickRhiItem: compute is not supported by the QRhi backend, computeOutput is ignored");
+            m_computeOutputWarned = true;
+        }
+        computeOutput = false;
+    }
+
+    // toggling mipmaps or compute output changes the texture flags, that
+    // needs a new texture instead of resizing the current one
+    const bool mipmap = m_item->mipmap();
+    const bool flagsChanged = mipmap != m_mipmap || computeOutput != m_computeOutput;
+    if (flagsChanged)
+        needsNew = true;
+
     if (needsNew) {
-        if (m_texture && m_sgWrapperTexture) {
+        QQuickRhiItemTraceScope traceScope("textureRecreate", m_traceName);
+        if (m_texture && m_sgWrapperTexture && !flagsChanged) {
             m_texture->setPixelSize(m_pixelSize);
+            ++m_stats.textureResizeCount;
+            ++m_stats.resourceAllocationCount;
             if (m_texture->create())
                 m_sgWrapperTexture->setTextureSize(m_pixelSize);
             else
                 qWarning("Failed to recreate QQuickRhiItem texture of size %dx%d", m_pixelSize.width(), m_pixelSize.height());
-        } else {
+            m_mipsValid = false;
+        } else if (QRhiTexture *texture = createNativeTexture(mipmap, computeOutput)) {
+            // The replacement is set on the node before the current texture
+            // and its wrapper go, when creating it fails they stay in use,
+            // together with their flags, so the change is retried.
+            QSGPlainTexture *wrapper = new QSGPlainTexture;
+            wrapper->setOwnsTexture(false);
+            wrapper->setTexture(texture);
+            wrapper->setTextureSize(m_pixelSize);
+            wrapper->setHasAlphaChannel(m_item->alphaBlending());
+            setTexture(wrapper);
             delete m_sgWrapperTexture;
-            m_sgWrapperTexture = nullptr;
+            m_sgWrapperTexture = wrapper;
             releaseNativeTexture();
-            createNativeTexture();
-            if (m_texture) {
-                m_sgWrapperTexture = new QSGPlainTexture;
-                m_sgWrapperTexture->setOwnsTexture(false);
-                m_sgWrapperTexture->setTexture(m_texture);
-                m_sgWrapperTexture->setTextureSize(m_pixelSize);
-                m_sgWrapperTexture->setHasAlphaChannel(m_item->alphaBlending());
-                setTexture(m_sgWrapperTexture);
-            }
+            m_texture = texture;
+            m_mipmap = mipmap;
+            m_computeOutput = computeOutput;
+            m_mipsValid = false;
         }
         QQuickRhiItemPrivate::get(m_item)->effectiveTextureSize = m_pixelSize;
         emit m_item->effectiveTextureSizeChanged();
-        if (m_texture)
-            m_renderer->initialize(m_rhi, m_texture);
+    }
+
+    // The first initialize() of a renderer may be left to the scheduler,
+    // which spreads the initialization of many items over several frames.
+    QQuickRhiItemPrivate *itemPriv = QQuickRhiItemPrivate::get(m_item);
+    if (!m_rendererInitialized && m_texture && !m_item->asyncRendering()
+            && m_scheduler && m_scheduler->hasInitializationBudget()) {
+        deferInitialization();
+    } else if (m_initPending) {
+        endDeferredInitialization();
+    }
+
+    syncEffects(needsNew);
+
+    // the renderer has to create its render target with different flags
+    bool needsInitialize = needsNew || !m_rendererInitialized;
+    if (m_item->preserveContents() != m_preserveContents) {
+        needsInitialize = true;
+        m_preserveContents = m_item->preserveContents();
+    }
+
+    // New textures, including ones rebuilt in place, have undefined contents.
+    // Otherwise only what the item reported as dirty is to be redrawn, but
+    // the damage accumulates until there is an actual render().
+    const QRect textureRect(QPoint(0, 0), m_pixelSize);
+    if (needsNew || !m_preserveContents)
+        m_damage = textureRect;
+    else
+        m_damage = (m_damage + itemPriv->dirtyRegion) & textureRect;
+    itemPriv->dirtyRegion = QRegion();
+    m_damageSynced = true;
+
+    if (itemPriv->captureFrameCount > 0) {
+        if (m_item->asyncRendering()) {
+            qWarning("QQuickRhiItem: capturing is not supported with asyncRendering");
+        } else {
+            m_capture.reset(new QQuickRhiItemCapture);
+            m_captureFileName = itemPriv->captureFileName;
+            m_captureFramesLeft = itemPriv->captureFrameCount;
+        }
+        itemPriv->captureFrameCount = 0;
+    }
+
+    if (m_item->asyncRendering() && !m_async) {
+        // with OpenGL the worker's frames are shared with the window's context
+        QOpenGLContext *shareContext = nullptr;
+        if (m_rhi->backend() == QRhi::OpenGLES2) {
+            shareContext = static_cast<QOpenGLContext *>(
+                m_window->rendererInterface()->getResource(m_window, QSGRendererInterface::OpenGLContextResource));
+        }
+        m_async.reset(new QQuickRhiItemAsyncRunner(m_renderer, m_rhi, m_window, itemPriv->asyncFallbackSurface,
+                                                   shareContext));
+        // the worker's frames lead to window updates, a sync that was
+        // refused while the worker was busy is retried then
+        m_asyncResync.reset(new std::atomic<bool>(false));
+        QQuickRhiItem *item = m_item;
+        QSharedPointer<std::atomic<bool>> resync = m_asyncResync;
+        m_asyncResyncConnection = connect(m_window, &QQuickWindow::afterAnimating, m_item, [item, resync] {
+            if (resync->exchange(false))
+                item->update();
+        });
+    }
+
+    if (!m_async && needsInitialize && m_texture && !m_initPending) {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::initialize", m_traceName);
+        QQuickRhiItemAllocationScope allocationScope(m_rhi, &m_stats);
+        const qint64 t = syncTimer.nsecsElapsed();
+        ++m_stats.rendererInitializeCount;
+        m_renderer->initialize(m_rhi, m_texture);
+        m_rendererInitialized = true;
+        m_stats.rendererInitializeTime += syncTimer.nsecsElapsed() - t;
     }
 
     if (m_sgWrapperTexture && m_sgWrapperTexture->hasAlphaChannel() != m_item->alphaBlending()) {
@@ -287,35 +549,450 @@ void QQuickRhiItemNode::sync()
         setTexture(m_sgWrapperTexture);
     }
 
-    m_renderer->synchronize(m_item);
+    if (m_async) {
+        // initialize() is up to the worker, the damage is handed over with
+        // the state
+        const qint64 t = syncTimer.nsecsElapsed();
+        if (m_async->synchronize(m_item, m_pixelSize, m_item->computeOutput(), m_preserveContents, m_damage))
+            m_damage = QRegion();
+        else
+            m_asyncResync->store(true);
+        m_stats.rendererSynchronizeTime += syncTimer.nsecsElapsed() - t;
+    } else if (!m_initPending) {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::synchronize", m_traceName);
+        QQuickRhiItemAllocationScope allocationScope(m_rhi, &m_stats);
+        const qint64 t = syncTimer.nsecsElapsed();
+        m_renderer->synchronize(m_item);
+        m_stats.rendererSynchronizeTime += syncTimer.nsecsElapsed() - t;
+    }
+
+    ++m_stats.syncCount;
+    m_stats.lastSyncTime = syncTimer.nsecsElapsed();
+    m_stats.syncTime += m_stats.lastSyncTime;
+}
+
+void QQuickRhiItemNode::syncEffects(bool textureChanged)
+{
+    QQuickRhiItemPrivate *itemPriv = QQuickRhiItemPrivate::get(m_item);
+    if (!itemPriv->effectsDirty && !textureChanged)
+        return;
+    itemPriv->effectsDirty = false;
+
+    const QList<QShader> shaders = itemPriv->activeEffectShaders();
+    if (shaders.isEmpty()) {
+        m_effectChain.reset();
+        m_effectParams.reset();
+    } else if (m_texture) {
+        if (!m_effectChain)
+            m_effectChain.reset(new QQuickRhiItemEffectChain(m_rhi));
+        m_effectChain->setEffects(shaders);
+        // the output is what gets sampled, including the mip levels
+        m_effectChain->resize(m_pixelSize, m_texture->flags() & ~QRhiTexture::Flags(QRhiTexture::UsedWithLoadStore));
+        m_effectParams = itemPriv->effectParams;
+        QMutexLocker lock(&m_effectParams->mutex);
+        m_effectChain->setParameters(itemPriv->activeEffectParameters());
+        m_effectParams->dirty = false;
+    }
+
+    if (m_sgWrapperTexture && m_sgWrapperTexture->rhiTexture() != displayTexture()) {
+        m_sgWrapperTexture->setTexture(displayTexture());
+        setTexture(m_sgWrapperTexture);
+        m_mipsValid = false;
+    }
+}
+
+/*
+    Shows the placeholder until the scheduler calls initializeDeferred(), and
+    registers the node there, with the priority given by the on-screen area
+    of the item. Called in each sync() until then.
+ */
+void QQuickRhiItemNode::deferInitialization()
+{
+    if (!m_initPending) {
+        m_initPending = true;
+        m_initRequestTime = QQuickRhiItemTrace::timestamp();
+        ++m_stats.deferredInitializeCount;
+    }
+
+    const QColor color = m_item->placeholderColor();
+    if (!m_placeholderTexture) {
+        m_placeholderTexture = m_rhi->newTexture(QRhiTexture::RGBA8, QSize(1, 1));
+        if (!m_placeholderTexture->create())
+            qWarning("Failed to create QQuickRhiItem placeholder texture");
+        m_placeholderDirty = true;
+    } else if (color != m_placeholderColor) {
+        m_placeholderDirty = true;
+    }
+    m_placeholderColor = color;
+
+    QQuickItemPrivate *itemPriv = QQuickItemPrivate::get(m_item);
+    const QRectF windowRect(QPointF(0, 0), m_window->size());
+    const QRectF rect = m_item->mapRectToScene(m_item->boundingRect()) & windowRect;
+    const bool visible = itemPriv->effectiveVisible && m_item->opacity() > 0 && !rect.isEmpty();
+    m_scheduler->requestInitialization(this, visible, visible ? rect.width() * rect.height() : 0);
+}
+
+void QQuickRhiItemNode::endDeferredInitialization()
+{
+    m_initPending = false;
+    if (m_scheduler)
+        m_scheduler->cancelInitialization(this);
+    if (m_sgWrapperTexture && m_sgWrapperTexture->rhiTexture() != displayTexture()) {
+        m_sgWrapperTexture->setTexture(displayTexture());
+        setTexture(m_sgWrapperTexture);
+    }
+    if (m_placeholderTexture) {
+        // may still be referenced by the previous frame's batches
+        m_placeholderTexture->deleteLater();
+        m_placeholderTexture = nullptr;
+    }
+}
+
+/*
+    Called by the scheduler on the render thread, once all items are
+    synchronized, so the GUI thread is still blocked and the item is safe to
+    access. Does what sync() left out.
+ */
+void QQuickRhiItemNode::initializeDeferred()
+{
+    if (!m_initPending || !m_renderer || !m_texture)
+        return;
+
+    endDeferredInitialization();
+
+    QElapsedTimer timer;
+    timer.start();
+    {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::initialize", m_traceName);
+        QQuickRhiItemAllocationScope allocationScope(m_rhi, &m_stats);
+        ++m_stats.rendererInitializeCount;
+        m_renderer->initialize(m_rhi, m_texture);
+        m_rendererInitialized = true;
+        m_stats.rendererInitializeTime += timer.nsecsElapsed();
+    }
+    {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::synchronize", m_traceName);
+        QQuickRhiItemAllocationScope allocationScope(m_rhi, &m_stats);
+        const qint64 t = timer.nsecsElapsed();
+        m_renderer->synchronize(m_item);
+        m_stats.rendererSynchronizeTime += timer.nsecsElapsed() - t;
+    }
+    m_stats.syncTime += timer.nsecsElapsed();
+    m_stats.initializeDelay = QQuickRhiItemTrace::timestamp() - m_initRequestTime;
+
+    // the contents are undefined until the first render()
+    m_damage = QRect(QPoint(0, 0), m_pixelSize);
+    m_renderPending = true;
+}
+
+QRhiTexture *QQuickRhiItemNode::displayTexture() const
+{
+    if (m_initPending && m_placeholderTexture)
+        return m_placeholderTexture;
+    return m_effectChain && m_effectChain->output() ? m_effectChain->output() : m_texture;
+}
+
+bool QQuickRhiItemNode::isMinified() const
+{
+    // Item transforms (such as a Scale) do not lead to updatePaintNode(), so
+    // rather than relying on sync(), figure out the on-screen size from the
+    // current transform node chain.
+    QMatrix4x4 m;
+    for (QSGNode *p = parent(); p; p = p->parent()) {
+        if (p->type() == QSGNode::TransformNodeType)
+            m = static_cast<QSGTransformNode *>(p)->matrix() * m;
+    }
+
+    const QRectF r = rect();
+    const QPointF tl = m.map(r.topLeft());
+    const QPointF tr = m.map(r.topRight());
+    const QPointF bl = m.map(r.bottomLeft());
+    const QPointF br = m.map(r.bottomRight());
+    const qreal w = qMax(QLineF(tl, tr).length(), QLineF(bl, br).length()) * m_dpr;
+    const qreal h = qMax(QLineF(tl, bl).length(), QLineF(tr, br).length()) * m_dpr;
+
+    // allow for some rounding, drawing at 1:1 does not need mipmaps
+    const qreal threshold = 0.99;
+    return w < m_pixelSize.width() * threshold || h < m_pixelSize.height() * threshold;
+}
+
+void QQuickRhiItemNode::launchPrepare(QThreadPool *pool)
+{
+    // called on the render thread once all items are synchronized
+
+    // the worker of asynchronous rendering calls prepare() itself
+    if (m_async)
+        return;
+
+    for (const QSharedPointer<QQuickRhiItemChannelState> &channel : std::as_const(m_channels)) {
+        if (channel->takeWakeup())
+            m_renderPending = true;
+    }
+
+    if (!m_rhi || !m_texture || !m_renderer || !m_renderPending || !m_prepareImplemented || m_prepareLaunched)
+        return;
+
+    // whether prepare() is reimplemented is only known once it ran, which
+    // happens on the render thread, so the pool never writes the flag
+    if (!m_prepareProbed)
+        return;
+
+    // prepare() only follows initialize()
+    if (m_initPending)
+        return;
+
+    m_prepareLaunched = true;
+    pool->start([this] {
+        runPrepare();
+        m_prepareDone.release();
+    });
+}
+
+void QQuickRhiItemNode::runPrepare()
+{
+    QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::prepare", m_traceName);
+    m_renderer->prepare();
+    m_prepared = true;
+}
+
+void QQuickRhiItemNode::waitForPrepare()
+{
+    if (!m_prepareLaunched)
+        return;
+
+    QQuickRhiItemTraceScope traceScope("waitForPrepare", m_traceName);
+    m_prepareDone.acquire();
+    m_prepareLaunched = false;
 }
 
 void QQuickRhiItemNode::render()
 {
     // called before Qt Quick starts recording its main render pass
 
+    waitForPrepare();
+
     if (!m_rhi || !m_texture || !m_renderer)
         return;
 
-    if (!m_renderPending)
+    // the first item rendering in the frame submits the scheduled uploads
+    if (m_scheduler && m_scheduler->needsUploadSubmit()) {
+        if (QRhiCommandBuffer *cb = commandBuffer())
+            m_scheduler->submitUploads(m_rhi, cb);
+    }
+
+    // nothing to render before initialize(), the placeholder is shown
+    if (m_initPending) {
+        if (m_placeholderDirty) {
+            if (QRhiCommandBuffer *cb = commandBuffer()) {
+                QImage image(1, 1, QImage::Format_RGBA8888_Premultiplied);
+                image.fill(m_placeholderColor);
+                QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+                rub->uploadTexture(m_placeholderTexture, image);
+                cb->resourceUpdate(rub);
+                m_placeholderDirty = false;
+                markDirty(QSGNode::DirtyMaterial);
+            }
+        }
+        return;
+    }
+
+    const bool minified = m_mipmap && isMinified();
+    // views sampling the texture may need the mip levels regardless
+    const bool wantsMips = minified || (m_mipmap && m_mipmapUsers > 0);
+    const bool needsMips = wantsMips && !m_mipsValid;
+    const QSGTexture::Filtering mipmapFiltering = minified ? QSGTexture::Linear : QSGTexture::None;
+    if (mipmapFiltering != static_cast<QSGOpaqueTextureMaterial *>(material())->mipmapFiltering()) {
+        // Sampling the mip levels is only enabled when minified, as they are
+        // not kept up-to-date otherwise. The materials override the
+        // texture's settings, so set it on both.
+        static_cast<QSGOpaqueTextureMaterial *>(material())->setMipmapFiltering(mipmapFiltering);
+        static_cast<QSGOpaqueTextureMaterial *>(opaqueMaterial())->setMipmapFiltering(mipmapFiltering);
+        m_sgWrapperTexture->setMipmapFiltering(mipmapFiltering);
+        markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // publishing on a channel requests rendering without a sync
+    for (const QSharedPointer<QQuickRhiItemChannelState> &channel : std::as_const(m_channels)) {
+        if (channel->takeWakeup()) {
+            if (m_async)
+                m_async->requestRender();
+            else
+                m_renderPending = true;
+        }
+    }
+
+    // With asynchronous rendering the worker renders, and this only shows
+    // its latest frame, if there is a new one. Frames of the previous size
+    // are dropped, a new one is on its way then.
+    QQuickRhiItemAsyncRunner::Frame asyncFrame;
+    if (m_async) {
+        m_renderPending = false;
+        if (m_async->takeFrame(&asyncFrame) && asyncFrame.pixelSize != m_pixelSize)
+            asyncFrame = QQuickRhiItemAsyncRunner::Frame();
+    }
+    // Frames read back by the worker are uploaded by the scheduler, within
+    // the budget shared with the renderers' uploads. They are shown once
+    // textureUploaded() reports the upload submitted, replacing a previous
+    // frame still waiting for it.
+    if (!asyncFrame.data.isEmpty() && m_scheduler) {
+        m_scheduler->cancelUploads(this, m_texture);
+        m_scheduler->scheduleUpload(this, m_texture,
+                                    QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(asyncFrame.data)), 0);
+        m_asyncUploadPending = true;
+        m_asyncUploadStartTime = asyncFrame.startTime;
+        m_asyncUploadRenderTime = asyncFrame.renderTime;
+        asyncFrame = QQuickRhiItemAsyncRunner::Frame();
+    }
+    const bool hasAsyncFrame = asyncFrame.nativeTexture || !asyncFrame.data.isEmpty();
+    const bool asyncUploaded = std::exchange(m_asyncUploaded, false);
+
+    // effect parameters changed on the GUI thread, without a sync
+    if (m_effectChain && m_effectParams) {
+        QMutexLocker lock(&m_effectParams->mutex);
+        if (m_effectParams->dirty) {
+            m_effectChain->setParameters(m_effectParams->data);
+            m_effectParams->dirty = false;
+        }
+    }
+    const bool effectsPending = m_effectChain && m_effectChain->isDirty();
+
+    if (!m_renderPending && !hasAsyncFrame && !asyncUploaded && !needsMips && !effectsPending)
+        return;
+
+    QRhiCommandBuffer *cb = commandBuffer();
+    if (!cb)
         return;
 
+    const bool rendering = m_renderPending || hasAsyncFrame || asyncUploaded;
+    if (hasAsyncFrame) {
+        QQuickRhiItemTraceScope traceScope("asyncFrameCopy", m_traceName);
+        QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+        if (asyncFrame.nativeTexture) {
+            // rendered in a context sharing with the window's, the wrapper
+            // does not own the texture
+            if (!m_asyncShared)
+                m_asyncShared.reset(m_rhi->newTexture(QRhiTexture::RGBA8, asyncFrame.pixelSize, 1, QRhiTexture::UsedAsTransferSource));
+            else
+                m_asyncShared->setPixelSize(asyncFrame.pixelSize);
+            if (m_asyncShared->createFrom({ asyncFrame.nativeTexture, 0 }))
+                rub->copyTexture(m_texture, m_asyncShared.data());
+            else
+                qWarning("QQuickRhiItem: failed to wrap the texture of the asynchronous renderer");
+        } else {
+            // no scheduler, the window is going away
+            rub->uploadTexture(m_texture, QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(asyncFrame.data)));
+        }
+        cb->resourceUpdate(rub);
+        asyncFrameShown(asyncFrame.startTime, asyncFrame.renderTime);
+    } else if (m_renderPending) {
+        m_renderPending = false;
+        // Renders without a sync in between, requested by the renderer's
+        // update() or a channel, have nothing that tracked what changed.
+        if (!m_damageSynced)
+            m_damage = QRect(QPoint(0, 0), m_pixelSize);
+        // a render requested after the prepare phase, e.g. by a channel, or
+        // the first one, which finds out whether prepare() is reimplemented
+        if (!m_prepared && m_prepareImplemented) {
+            m_prepareProbing = !m_prepareProbed;
+            runPrepare();
+            m_prepareProbing = false;
+            m_prepareProbed = true;
+        }
+        m_prepared = false;
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::render", m_traceName);
+        QQuickRhiItemAllocationScope allocationScope(m_rhi, &m_stats);
+        QElapsedTimer renderTimer;
+        renderTimer.start();
+        if (m_capture)
+            m_capture->beginFrame(m_rhi);
+        m_renderer->render(cb);
+        if (m_capture) {
+            m_capture->endFrame();
+            if (--m_captureFramesLeft == 0) {
+                if (m_capture->save(m_captureFileName))
+                    qInfo("QQuickRhiItem: captured %d frames to %s", m_capture->frameCount(), qPrintable(m_captureFileName));
+                m_capture.reset();
+            }
+        }
+        ++m_stats.renderCount;
+        m_stats.lastRenderTime = renderTimer.nsecsElapsed();
+        m_stats.renderTime += m_stats.lastRenderTime;
+        // snapshots taken from channels in prepare() or render(), measured
+        // from their publish() to the end of recording
+        const qint64 now = QQuickRhiItemChannelState::timestamp();
+        for (const QSharedPointer<QQuickRhiItemChannelState> &channel : std::as_const(m_channels)) {
+            if (const qint64 publishTime = channel->takeLatchTime()) {
+                ++m_stats.latchCount;
+                m_stats.lastLatchLatency = now - publishTime;
+                m_stats.latchLatency += m_stats.lastLatchLatency;
+            }
+        }
+        m_damage = QRegion();
+        m_damageSynced = false;
+        m_mipsValid = false;
+    }
+
+    // unchanged parameters on unchanged contents give the same result
+    if (m_effectChain && (rendering || effectsPending)) {
+        QQuickRhiItemTraceScope traceScope("effects", m_traceName);
+        m_effectChain->run(cb, m_texture);
+        ++m_stats.effectRunCount;
+        m_mipsValid = false;
+    }
+
+    if (wantsMips && !m_mipsValid) {
+        QQuickRhiItemTraceScope traceScope("resourceUpdate", m_traceName);
+        QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+        rub->generateMips(displayTexture());
+        cb->resourceUpdate(rub);
+        m_mipsValid = true;
+    }
+
+    markDirty(QSGNode::DirtyMaterial);
+    emit textureChanged();
+}
+
+QRhiCommandBuffer *QQuickRhiItemNode::commandBuffer() const
+{
     QSGRendererInterface *rif = m_window->rendererInterface();
     QRhiCommandBuffer *cb = nullptr;
     QRhiSwapChain *swapchain = static_cast<QRhiSwapChain *>(
         rif->getResource(m_window, QSGRendererInterface::RhiSwapchainResource));
     cb = swapchain ? swapchain->currentFrameCommandBuffer()
                    : static_cast<QRhiCommandBuffer *>(rif->getResource(m_window, QSGRendererInterface::RhiRedirectCommandBuffer));
-    if (!cb) {
+    if (!cb)
         qWarning("Neither swapchain nor redirected command buffer are available.");
+    return cb;
+}
+
+void QQuickRhiItemNode::textureUploaded(QRhiTexture *texture)
+{
+    // the only uploads of asynchronous rendering are the read back frames,
+    // the renderer's own are submitted on the worker
+    if (m_async) {
+        if (texture == m_texture && m_asyncUploadPending) {
+            m_asyncUploadPending = false;
+            m_asyncUploaded = true;
+            asyncFrameShown(m_asyncUploadStartTime, m_asyncUploadRenderTime);
+        }
         return;
     }
+    // the first item rendering in the frame submits the uploads of all of
+    // them, the others may still be in prepare()
+    waitForPrepare();
+    if (m_renderer)
+        m_renderer->textureUploaded(texture);
+}
 
-    m_renderPending = false;
-    m_renderer->render(cb);
-
-    markDirty(QSGNode::DirtyMaterial);
-    emit textureChanged();
+void QQuickRhiItemNode::asyncFrameShown(qint64 startTime, qint64 renderTime)
+{
+    ++m_stats.renderCount;
+    m_stats.lastRenderTime = renderTime;
+    m_stats.renderTime += renderTime;
+    ++m_stats.asyncFrameCount;
+    m_stats.lastAsyncFrameAge = QQuickRhiItemTrace::timestamp() - startTime;
+    m_stats.asyncFrameAge += m_stats.lastAsyncFrameAge;
+    m_mipsValid = false;
 }
 
 void QQuickRhiItemNode::scheduleUpdate()
@@ -324,6 +1001,185 @@ void QQuickRhiItemNode::scheduleUpdate()
     m_window->update(); // ensure getting to beforeRendering() at some point
 }
 
+/*!
+    \class QQuickRhiItemChannel
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief A lock-free, triple-buffered channel for passing data from a
+    QQuickRhiItem and its producer threads to the QQuickRhiItemRenderer.
+
+    QQuickRhiItemRenderer::synchronize() is the only place where the renderer
+    can safely read the item's data, and it is called with the GUI thread
+    blocked. For large amounts of data that change many times per frame, such
+    as the sample arrays of a telemetry view updated by worker threads,
+    copying in synchronize() stalls the GUI thread, and each
+    QQuickItem::update() implies a full synchronization.
+
+    QQuickRhiItemChannel holds three instances of \c T. The producer fills one
+    of them and publishes it, the renderer takes the most recently published
+    one in render(), and the third is the one in between. Publishing and
+    taking never block and never copy \c T, they only exchange indices.
+    Snapshots published faster than the renderer can consume them are
+    dropped, only the newest one is ever seen by the renderer.
+
+    Publishing also requests a new frame, resulting in a render() call for the
+    item, just like QQuickRhiItemRenderer::update() does. synchronize() is not
+    called because of a publish.
+
+    The channel is created by the item, typically as a member. The renderer
+    gets its own handle to the same channel by copying it in synchronize(),
+    which is cheap. The handles share the underlying data, so it remains
+    valid for the renderer even after the item is destroyed.
+
+    \code
+        class PlotItem : public QQuickRhiItem
+        {
+        public:
+            QQuickRhiItemChannel<QList<float>> samples { this };
+            ...
+        };
+
+        // producer thread
+        QList<float> &buf = item->samples.beginPublish();
+        buf.clear();
+        ...
+        item->samples.publish();
+
+        void PlotRenderer::synchronize(QQuickRhiItem *item)
+        {
+            m_samples = static_cast<PlotItem *>(item)->samples;
+        }
+
+        void PlotRenderer::render(QRhiCommandBuffer *cb)
+        {
+            if (m_samples.takeLatest())
+                upload(m_samples.latest());
+            ...
+        }
+    \endcode
+
+    For interactive content, such as a transform driven by dragging with the
+    mouse, the channel also allows late latching: the event handler publishes
+    the newest transform, and the renderer takes it at the start of render(),
+    right before recording the commands, and patches its uniform buffer. The
+    frame then reflects the most recent input without waiting for the next
+    synchronize(). The publish time of each snapshot is recorded, the latency
+    from publish() to the end of the render() call that took the snapshot is
+    reported in QQuickRhiItem::stats().
+
+    \note beginPublish() and publish() can be called from any thread, but not
+    from more than one thread at the same time. The producer must stop
+    publishing before the item is destroyed. takeLatest() and latest() must
+    only be called from the renderer.
+ */
+
+void QQuickRhiItemChannelState::attach(QQuickRhiItem *item, const QSharedPointer<QQuickRhiItemChannelState> &state)
+{
+    state->m_item = item;
+    QQuickRhiItemPrivate::get(item)->channels.append(state);
+}
+
+qint64 QQuickRhiItemChannelState::timestamp()
+{
+    return QQuickRhiItemTrace::timestamp();
+}
+
+void QQuickRhiItemChannelState::wake()
+{
+    m_wakeup.store(true, std::memory_order_release);
+
+    // QQuickWindow::update() cannot be called from arbitrary threads, go
+    // through the item's thread, coalescing the requests
+    if (m_notifyPending.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    QMetaObject::invokeMethod(m_item, [this] {
+        m_notifyPending.store(false, std::memory_order_release);
+        if (QQuickWindow *w = m_item->window())
+            w->update();
+    }, Qt::QueuedConnection);
+}
+
+static QMutex rendererPoolMutex;
+static QHash<QRhi *, QQuickRhiItemRendererPool *> rendererPools;
+
+QQuickRhiItemRendererPool *QQuickRhiItemRendererPool::get(QRhi *rhi)
+{
+    QMutexLocker lock(&rendererPoolMutex);
+    QQuickRhiItemRendererPool *&pool = rendererPools[rhi];
+    if (!pool) {
+        pool = new QQuickRhiItemRendererPool;
+        // the renderers own QRhi resources, so they must go before the QRhi
+        rhi->addCleanupCallback([](QRhi *rhi) {
+            QMutexLocker lock(&rendererPoolMutex);
+            delete rendererPools.take(rhi);
+        });
+    }
+    return pool;
+}
+
+QQuickRhiItemRendererPool::QQuickRhiItemRendererPool()
+{
+    bool ok = false;
+    m_maxPerType = qEnvironmentVariableIntValue("QSG_RHIITEM_RENDERER_POOL_SIZE", &ok);
+    if (!ok)
+        m_maxPerType = 16;
+    m_maxPerType = qBound(0, m_maxPerType, 1024);
+}
+
+QQuickRhiItemRendererPool::~QQuickRhiItemRendererPool()
+{
+    for (const Entry &e : std::as_const(m_entries))
+        delete e.renderer;
+}
+
+void QQuickRhiItemRendererPool::stash(const QMetaObject *type, const void *owner, QQuickRhiItemRenderer *renderer)
+{
+    // pooling disabled by the environment
+    if (m_maxPerType <= 0) {
+        delete renderer;
+        return;
+    }
+
+    int count = 0;
+    int oldest = -1;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries[i].type == type) {
+            if (oldest < 0)
+                oldest = i;
+            ++count;
+        }
+    }
+    if (count >= m_maxPerType) {
+        delete m_entries[oldest].renderer;
+        m_entries.removeAt(oldest);
+    }
+    m_entries.append({ type, owner, renderer });
+}
+
+QQuickRhiItemRenderer *QQuickRhiItemRendererPool::take(const QMetaObject *type, const void *owner)
+{
+    // Prefer the renderer that was used by the same item before, e.g. when a
+    // pooled delegate gets reused, then fall back to the most recent one of
+    // the same type.
+    int match = -1;
+    for (int i = m_entries.count() - 1; i >= 0; --i) {
+        if (m_entries[i].type != type)
+            continue;
+        if (m_entries[i].owner == owner) {
+            match = i;
+            break;
+        }
+        if (match < 0)
+            match = i;
+    }
+    if (match < 0)
+        return nullptr;
+
+    return m_entries.takeAt(match).renderer;
+}
+
 QQuickRhiItem::QQuickRhiItem(QQuickItem *parent)
     : QQuickItem(*new QQuickRhiItemPrivate, parent)
 {
@@ -335,6 +1191,7 @@ QQuickRhiItem::QQuickRhiItem(QQuickItem *parent)
  */
 QSGNode *QQuickRhiItem::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
 {
+    QQuickRhiItemTraceScope traceScope("QQuickRhiItem::updatePaintNode", this);
     Q_D(QQuickRhiItem);
     QQuickRhiItemNode *n = static_cast<QQuickRhiItemNode *>(node);
 
@@ -345,17 +1202,45 @@ QSGNode *QQuickRhiItem::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
     if (!n && (width() <= 0 || height() <= 0))
         return nullptr;
 
+    // a pooled delegate gives up its node and texture, and the renderer
+    // goes to the pool of recycled renderers with rendererRecycling
+    if (d->pooled) {
+        if (n) {
+            delete n;
+            d->node = nullptr;
+        }
+        return nullptr;
+    }
+
     if (!n) {
         if (!d->node)
             d->node = new QQuickRhiItemNode(this);
         n = d->node;
     }
 
+    if (n->hasRenderer() && n->isAsync() != d->asyncRendering)
+        n->releaseRenderer();
+
+    // reused before the node was released, the renderer stays but is now
+    // for a different model row
+    if (d->rendererResetPending && n->hasRenderer() && !n->isAsync())
+        n->resetRenderer();
+    d->rendererResetPending = false;
+
     if (!n->hasRenderer()) {
-        QQuickRhiItemRenderer *r = createRenderer();
+        QQuickRhiItemRenderer *r = d->rendererRecycling && !d->asyncRendering ? n->takeRecycledRenderer() : nullptr;
+        const bool recycled = r != nullptr;
+        if (!recycled)
+            r = createRenderer();
         if (r) {
-            r->data = n;
+            if (!recycled)
+                ++n->stats().rendererCreateCount;
+            // asynchronous renderers find their runner through
+            // QQuickRhiItemAsyncRunner::current(), the node is not theirs
+            r->data = d->asyncRendering ? nullptr : n;
             n->setRenderer(r);
+            if (recycled)
+                r->reset();
         } else {
             qWarning("No QQuickRhiItemRenderer was created; the item will not render");
             delete n;
@@ -391,6 +1276,18 @@ void QQuickRhiItem::geometryChange(const QRectF &newGeometry, const QRectF &oldG
         update();
 }
 
+/*!
+    \reimp
+ */
+void QQuickRhiItem::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    // prewarming the pipelines starts with the scenegraph, not only once the
+    // first item has been rendered
+    if (change == ItemSceneChange && value.window)
+        QQuickRhiItemFrameScheduler::watch(value.window);
+}
+
 /*!
     \internal
  */
@@ -577,9 +1474,580 @@ void QQuickRhiItem::setMirrorVertically(bool enable)
 }
 
 /*!
-    Call this function when the texture contents should be rendered again. This
-    function can be called from render() to force the texture to be rendered to
-    again before the next frame, i.e. to request another call to render().
+    \property QQuickRhiItem::mipmap
+
+    This property controls if the QQuickRhiItem's associated texture has a
+    full mipmap chain, to be used when the item is drawn on screen at a
+    smaller size than the texture, for example when scaled down.
+
+    The default value is false.
+
+    When enabled, the texture is created with mipmaps. After each render(),
+    the mip levels are generated, but only when the item is actually minified
+    on screen, taking transforms such as Scale into account. When drawn at 1:1
+    or magnified, no mipmap generation or mipmap filtering is performed.
+
+    Enabling this improves the quality and the texture cache efficiency of
+    items that are commonly shown at smaller sizes, for example in thumbnail
+    grids, at the expense of 33% more texture memory and the cost of
+    generating the mip levels.
+
+    \note Toggling the value leads to recreating the texture.
+ */
+
+bool QQuickRhiItem::mipmap() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->mipmap;
+}
+
+void QQuickRhiItem::setMipmap(bool enable)
+{
+    Q_D(QQuickRhiItem);
+    if (d->mipmap == enable)
+        return;
+
+    d->mipmap = enable;
+    emit mipmapChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::rendererRecycling
+
+    This property controls if the QQuickRhiItemRenderer is kept alive and
+    reused when the item's scenegraph node is destroyed, instead of deleting
+    it.
+
+    The default value is false.
+
+    Delegates in views such as ListView and TableView are created and
+    destroyed, or pooled and reused, as the view scrolls. Each time this
+    happens, the item loses its node and with it the renderer, so the next
+    time the item is shown createRenderer() and the full initialization of the
+    renderer, including all its graphics resources, has to happen again.
+
+    When this property is set to true, the renderer is instead placed in a pool
+    belonging to the QRhi. Whenever an item of the same type needs a renderer,
+    a pooled one is taken, preferring the one that belonged to the same item
+    before, as is the case with \c{ListView.reuseItems}. createRenderer() is
+    not called then. Instead, QQuickRhiItemRenderer::reset() is invoked,
+    followed by the usual initialize() and synchronize() calls.
+
+    Delegates that are pooled rather than destroyed keep their node while
+    they are hidden, unless they call pooled() and reused() from the view's
+    attached signals.
+
+    The number of pooled renderers per item type is limited to 16 by default,
+    this can be overridden by the \c QSG_RHIITEM_RENDERER_POOL_SIZE environment
+    variable, up to 1024. A size of 0 disables the pool, the renderers are
+    then destroyed as without recycling.
+
+    \note Only enable this for items whose renderers can be moved between item
+    instances, i.e. that only depend on state that is passed to them in
+    synchronize().
+ */
+
+bool QQuickRhiItem::rendererRecycling() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->rendererRecycling;
+}
+
+void QQuickRhiItem::setRendererRecycling(bool enable)
+{
+    Q_D(QQuickRhiItem);
+    if (d->rendererRecycling == enable)
+        return;
+
+    d->rendererRecycling = enable;
+    emit rendererRecyclingChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::preserveContents
+
+    This property controls if the contents of the texture are kept between
+    renders, allowing the renderer to only redraw the parts that changed.
+
+    The default value is false, meaning the renderer is expected to redraw
+    the entire texture in each render().
+
+    When enabled, the item reports the changed areas with addDirtyRect(), and
+    the renderer queries the accumulated region with
+    QQuickRhiItemRenderer::damageRegion() in render(), and restricts its
+    drawing to it, for example with scissor rectangles. The renderer must
+    create its render target with
+    QRhiTextureRenderTarget::PreserveColorContents in initialize() when
+    QQuickRhiItemRenderer::preserveContents() returns true, otherwise the
+    previous contents are not guaranteed to be available. This makes
+    incremental updates, where only a small part of a large canvas changes
+    per frame, significantly cheaper in terms of fill rate.
+
+    Whenever the texture is recreated, for example due to a size change, the
+    damage region is the entire texture.
+
+    \note Toggling the value leads to calling
+    QQuickRhiItemRenderer::initialize() again, with the same output texture.
+    Renderers have to compare QQuickRhiItemRenderer::preserveContents() with
+    the value their render target was created with, and rebuild it when it
+    differs. Checking for a new output texture is not enough.
+
+    \sa addDirtyRect(), QQuickRhiItemRenderer::damageRegion()
+ */
+
+bool QQuickRhiItem::preserveContents() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->preserveContents;
+}
+
+void QQuickRhiItem::setPreserveContents(bool enable)
+{
+    Q_D(QQuickRhiItem);
+    if (d->preserveContents == enable)
+        return;
+
+    d->preserveContents = enable;
+    emit preserveContentsChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::computeOutput
+
+    This property controls if the QQuickRhiItem's associated texture is
+    written by compute shaders instead of being rendered into.
+
+    The default value is false.
+
+    When enabled, the texture is created with QRhiTexture::UsedWithLoadStore
+    instead of QRhiTexture::RenderTarget. The renderer binds it as a storage
+    image, with QRhiShaderResourceBinding::imageStore(), and dispatches a
+    QRhiComputePipeline writing every pixel, without a render target, a
+    render pass or a graphics pipeline. This suits items that are per-pixel
+    computations, such as fractals, simulations or image processing.
+
+    As with uploaded images, the pixel at (0, 0) is the top-left corner of
+    the item, with all backends.
+
+    When QRhi::Compute is not supported, for example with OpenGL ES 3.0 or
+    older OpenGL versions, the property is ignored with a warning, and the
+    renderer gets a texture to render into. Renderers are therefore expected
+    to check QQuickRhiItemRenderer::computeOutput() in initialize() and
+    provide a raster path as a fallback.
+
+    \note Toggling the value leads to recreating the texture.
+ */
+
+bool QQuickRhiItem::computeOutput() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->computeOutput;
+}
+
+void QQuickRhiItem::setComputeOutput(bool enable)
+{
+    Q_D(QQuickRhiItem);
+    if (d->computeOutput == enable)
+        return;
+
+    d->computeOutput = enable;
+    emit computeOutputChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::asyncRendering
+
+    This property controls if the renderer runs on a thread of its own,
+    decoupled from Qt Quick's frames.
+
+    The default value is false.
+
+    When enabled, the renderer gets its own QRhi, for the same graphics API
+    as the window, and a thread that calls prepare() and render() whenever
+    update() was called and the previous frame has finished. A renderer
+    taking longer than a frame to render then does not slow down the rest of
+    the scene: Qt Quick keeps showing the latest completed frame of the
+    item, and picks up the next one once it is ready.
+
+    With OpenGL, the renderer's context shares with the window's, and
+    completed frames are copied on the GPU into the texture shown in the
+    scene. With the other graphics APIs, whose QRhi resources cannot be
+    shared between QRhi instances, and when the contexts do not share,
+    completed frames are read back on the renderer's thread and uploaded
+    into the texture shown in the scene. These uploads count against the
+    same per-frame budget as QQuickRhiItemRenderer::scheduleTextureUpload(),
+    and cost a copy of the item's pixels per shown frame, so the mode suits
+    expensive renderers rather than cheap ones at high resolutions. The age
+    of the shown contents is reported in stats().
+
+    synchronize() is called, with the GUI thread blocked, only in between
+    the renderer's frames. Changes made while a frame is in progress are
+    synchronized once it has finished. The QRhi and the output texture
+    passed to initialize() belong to the renderer's thread, and
+    QQuickRhiItemRenderer::scheduleTextureUpload() submits uploads at the
+    start of the next frame, without a budget.
+
+    Renderers are not recycled in this mode, and toggling the value
+    recreates the renderer. The old renderer is destroyed on its thread once
+    the frame it is rendering has finished, which Qt Quick does not wait
+    for. Effects, the channel and the compute output
+    mode work as usual.
+ */
+
+bool QQuickRhiItem::asyncRendering() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->asyncRendering;
+}
+
+void QQuickRhiItem::setAsyncRendering(bool enable)
+{
+    Q_D(QQuickRhiItem);
+    if (d->asyncRendering == enable)
+        return;
+
+    d->asyncRendering = enable;
+#if QT_CONFIG(opengl)
+    // must be created on the GUI thread, for the context of the worker
+    if (enable && !d->asyncFallbackSurface && QQuickWindow::graphicsApi() == QSGRendererInterface::OpenGL)
+        d->asyncFallbackSurface.reset(QRhiGles2InitParams::newFallbackSurface(), &QObject::deleteLater);
+#endif
+    emit asyncRenderingChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::placeholderColor
+
+    This property holds the color shown in place of the item's contents
+    while the initialization of its renderer is deferred.
+
+    The default value is transparent.
+
+    When a page with many items appears, all of them create their renderers
+    and run QQuickRhiItemRenderer::initialize() in the same frame, which
+    can take long enough to be visible as a stall. Setting the
+    \c QSG_RHIITEM_INIT_BUDGET environment variable limits how many items
+    are initialized per frame, either as a count, such as \c 4, or as a
+    time in milliseconds, such as \c 8ms. The first initialization of the
+    renderers beyond the budget is deferred to the following frames, and
+    the item shows this color until then. Items that are visible in the
+    window go first, the ones covering the largest area on screen first
+    among them. At least one item is initialized per frame, so a renderer
+    taking longer than the time budget is not starved.
+
+    Only the first initialize() of a renderer is deferred, the ones due to a
+    new texture size or a changed preserveContents are not. synchronize()
+    and render() are not called before the renderer is initialized. Items
+    with \l asyncRendering initialize on their own thread and are not
+    affected.
+
+    The delay for each item is reported in stats(), together with the time
+    from the first deferred item of a page to the frame in which the last
+    one is initialized, which is also logged in the
+    \c qt.quick.rhiitem.init logging category.
+ */
+
+QColor QQuickRhiItem::placeholderColor() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->placeholderColor;
+}
+
+void QQuickRhiItem::setPlaceholderColor(const QColor &color)
+{
+    Q_D(QQuickRhiItem);
+    if (d->placeholderColor == color)
+        return;
+
+    d->placeholderColor = color;
+    emit placeholderColorChanged();
+    update();
+}
+
+/*!
+    Marks \a rect, in texture pixels with the origin at the top-left corner,
+    as needing to be redrawn, and schedules an update. The rectangles added
+    between two renders are merged into QQuickRhiItemRenderer::damageRegion().
+
+    Only relevant when preserveContents is enabled. Calling update() without
+    adding a dirty rectangle leads to an empty damage region, except when the
+    texture has been recreated. Use effectiveTextureSize to map from item
+    coordinates. Renders requested from the render thread, by
+    QQuickRhiItemRenderer::update() or a QQuickRhiItemChannel, redraw the
+    entire texture.
+
+    \sa preserveContents
+ */
+void QQuickRhiItem::addDirtyRect(const QRect &rect)
+{
+    Q_D(QQuickRhiItem);
+    d->dirtyRegion += rect;
+    update();
+}
+
+/*!
+    Tells the item that its delegate was put into the reuse pool of a view,
+    such as ListView with \c reuseItems enabled. Call it from the delegate's
+    \c{ListView.onPooled} or \c{TableView.onPooled} handler:
+
+    \qml
+        delegate: MyRhiItem {
+            id: preview
+            rendererRecycling: true
+            ListView.onPooled: preview.pooled()
+            ListView.onReused: preview.reused()
+        }
+    \endqml
+
+    The item then releases its texture, and its renderer, into the pool of
+    recycled renderers when \l rendererRecycling is enabled, so that pooled
+    delegates do not hold graphics resources while they are hidden.
+
+    \sa reused(), rendererRecycling
+ */
+void QQuickRhiItem::pooled()
+{
+    Q_D(QQuickRhiItem);
+    if (d->pooled)
+        return;
+
+    d->pooled = true;
+    update();
+}
+
+/*!
+    Tells the item that its delegate was taken out of the reuse pool of a
+    view, for a different model row. Call it from the delegate's
+    \c{ListView.onReused} or \c{TableView.onReused} handler.
+
+    The item gets its renderer back, preferably the one it had before, or
+    keeps it if it was still there, and QQuickRhiItemRenderer::reset() is
+    called on it in either case.
+
+    \sa pooled()
+ */
+void QQuickRhiItem::reused()
+{
+    Q_D(QQuickRhiItem);
+    if (!d->pooled)
+        return;
+
+    d->pooled = false;
+    d->rendererResetPending = true;
+    update();
+}
+
+/*!
+    Records what the renderer issues in its next \a frameCount render()
+    calls, and writes it to \a fileName, to be replayed with the rhireplay
+    tool independently of the scene.
+
+    Only commands issued through a QQuickRhiItemCommandRecorder created
+    with QQuickRhiItemRenderer::capture() are recorded, no file is written
+    when there are none. QRhiCommandBuffer cannot be intercepted, so
+    renderers have to issue their commands through the recorder, which
+    QQuickRhiItemRenderGraph::render() and QQuickRhiItemText::draw() accept
+    as well. The capture starts with the next synchronization, and the file
+    is written on the render thread after the last frame. Capturing is not supported with
+    \l asyncRendering.
+
+    \sa QQuickRhiItemCapture
+ */
+void QQuickRhiItem::captureFrames(const QString &fileName, int frameCount)
+{
+    Q_D(QQuickRhiItem);
+    if (frameCount <= 0)
+        return;
+
+    d->captureFileName = fileName;
+    d->captureFrameCount = frameCount;
+    update();
+}
+
+/*!
+    \property QQuickRhiItem::effects
+
+    A list of RhiItemEffect full-screen shader passes, run on the render
+    thread after the renderer, in list order. The last effect writes the
+    texture that the item shows and that its texture provider exposes.
+
+    The effects run again when the renderer has rendered, or when an effect
+    parameter has changed. A parameter change alone does not lead to
+    synchronizing or rendering the renderer. Adding, removing, enabling or
+    disabling effects, or changing their shaders, does.
+
+    \sa RhiItemEffect
+ */
+QQmlListProperty<QQuickRhiItemEffect> QQuickRhiItem::effects()
+{
+    return QQmlListProperty<QQuickRhiItemEffect>(this, nullptr,
+                                                 QQuickRhiItemPrivate::effects_append,
+                                                 QQuickRhiItemPrivate::effects_count,
+                                                 QQuickRhiItemPrivate::effects_at,
+                                                 QQuickRhiItemPrivate::effects_clear);
+}
+
+void QQuickRhiItemPrivate::effects_append(QQmlListProperty<QQuickRhiItemEffect> *list, QQuickRhiItemEffect *effect)
+{
+    QQuickRhiItem *item = static_cast<QQuickRhiItem *>(list->object);
+    QQuickRhiItemPrivate *d = get(item);
+    if (!effect || d->effects.contains(effect))
+        return;
+
+    if (!d->effectParams)
+        d->effectParams.reset(new QQuickRhiItemEffectParams);
+    d->effects.append(effect);
+    QObject::connect(effect, &QQuickRhiItemEffect::changed, item, [d] { d->effectsChanged(); });
+    QObject::connect(effect, &QQuickRhiItemEffect::parametersChanged, item, [d] { d->publishEffectParameters(); });
+    QObject::connect(effect, &QObject::destroyed, item, [d, effect] {
+        d->effects.removeOne(effect);
+        d->effectsChanged();
+    });
+    d->effectsChanged();
+}
+
+qsizetype QQuickRhiItemPrivate::effects_count(QQmlListProperty<QQuickRhiItemEffect> *list)
+{
+    return get(static_cast<QQuickRhiItem *>(list->object))->effects.count();
+}
+
+QQuickRhiItemEffect *QQuickRhiItemPrivate::effects_at(QQmlListProperty<QQuickRhiItemEffect> *list, qsizetype index)
+{
+    return get(static_cast<QQuickRhiItem *>(list->object))->effects.at(index);
+}
+
+void QQuickRhiItemPrivate::effects_clear(QQmlListProperty<QQuickRhiItemEffect> *list)
+{
+    QQuickRhiItem *item = static_cast<QQuickRhiItem *>(list->object);
+    QQuickRhiItemPrivate *d = get(item);
+    for (QQuickRhiItemEffect *effect : std::as_const(d->effects))
+        QObject::disconnect(effect, nullptr, item, nullptr);
+    d->effects.clear();
+    d->effectsChanged();
+}
+
+void QQuickRhiItemPrivate::effectsChanged()
+{
+    Q_Q(QQuickRhiItem);
+    effectsDirty = true;
+    q->update();
+}
+
+void QQuickRhiItemPrivate::publishEffectParameters()
+{
+    Q_Q(QQuickRhiItem);
+    {
+        QMutexLocker lock(&effectParams->mutex);
+        effectParams->data = activeEffectParameters();
+        effectParams->dirty = true;
+    }
+    // no sync needed, the node picks the data up in render()
+    if (QQuickWindow *w = q->window())
+        w->update();
+}
+
+QList<QShader> QQuickRhiItemPrivate::activeEffectShaders() const
+{
+    QList<QShader> shaders;
+    for (const QQuickRhiItemEffect *effect : effects) {
+        if (effect->isActive())
+            shaders.append(effect->shader());
+    }
+    return shaders;
+}
+
+QList<QByteArray> QQuickRhiItemPrivate::activeEffectParameters() const
+{
+    QList<QByteArray> data;
+    for (const QQuickRhiItemEffect *effect : effects) {
+        if (effect->isActive())
+            data.append(effect->parameterData());
+    }
+    return data;
+}
+
+/*!
+    \return statistics about the work performed by the item and its renderer
+    on the render thread. The counters and times (in nanoseconds) accumulate
+    over the lifetime of the item, also when the scenegraph node and the
+    renderer are recreated.
+
+    \list
+    \li \c syncCount, \c renderCount - the number of synchronize() and
+    render() invocations
+    \li \c rendererCreateCount - the number of renderers returned by
+    createRenderer()
+    \li \c rendererInitializeCount - the number of initialize() calls
+    \li \c textureCreateCount - the number of times a new texture was
+    associated with the item, either newly created or recycled
+    \li \c textureResizeCount - the number of times the texture was rebuilt
+    in place with a new size
+    \li \c resourceAllocationCount - the number of graphics resources
+    actually created by the item, i.e. textures not coming from the pool,
+    plus the in-place rebuilds, and by the renderer in initialize(),
+    synchronize() and render(), including the ones created on the QRhi
+    directly. Resources taken from QQuickRhiItemTexturePool or
+    QQuickRhiItemPipelineCache with a hit are not counted, neither are the
+    ones of \l asyncRendering. When several windows render on different
+    threads at the same time, the count may include their resources too
+    \li \c syncTime, \c lastSyncTime - the time spent in synchronizing the
+    node, including the renderer's initialize() and synchronize()
+    \li \c rendererSynchronizeTime - the time spent in the renderer's
+    synchronize()
+    \li \c renderTime, \c lastRenderTime - the time spent in the renderer's
+    render()
+    \li \c effectRunCount - the number of times the \l effects chain was
+    run
+    \li \c latchCount - the number of snapshots the renderer took from a
+    QQuickRhiItemChannel
+    \li \c latchLatency, \c lastLatchLatency - the time from publishing a
+    snapshot to the end of the render() call that took it, i.e. the latency
+    from the producer, such as an input event handler, to the recorded
+    frame
+    \li \c asyncFrameCount - with \l asyncRendering, the number of frames
+    of the renderer that were shown
+    \li \c asyncFrameAge, \c lastAsyncFrameAge - with \l asyncRendering,
+    the time from the start of the renderer's render() to the frame being
+    copied or uploaded for display, i.e. how old the shown contents are
+    \li \c rendererInitializeTime - the time spent in the renderer's
+    initialize()
+    \li \c deferredInitializeCount, \c initializeDelay - the number of
+    times the renderer's initialization was deferred due to the budget
+    described in \l placeholderColor, and the time from the item's first
+    frame to the last deferred initialization
+    \li \c initializeBurstTime - the time from the first deferred
+    initialization of the most recent page of items in the window to the
+    frame in which the last one was done, i.e. until the page was complete
+    \endlist
+
+    With \l asyncRendering, \c renderCount and the render times refer to
+    the frames that were shown, frames replaced by newer ones before being
+    shown are not counted.
+
+    The values are transferred to the item in the synchronization phase, so
+    they reflect the state as of the previous frame.
+
+    Comparing the deltas over a number of frames, for example in an
+    application-level benchmark, allows detecting both performance and
+    allocation regressions. In a steady state, where neither the item size nor
+    the renderer changes, \c resourceAllocationCount is not expected to
+    increase.
+ */
+QQuickRhiItem::Stats QQuickRhiItem::stats() const
+{
+    Q_D(const QQuickRhiItem);
+    return d->stats;
+}
+
+/*!
+    Call this function when the texture contents should be rendered again. This
+    function can be called from render() to force the texture to be rendered to
+    again before the next frame, i.e. to request another call to render().
 
     \note This function should be used from inside the renderer. To update the
     item on the GUI thread, use QQuickRhiItem::update(). Calling this function
@@ -590,8 +2058,172 @@ void QQuickRhiItem::setMirrorVertically(bool enable)
  */
 void QQuickRhiItemRenderer::update()
 {
-    if (data)
-        static_cast<QQuickRhiItemNode *>(data)->scheduleUpdate();
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current())
+        runner->requestRender();
+    else if (QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data))
+        node->scheduleUpdate();
+}
+
+/*!
+    \return true when QQuickRhiItem::preserveContents is enabled. Then the
+    render target should be created with
+    QRhiTextureRenderTarget::PreserveColorContents. The value is valid in
+    initialize(), which is called again when it changes, with the same
+    output texture, so the render target has to be rebuilt then.
+ */
+bool QQuickRhiItemRenderer::preserveContents() const
+{
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current())
+        return runner->preserveContents();
+    QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data);
+    return node && node->preserveContents();
+}
+
+/*!
+    \return the region of the texture, in pixels with the origin at the
+    top-left corner, that needs to be redrawn in render().
+
+    This is the entire texture when QQuickRhiItem::preserveContents is
+    disabled, and when the texture has been created or resized since the last
+    render(). Otherwise it is the union of the rectangles reported via
+    QQuickRhiItem::addDirtyRect() since the last render(), which may be empty.
+    Renders without a synchronize() since the last one, requested by update()
+    or by a QQuickRhiItemChannel, get the entire texture as well.
+
+    Note that with OpenGL the scissor rectangles are specified with the
+    origin at the bottom-left corner.
+
+    \code
+        void CanvasRenderer::render(QRhiCommandBuffer *cb)
+        {
+            const QRegion damage = damageRegion();
+            if (damage.isEmpty())
+                return;
+            cb->beginPass(m_rt.data(), Qt::transparent, { 1.0f, 0 });
+            cb->setGraphicsPipeline(m_ps.data()); // with UsesScissor set
+            for (const QRect &r : damage) {
+                const int y = m_rhi->isYUpInFramebuffer() ? m_output->pixelSize().height() - r.bottom() - 1 : r.y();
+                cb->setScissor({ r.x(), y, r.width(), r.height() });
+                ...
+            }
+            cb->endPass();
+        }
+    \endcode
+ */
+QRegion QQuickRhiItemRenderer::damageRegion() const
+{
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current())
+        return runner->damage();
+    QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data);
+    return node ? node->damage() : QRegion();
+}
+
+/*!
+    \return true when the output texture is to be written by compute shaders,
+    as a storage image. This is the case when QQuickRhiItem::computeOutput is
+    enabled and QRhi::Compute is supported. Otherwise the output texture can
+    only be rendered into. The value is valid in initialize(), which is
+    called again, with a new texture, when it changes.
+ */
+bool QQuickRhiItemRenderer::computeOutput() const
+{
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current())
+        return runner->computeOutput();
+    QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data);
+    return node && node->computeOutput();
+}
+
+/*!
+    \return the active capture, started by QQuickRhiItem::captureFrames(),
+    or null. Valid in render(), where it is passed to the
+    QQuickRhiItemCommandRecorder the commands are issued through.
+ */
+QQuickRhiItemCapture *QQuickRhiItemRenderer::capture() const
+{
+    return data ? static_cast<QQuickRhiItemNode *>(data)->capture() : nullptr;
+}
+
+/*!
+    Schedules uploading \a desc into \a texture, instead of recording it in
+    a resource update batch directly.
+
+    The uploads scheduled by all QQuickRhiItem renderers in a window are
+    submitted with a per-frame budget, higher \a priority first. When many
+    renderers upload large images in the same frame, for example when the
+    content of many items changes at once, the uploads are spread over the
+    following frames, avoiding a long frame. The budget is 4 MB by default,
+    and can be changed by setting the \c QSG_RHIITEM_UPLOAD_BUDGET environment
+    variable to a value in bytes. At least one upload is submitted per frame.
+
+    textureUploaded() is called once the upload is submitted. \a texture must
+    stay valid until then, or until the upload is cancelled with
+    cancelTextureUploads(). Scheduled uploads are dropped when the item's
+    node, and thus the renderer, is destroyed.
+
+    With QQuickRhiItem::asyncRendering, the uploads are submitted at the
+    beginning of the renderer's next frame on its own thread, without a
+    budget, as they do not delay Qt Quick's frames.
+
+    A renderer that is not driven by a QQuickRhiItem, for example one
+    created directly in a benchmark, uploads right away in an offscreen
+    frame of the texture's QRhi, and textureUploaded() is called before this
+    function returns. This is not possible while that QRhi is recording a
+    frame, then the upload is dropped with a warning.
+
+    \sa textureUploaded(), cancelTextureUploads()
+ */
+void QQuickRhiItemRenderer::scheduleTextureUpload(QRhiTexture *texture, const QRhiTextureUploadDescription &desc, int priority)
+{
+    QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data);
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current()) {
+        runner->scheduleUpload(texture, desc);
+        return;
+    }
+    if (node && node->scheduler()) {
+        node->scheduler()->scheduleUpload(node, texture, desc, priority);
+        return;
+    }
+
+    // no frame scheduler to hand the upload to
+    QRhi *rhi = texture->rhi();
+    QRhiCommandBuffer *cb = nullptr;
+    if (!rhi || rhi->isRecordingFrame() || rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+        qWarning("QQuickRhiItemRenderer: Failed to upload texture, there is no frame scheduler and no offscreen frame");
+        return;
+    }
+    QRhiResourceUpdateBatch *u = rhi->nextResourceUpdateBatch();
+    u->uploadTexture(texture, desc);
+    cb->resourceUpdate(u);
+    rhi->endOffscreenFrame();
+    textureUploaded(texture);
+}
+
+/*!
+    Cancels the scheduled uploads for \a texture that have not been submitted
+    yet. Must be called before destroying a texture with pending uploads.
+ */
+void QQuickRhiItemRenderer::cancelTextureUploads(QRhiTexture *texture)
+{
+    QQuickRhiItemNode *node = static_cast<QQuickRhiItemNode *>(data);
+    if (QQuickRhiItemAsyncRunner *runner = QQuickRhiItemAsyncRunner::current())
+        runner->cancelUploads(texture);
+    else if (node && node->scheduler())
+        node->scheduler()->cancelUploads(node, texture);
+}
+
+/*!
+    Called on the render thread when an upload scheduled with
+    scheduleTextureUpload() for \a texture has been submitted. The texture can
+    be used in render passes from this point on, including in the current
+    frame.
+
+    The default implementation calls update(), in order to get render()
+    invoked.
+ */
+void QQuickRhiItemRenderer::textureUploaded(QRhiTexture *texture)
+{
+    Q_UNUSED(texture);
+    update();
 }
 
 /*!
@@ -645,6 +2277,11 @@ QQuickRhiItemRenderer::~QQuickRhiItemRenderer()
     This function is called on the render thread of the Qt Quick scenegraph.
     Called with the GUI (main) thread blocked.
 
+    Renderers that are created and destroyed frequently, such as the ones
+    belonging to ListView delegates, can acquire their depth-stencil buffers
+    from QQuickRhiItemTexturePool instead of creating them directly. The
+    texture passed in \a outputTexture is recycled the same way.
+
     The created resources are expected to be released in the destructor
     implementation of the subclass. \a rhi and \a outputTexture are not owned
     by, and are guaranteed to outlive the QQuickRhiItemRenderer.
@@ -682,6 +2319,47 @@ void QQuickRhiItemRenderer::synchronize(QQuickRhiItem *item)
     Q_UNUSED(item);
 }
 
+/*!
+    Called before each render(), on a worker thread, to perform CPU-side
+    work, such as calculating matrices, culling, or building per-instance
+    data, that does not need to happen on the render thread.
+
+    The prepare() calls of all QQuickRhiItems in a window are started in
+    parallel, on a thread pool, once the synchronization of the items is
+    complete. Each item's render() waits for its own prepare() to finish, so
+    on machines with many cores the CPU work of a large number of items no
+    longer adds up on the render thread. The size of the pool can be set by
+    the \c QSG_RHIITEM_PREPARE_THREADS environment variable, the default is
+    the number of CPU cores.
+
+    The implementation must only access the renderer's own data, as prepared
+    by synchronize(), and must not use the QRhi or the item. Results, for
+    example the contents of uniform buffers, are to be uploaded in render().
+    In some cases, such as when a render is requested via a
+    QQuickRhiItemChannel after the synchronization phase, this function is
+    called on the render thread instead, right before render().
+
+    No other function of the renderer is called while prepare() runs. The
+    render thread waits for it to finish before calling render(),
+    synchronize(), textureUploaded(), which may be due to the submission of
+    another item's uploads, reset() or the destructor. The renderer's
+    functions that are called from within prepare() are exempt, so update(),
+    for example, can be called from there.
+
+    The first call after the renderer is created is always on the render
+    thread. The default implementation does nothing, renderers not
+    reimplementing this function, or whose reimplementation calls it, are
+    not scheduled on the worker threads at all.
+
+    \sa render(), synchronize()
+ */
+void QQuickRhiItemRenderer::prepare()
+{
+    // not reimplemented, avoid the thread hops from now on
+    if (data)
+        static_cast<QQuickRhiItemNode *>(data)->prepareNotImplemented();
+}
+
 /*!
     Called when the item contents (i.e. the contents of the texture) need
     updating.
@@ -707,5 +2385,29 @@ void QQuickRhiItemRenderer::render(QRhiCommandBuffer *cb)
     Q_UNUSED(cb);
 }
 
+/*!
+    Called when a renderer is taken from the pool of recycled renderers and
+    associated with an item, instead of creating a new one via
+    QQuickRhiItem::createRenderer(). This can only happen when
+    QQuickRhiItem::rendererRecycling is enabled. It is also called when the
+    item is reused by a view via QQuickRhiItem::reused() while it still had
+    its renderer, then only synchronize() follows.
+
+    The renderer may have belonged to a different item of the same type
+    before. Reimplement this function to drop state that is specific to the
+    previous item. Graphics resources, such as pipelines, should be kept, that
+    is the point of recycling. Calls to initialize() and synchronize() follow,
+    as with a newly created renderer, but \c outputTexture is likely to be
+    different from before.
+
+    This function is called on the render thread of the Qt Quick scenegraph.
+    Called with the GUI (main) thread blocked.
+
+    \sa QQuickRhiItem::rendererRecycling, QQuickRhiItem::reused(), initialize()
+ */
+void QQuickRhiItemRenderer::reset()
+{
+}
+
 #include "rhiitem.moc"
 #include "moc_rhiitem.cpp"
@@ -1,13 +1,19 @@
 #ifndef RHIITEM_H
 #define RHIITEM_H
 
+#include <QColor>
 #include <QQuickItem>
+#include <QQmlListProperty>
+#include <QRegion>
 
 class QQuickRhiItem;
+class QQuickRhiItemCapture;
+class QQuickRhiItemEffect;
 class QQuickRhiItemPrivate;
 class QRhi;
 class QRhiTexture;
 class QRhiCommandBuffer;
+class QRhiTextureUploadDescription;
 
 class QQuickRhiItemRenderer
 {
@@ -15,13 +21,26 @@ public:
     virtual ~QQuickRhiItemRenderer();
     virtual void initialize(QRhi *rhi, QRhiTexture *outputTexture);
     virtual void synchronize(QQuickRhiItem *item);
+    virtual void prepare();
     virtual void render(QRhiCommandBuffer *cb);
+    virtual void reset();
+    virtual void textureUploaded(QRhiTexture *texture);
 
     void update();
 
+    void scheduleTextureUpload(QRhiTexture *texture, const QRhiTextureUploadDescription &desc, int priority = 0);
+    void cancelTextureUploads(QRhiTexture *texture);
+
+    bool preserveContents() const;
+    QRegion damageRegion() const;
+    bool computeOutput() const;
+
+    QQuickRhiItemCapture *capture() const;
+
 private:
-    void *data;
+    void *data = nullptr;
     friend class QQuickRhiItem;
+    friend class QQuickRhiItemNode;
 };
 
 class QQuickRhiItem : public QQuickItem
@@ -34,8 +53,42 @@ class QQuickRhiItem : public QQuickItem
     Q_PROPERTY(QSize effectiveTextureSize READ effectiveTextureSize NOTIFY effectiveTextureSizeChanged)
     Q_PROPERTY(bool alphaBlending READ alphaBlending WRITE setAlphaBlending NOTIFY alphaBlendingChanged)
     Q_PROPERTY(bool mirrorVertically READ mirrorVertically WRITE setMirrorVertically NOTIFY mirrorVerticallyChanged)
+    Q_PROPERTY(bool mipmap READ mipmap WRITE setMipmap NOTIFY mipmapChanged)
+    Q_PROPERTY(bool rendererRecycling READ rendererRecycling WRITE setRendererRecycling NOTIFY rendererRecyclingChanged)
+    Q_PROPERTY(bool preserveContents READ preserveContents WRITE setPreserveContents NOTIFY preserveContentsChanged)
+    Q_PROPERTY(bool computeOutput READ computeOutput WRITE setComputeOutput NOTIFY computeOutputChanged)
+    Q_PROPERTY(bool asyncRendering READ asyncRendering WRITE setAsyncRendering NOTIFY asyncRenderingChanged)
+    Q_PROPERTY(QColor placeholderColor READ placeholderColor WRITE setPlaceholderColor NOTIFY placeholderColorChanged)
+    Q_PROPERTY(QQmlListProperty<QQuickRhiItemEffect> effects READ effects)
+    Q_MOC_INCLUDE("rhiitemeffect.h")
 
 public:
+    struct Stats {
+        quint64 syncCount = 0;
+        quint64 renderCount = 0;
+        quint64 rendererCreateCount = 0;
+        quint64 rendererInitializeCount = 0;
+        quint64 textureCreateCount = 0;
+        quint64 textureResizeCount = 0;
+        quint64 resourceAllocationCount = 0;
+        qint64 syncTime = 0;
+        qint64 rendererSynchronizeTime = 0;
+        qint64 renderTime = 0;
+        qint64 lastSyncTime = 0;
+        qint64 lastRenderTime = 0;
+        quint64 latchCount = 0;
+        qint64 latchLatency = 0;
+        qint64 lastLatchLatency = 0;
+        quint64 effectRunCount = 0;
+        quint64 asyncFrameCount = 0;
+        qint64 asyncFrameAge = 0;
+        qint64 lastAsyncFrameAge = 0;
+        qint64 rendererInitializeTime = 0;
+        quint64 deferredInitializeCount = 0;
+        qint64 initializeDelay = 0;
+        qint64 initializeBurstTime = 0;
+    };
+
     QQuickRhiItem(QQuickItem *parent = nullptr);
 
     virtual QQuickRhiItemRenderer *createRenderer() = 0;
@@ -53,9 +106,37 @@ public:
     bool mirrorVertically() const;
     void setMirrorVertically(bool enable);
 
+    bool mipmap() const;
+    void setMipmap(bool enable);
+
+    bool rendererRecycling() const;
+    void setRendererRecycling(bool enable);
+
+    bool preserveContents() const;
+    void setPreserveContents(bool enable);
+
+    bool computeOutput() const;
+    void setComputeOutput(bool enable);
+
+    bool asyncRendering() const;
+    void setAsyncRendering(bool enable);
+
+    QColor placeholderColor() const;
+    void setPlaceholderColor(const QColor &color);
+
+    Q_INVOKABLE void addDirtyRect(const QRect &rect);
+    Q_INVOKABLE void captureFrames(const QString &fileName, int frameCount);
+    Q_INVOKABLE void pooled();
+    Q_INVOKABLE void reused();
+
+    QQmlListProperty<QQuickRhiItemEffect> effects();
+
+    Stats stats() const;
+
 protected:
     QSGNode *updatePaintNode(QSGNode *, UpdatePaintNodeData *) override;
     void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
     void releaseResources() override;
     bool isTextureProvider() const override;
     QSGTextureProvider *textureProvider() const override;
@@ -66,6 +147,12 @@ Q_SIGNALS:
     void effectiveTextureSizeChanged();
     void alphaBlendingChanged();
     void mirrorVerticallyChanged();
+    void mipmapChanged();
+    void rendererRecyclingChanged();
+    void preserveContentsChanged();
+    void computeOutputChanged();
+    void asyncRenderingChanged();
+    void placeholderColorChanged();
 
 private Q_SLOTS:
     void invalidateSceneGraph();
@@ -2,12 +2,24 @@
 #define RHIITEM_P_H
 
 #include "rhiitem.h"
+#include "rhiitemchannel.h"
+#include <QtGui/private/qshader_p.h>
+#include <QPointer>
+#include <QSemaphore>
 #include <QSGSimpleTextureNode>
 #include <QtQuick/private/qquickitem_p.h>
+#include <atomic>
 
 class QSGPlainTexture;
 class QRhiTexture;
 class QRhi;
+class QThreadPool;
+class QQuickRhiItemFrameScheduler;
+class QQuickRhiItemEffectChain;
+class QQuickRhiItemAsyncRunner;
+class QQuickRhiItemCapture;
+class QOffscreenSurface;
+struct QQuickRhiItemEffectParams;
 
 class QQuickRhiItemNode : public QSGTextureProvider, public QSGSimpleTextureNode
 {
@@ -23,14 +35,47 @@ public:
     bool isValid() const { return m_rhi && m_texture && m_sgWrapperTexture; }
     void scheduleUpdate();
     bool hasRenderer() const { return m_renderer; }
-    void setRenderer(QQuickRhiItemRenderer *r) { m_renderer = r; }
+    void setRenderer(QQuickRhiItemRenderer *r)
+    {
+        m_renderer = r;
+        m_rendererInitialized = false;
+        m_prepareProbed = false;
+        m_prepareImplemented = true;
+    }
+    void releaseRenderer();
+    void resetRenderer();
+    bool isAsync() const { return m_async; }
+    QQuickRhiItemRenderer *takeRecycledRenderer();
+    QQuickRhiItem *item() const { return m_item; }
+    QQuickRhiItem::Stats &stats() { return m_stats; }
+    bool preserveContents() const { return m_preserveContents; }
+    bool computeOutput() const { return m_computeOutput; }
+    QQuickRhiItemCapture *capture() const { return m_capture.data(); }
+    QRegion damage() const { return m_damage; }
+    void addMipmapUser() { ++m_mipmapUsers; }
+    void removeMipmapUser() { --m_mipmapUsers; }
+    void launchPrepare(QThreadPool *pool);
+    QQuickRhiItemFrameScheduler *scheduler() const { return m_scheduler; }
+    void textureUploaded(QRhiTexture *texture);
+    void prepareNotImplemented() { if (m_prepareProbing) m_prepareImplemented = false; }
+    void initializeDeferred();
 
 private slots:
     void render();
 
 private:
-    void createNativeTexture();
+    bool resolveRhi();
+    bool isMinified() const;
+    void runPrepare();
+    QRhiCommandBuffer *commandBuffer() const;
+    void waitForPrepare();
+    QRhiTexture *createNativeTexture(bool mipmap, bool computeOutput);
     void releaseNativeTexture();
+    void syncEffects(bool textureChanged);
+    QRhiTexture *displayTexture() const;
+    void deferInitialization();
+    void endDeferredInitialization();
+    void asyncFrameShown(qint64 startTime, qint64 renderTime);
 
     QQuickRhiItem *m_item;
     QQuickWindow *m_window;
@@ -40,7 +85,67 @@ private:
     QRhiTexture *m_texture = nullptr;
     QSGPlainTexture *m_sgWrapperTexture = nullptr;
     bool m_renderPending = true;
+    bool m_mipmap = false;
+    bool m_computeOutput = false;
+    bool m_computeOutputWarned = false;
+    bool m_mipsValid = false;
+    int m_mipmapUsers = 0;
     QQuickRhiItemRenderer *m_renderer = nullptr;
+    bool m_rendererInitialized = false;
+    const QMetaObject *m_rendererType;
+    bool m_rendererRecycling = false;
+    bool m_preserveContents = false;
+    QRegion m_damage;
+    bool m_damageSynced = false; // since the last render()
+    QList<QSharedPointer<QQuickRhiItemChannelState>> m_channels;
+    QByteArray m_traceName;
+    QQuickRhiItem::Stats m_stats;
+    QPointer<QQuickRhiItemFrameScheduler> m_scheduler;
+    QSemaphore m_prepareDone;
+    bool m_prepareLaunched = false;
+    bool m_prepared = false;
+    bool m_prepareImplemented = true;
+    bool m_prepareProbed = false; // the first prepare() ran on the render thread
+    bool m_prepareProbing = false;
+    QScopedPointer<QQuickRhiItemEffectChain> m_effectChain;
+    QSharedPointer<QQuickRhiItemEffectParams> m_effectParams;
+    QScopedPointer<QQuickRhiItemAsyncRunner> m_async;
+    QSharedPointer<std::atomic<bool>> m_asyncResync;
+    QMetaObject::Connection m_asyncResyncConnection;
+    QScopedPointer<QRhiTexture> m_asyncShared; // wraps the worker's texture
+    bool m_asyncUploadPending = false; // a read back frame in the scheduler
+    qint64 m_asyncUploadStartTime = 0;
+    qint64 m_asyncUploadRenderTime = 0;
+    bool m_asyncUploaded = false; // since the last render()
+    QScopedPointer<QQuickRhiItemCapture> m_capture;
+    QString m_captureFileName;
+    int m_captureFramesLeft = 0;
+    bool m_initPending = false;
+    qint64 m_initRequestTime = 0;
+    QRhiTexture *m_placeholderTexture = nullptr;
+    QColor m_placeholderColor;
+    bool m_placeholderDirty = false;
+};
+
+class QQuickRhiItemRendererPool
+{
+public:
+    static QQuickRhiItemRendererPool *get(QRhi *rhi);
+
+    void stash(const QMetaObject *type, const void *owner, QQuickRhiItemRenderer *renderer);
+    QQuickRhiItemRenderer *take(const QMetaObject *type, const void *owner);
+
+private:
+    QQuickRhiItemRendererPool();
+    ~QQuickRhiItemRendererPool();
+
+    struct Entry {
+        const QMetaObject *type;
+        const void *owner; // only compared, never dereferenced
+        QQuickRhiItemRenderer *renderer;
+    };
+    QList<Entry> m_entries; // oldest first
+    int m_maxPerType;
 };
 
 class QQuickRhiItemPrivate : public QQuickItemPrivate
@@ -48,12 +153,39 @@ class QQuickRhiItemPrivate : public QQuickItemPrivate
     Q_DECLARE_PUBLIC(QQuickRhiItem)
 public:
     static QQuickRhiItemPrivate *get(QQuickRhiItem *item) { return item->d_func(); }
+
+    static void effects_append(QQmlListProperty<QQuickRhiItemEffect> *list, QQuickRhiItemEffect *effect);
+    static qsizetype effects_count(QQmlListProperty<QQuickRhiItemEffect> *list);
+    static QQuickRhiItemEffect *effects_at(QQmlListProperty<QQuickRhiItemEffect> *list, qsizetype index);
+    static void effects_clear(QQmlListProperty<QQuickRhiItemEffect> *list);
+    void effectsChanged();
+    void publishEffectParameters();
+    QList<QShader> activeEffectShaders() const;
+    QList<QByteArray> activeEffectParameters() const;
+
     mutable QQuickRhiItemNode *node = nullptr;
     int explicitTextureWidth = 0;
     int explicitTextureHeight = 0;
     bool blend = true;
     bool mirrorVertically = false;
+    bool mipmap = false;
+    bool rendererRecycling = false;
+    bool pooled = false;
+    bool rendererResetPending = false;
+    bool preserveContents = false;
+    bool computeOutput = false;
+    bool asyncRendering = false;
+    QSharedPointer<QOffscreenSurface> asyncFallbackSurface;
+    QString captureFileName;
+    int captureFrameCount = 0;
+    QColor placeholderColor = Qt::transparent;
+    QRegion dirtyRegion; // in texture pixels
     QSize effectiveTextureSize;
+    QList<QSharedPointer<QQuickRhiItemChannelState>> channels;
+    QQuickRhiItem::Stats stats;
+    QList<QQuickRhiItemEffect *> effects;
+    bool effectsDirty = false;
+    QSharedPointer<QQuickRhiItemEffectParams> effectParams;
 };
 
 #endif
@@ -0,0 +1,417 @@
+#include "rhiitemasync_p.h"
+#include "rhiitem.h"
+#include "rhiitemtrace_p.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QQuickWindow>
+#if QT_CONFIG(opengl)
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#endif
+
+/*
+    Runs a QQuickRhiItemRenderer on a thread of its own, with its own
+    offscreen QRhi of the same backend as the window's, for
+    QQuickRhiItem::asyncRendering.
+
+    The node hands over the item's state by calling synchronize() during its
+    sync, which only happens when the worker is idle. Otherwise the sync is
+    retried in the next frame, so the Qt Quick frame never waits for the
+    renderer. Each frame rendered on the worker is published as the latest
+    frame, replacing one that was not taken yet, and the window is asked to
+    update. The node takes it in its render().
+
+    With OpenGL the worker's context shares with the window's, so the frames
+    need not leave the GPU. The worker copies each one into one of a few
+    slot textures and waits for the copy, the node wraps the slot's texture
+    with QRhiTexture::createFrom() and copies it into the texture shown by
+    the scenegraph. A slot is only rendered into again once the node took
+    two more frames, by then the copy reading it is done. The other backends
+    offer no way to share textures between QRhi instances, nor does OpenGL
+    when the contexts turn out not to share, so the frames are read back
+    instead. The node hands the data to the frame scheduler, which uploads
+    it within the budget shared with the renderers' uploads.
+
+    Stopping the worker, when the node goes away or switches to synchronous
+    rendering, does not wait for the frame it is rendering. The runner
+    deletes itself on the GUI thread once the worker is done.
+ */
+
+static thread_local QQuickRhiItemAsyncRunner *currentRunner = nullptr;
+
+QQuickRhiItemAsyncRunner::QQuickRhiItemAsyncRunner(QQuickRhiItemRenderer *renderer, QRhi *rhi, QQuickWindow *window,
+                                                   const QSharedPointer<QOffscreenSurface> &fallbackSurface,
+                                                   QOpenGLContext *shareContext)
+    : m_renderer(renderer),
+      m_backend(rhi->backend()),
+      m_window(window),
+      m_fallbackSurface(fallbackSurface),
+      m_shareContext(shareContext)
+{
+#if QT_CONFIG(vulkan)
+    m_vulkanInstance = window->vulkanInstance();
+#endif
+    setObjectName(QLatin1String("QQuickRhiItem async"));
+    start();
+}
+
+QQuickRhiItemAsyncRunner::~QQuickRhiItemAsyncRunner()
+{
+    stop();
+}
+
+void QQuickRhiItemAsyncRunner::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_quit = true;
+        m_wakeup.wakeOne();
+    }
+    // the renderer and the QRhi are destroyed on the worker
+    wait();
+}
+
+/*
+    Like stop(), without waiting for the worker, and deletes the runner once
+    it has finished. Called on the render thread instead of deleting it.
+ */
+void QQuickRhiItemAsyncRunner::release()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_quit = true;
+        m_wakeup.wakeOne();
+    }
+    // the render thread may be gone by the time the worker finishes
+    moveToThread(QCoreApplication::instance()->thread());
+    connect(this, &QThread::finished, this, &QObject::deleteLater);
+    if (isFinished())
+        deleteLater();
+}
+
+/*
+    The renderers of asynchronous rendering have no node, their functions
+    find the runner through this instead. Set on the worker, and on the
+    render thread while synchronize() calls the renderer.
+ */
+QQuickRhiItemAsyncRunner *QQuickRhiItemAsyncRunner::current()
+{
+    return currentRunner;
+}
+
+/*
+    Called on the render thread with the GUI thread blocked. Returns false,
+    without calling the renderer's synchronize(), while the worker is
+    rendering.
+ */
+bool QQuickRhiItemAsyncRunner::synchronize(QQuickRhiItem *item, const QSize &pixelSize, bool computeOutput,
+                                           bool preserveContents, const QRegion &damage)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_busy)
+            return false;
+        m_pending.pixelSize = pixelSize;
+        m_pending.computeOutput = computeOutput;
+        m_pending.preserveContents = preserveContents;
+        m_pending.damage += damage;
+        m_pending.synchronized = true;
+        // keeps the worker waiting, without holding the mutex, which
+        // update() in synchronize() needs
+        m_synchronizing = true;
+    }
+
+    {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::synchronize", static_cast<QQuickItem *>(item));
+        currentRunner = this;
+        m_renderer->synchronize(item);
+        currentRunner = nullptr;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_synchronizing = false;
+    m_renderRequested = true;
+    m_wakeup.wakeOne();
+    return true;
+}
+
+bool QQuickRhiItemAsyncRunner::takeFrame(Frame *frame)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_frameReady)
+        return false;
+
+    *frame = std::move(m_frame);
+    m_frame = Frame();
+    m_frameReady = false;
+    // the slot taken before may still be copied from in the frame being
+    // shown, it is only rendered into again after the next one is taken
+    m_retiredSlot = m_heldSlot;
+    m_heldSlot = frame->slot;
+    m_readySlot = -1;
+    return true;
+}
+
+void QQuickRhiItemAsyncRunner::requestRender()
+{
+    QMutexLocker lock(&m_mutex);
+    m_renderRequested = true;
+    m_wakeup.wakeOne();
+}
+
+void QQuickRhiItemAsyncRunner::scheduleUpload(QRhiTexture *texture, const QRhiTextureUploadDescription &desc)
+{
+    // not budgeted, the uploads do not hold up the Qt Quick frame
+    QMutexLocker lock(&m_mutex);
+    m_uploads.append({ texture, desc });
+    m_renderRequested = true;
+    m_wakeup.wakeOne();
+}
+
+void QQuickRhiItemAsyncRunner::cancelUploads(QRhiTexture *texture)
+{
+    QMutexLocker lock(&m_mutex);
+    m_uploads.removeIf([texture](const Upload &u) { return u.texture == texture; });
+}
+
+bool QQuickRhiItemAsyncRunner::createRhi()
+{
+    switch (m_backend) {
+    case QRhi::Null: {
+        QRhiNullInitParams params;
+        m_rhi = QRhi::create(QRhi::Null, &params);
+        break;
+    }
+#if QT_CONFIG(opengl)
+    case QRhi::OpenGLES2: {
+        QRhiGles2InitParams params;
+        params.format = QSurfaceFormat::defaultFormat();
+        params.fallbackSurface = m_fallbackSurface.data();
+        params.shareContext = m_shareContext;
+        if (params.fallbackSurface)
+            m_rhi = QRhi::create(QRhi::OpenGLES2, &params);
+        if (m_rhi && m_shareContext) {
+            const auto *handles = static_cast<const QRhiGles2NativeHandles *>(m_rhi->nativeHandles());
+            m_sharedTextures = handles && QOpenGLContext::areSharing(handles->context, m_shareContext);
+        }
+        break;
+    }
+#endif
+#if QT_CONFIG(vulkan)
+    case QRhi::Vulkan: {
+        QRhiVulkanInitParams params;
+        params.inst = m_vulkanInstance;
+        if (params.inst)
+            m_rhi = QRhi::create(QRhi::Vulkan, &params);
+        break;
+    }
+#endif
+#ifdef Q_OS_WIN
+    case QRhi::D3D11: {
+        QRhiD3D11InitParams params;
+        m_rhi = QRhi::create(QRhi::D3D11, &params);
+        break;
+    }
+    case QRhi::D3D12: {
+        QRhiD3D12InitParams params;
+        m_rhi = QRhi::create(QRhi::D3D12, &params);
+        break;
+    }
+#endif
+#if QT_CONFIG(metal)
+    case QRhi::Metal: {
+        QRhiMetalInitParams params;
+        m_rhi = QRhi::create(QRhi::Metal, &params);
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+
+    if (!m_rhi)
+        qWarning("QQuickRhiItem: failed to create a QRhi for asynchronous rendering, the item will not render");
+    return m_rhi != nullptr;
+}
+
+bool QQuickRhiItemAsyncRunner::ensureTexture()
+{
+    QRhiTexture::Flags flags = QRhiTexture::UsedAsTransferSource;
+    m_current.computeOutput = m_current.computeOutput && m_rhi->isFeatureSupported(QRhi::Compute);
+    flags |= m_current.computeOutput ? QRhiTexture::UsedWithLoadStore : QRhiTexture::RenderTarget;
+
+    if (m_texture && m_texture->pixelSize() == m_current.pixelSize && m_texture->flags() == flags)
+        return true;
+
+    if (m_texture && m_texture->flags() == flags) {
+        m_texture->setPixelSize(m_current.pixelSize);
+    } else {
+        delete m_texture;
+        m_texture = m_rhi->newTexture(QRhiTexture::RGBA8, m_current.pixelSize, 1, flags);
+    }
+    m_initialized = false;
+    if (!m_texture->create()) {
+        qWarning("Failed to create QQuickRhiItem texture of size %dx%d",
+                 m_current.pixelSize.width(), m_current.pixelSize.height());
+        return false;
+    }
+    return true;
+}
+
+/*
+    Returns a slot texture of the current size that the node is not using,
+    or -1, when the frame is to be read back instead.
+ */
+int QQuickRhiItemAsyncRunner::acquireSlot()
+{
+    int slot = -1;
+    {
+        QMutexLocker lock(&m_mutex);
+        for (int i = 0; i < SLOT_COUNT && slot < 0; ++i) {
+            if (i != m_readySlot && i != m_heldSlot && i != m_retiredSlot)
+                slot = i;
+        }
+    }
+    if (slot < 0)
+        return -1;
+
+    QRhiTexture *&texture = m_slots[slot];
+    if (texture && texture->pixelSize() == m_current.pixelSize)
+        return slot;
+    if (texture)
+        texture->setPixelSize(m_current.pixelSize);
+    else
+        texture = m_rhi->newTexture(QRhiTexture::RGBA8, m_current.pixelSize, 1, QRhiTexture::UsedAsTransferSource);
+    if (!texture->create()) {
+        qWarning("Failed to create QQuickRhiItem shared texture of size %dx%d",
+                 m_current.pixelSize.width(), m_current.pixelSize.height());
+        return -1;
+    }
+    return slot;
+}
+
+void QQuickRhiItemAsyncRunner::renderFrame(const QList<Upload> &uploads)
+{
+    auto finish = [this](Frame *frame) {
+        QMutexLocker lock(&m_mutex);
+        if (frame) {
+            m_readySlot = frame->slot;
+            m_frame = std::move(*frame);
+            m_frameReady = true;
+            // under the lock, the window may be gone once release() returned
+            if (!m_quit)
+                QMetaObject::invokeMethod(m_window, &QQuickWindow::update, Qt::QueuedConnection);
+        }
+        m_busy = false;
+    };
+
+    // nothing to render into before the first synchronize()
+    if (m_current.pixelSize.isEmpty() || !ensureTexture()) {
+        finish(nullptr);
+        return;
+    }
+
+    if (!m_initialized || m_current.preserveContents != m_initializedPreserveContents) {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::initialize", QByteArrayLiteral("QQuickRhiItem async"));
+        m_renderer->initialize(m_rhi, m_texture);
+        m_initialized = true;
+        m_initializedPreserveContents = m_current.preserveContents;
+        m_current.damage = QRect(QPoint(0, 0), m_current.pixelSize);
+    }
+    if (!m_current.preserveContents)
+        m_current.damage = QRect(QPoint(0, 0), m_current.pixelSize);
+
+    QRhiCommandBuffer *cb = nullptr;
+    if (m_rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+        finish(nullptr);
+        return;
+    }
+
+    if (!uploads.isEmpty()) {
+        QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+        for (const Upload &u : std::as_const(uploads))
+            rub->uploadTexture(u.texture, u.desc);
+        cb->resourceUpdate(rub);
+        for (const Upload &u : std::as_const(uploads))
+            m_renderer->textureUploaded(u.texture);
+    }
+
+    Frame frame;
+    frame.startTime = QQuickRhiItemTrace::timestamp();
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+    {
+        QQuickRhiItemTraceScope traceScope("QQuickRhiItemRenderer::render", QByteArrayLiteral("QQuickRhiItem async"));
+        m_renderer->prepare();
+        m_renderer->render(cb);
+    }
+    frame.renderTime = renderTimer.nsecsElapsed();
+
+    const int slot = m_sharedTextures ? acquireSlot() : -1;
+    QRhiReadbackResult readback;
+    QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+    if (slot >= 0)
+        rub->copyTexture(m_slots[slot], m_texture);
+    else
+        rub->readBackTexture({ m_texture }, &readback);
+    cb->resourceUpdate(rub);
+    // waits for the GPU, the readback is complete afterwards
+    m_rhi->endOffscreenFrame();
+
+    if (slot >= 0) {
+#if QT_CONFIG(opengl)
+        // the window's context may only sample the copy once it is done
+        if (m_rhi->makeThreadLocalNativeContextCurrent())
+            QOpenGLContext::currentContext()->functions()->glFinish();
+#endif
+        frame.nativeTexture = m_slots[slot]->nativeTexture().object;
+        frame.slot = slot;
+        frame.pixelSize = m_current.pixelSize;
+    } else {
+        frame.data = std::move(readback.data);
+        frame.pixelSize = readback.pixelSize;
+    }
+    finish(&frame);
+}
+
+void QQuickRhiItemAsyncRunner::run()
+{
+    currentRunner = this;
+    const bool hasRhi = createRhi();
+
+    for (;;) {
+        QList<Upload> uploads;
+        {
+            QMutexLocker lock(&m_mutex);
+            while (!m_quit && (!m_renderRequested || m_synchronizing))
+                m_wakeup.wait(&m_mutex);
+            if (m_quit)
+                break;
+            m_renderRequested = false;
+            if (!hasRhi) {
+                m_uploads.clear();
+                continue;
+            }
+            // from here on synchronize() is refused until the frame is done
+            m_busy = true;
+            if (m_pending.synchronized) {
+                m_current = m_pending;
+                m_pending.damage = QRegion();
+                m_pending.synchronized = false;
+            } else {
+                // requested by the renderer's update() or a channel,
+                // nothing tracked what changed
+                m_current.damage = QRect(QPoint(0, 0), m_current.pixelSize);
+            }
+            uploads = std::exchange(m_uploads, {});
+        }
+        renderFrame(uploads);
+    }
+
+    delete m_renderer;
+    delete m_texture;
+    for (QRhiTexture *texture : m_slots)
+        delete texture;
+    delete m_rhi;
+}
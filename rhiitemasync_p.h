@@ -0,0 +1,113 @@
+#ifndef RHIITEMASYNC_P_H
+#define RHIITEMASYNC_P_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QByteArray>
+#include <QMutex>
+#include <QRegion>
+#include <QSharedPointer>
+#include <QThread>
+#include <QWaitCondition>
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QVulkanInstance;
+class QQuickItem;
+class QQuickWindow;
+class QQuickRhiItem;
+class QQuickRhiItemRenderer;
+
+class QQuickRhiItemAsyncRunner : public QThread
+{
+public:
+    struct Frame {
+        QByteArray data; // RGBA8, tightly packed, in the row order of the texture
+        quint64 nativeTexture = 0; // instead of data, in a context sharing with the window's
+        int slot = -1;
+        QSize pixelSize;
+        qint64 startTime = 0; // when the render() producing it started
+        qint64 renderTime = 0;
+    };
+
+    QQuickRhiItemAsyncRunner(QQuickRhiItemRenderer *renderer, QRhi *rhi, QQuickWindow *window,
+                             const QSharedPointer<QOffscreenSurface> &fallbackSurface,
+                             QOpenGLContext *shareContext);
+    ~QQuickRhiItemAsyncRunner();
+
+    void stop();
+    void release();
+
+    // the runner whose renderer is being called on this thread, if any
+    static QQuickRhiItemAsyncRunner *current();
+
+    // render thread side
+    bool synchronize(QQuickRhiItem *item, const QSize &pixelSize, bool computeOutput, bool preserveContents,
+                     const QRegion &damage);
+    bool takeFrame(Frame *frame);
+
+    // any thread
+    void requestRender();
+    void scheduleUpload(QRhiTexture *texture, const QRhiTextureUploadDescription &desc);
+    void cancelUploads(QRhiTexture *texture);
+
+    // worker side, valid in the renderer's functions
+    bool computeOutput() const { return m_current.computeOutput; }
+    bool preserveContents() const { return m_current.preserveContents; }
+    QRegion damage() const { return m_current.damage; }
+
+protected:
+    void run() override;
+
+private:
+    struct Upload {
+        QRhiTexture *texture;
+        QRhiTextureUploadDescription desc;
+    };
+
+    bool createRhi();
+    bool ensureTexture();
+    int acquireSlot();
+    void renderFrame(const QList<Upload> &uploads);
+
+    struct Params {
+        QSize pixelSize;
+        bool computeOutput = false;
+        bool preserveContents = false;
+        QRegion damage;
+        bool synchronized = false;
+    };
+
+    QQuickRhiItemRenderer *m_renderer; // owned, deleted on the worker
+    QRhi::Implementation m_backend;
+    QQuickWindow *m_window;
+    QSharedPointer<QOffscreenSurface> m_fallbackSurface;
+    QVulkanInstance *m_vulkanInstance = nullptr;
+    QOpenGLContext *m_shareContext;
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeup;
+    bool m_quit = false;
+    bool m_busy = false;
+    bool m_synchronizing = false;
+    bool m_renderRequested = false;
+    Params m_pending;
+    QList<Upload> m_uploads;
+    Frame m_frame;
+    bool m_frameReady = false;
+    // the slots that are not to be rendered into, see takeFrame()
+    int m_readySlot = -1;
+    int m_heldSlot = -1;
+    int m_retiredSlot = -1;
+
+    // only touched on the worker
+    Params m_current;
+    QRhi *m_rhi = nullptr;
+    QRhiTexture *m_texture = nullptr;
+    bool m_sharedTextures = false;
+    static const int SLOT_COUNT = 4;
+    QRhiTexture *m_slots[SLOT_COUNT] = {};
+    bool m_initialized = false;
+    bool m_initializedPreserveContents = false;
+};
+
+#endif
@@ -0,0 +1,1307 @@
+#include "rhiitemcapture.h"
+#include <QDataStream>
+#include <QFile>
+#include <QImage>
+#include <algorithm>
+
+/*!
+    \class QQuickRhiItemCapture
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Records the QRhi commands of a QQuickRhiItemRenderer, and replays
+    them outside of Qt Quick.
+
+    Performance problems of renderers often depend on the live scene, its
+    animations and the timing of the frames, which makes them hard to
+    reproduce and to measure. A capture holds what a renderer's render()
+    issued in a number of frames: the resources it used, the resource
+    updates, together with their data, and the commands. It is started with
+    QQuickRhiItem::captureFrames() and written to a compact binary file, that
+    the tools/rhireplay tool replays any number of times against an
+    offscreen QRhi, reporting the CPU cost of recording and submitting each
+    frame.
+
+    QRhiCommandBuffer cannot be intercepted, so renderers issue their
+    commands through a QQuickRhiItemCommandRecorder, which forwards each call
+    to the command buffer and records it while a capture is active:
+
+    \code
+        void MyRenderer::render(QRhiCommandBuffer *commandBuffer)
+        {
+            QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+            cb.beginPass(m_rt.get(), Qt::black, { 1.0f, 0 }, m_resourceUpdates);
+            cb.setGraphicsPipeline(m_ps.get());
+            // ...
+            cb.endPass();
+        }
+    \endcode
+
+    When no capture is active, the recorder only forwards. Commands issued
+    directly on the QRhiCommandBuffer are not part of the capture, helpers
+    such as QQuickRhiItemRenderGraph::render() and QQuickRhiItemText::draw()
+    take the recorder for this reason.
+
+    Resources are recorded by their description, when first used in the
+    captured frames, and created from it at replay. The contents of
+    resources uploaded before the capture started are not known, replays
+    start with these uninitialized. Resource updates are taken from the
+    QRhiResourceUpdateBatch passed to the recorder, readbacks are left out.
+    Identical data, such as the same shader in multiple pipelines or an
+    unchanged buffer uploaded every frame, is stored once.
+ */
+
+static const char MAGIC[4] = { 'Q', 'R', 'I', 'C' };
+static const quint32 VERSION = 1;
+
+QDataStream &operator<<(QDataStream &ds, const QQuickRhiItemCapture::UpdateOp &u)
+{
+    return ds << quint8(u.type) << u.dst << u.src << u.blob << u.offset << u.layer << u.level
+              << u.srcLayer << u.srcLevel << u.srcTopLeft << u.dstTopLeft << u.size
+              << u.imageFormat << u.imageSize << u.bytesPerLine;
+}
+
+QDataStream &operator>>(QDataStream &ds, QQuickRhiItemCapture::UpdateOp &u)
+{
+    quint8 type;
+    ds >> type >> u.dst >> u.src >> u.blob >> u.offset >> u.layer >> u.level
+       >> u.srcLayer >> u.srcLevel >> u.srcTopLeft >> u.dstTopLeft >> u.size
+       >> u.imageFormat >> u.imageSize >> u.bytesPerLine;
+    u.type = QQuickRhiItemCapture::UpdateOp::Type(type);
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream &ds, const QQuickRhiItemCapture::Command &c)
+{
+    ds << quint8(c.op) << c.resource << c.updates;
+    for (quint32 a : c.args)
+        ds << a;
+    for (float v : c.values)
+        ds << v;
+    return ds << c.bindings;
+}
+
+QDataStream &operator>>(QDataStream &ds, QQuickRhiItemCapture::Command &c)
+{
+    quint8 op;
+    ds >> op >> c.resource >> c.updates;
+    for (quint32 &a : c.args)
+        ds >> a;
+    for (float &v : c.values)
+        ds >> v;
+    ds >> c.bindings;
+    c.op = QQuickRhiItemCapture::Op(op);
+    return ds;
+}
+
+QQuickRhiItemCapture::QQuickRhiItemCapture() = default;
+
+QQuickRhiItemCapture::~QQuickRhiItemCapture()
+{
+    releaseResources();
+}
+
+void QQuickRhiItemCapture::beginFrame(QRhi *rhi)
+{
+    m_backendName = rhi->backendName();
+    m_frames.append(QList<Command>());
+    m_recording = true;
+}
+
+void QQuickRhiItemCapture::endFrame()
+{
+    m_recording = false;
+    m_renderTarget = -1;
+}
+
+void QQuickRhiItemCapture::record(const Command &command)
+{
+    if (m_recording)
+        m_frames.last().append(command);
+}
+
+int QQuickRhiItemCapture::blobId(const QByteArray &data)
+{
+    auto it = m_blobIds.constFind(data);
+    if (it != m_blobIds.cend())
+        return *it;
+    m_blobs.append(data);
+    m_blobIds.insert(data, m_blobs.count() - 1);
+    return m_blobs.count() - 1;
+}
+
+/*
+    Returns the id of the resource, recording its description the first time
+    it is seen. A resource that was changed and rebuilt since, such as a
+    texture with a new size, gets a new id.
+ */
+int QQuickRhiItemCapture::resourceId(QRhiResource *r)
+{
+    if (!r)
+        return -1;
+
+    ResourceType type;
+    QByteArray desc;
+    QDataStream ds(&desc, QIODevice::WriteOnly);
+    switch (r->resourceType()) {
+    case QRhiResource::Buffer: {
+        QRhiBuffer *b = static_cast<QRhiBuffer *>(r);
+        type = Buffer;
+        ds << qint32(b->type()) << qint32(b->usage().toInt()) << b->size();
+        break;
+    }
+    case QRhiResource::Texture: {
+        QRhiTexture *t = static_cast<QRhiTexture *>(r);
+        type = Texture;
+        ds << qint32(t->format()) << t->pixelSize() << qint32(t->depth()) << qint32(t->arraySize())
+           << qint32(t->sampleCount()) << qint32(t->flags().toInt());
+        break;
+    }
+    case QRhiResource::Sampler: {
+        QRhiSampler *s = static_cast<QRhiSampler *>(r);
+        type = Sampler;
+        ds << qint32(s->magFilter()) << qint32(s->minFilter()) << qint32(s->mipmapMode())
+           << qint32(s->addressU()) << qint32(s->addressV()) << qint32(s->addressW())
+           << qint32(s->textureCompareOp());
+        break;
+    }
+    case QRhiResource::RenderBuffer: {
+        QRhiRenderBuffer *rb = static_cast<QRhiRenderBuffer *>(r);
+        type = RenderBuffer;
+        ds << qint32(rb->type()) << rb->pixelSize() << qint32(rb->sampleCount()) << qint32(rb->flags().toInt())
+           << qint32(rb->backingFormat());
+        break;
+    }
+    case QRhiResource::TextureRenderTarget: {
+        QRhiTextureRenderTarget *rt = static_cast<QRhiTextureRenderTarget *>(r);
+        const QRhiTextureRenderTargetDescription d = rt->description();
+        type = TextureRenderTarget;
+        ds << qint32(rt->flags().toInt()) << qint32(d.colorAttachmentCount());
+        for (auto it = d.cbeginColorAttachments(); it != d.cendColorAttachments(); ++it) {
+            ds << qint32(resourceId(it->texture())) << qint32(resourceId(it->renderBuffer()))
+               << qint32(it->layer()) << qint32(it->level()) << qint32(resourceId(it->resolveTexture()))
+               << qint32(it->resolveLayer()) << qint32(it->resolveLevel());
+        }
+        ds << qint32(resourceId(d.depthStencilBuffer())) << qint32(resourceId(d.depthTexture()));
+        break;
+    }
+    case QRhiResource::ShaderResourceBindings: {
+        QRhiShaderResourceBindings *srb = static_cast<QRhiShaderResourceBindings *>(r);
+        type = ShaderResourceBindings;
+        ds << qint32(srb->cendBindings() - srb->cbeginBindings());
+        for (auto it = srb->cbeginBindings(); it != srb->cendBindings(); ++it) {
+            const QRhiShaderResourceBinding::Data *b = it->data();
+            ds << qint32(b->binding) << qint32(b->stage.toInt()) << qint32(b->type);
+            switch (b->type) {
+            case QRhiShaderResourceBinding::UniformBuffer:
+                ds << qint32(resourceId(b->u.ubuf.buf)) << b->u.ubuf.offset << b->u.ubuf.maybeSize
+                   << b->u.ubuf.hasDynamicOffset;
+                break;
+            case QRhiShaderResourceBinding::SampledTexture:
+            case QRhiShaderResourceBinding::Texture:
+            case QRhiShaderResourceBinding::Sampler:
+                ds << qint32(b->u.stex.count);
+                for (int i = 0; i < b->u.stex.count; ++i) {
+                    ds << qint32(resourceId(b->u.stex.texSamplers[i].tex))
+                       << qint32(resourceId(b->u.stex.texSamplers[i].sampler));
+                }
+                break;
+            case QRhiShaderResourceBinding::ImageLoad:
+            case QRhiShaderResourceBinding::ImageStore:
+            case QRhiShaderResourceBinding::ImageLoadStore:
+                ds << qint32(resourceId(b->u.simage.tex)) << qint32(b->u.simage.level);
+                break;
+            case QRhiShaderResourceBinding::BufferLoad:
+            case QRhiShaderResourceBinding::BufferStore:
+            case QRhiShaderResourceBinding::BufferLoadStore:
+                ds << qint32(resourceId(b->u.sbuf.buf)) << b->u.sbuf.offset << b->u.sbuf.maybeSize;
+                break;
+            }
+        }
+        break;
+    }
+    case QRhiResource::GraphicsPipeline: {
+        QRhiGraphicsPipeline *ps = static_cast<QRhiGraphicsPipeline *>(r);
+        type = GraphicsPipeline;
+        ds << qint32(m_renderTarget) << qint32(resourceId(ps->shaderResourceBindings()))
+           << qint32(ps->flags().toInt()) << qint32(ps->topology()) << qint32(ps->cullMode())
+           << qint32(ps->frontFace()) << qint32(ps->polygonMode());
+        ds << qint32(ps->cendTargetBlends() - ps->cbeginTargetBlends());
+        for (auto it = ps->cbeginTargetBlends(); it != ps->cendTargetBlends(); ++it) {
+            ds << qint32(it->colorWrite.toInt()) << it->enable << qint32(it->srcColor) << qint32(it->dstColor)
+               << qint32(it->opColor) << qint32(it->srcAlpha) << qint32(it->dstAlpha) << qint32(it->opAlpha);
+        }
+        ds << ps->hasDepthTest() << ps->hasDepthWrite() << qint32(ps->depthOp()) << ps->hasStencilTest();
+        for (const QRhiGraphicsPipeline::StencilOpState &s : { ps->stencilFront(), ps->stencilBack() })
+            ds << qint32(s.failOp) << qint32(s.depthFailOp) << qint32(s.passOp) << qint32(s.compareOp);
+        ds << ps->stencilReadMask() << ps->stencilWriteMask() << qint32(ps->sampleCount()) << ps->lineWidth()
+           << qint32(ps->depthBias()) << ps->slopeScaledDepthBias() << qint32(ps->patchControlPointCount());
+        ds << qint32(ps->cendShaderStages() - ps->cbeginShaderStages());
+        for (auto it = ps->cbeginShaderStages(); it != ps->cendShaderStages(); ++it)
+            ds << qint32(it->type()) << qint32(blobId(it->shader().serialized())) << qint32(it->shaderVariant());
+        const QRhiVertexInputLayout layout = ps->vertexInputLayout();
+        ds << qint32(layout.cendBindings() - layout.cbeginBindings());
+        for (auto it = layout.cbeginBindings(); it != layout.cendBindings(); ++it)
+            ds << it->stride() << qint32(it->classification()) << it->instanceStepRate();
+        ds << qint32(layout.cendAttributes() - layout.cbeginAttributes());
+        for (auto it = layout.cbeginAttributes(); it != layout.cendAttributes(); ++it) {
+            ds << qint32(it->binding()) << qint32(it->location()) << qint32(it->format()) << it->offset()
+               << qint32(it->matrixSlice());
+        }
+        break;
+    }
+    case QRhiResource::ComputePipeline: {
+        QRhiComputePipeline *ps = static_cast<QRhiComputePipeline *>(r);
+        type = ComputePipeline;
+        const QRhiShaderStage stage = ps->shaderStage();
+        ds << qint32(resourceId(ps->shaderResourceBindings())) << qint32(ps->flags().toInt())
+           << qint32(blobId(stage.shader().serialized())) << qint32(stage.shaderVariant());
+        break;
+    }
+    default:
+        qWarning("QQuickRhiItemCapture: resources of type %d cannot be captured", int(r->resourceType()));
+        return -1;
+    }
+
+    auto it = m_ids.constFind(r);
+    if (it != m_ids.cend() && m_resources[*it].type == type && m_resources[*it].desc == desc)
+        return *it;
+    m_resources.append({ type, desc });
+    m_ids.insert(r, m_resources.count() - 1);
+    return m_resources.count() - 1;
+}
+
+/*
+    Copies the operations of a batch, before the command buffer consumes it.
+ */
+int QQuickRhiItemCapture::recordUpdates(QRhiResourceUpdateBatch *rub)
+{
+    if (!rub || !m_recording)
+        return -1;
+
+    QList<UpdateOp> ops;
+    QRhiResourceUpdateBatchPrivate *d = QRhiResourceUpdateBatchPrivate::get(rub);
+    for (int i = 0; i < d->activeBufferOpCount; ++i) {
+        const QRhiResourceUpdateBatchPrivate::BufferOp &b(d->bufferOps[i]);
+        if (b.type == QRhiResourceUpdateBatchPrivate::BufferOp::Read)
+            continue;
+        UpdateOp u;
+        u.type = b.type == QRhiResourceUpdateBatchPrivate::BufferOp::DynamicUpdate ? UpdateOp::BufferUpdate
+                                                                                  : UpdateOp::BufferUpload;
+        u.dst = resourceId(b.buf);
+        if (u.dst < 0)
+            continue;
+        u.offset = b.offset;
+        u.blob = blobId(QByteArray(b.data.constData(), b.data.size()));
+        ops.append(u);
+    }
+    for (int i = 0; i < d->activeTextureOpCount; ++i) {
+        const QRhiResourceUpdateBatchPrivate::TextureOp &t(d->textureOps[i]);
+        switch (t.type) {
+        case QRhiResourceUpdateBatchPrivate::TextureOp::Upload:
+            for (int layer = 0; layer < t.subresDesc.count(); ++layer) {
+                for (int level = 0; level < QRhi::MAX_MIP_LEVELS; ++level) {
+                    for (const QRhiTextureSubresourceUploadDescription &s : t.subresDesc[layer][level]) {
+                        UpdateOp u;
+                        u.type = UpdateOp::TextureUpload;
+                        u.dst = resourceId(t.dst);
+                        if (u.dst < 0)
+                            continue;
+                        u.layer = layer;
+                        u.level = level;
+                        u.srcTopLeft = s.sourceTopLeft();
+                        u.dstTopLeft = s.destinationTopLeft();
+                        u.size = s.sourceSize();
+                        const QImage image = s.image();
+                        if (!image.isNull()) {
+                            u.imageFormat = image.format();
+                            u.imageSize = image.size();
+                            u.bytesPerLine = image.bytesPerLine();
+                            u.blob = blobId(QByteArray(reinterpret_cast<const char *>(image.constBits()),
+                                                       image.sizeInBytes()));
+                        } else {
+                            u.offset = s.dataStride();
+                            u.blob = blobId(s.data());
+                        }
+                        ops.append(u);
+                    }
+                }
+            }
+            break;
+        case QRhiResourceUpdateBatchPrivate::TextureOp::Copy: {
+            UpdateOp u;
+            u.type = UpdateOp::TextureCopy;
+            u.dst = resourceId(t.dst);
+            u.src = resourceId(t.src);
+            if (u.dst < 0 || u.src < 0)
+                break;
+            u.size = t.desc.pixelSize();
+            u.srcLayer = t.desc.sourceLayer();
+            u.srcLevel = t.desc.sourceLevel();
+            u.srcTopLeft = t.desc.sourceTopLeft();
+            u.layer = t.desc.destinationLayer();
+            u.level = t.desc.destinationLevel();
+            u.dstTopLeft = t.desc.destinationTopLeft();
+            ops.append(u);
+            break;
+        }
+        case QRhiResourceUpdateBatchPrivate::TextureOp::GenMips: {
+            UpdateOp u;
+            u.type = UpdateOp::GenerateMips;
+            u.dst = resourceId(t.dst);
+            if (u.dst >= 0)
+                ops.append(u);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    m_updates.append(ops);
+    return m_updates.count() - 1;
+}
+
+/*!
+    Writes the recorded frames to \a fileName. Fails when no commands were
+    recorded, as the renderer did not issue any through a
+    QQuickRhiItemCommandRecorder.
+ */
+bool QQuickRhiItemCapture::save(const QString &fileName) const
+{
+    const bool empty = std::all_of(m_frames.cbegin(), m_frames.cend(),
+                                   [](const QList<Command> &frame) { return frame.isEmpty(); });
+    if (empty) {
+        qWarning("No commands were recorded for %s, the renderer has to issue them through "
+                 "QQuickRhiItemCommandRecorder", qPrintable(fileName));
+        return false;
+    }
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Failed to open %s for writing", qPrintable(fileName));
+        return false;
+    }
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_6_0);
+    ds.writeRawData(MAGIC, 4);
+    ds << VERSION << m_backendName << quint32(m_resources.count());
+    for (const Resource &r : m_resources)
+        ds << quint8(r.type) << r.desc;
+    ds << m_blobs << m_updates << m_frames;
+    return ds.status() == QDataStream::Ok;
+}
+
+bool QQuickRhiItemCapture::load(const QString &fileName)
+{
+    releaseResources();
+    m_resources.clear();
+    m_blobs.clear();
+    m_updates.clear();
+    m_frames.clear();
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open capture %s", qPrintable(fileName));
+        return false;
+    }
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_6_0);
+    char magic[4];
+    quint32 version = 0;
+    if (ds.readRawData(magic, 4) != 4 || memcmp(magic, MAGIC, 4) || (ds >> version, version != VERSION)) {
+        qWarning("%s is not a capture of a supported version", qPrintable(fileName));
+        return false;
+    }
+    quint32 resourceCount = 0;
+    ds >> m_backendName >> resourceCount;
+    for (quint32 i = 0; i < resourceCount && ds.status() == QDataStream::Ok; ++i) {
+        quint8 type;
+        Resource r;
+        ds >> type >> r.desc;
+        r.type = ResourceType(type);
+        m_resources.append(r);
+    }
+    ds >> m_blobs >> m_updates >> m_frames;
+    if (ds.status() != QDataStream::Ok || !validate()) {
+        qWarning("Corrupt capture %s", qPrintable(fileName));
+        m_resources.clear();
+        m_blobs.clear();
+        m_updates.clear();
+        m_frames.clear();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Returns \c true when everything referenced by index in the updates and
+    the commands exists and is of the right type, so that replaying only
+    needs to check what depends on the created resources. load() rejects
+    captures that do not validate.
+ */
+bool QQuickRhiItemCapture::validate() const
+{
+    for (const Resource &r : m_resources) {
+        if (r.type > ComputePipeline)
+            return false;
+    }
+
+    const auto isBlob = [this](qint32 blob) { return blob >= 0 && blob < m_blobs.count(); };
+    for (const QList<UpdateOp> &ops : m_updates) {
+        for (const UpdateOp &u : ops) {
+            switch (u.type) {
+            case UpdateOp::BufferUpdate:
+            case UpdateOp::BufferUpload:
+                if (!isResource(u.dst, Buffer) || !isBlob(u.blob))
+                    return false;
+                break;
+            case UpdateOp::TextureUpload:
+                if (!isResource(u.dst, Texture) || !isBlob(u.blob))
+                    return false;
+                if (u.imageFormat != QImage::Format_Invalid) {
+                    if (u.imageFormat <= QImage::Format_Invalid || u.imageFormat >= QImage::NImageFormats
+                        || u.imageSize.width() <= 0 || u.imageSize.height() <= 0) {
+                        return false;
+                    }
+                    const int bitsPerPixel = QImage::toPixelFormat(QImage::Format(u.imageFormat)).bitsPerPixel();
+                    if (u.bytesPerLine < (qint64(u.imageSize.width()) * bitsPerPixel + 7) / 8
+                        || qint64(u.bytesPerLine) * u.imageSize.height() > m_blobs[u.blob].size()) {
+                        return false;
+                    }
+                }
+                break;
+            case UpdateOp::TextureCopy:
+                if (!isResource(u.src, Texture) || u.srcLayer < 0 || u.srcLevel < 0 || u.srcLevel >= QRhi::MAX_MIP_LEVELS)
+                    return false;
+                Q_FALLTHROUGH();
+            case UpdateOp::GenerateMips:
+                if (!isResource(u.dst, Texture))
+                    return false;
+                break;
+            default:
+                return false;
+            }
+            if (u.layer < 0 || u.level < 0 || u.level >= QRhi::MAX_MIP_LEVELS)
+                return false;
+        }
+    }
+
+    for (const QList<Command> &frame : m_frames) {
+        for (const Command &c : frame) {
+            if (c.updates < -1 || c.updates >= m_updates.count() || c.resource < -1 || c.resource >= m_resources.count())
+                return false;
+            bool ok = true;
+            switch (c.op) {
+            case BeginPass:
+                ok = isResource(c.resource, TextureRenderTarget);
+                break;
+            case SetGraphicsPipeline:
+                ok = isResource(c.resource, GraphicsPipeline);
+                break;
+            case SetShaderResources:
+                // null is the pipeline's
+                ok = c.resource == -1 || isResource(c.resource, ShaderResourceBindings);
+                break;
+            case SetVertexInput:
+                ok = c.resource == -1 || isResource(c.resource, Buffer);
+                for (const auto &b : c.bindings)
+                    ok = ok && isResource(b.first, Buffer);
+                break;
+            case SetComputePipeline:
+                ok = isResource(c.resource, ComputePipeline);
+                break;
+            case ResourceUpdate:
+            case EndPass:
+            case SetViewport:
+            case SetScissor:
+            case SetBlendConstants:
+            case SetStencilRef:
+            case Draw:
+            case DrawIndexed:
+            case BeginComputePass:
+            case EndComputePass:
+            case Dispatch:
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            if (!ok)
+                return false;
+        }
+    }
+    return true;
+}
+
+/*!
+    Creates the resources of the capture with \a rhi, in the order they were
+    first used, so that each is created after the ones it references.
+ */
+bool QQuickRhiItemCapture::createResources(QRhi *rhi)
+{
+    releaseResources();
+    m_rhi = rhi;
+
+    // references of the wrong type, or to resources not created yet, are null
+    auto resource = [this](qint32 id, ResourceType type) {
+        return id < m_replayResources.count() && isResource(id, type) ? m_replayResources[id] : nullptr;
+    };
+    auto texture = [&resource](qint32 id) { return static_cast<QRhiTexture *>(resource(id, Texture)); };
+    auto buffer = [&resource](qint32 id) { return static_cast<QRhiBuffer *>(resource(id, Buffer)); };
+    auto renderBuffer = [&resource](qint32 id) { return static_cast<QRhiRenderBuffer *>(resource(id, RenderBuffer)); };
+    auto sampler = [&resource](qint32 id) { return static_cast<QRhiSampler *>(resource(id, Sampler)); };
+    auto shader = [this](qint32 blob) { return QShader::fromSerialized(m_blobs.value(blob)); };
+
+    for (const Resource &r : std::as_const(m_resources)) {
+        QDataStream ds(r.desc);
+        QRhiResource *created = nullptr;
+        QRhiRenderPassDescriptor *rp = nullptr;
+        switch (r.type) {
+        case Buffer: {
+            qint32 type, usage;
+            quint32 size;
+            ds >> type >> usage >> size;
+            created = rhi->newBuffer(QRhiBuffer::Type(type), QRhiBuffer::UsageFlags::fromInt(usage), size);
+            break;
+        }
+        case Texture: {
+            qint32 format, depth, arraySize, sampleCount, flags;
+            QSize size;
+            ds >> format >> size >> depth >> arraySize >> sampleCount >> flags;
+            const QRhiTexture::Flags f = QRhiTexture::Flags::fromInt(flags);
+            if (f.testFlag(QRhiTexture::TextureArray))
+                created = rhi->newTextureArray(QRhiTexture::Format(format), arraySize, size, sampleCount, f);
+            else
+                created = rhi->newTexture(QRhiTexture::Format(format), size.width(), size.height(), depth, sampleCount, f);
+            break;
+        }
+        case Sampler: {
+            qint32 mag, min, mip, u, v, w, compareOp;
+            ds >> mag >> min >> mip >> u >> v >> w >> compareOp;
+            QRhiSampler *s = rhi->newSampler(QRhiSampler::Filter(mag), QRhiSampler::Filter(min), QRhiSampler::Filter(mip),
+                                             QRhiSampler::AddressMode(u), QRhiSampler::AddressMode(v),
+                                             QRhiSampler::AddressMode(w));
+            s->setTextureCompareOp(QRhiSampler::CompareOp(compareOp));
+            created = s;
+            break;
+        }
+        case RenderBuffer: {
+            qint32 type, sampleCount, flags, backingFormat;
+            QSize size;
+            ds >> type >> size >> sampleCount >> flags >> backingFormat;
+            created = rhi->newRenderBuffer(QRhiRenderBuffer::Type(type), size, sampleCount,
+                                           QRhiRenderBuffer::Flags::fromInt(flags),
+                                           QRhiTexture::Format(backingFormat));
+            break;
+        }
+        case TextureRenderTarget: {
+            qint32 flags, count;
+            ds >> flags >> count;
+            QList<QRhiColorAttachment> attachments;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                qint32 tex, rb, layer, level, resolveTex, resolveLayer, resolveLevel;
+                ds >> tex >> rb >> layer >> level >> resolveTex >> resolveLayer >> resolveLevel;
+                QRhiColorAttachment a;
+                a.setTexture(texture(tex));
+                a.setRenderBuffer(renderBuffer(rb));
+                a.setLayer(layer);
+                a.setLevel(level);
+                a.setResolveTexture(texture(resolveTex));
+                a.setResolveLayer(resolveLayer);
+                a.setResolveLevel(resolveLevel);
+                attachments.append(a);
+            }
+            qint32 depthStencil, depthTexture;
+            ds >> depthStencil >> depthTexture;
+            QRhiTextureRenderTargetDescription d;
+            d.setColorAttachments(attachments.cbegin(), attachments.cend());
+            d.setDepthStencilBuffer(renderBuffer(depthStencil));
+            d.setDepthTexture(texture(depthTexture));
+            QRhiTextureRenderTarget *rt = rhi->newTextureRenderTarget(d, QRhiTextureRenderTarget::Flags::fromInt(flags));
+            rp = rt->newCompatibleRenderPassDescriptor();
+            rt->setRenderPassDescriptor(rp);
+            created = rt;
+            break;
+        }
+        case ShaderResourceBindings: {
+            qint32 count;
+            ds >> count;
+            QList<QRhiShaderResourceBinding> bindings;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                qint32 binding, stageFlags, type;
+                ds >> binding >> stageFlags >> type;
+                const auto stage = QRhiShaderResourceBinding::StageFlags::fromInt(stageFlags);
+                switch (QRhiShaderResourceBinding::Type(type)) {
+                case QRhiShaderResourceBinding::UniformBuffer: {
+                    qint32 buf;
+                    quint32 offset, size;
+                    bool dynamic;
+                    ds >> buf >> offset >> size >> dynamic;
+                    if (dynamic)
+                        bindings.append(QRhiShaderResourceBinding::uniformBufferWithDynamicOffset(binding, stage, buffer(buf), size));
+                    else if (size)
+                        bindings.append(QRhiShaderResourceBinding::uniformBuffer(binding, stage, buffer(buf), offset, size));
+                    else
+                        bindings.append(QRhiShaderResourceBinding::uniformBuffer(binding, stage, buffer(buf)));
+                    break;
+                }
+                case QRhiShaderResourceBinding::SampledTexture:
+                case QRhiShaderResourceBinding::Texture:
+                case QRhiShaderResourceBinding::Sampler: {
+                    qint32 n;
+                    ds >> n;
+                    QVarLengthArray<QRhiShaderResourceBinding::TextureAndSampler, 4> texSamplers;
+                    QVarLengthArray<QRhiTexture *, 4> textures;
+                    for (int j = 0; j < n && ds.status() == QDataStream::Ok; ++j) {
+                        qint32 tex, samp;
+                        ds >> tex >> samp;
+                        texSamplers.append({ texture(tex), sampler(samp) });
+                        textures.append(texture(tex));
+                    }
+                    if (texSamplers.count() != n)
+                        break;
+                    if (type == QRhiShaderResourceBinding::SampledTexture)
+                        bindings.append(QRhiShaderResourceBinding::sampledTextures(binding, stage, n, texSamplers.constData()));
+                    else if (type == QRhiShaderResourceBinding::Texture)
+                        bindings.append(QRhiShaderResourceBinding::textures(binding, stage, n, textures.data()));
+                    else if (n)
+                        bindings.append(QRhiShaderResourceBinding::sampler(binding, stage, texSamplers[0].sampler));
+                    break;
+                }
+                case QRhiShaderResourceBinding::ImageLoad:
+                case QRhiShaderResourceBinding::ImageStore:
+                case QRhiShaderResourceBinding::ImageLoadStore: {
+                    qint32 tex, level;
+                    ds >> tex >> level;
+                    if (type == QRhiShaderResourceBinding::ImageLoad)
+                        bindings.append(QRhiShaderResourceBinding::imageLoad(binding, stage, texture(tex), level));
+                    else if (type == QRhiShaderResourceBinding::ImageStore)
+                        bindings.append(QRhiShaderResourceBinding::imageStore(binding, stage, texture(tex), level));
+                    else
+                        bindings.append(QRhiShaderResourceBinding::imageLoadStore(binding, stage, texture(tex), level));
+                    break;
+                }
+                case QRhiShaderResourceBinding::BufferLoad:
+                case QRhiShaderResourceBinding::BufferStore:
+                case QRhiShaderResourceBinding::BufferLoadStore: {
+                    qint32 buf;
+                    quint32 offset, size;
+                    ds >> buf >> offset >> size;
+                    if (!size)
+                        size = buffer(buf) ? buffer(buf)->size() - offset : 0;
+                    if (type == QRhiShaderResourceBinding::BufferLoad)
+                        bindings.append(QRhiShaderResourceBinding::bufferLoad(binding, stage, buffer(buf), offset, size));
+                    else if (type == QRhiShaderResourceBinding::BufferStore)
+                        bindings.append(QRhiShaderResourceBinding::bufferStore(binding, stage, buffer(buf), offset, size));
+                    else
+                        bindings.append(QRhiShaderResourceBinding::bufferLoadStore(binding, stage, buffer(buf), offset, size));
+                    break;
+                }
+                }
+            }
+            QRhiShaderResourceBindings *srb = rhi->newShaderResourceBindings();
+            srb->setBindings(bindings.cbegin(), bindings.cend());
+            created = srb;
+            break;
+        }
+        case GraphicsPipeline: {
+            QRhiGraphicsPipeline *ps = rhi->newGraphicsPipeline();
+            qint32 rt, srb, flags, topology, cullMode, frontFace, polygonMode, count;
+            ds >> rt >> srb >> flags >> topology >> cullMode >> frontFace >> polygonMode;
+            ps->setFlags(QRhiGraphicsPipeline::Flags::fromInt(flags));
+            ps->setTopology(QRhiGraphicsPipeline::Topology(topology));
+            ps->setCullMode(QRhiGraphicsPipeline::CullMode(cullMode));
+            ps->setFrontFace(QRhiGraphicsPipeline::FrontFace(frontFace));
+            ps->setPolygonMode(QRhiGraphicsPipeline::PolygonMode(polygonMode));
+            ds >> count;
+            QList<QRhiGraphicsPipeline::TargetBlend> blends;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                qint32 colorWrite, srcColor, dstColor, opColor, srcAlpha, dstAlpha, opAlpha;
+                QRhiGraphicsPipeline::TargetBlend b;
+                ds >> colorWrite >> b.enable >> srcColor >> dstColor >> opColor >> srcAlpha >> dstAlpha >> opAlpha;
+                b.colorWrite = QRhiGraphicsPipeline::ColorMask::fromInt(colorWrite);
+                b.srcColor = QRhiGraphicsPipeline::BlendFactor(srcColor);
+                b.dstColor = QRhiGraphicsPipeline::BlendFactor(dstColor);
+                b.opColor = QRhiGraphicsPipeline::BlendOp(opColor);
+                b.srcAlpha = QRhiGraphicsPipeline::BlendFactor(srcAlpha);
+                b.dstAlpha = QRhiGraphicsPipeline::BlendFactor(dstAlpha);
+                b.opAlpha = QRhiGraphicsPipeline::BlendOp(opAlpha);
+                blends.append(b);
+            }
+            ps->setTargetBlends(blends.cbegin(), blends.cend());
+            bool depthTest, depthWrite, stencilTest;
+            qint32 depthOp;
+            ds >> depthTest >> depthWrite >> depthOp >> stencilTest;
+            ps->setDepthTest(depthTest);
+            ps->setDepthWrite(depthWrite);
+            ps->setDepthOp(QRhiGraphicsPipeline::CompareOp(depthOp));
+            ps->setStencilTest(stencilTest);
+            QRhiGraphicsPipeline::StencilOpState stencil[2];
+            for (QRhiGraphicsPipeline::StencilOpState &s : stencil) {
+                qint32 failOp, depthFailOp, passOp, compareOp;
+                ds >> failOp >> depthFailOp >> passOp >> compareOp;
+                s = { QRhiGraphicsPipeline::StencilOp(failOp), QRhiGraphicsPipeline::StencilOp(depthFailOp),
+                      QRhiGraphicsPipeline::StencilOp(passOp), QRhiGraphicsPipeline::CompareOp(compareOp) };
+            }
+            ps->setStencilFront(stencil[0]);
+            ps->setStencilBack(stencil[1]);
+            quint32 readMask, writeMask;
+            qint32 sampleCount, depthBias, patchControlPoints;
+            float lineWidth, slopeScaledDepthBias;
+            ds >> readMask >> writeMask >> sampleCount >> lineWidth >> depthBias >> slopeScaledDepthBias >> patchControlPoints;
+            ps->setStencilReadMask(readMask);
+            ps->setStencilWriteMask(writeMask);
+            ps->setSampleCount(sampleCount);
+            ps->setLineWidth(lineWidth);
+            ps->setDepthBias(depthBias);
+            ps->setSlopeScaledDepthBias(slopeScaledDepthBias);
+            ps->setPatchControlPointCount(patchControlPoints);
+            ds >> count;
+            QList<QRhiShaderStage> stages;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                qint32 type, blob, variant;
+                ds >> type >> blob >> variant;
+                stages.append(QRhiShaderStage(QRhiShaderStage::Type(type), shader(blob), QShader::Variant(variant)));
+            }
+            ps->setShaderStages(stages.cbegin(), stages.cend());
+            QRhiVertexInputLayout layout;
+            ds >> count;
+            QList<QRhiVertexInputBinding> inputBindings;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                quint32 stride, stepRate;
+                qint32 classification;
+                ds >> stride >> classification >> stepRate;
+                inputBindings.append(QRhiVertexInputBinding(stride, QRhiVertexInputBinding::Classification(classification), stepRate));
+            }
+            layout.setBindings(inputBindings.cbegin(), inputBindings.cend());
+            ds >> count;
+            QList<QRhiVertexInputAttribute> attributes;
+            for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+                qint32 binding, location, format, matrixSlice;
+                quint32 offset;
+                ds >> binding >> location >> format >> offset >> matrixSlice;
+                attributes.append(QRhiVertexInputAttribute(binding, location, QRhiVertexInputAttribute::Format(format),
+                                                           offset, matrixSlice));
+            }
+            layout.setAttributes(attributes.cbegin(), attributes.cend());
+            ps->setVertexInputLayout(layout);
+            ps->setShaderResourceBindings(static_cast<QRhiShaderResourceBindings *>(resource(srb, ShaderResourceBindings)));
+            ps->setRenderPassDescriptor(m_replayPassDescriptors.value(rt));
+            created = ps;
+            break;
+        }
+        case ComputePipeline: {
+            qint32 srb, flags, blob, variant;
+            ds >> srb >> flags >> blob >> variant;
+            QRhiComputePipeline *ps = rhi->newComputePipeline();
+            ps->setFlags(QRhiComputePipeline::Flags::fromInt(flags));
+            ps->setShaderStage(QRhiShaderStage(QRhiShaderStage::Compute, shader(blob), QShader::Variant(variant)));
+            ps->setShaderResourceBindings(static_cast<QRhiShaderResourceBindings *>(resource(srb, ShaderResourceBindings)));
+            created = ps;
+            break;
+        }
+        }
+
+        m_replayResources.append(created);
+        m_replayPassDescriptors.append(rp);
+        if (!created || ds.status() != QDataStream::Ok) {
+            qWarning("QQuickRhiItemCapture: corrupt description of resource %d", int(m_replayResources.count() - 1));
+            return false;
+        }
+
+        bool ok = false;
+        switch (r.type) {
+        case Buffer:
+            ok = static_cast<QRhiBuffer *>(created)->create();
+            break;
+        case Texture:
+            ok = static_cast<QRhiTexture *>(created)->create();
+            break;
+        case Sampler:
+            ok = static_cast<QRhiSampler *>(created)->create();
+            break;
+        case RenderBuffer:
+            ok = static_cast<QRhiRenderBuffer *>(created)->create();
+            break;
+        case TextureRenderTarget:
+            ok = static_cast<QRhiTextureRenderTarget *>(created)->create();
+            break;
+        case ShaderResourceBindings:
+            ok = static_cast<QRhiShaderResourceBindings *>(created)->create();
+            break;
+        case GraphicsPipeline:
+            ok = static_cast<QRhiGraphicsPipeline *>(created)->create();
+            break;
+        case ComputePipeline:
+            ok = static_cast<QRhiComputePipeline *>(created)->create();
+            break;
+        }
+        if (!ok) {
+            qWarning("QQuickRhiItemCapture: failed to create resource %d", int(m_replayResources.count() - 1));
+            return false;
+        }
+    }
+    return true;
+}
+
+void QQuickRhiItemCapture::releaseResources()
+{
+    // in reverse, the pipelines and render targets go before what they use
+    for (int i = m_replayResources.count() - 1; i >= 0; --i) {
+        delete m_replayResources[i];
+        delete m_replayPassDescriptors[i];
+    }
+    m_replayResources.clear();
+    m_replayPassDescriptors.clear();
+    m_rhi = nullptr;
+}
+
+/*
+    The size of the raw data of an upload of size in format, tightly packed
+    or with the row stride, or 0 when the format is not known.
+ */
+static quint64 textureDataSize(QRhiTexture::Format format, const QSize &size, quint32 stride)
+{
+    int blockWidth = 1;
+    int blockHeight = 1;
+    int blockBytes = 0;
+    switch (format) {
+    case QRhiTexture::R8:
+    case QRhiTexture::RED_OR_ALPHA8:
+        blockBytes = 1;
+        break;
+    case QRhiTexture::RG8:
+    case QRhiTexture::R16:
+    case QRhiTexture::R16F:
+    case QRhiTexture::D16:
+        blockBytes = 2;
+        break;
+    case QRhiTexture::RGBA8:
+    case QRhiTexture::BGRA8:
+    case QRhiTexture::RG16:
+    case QRhiTexture::R32F:
+    case QRhiTexture::RGB10A2:
+    case QRhiTexture::D24:
+    case QRhiTexture::D24S8:
+    case QRhiTexture::D32F:
+        blockBytes = 4;
+        break;
+    case QRhiTexture::RGBA16F:
+        blockBytes = 8;
+        break;
+    case QRhiTexture::RGBA32F:
+        blockBytes = 16;
+        break;
+    case QRhiTexture::BC1:
+    case QRhiTexture::BC4:
+    case QRhiTexture::ETC2_RGB8:
+    case QRhiTexture::ETC2_RGB8A1:
+        blockWidth = blockHeight = 4;
+        blockBytes = 8;
+        break;
+    case QRhiTexture::BC2:
+    case QRhiTexture::BC3:
+    case QRhiTexture::BC5:
+    case QRhiTexture::BC6H:
+    case QRhiTexture::BC7:
+    case QRhiTexture::ETC2_RGBA8:
+        blockWidth = blockHeight = 4;
+        blockBytes = 16;
+        break;
+    default:
+        if (format >= QRhiTexture::ASTC_4x4 && format <= QRhiTexture::ASTC_12x12) {
+            static const int astcBlocks[][2] = { { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+                                                 { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 },
+                                                 { 12, 12 } };
+            blockWidth = astcBlocks[format - QRhiTexture::ASTC_4x4][0];
+            blockHeight = astcBlocks[format - QRhiTexture::ASTC_4x4][1];
+            blockBytes = 16;
+        }
+        break;
+    }
+    if (!blockBytes || size.isEmpty())
+        return 0;
+
+    const quint64 rowBytes = quint64((size.width() + blockWidth - 1) / blockWidth) * blockBytes;
+    const quint64 rows = quint64((size.height() + blockHeight - 1) / blockHeight);
+    return stride ? stride * (rows - 1) + rowBytes : rowBytes * rows;
+}
+
+QRhiResourceUpdateBatch *QQuickRhiItemCapture::replayUpdates(int index)
+{
+    if (index < 0)
+        return nullptr;
+
+    // the indices are validated in load(), the sizes depend on the resources
+    QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+    for (const UpdateOp &u : std::as_const(m_updates[index])) {
+        const QByteArray &data(u.blob >= 0 ? m_blobs[u.blob] : QByteArray());
+        switch (u.type) {
+        case UpdateOp::BufferUpdate:
+        case UpdateOp::BufferUpload: {
+            QRhiBuffer *buf = static_cast<QRhiBuffer *>(m_replayResources[u.dst]);
+            if (quint64(u.offset) + quint64(data.size()) > buf->size()) {
+                qWarning("QQuickRhiItemCapture: skipping an update past the end of buffer %d", int(u.dst));
+                break;
+            }
+            if (u.type == UpdateOp::BufferUpdate)
+                rub->updateDynamicBuffer(buf, u.offset, data.size(), data.constData());
+            else
+                rub->uploadStaticBuffer(buf, u.offset, data.size(), data.constData());
+            break;
+        }
+        case UpdateOp::TextureUpload: {
+            QRhiTexture *texture = static_cast<QRhiTexture *>(m_replayResources[u.dst]);
+            QRhiTextureSubresourceUploadDescription s;
+            if (u.imageFormat != QImage::Format_Invalid) {
+                // wraps the blob, without a copy, its size is checked in load()
+                s.setImage(QImage(reinterpret_cast<const uchar *>(data.constData()), u.imageSize.width(),
+                                  u.imageSize.height(), u.bytesPerLine, QImage::Format(u.imageFormat)));
+            } else {
+                const QSize levelSize(qMax(1, texture->pixelSize().width() >> u.level),
+                                      qMax(1, texture->pixelSize().height() >> u.level));
+                const quint64 size = textureDataSize(texture->format(), u.size.isEmpty() ? levelSize : u.size, u.offset);
+                if (!size || size > quint64(data.size())) {
+                    qWarning("QQuickRhiItemCapture: skipping an upload with too little data for texture %d", int(u.dst));
+                    break;
+                }
+                s.setData(data);
+                s.setDataStride(u.offset);
+            }
+            s.setSourceTopLeft(u.srcTopLeft);
+            s.setDestinationTopLeft(u.dstTopLeft);
+            s.setSourceSize(u.size);
+            rub->uploadTexture(texture, QRhiTextureUploadEntry(u.layer, u.level, s));
+            break;
+        }
+        case UpdateOp::TextureCopy: {
+            QRhiTextureCopyDescription desc;
+            desc.setPixelSize(u.size);
+            desc.setSourceLayer(u.srcLayer);
+            desc.setSourceLevel(u.srcLevel);
+            desc.setSourceTopLeft(u.srcTopLeft);
+            desc.setDestinationLayer(u.layer);
+            desc.setDestinationLevel(u.level);
+            desc.setDestinationTopLeft(u.dstTopLeft);
+            rub->copyTexture(static_cast<QRhiTexture *>(m_replayResources[u.dst]),
+                             static_cast<QRhiTexture *>(m_replayResources[u.src]), desc);
+            break;
+        }
+        case UpdateOp::GenerateMips:
+            rub->generateMips(static_cast<QRhiTexture *>(m_replayResources[u.dst]));
+            break;
+        }
+    }
+    return rub;
+}
+
+/*!
+    Records the commands of \a frame on \a cb, which must be in between
+    QRhi::beginOffscreenFrame() and QRhi::endOffscreenFrame() of the QRhi
+    passed to createResources().
+ */
+void QQuickRhiItemCapture::replayFrame(QRhiCommandBuffer *cb, int frame)
+{
+    QVarLengthArray<QRhiCommandBuffer::VertexInput, 4> vertexInputs;
+    QVarLengthArray<QRhiCommandBuffer::DynamicOffset, 4> dynamicOffsets;
+    for (const Command &c : std::as_const(m_frames[frame])) {
+        QRhiResource *r = c.resource >= 0 ? m_replayResources[c.resource] : nullptr;
+        switch (c.op) {
+        case ResourceUpdate:
+            cb->resourceUpdate(replayUpdates(c.updates));
+            break;
+        case BeginPass:
+            cb->beginPass(static_cast<QRhiTextureRenderTarget *>(r),
+                          QColor::fromRgbF(c.values[0], c.values[1], c.values[2], c.values[3]),
+                          { c.values[4], c.args[0] }, replayUpdates(c.updates),
+                          QRhiCommandBuffer::BeginPassFlags::fromInt(c.args[1]));
+            break;
+        case EndPass:
+            cb->endPass(replayUpdates(c.updates));
+            break;
+        case SetGraphicsPipeline:
+            cb->setGraphicsPipeline(static_cast<QRhiGraphicsPipeline *>(r));
+            break;
+        case SetShaderResources:
+            dynamicOffsets.clear();
+            for (const auto &b : c.bindings)
+                dynamicOffsets.append({ b.first, b.second });
+            cb->setShaderResources(static_cast<QRhiShaderResourceBindings *>(r), dynamicOffsets.count(),
+                                   dynamicOffsets.constData());
+            break;
+        case SetVertexInput:
+            vertexInputs.clear();
+            for (const auto &b : c.bindings)
+                vertexInputs.append({ static_cast<QRhiBuffer *>(m_replayResources[b.first]), b.second });
+            cb->setVertexInput(int(c.args[0]), vertexInputs.count(), vertexInputs.constData(),
+                               static_cast<QRhiBuffer *>(r), c.args[1], QRhiCommandBuffer::IndexFormat(c.args[2]));
+            break;
+        case SetViewport:
+            cb->setViewport(QRhiViewport(c.values[0], c.values[1], c.values[2], c.values[3], c.values[4], c.values[5]));
+            break;
+        case SetScissor:
+            cb->setScissor(QRhiScissor(int(c.args[0]), int(c.args[1]), int(c.args[2]), int(c.args[3])));
+            break;
+        case SetBlendConstants:
+            cb->setBlendConstants(QColor::fromRgbF(c.values[0], c.values[1], c.values[2], c.values[3]));
+            break;
+        case SetStencilRef:
+            cb->setStencilRef(c.args[0]);
+            break;
+        case Draw:
+            cb->draw(c.args[0], c.args[1], c.args[2], c.args[3]);
+            break;
+        case DrawIndexed:
+            cb->drawIndexed(c.args[0], c.args[1], c.args[2], qint32(c.args[3]), c.args[4]);
+            break;
+        case BeginComputePass:
+            cb->beginComputePass(replayUpdates(c.updates), QRhiCommandBuffer::BeginPassFlags::fromInt(c.args[0]));
+            break;
+        case EndComputePass:
+            cb->endComputePass(replayUpdates(c.updates));
+            break;
+        case SetComputePipeline:
+            cb->setComputePipeline(static_cast<QRhiComputePipeline *>(r));
+            break;
+        case Dispatch:
+            cb->dispatch(int(c.args[0]), int(c.args[1]), int(c.args[2]));
+            break;
+        }
+    }
+}
+
+/*!
+    \class QQuickRhiItemCommandRecorder
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Forwards commands to a QRhiCommandBuffer, recording them into a
+    QQuickRhiItemCapture when one is active.
+
+    The functions match the ones of QRhiCommandBuffer.
+
+    \sa QQuickRhiItemCapture, QQuickRhiItemRenderer::capture()
+ */
+
+void QQuickRhiItemCommandRecorder::resourceUpdate(QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::ResourceUpdate;
+        c.updates = m_capture->recordUpdates(resourceUpdates);
+        m_capture->record(c);
+    }
+    m_cb->resourceUpdate(resourceUpdates);
+}
+
+void QQuickRhiItemCommandRecorder::beginPass(QRhiRenderTarget *rt, const QColor &colorClearValue,
+                                             const QRhiDepthStencilClearValue &depthStencilClearValue,
+                                             QRhiResourceUpdateBatch *resourceUpdates,
+                                             QRhiCommandBuffer::BeginPassFlags flags)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::BeginPass;
+        c.resource = m_capture->resourceId(rt);
+        c.updates = m_capture->recordUpdates(resourceUpdates);
+        c.values[0] = colorClearValue.redF();
+        c.values[1] = colorClearValue.greenF();
+        c.values[2] = colorClearValue.blueF();
+        c.values[3] = colorClearValue.alphaF();
+        c.values[4] = depthStencilClearValue.depthClearValue();
+        c.args[0] = depthStencilClearValue.stencilClearValue();
+        c.args[1] = quint32(flags.toInt());
+        m_capture->m_renderTarget = c.resource;
+        m_capture->record(c);
+    }
+    m_cb->beginPass(rt, colorClearValue, depthStencilClearValue, resourceUpdates, flags);
+}
+
+void QQuickRhiItemCommandRecorder::endPass(QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::EndPass;
+        c.updates = m_capture->recordUpdates(resourceUpdates);
+        m_capture->record(c);
+    }
+    m_cb->endPass(resourceUpdates);
+}
+
+void QQuickRhiItemCommandRecorder::setGraphicsPipeline(QRhiGraphicsPipeline *ps)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetGraphicsPipeline;
+        c.resource = m_capture->resourceId(ps);
+        m_capture->record(c);
+    }
+    m_cb->setGraphicsPipeline(ps);
+}
+
+void QQuickRhiItemCommandRecorder::setShaderResources(QRhiShaderResourceBindings *srb, int dynamicOffsetCount,
+                                                      const QRhiCommandBuffer::DynamicOffset *dynamicOffsets)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetShaderResources;
+        // null is the pipeline's, which is part of the pipeline's description
+        c.resource = m_capture->resourceId(srb);
+        for (int i = 0; i < dynamicOffsetCount; ++i)
+            c.bindings.append({ dynamicOffsets[i].first, dynamicOffsets[i].second });
+        m_capture->record(c);
+    }
+    m_cb->setShaderResources(srb, dynamicOffsetCount, dynamicOffsets);
+}
+
+void QQuickRhiItemCommandRecorder::setVertexInput(int startBinding, int bindingCount,
+                                                  const QRhiCommandBuffer::VertexInput *bindings,
+                                                  QRhiBuffer *indexBuf, quint32 indexOffset,
+                                                  QRhiCommandBuffer::IndexFormat indexFormat)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetVertexInput;
+        c.resource = m_capture->resourceId(indexBuf);
+        for (int i = 0; i < bindingCount; ++i)
+            c.bindings.append({ m_capture->resourceId(bindings[i].first), bindings[i].second });
+        c.args[0] = quint32(startBinding);
+        c.args[1] = indexOffset;
+        c.args[2] = quint32(indexFormat);
+        m_capture->record(c);
+    }
+    m_cb->setVertexInput(startBinding, bindingCount, bindings, indexBuf, indexOffset, indexFormat);
+}
+
+void QQuickRhiItemCommandRecorder::setViewport(const QRhiViewport &viewport)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetViewport;
+        const std::array<float, 4> r = viewport.viewport();
+        for (int i = 0; i < 4; ++i)
+            c.values[i] = r[i];
+        c.values[4] = viewport.minDepth();
+        c.values[5] = viewport.maxDepth();
+        m_capture->record(c);
+    }
+    m_cb->setViewport(viewport);
+}
+
+void QQuickRhiItemCommandRecorder::setScissor(const QRhiScissor &scissor)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetScissor;
+        const std::array<int, 4> r = scissor.scissor();
+        for (int i = 0; i < 4; ++i)
+            c.args[i] = quint32(r[i]);
+        m_capture->record(c);
+    }
+    m_cb->setScissor(scissor);
+}
+
+void QQuickRhiItemCommandRecorder::setBlendConstants(const QColor &color)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetBlendConstants;
+        c.values[0] = color.redF();
+        c.values[1] = color.greenF();
+        c.values[2] = color.blueF();
+        c.values[3] = color.alphaF();
+        m_capture->record(c);
+    }
+    m_cb->setBlendConstants(color);
+}
+
+void QQuickRhiItemCommandRecorder::setStencilRef(quint32 refValue)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetStencilRef;
+        c.args[0] = refValue;
+        m_capture->record(c);
+    }
+    m_cb->setStencilRef(refValue);
+}
+
+void QQuickRhiItemCommandRecorder::draw(quint32 vertexCount, quint32 instanceCount, quint32 firstVertex,
+                                        quint32 firstInstance)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::Draw;
+        c.args[0] = vertexCount;
+        c.args[1] = instanceCount;
+        c.args[2] = firstVertex;
+        c.args[3] = firstInstance;
+        m_capture->record(c);
+    }
+    m_cb->draw(vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void QQuickRhiItemCommandRecorder::drawIndexed(quint32 indexCount, quint32 instanceCount, quint32 firstIndex,
+                                               qint32 vertexOffset, quint32 firstInstance)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::DrawIndexed;
+        c.args[0] = indexCount;
+        c.args[1] = instanceCount;
+        c.args[2] = firstIndex;
+        c.args[3] = quint32(vertexOffset);
+        c.args[4] = firstInstance;
+        m_capture->record(c);
+    }
+    m_cb->drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void QQuickRhiItemCommandRecorder::beginComputePass(QRhiResourceUpdateBatch *resourceUpdates,
+                                                    QRhiCommandBuffer::BeginPassFlags flags)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::BeginComputePass;
+        c.updates = m_capture->recordUpdates(resourceUpdates);
+        c.args[0] = quint32(flags.toInt());
+        m_capture->record(c);
+    }
+    m_cb->beginComputePass(resourceUpdates, flags);
+}
+
+void QQuickRhiItemCommandRecorder::endComputePass(QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::EndComputePass;
+        c.updates = m_capture->recordUpdates(resourceUpdates);
+        m_capture->record(c);
+    }
+    m_cb->endComputePass(resourceUpdates);
+}
+
+void QQuickRhiItemCommandRecorder::setComputePipeline(QRhiComputePipeline *ps)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::SetComputePipeline;
+        c.resource = m_capture->resourceId(ps);
+        m_capture->record(c);
+    }
+    m_cb->setComputePipeline(ps);
+}
+
+void QQuickRhiItemCommandRecorder::dispatch(int x, int y, int z)
+{
+    if (m_capture) {
+        QQuickRhiItemCapture::Command c;
+        c.op = QQuickRhiItemCapture::Dispatch;
+        c.args[0] = quint32(x);
+        c.args[1] = quint32(y);
+        c.args[2] = quint32(z);
+        m_capture->record(c);
+    }
+    m_cb->dispatch(x, y, z);
+}
@@ -0,0 +1,174 @@
+#ifndef RHIITEMCAPTURE_H
+#define RHIITEMCAPTURE_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QHash>
+
+class QDataStream;
+
+class QQuickRhiItemCapture
+{
+public:
+    QQuickRhiItemCapture();
+    ~QQuickRhiItemCapture();
+
+    // recording
+    void beginFrame(QRhi *rhi);
+    void endFrame();
+    bool save(const QString &fileName) const;
+
+    // replaying
+    bool load(const QString &fileName);
+    bool createResources(QRhi *rhi);
+    void releaseResources();
+    void replayFrame(QRhiCommandBuffer *cb, int frame);
+    bool validate() const;
+
+    int frameCount() const { return m_frames.count(); }
+    int resourceCount() const { return m_resources.count(); }
+    int commandCount(int frame) const { return m_frames[frame].count(); }
+    QByteArray backendName() const { return m_backendName; }
+
+private:
+    enum ResourceType : quint8 {
+        Buffer,
+        Texture,
+        Sampler,
+        RenderBuffer,
+        TextureRenderTarget,
+        ShaderResourceBindings,
+        GraphicsPipeline,
+        ComputePipeline
+    };
+
+    enum Op : quint8 {
+        ResourceUpdate,
+        BeginPass,
+        EndPass,
+        SetGraphicsPipeline,
+        SetShaderResources,
+        SetVertexInput,
+        SetViewport,
+        SetScissor,
+        SetBlendConstants,
+        SetStencilRef,
+        Draw,
+        DrawIndexed,
+        BeginComputePass,
+        EndComputePass,
+        SetComputePipeline,
+        Dispatch
+    };
+
+    struct Resource {
+        ResourceType type;
+        QByteArray desc; // serialized, also what identifies the resource
+    };
+
+    struct UpdateOp {
+        enum Type : quint8 {
+            BufferUpdate,
+            BufferUpload,
+            TextureUpload,
+            TextureCopy,
+            GenerateMips
+        };
+        Type type = BufferUpdate;
+        qint32 dst = -1;
+        qint32 src = -1;
+        qint32 blob = -1;
+        quint32 offset = 0; // of buffer updates, or the data stride of texture uploads
+        qint32 layer = 0;
+        qint32 level = 0;
+        qint32 srcLayer = 0;
+        qint32 srcLevel = 0;
+        QPoint srcTopLeft;
+        QPoint dstTopLeft;
+        QSize size;
+        qint32 imageFormat = 0; // QImage::Format_Invalid for raw data
+        QSize imageSize;
+        qint32 bytesPerLine = 0;
+    };
+
+    struct Command {
+        Op op = ResourceUpdate;
+        qint32 resource = -1;
+        qint32 updates = -1;
+        quint32 args[5] = {};
+        float values[6] = {};
+        QList<QPair<qint32, quint32>> bindings; // vertex inputs or dynamic offsets
+    };
+
+    int resourceId(QRhiResource *r);
+    int blobId(const QByteArray &data);
+    int recordUpdates(QRhiResourceUpdateBatch *rub);
+    void record(const Command &command);
+    QRhiResourceUpdateBatch *replayUpdates(int index);
+    bool isResource(qint32 id, ResourceType type) const
+    {
+        return id >= 0 && id < m_resources.count() && m_resources[id].type == type;
+    }
+
+    friend class QQuickRhiItemCommandRecorder;
+    friend QDataStream &operator<<(QDataStream &ds, const Command &c);
+    friend QDataStream &operator>>(QDataStream &ds, Command &c);
+    friend QDataStream &operator<<(QDataStream &ds, const UpdateOp &u);
+    friend QDataStream &operator>>(QDataStream &ds, UpdateOp &u);
+
+    QByteArray m_backendName;
+    QList<Resource> m_resources;
+    QList<QByteArray> m_blobs;
+    QList<QList<UpdateOp>> m_updates;
+    QList<QList<Command>> m_frames;
+
+    // recording
+    QHash<QRhiResource *, int> m_ids;
+    QHash<QByteArray, int> m_blobIds;
+    bool m_recording = false;
+    int m_renderTarget = -1; // of the current pass, for the pipelines
+
+    // replaying
+    QRhi *m_rhi = nullptr;
+    QList<QRhiResource *> m_replayResources;
+    QList<QRhiRenderPassDescriptor *> m_replayPassDescriptors;
+};
+
+class QQuickRhiItemCommandRecorder
+{
+public:
+    QQuickRhiItemCommandRecorder(QRhiCommandBuffer *cb, QQuickRhiItemCapture *capture)
+        : m_cb(cb), m_capture(capture) { }
+
+    QRhiCommandBuffer *commandBuffer() const { return m_cb; }
+
+    void resourceUpdate(QRhiResourceUpdateBatch *resourceUpdates);
+    void beginPass(QRhiRenderTarget *rt, const QColor &colorClearValue,
+                   const QRhiDepthStencilClearValue &depthStencilClearValue,
+                   QRhiResourceUpdateBatch *resourceUpdates = nullptr,
+                   QRhiCommandBuffer::BeginPassFlags flags = {});
+    void endPass(QRhiResourceUpdateBatch *resourceUpdates = nullptr);
+    void setGraphicsPipeline(QRhiGraphicsPipeline *ps);
+    void setShaderResources(QRhiShaderResourceBindings *srb = nullptr, int dynamicOffsetCount = 0,
+                            const QRhiCommandBuffer::DynamicOffset *dynamicOffsets = nullptr);
+    void setVertexInput(int startBinding, int bindingCount, const QRhiCommandBuffer::VertexInput *bindings,
+                        QRhiBuffer *indexBuf = nullptr, quint32 indexOffset = 0,
+                        QRhiCommandBuffer::IndexFormat indexFormat = QRhiCommandBuffer::IndexUInt16);
+    void setViewport(const QRhiViewport &viewport);
+    void setScissor(const QRhiScissor &scissor);
+    void setBlendConstants(const QColor &c);
+    void setStencilRef(quint32 refValue);
+    void draw(quint32 vertexCount, quint32 instanceCount = 1, quint32 firstVertex = 0, quint32 firstInstance = 0);
+    void drawIndexed(quint32 indexCount, quint32 instanceCount = 1, quint32 firstIndex = 0,
+                     qint32 vertexOffset = 0, quint32 firstInstance = 0);
+    void beginComputePass(QRhiResourceUpdateBatch *resourceUpdates = nullptr,
+                          QRhiCommandBuffer::BeginPassFlags flags = {});
+    void endComputePass(QRhiResourceUpdateBatch *resourceUpdates = nullptr);
+    void setComputePipeline(QRhiComputePipeline *ps);
+    void dispatch(int x, int y, int z);
+
+private:
+    QRhiCommandBuffer *m_cb;
+    QQuickRhiItemCapture *m_capture;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef RHIITEMCHANNEL_H
+#define RHIITEMCHANNEL_H
+
+#include <QSharedPointer>
+#include <atomic>
+
+class QQuickRhiItem;
+
+class QQuickRhiItemChannelState
+{
+public:
+    virtual ~QQuickRhiItemChannelState() = default;
+
+    bool takeWakeup() { return m_wakeup.exchange(false, std::memory_order_acq_rel); }
+
+    // the publish time of the snapshot taken last, 0 when already reported
+    qint64 takeLatchTime() { const qint64 t = m_latchTime; m_latchTime = 0; return t; }
+
+    static qint64 timestamp();
+
+protected:
+    static void attach(QQuickRhiItem *item, const QSharedPointer<QQuickRhiItemChannelState> &state);
+    void wake();
+
+    QQuickRhiItem *m_item = nullptr;
+    std::atomic<bool> m_wakeup { false };
+    std::atomic<bool> m_notifyPending { false };
+    qint64 m_latchTime = 0; // consumer side
+};
+
+template <typename T>
+class QQuickRhiItemChannel
+{
+public:
+    QQuickRhiItemChannel() = default;
+    explicit QQuickRhiItemChannel(QQuickRhiItem *item)
+        : d(new State)
+    {
+        State::attach(item, d);
+    }
+
+    bool isValid() const { return !d.isNull(); }
+
+    // producer side, any thread, but only one at a time
+    T &beginPublish() { return d->slots[d->back]; }
+    void publish()
+    {
+        d->stamps[d->back] = QQuickRhiItemChannelState::timestamp();
+        const int prev = d->middle.exchange(d->back | FreshBit, std::memory_order_acq_rel);
+        d->back = prev & IndexMask;
+        d->wakeRenderer();
+    }
+    void publish(const T &value) { beginPublish() = value; publish(); }
+    void publish(T &&value) { beginPublish() = std::move(value); publish(); }
+
+    // consumer side, the render thread
+    bool takeLatest()
+    {
+        if (!(d->middle.load(std::memory_order_relaxed) & FreshBit))
+            return false;
+        const int prev = d->middle.exchange(d->front, std::memory_order_acq_rel);
+        d->front = prev & IndexMask;
+        d->latch();
+        return true;
+    }
+    T &latest() { return d->slots[d->front]; }
+    const T &latest() const { return d->slots[d->front]; }
+
+private:
+    enum { IndexMask = 0x3, FreshBit = 0x4 };
+
+    struct State : public QQuickRhiItemChannelState
+    {
+        using QQuickRhiItemChannelState::attach;
+        void wakeRenderer() { wake(); }
+        void latch() { m_latchTime = stamps[front]; }
+
+        T slots[3];
+        qint64 stamps[3] = {};
+        int back = 0; // owned by the producer
+        std::atomic<int> middle { 1 };
+        int front = 2; // owned by the consumer
+    };
+
+    QSharedPointer<State> d;
+};
+
+#endif
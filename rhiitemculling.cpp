@@ -0,0 +1,538 @@
+#include "rhiitemculling.h"
+#include <QtCore/private/qsimd_p.h>
+#include <cfloat>
+#include <cstring>
+
+#if defined(Q_PROCESSOR_X86)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(Q_PROCESSOR_ARM_64)
+#include <arm_neon.h>
+#define RHIITEMCULLING_NEON
+#endif
+
+/*!
+    \class QQuickRhiItemCuller
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Frustum culling and level of detail selection for renderers
+    drawing many instances.
+
+    A QQuickRhiItemRenderer drawing thousands of objects spends most of its
+    CPU time per frame in deciding what to draw. The culler keeps the bounds
+    of the objects as a structure of arrays, and tests them against the
+    frustum of a view-projection matrix with SSE2, AVX2 or NEON, four or
+    eight objects at a time, picking the best implementation the CPU
+    supports at runtime.
+
+    Objects are added with a bounding sphere, or an axis-aligned bounding
+    box, in the space the view-projection matrix transforms from, typically
+    world space. Each object has both: a box added with addBox() gets the
+    enclosing sphere, a sphere gets the enclosing box, and an object is
+    culled when either of them is outside a frustum plane. As both enclose
+    the object, the test is conservative, objects intersecting the frustum
+    are never culled.
+
+    Visible objects are assigned a level of detail by their projected size,
+    the radius in pixels at the distance of the center, compared with the
+    thresholds from setLodThresholds(). Objects smaller than minimumSize()
+    are culled.
+
+    cull() takes the matrix the vertex shader uses, for example scene.mvp of
+    a renderer built on QRhi::clipSpaceCorrMatrix() and a perspective
+    projection, and the scale from world units to pixels, which
+    pixelsPerUnit() calculates from the projection matrix. compact() then
+    gathers the instance data of the visible objects, LOD by LOD, into a
+    contiguous buffer that is uploaded once per frame:
+
+    \code
+        void MyRenderer::render(QRhiCommandBuffer *cb)
+        {
+            m_culler.cull(m_viewProjection, QQuickRhiItemCuller::pixelsPerUnit(m_projection, m_outputSize.height()),
+                          m_rhi->isClipDepthZeroToOne());
+            const int count = m_culler.compact(&m_visibleInstances, m_instances.constData(), sizeof(Instance));
+            QRhiResourceUpdateBatch *u = m_rhi->nextResourceUpdateBatch();
+            if (count)
+                u->updateDynamicBuffer(m_instanceBuffer.get(), 0, m_visibleInstances.size(), m_visibleInstances.constData());
+            cb->beginPass(m_rt.get(), Qt::black, { 1.0f, 0 }, u);
+            // ...
+            for (int lod = 0; lod < m_culler.lodCount(); ++lod) {
+                const QRhiCommandBuffer::VertexInput inputs[] = {
+                    { m_meshes[lod].vertexBuffer, 0 },
+                    { m_instanceBuffer.get(), quint32(m_culler.lodOffset(lod) * sizeof(Instance)) }
+                };
+                cb->setVertexInput(0, 2, inputs, m_meshes[lod].indexBuffer, 0, QRhiCommandBuffer::IndexUInt16);
+                cb->drawIndexed(m_meshes[lod].indexCount, m_culler.visible(lod).count());
+            }
+            cb->endPass();
+        }
+    \endcode
+
+    The culler does not touch the QRhi, so it can run in
+    QQuickRhiItemRenderer::prepare() on a worker thread. The tools/cullbench
+    tool compares the implementations with each other.
+ */
+
+namespace {
+
+struct CullParams {
+    float planes[6][4]; // normalized
+    float absPlanes[6][3];
+    float w[4]; // the row of the matrix giving the clip space w
+    float pixelsPerUnit;
+    float minimumSize;
+    const float *thresholds;
+    int thresholdCount;
+    const float *cx, *cy, *cz, *r, *ex, *ey, *ez;
+};
+
+// Projected sizes of objects around or behind the eye are treated as huge:
+// they are either culled by the planes, or intersect the near plane.
+const float MIN_W = 1e-6f;
+
+void cullScalar(const CullParams &p, quint8 *out, int count)
+{
+    // summed in the same order as the vector implementations, so that the
+    // results are bit-identical, also for objects touching a plane
+    for (int i = 0; i < count; ++i) {
+        bool inside = true;
+        for (int k = 0; k < 6; ++k) {
+            const float d = (p.planes[k][0] * p.cx[i] + p.planes[k][1] * p.cy[i])
+                    + (p.planes[k][2] * p.cz[i] + p.planes[k][3]);
+            const float boxRadius = p.absPlanes[k][0] * p.ex[i] + p.absPlanes[k][1] * p.ey[i] + p.absPlanes[k][2] * p.ez[i];
+            inside &= d >= -qMin(p.r[i], boxRadius);
+        }
+        const float w = (p.w[0] * p.cx[i] + p.w[1] * p.cy[i]) + (p.w[2] * p.cz[i] + p.w[3]);
+        const float size = w > MIN_W ? p.r[i] * p.pixelsPerUnit / w : FLT_MAX;
+        if (!inside || size < p.minimumSize) {
+            out[i] = QQuickRhiItemCuller::Culled;
+            continue;
+        }
+        int lod = 0;
+        for (int t = 0; t < p.thresholdCount; ++t)
+            lod += size < p.thresholds[t] ? 1 : 0;
+        out[i] = quint8(lod);
+    }
+}
+
+#if defined(__SSE2__)
+void cullSSE2(const CullParams &p, quint8 *out, int count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 culled = _mm_set1_ps(QQuickRhiItemCuller::Culled);
+    const __m128 huge = _mm_set1_ps(FLT_MAX);
+    const __m128 minW = _mm_set1_ps(MIN_W);
+    const __m128 ppu = _mm_set1_ps(p.pixelsPerUnit);
+    const __m128 minSize = _mm_set1_ps(p.minimumSize);
+    for (int i = 0; i < count; i += 4) {
+        const __m128 cx = _mm_loadu_ps(p.cx + i);
+        const __m128 cy = _mm_loadu_ps(p.cy + i);
+        const __m128 cz = _mm_loadu_ps(p.cz + i);
+        const __m128 r = _mm_loadu_ps(p.r + i);
+        const __m128 ex = _mm_loadu_ps(p.ex + i);
+        const __m128 ey = _mm_loadu_ps(p.ey + i);
+        const __m128 ez = _mm_loadu_ps(p.ez + i);
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int k = 0; k < 6; ++k) {
+            const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.planes[k][0]), cx),
+                                                   _mm_mul_ps(_mm_set1_ps(p.planes[k][1]), cy)),
+                                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.planes[k][2]), cz),
+                                                   _mm_set1_ps(p.planes[k][3])));
+            const __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.absPlanes[k][0]), ex),
+                                                           _mm_mul_ps(_mm_set1_ps(p.absPlanes[k][1]), ey)),
+                                                _mm_mul_ps(_mm_set1_ps(p.absPlanes[k][2]), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_sub_ps(zero, _mm_min_ps(r, boxRadius))));
+        }
+        const __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.w[0]), cx), _mm_mul_ps(_mm_set1_ps(p.w[1]), cy)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.w[2]), cz), _mm_set1_ps(p.w[3])));
+        const __m128 inFront = _mm_cmpgt_ps(w, minW);
+        __m128 size = _mm_div_ps(_mm_mul_ps(r, ppu), w);
+        size = _mm_or_ps(_mm_and_ps(inFront, size), _mm_andnot_ps(inFront, huge));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(size, minSize));
+        __m128 lod = zero;
+        for (int t = 0; t < p.thresholdCount; ++t)
+            lod = _mm_add_ps(lod, _mm_and_ps(_mm_cmplt_ps(size, _mm_set1_ps(p.thresholds[t])), one));
+        lod = _mm_or_ps(_mm_and_ps(inside, lod), _mm_andnot_ps(inside, culled));
+        const __m128i l32 = _mm_cvttps_epi32(lod);
+        const __m128i l16 = _mm_packs_epi32(l32, l32);
+        const int l8 = _mm_cvtsi128_si32(_mm_packus_epi16(l16, l16));
+        memcpy(out + i, &l8, 4);
+    }
+}
+#endif
+
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+QT_FUNCTION_TARGET(AVX2)
+void cullAVX2(const CullParams &p, quint8 *out, int count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 culled = _mm256_set1_ps(QQuickRhiItemCuller::Culled);
+    const __m256 huge = _mm256_set1_ps(FLT_MAX);
+    const __m256 minW = _mm256_set1_ps(MIN_W);
+    const __m256 ppu = _mm256_set1_ps(p.pixelsPerUnit);
+    const __m256 minSize = _mm256_set1_ps(p.minimumSize);
+    for (int i = 0; i < count; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(p.cx + i);
+        const __m256 cy = _mm256_loadu_ps(p.cy + i);
+        const __m256 cz = _mm256_loadu_ps(p.cz + i);
+        const __m256 r = _mm256_loadu_ps(p.r + i);
+        const __m256 ex = _mm256_loadu_ps(p.ex + i);
+        const __m256 ey = _mm256_loadu_ps(p.ey + i);
+        const __m256 ez = _mm256_loadu_ps(p.ez + i);
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int k = 0; k < 6; ++k) {
+            // no FMA, to give the same results as the other implementations
+            const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.planes[k][0]), cx),
+                                                         _mm256_mul_ps(_mm256_set1_ps(p.planes[k][1]), cy)),
+                                           _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.planes[k][2]), cz),
+                                                         _mm256_set1_ps(p.planes[k][3])));
+            const __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.absPlanes[k][0]), ex),
+                                                                 _mm256_mul_ps(_mm256_set1_ps(p.absPlanes[k][1]), ey)),
+                                                   _mm256_mul_ps(_mm256_set1_ps(p.absPlanes[k][2]), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_sub_ps(zero, _mm256_min_ps(r, boxRadius)), _CMP_GE_OQ));
+        }
+        const __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.w[0]), cx),
+                                                     _mm256_mul_ps(_mm256_set1_ps(p.w[1]), cy)),
+                                       _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.w[2]), cz),
+                                                     _mm256_set1_ps(p.w[3])));
+        const __m256 inFront = _mm256_cmp_ps(w, minW, _CMP_GT_OQ);
+        const __m256 size = _mm256_blendv_ps(huge, _mm256_div_ps(_mm256_mul_ps(r, ppu), w), inFront);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(size, minSize, _CMP_GE_OQ));
+        __m256 lod = zero;
+        for (int t = 0; t < p.thresholdCount; ++t)
+            lod = _mm256_add_ps(lod, _mm256_and_ps(_mm256_cmp_ps(size, _mm256_set1_ps(p.thresholds[t]), _CMP_LT_OQ), one));
+        lod = _mm256_blendv_ps(culled, lod, inside);
+        const __m256i l32 = _mm256_cvttps_epi32(lod);
+        const __m128i l16 = _mm_packs_epi32(_mm256_castsi256_si128(l32), _mm256_extracti128_si256(l32, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(l16, l16));
+    }
+}
+#endif
+
+#ifdef RHIITEMCULLING_NEON
+void cullNEON(const CullParams &p, quint8 *out, int count)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t culled = vdupq_n_f32(QQuickRhiItemCuller::Culled);
+    const float32x4_t huge = vdupq_n_f32(FLT_MAX);
+    const float32x4_t minW = vdupq_n_f32(MIN_W);
+    const float32x4_t ppu = vdupq_n_f32(p.pixelsPerUnit);
+    const float32x4_t minSize = vdupq_n_f32(p.minimumSize);
+    for (int i = 0; i < count; i += 4) {
+        const float32x4_t cx = vld1q_f32(p.cx + i);
+        const float32x4_t cy = vld1q_f32(p.cy + i);
+        const float32x4_t cz = vld1q_f32(p.cz + i);
+        const float32x4_t r = vld1q_f32(p.r + i);
+        const float32x4_t ex = vld1q_f32(p.ex + i);
+        const float32x4_t ey = vld1q_f32(p.ey + i);
+        const float32x4_t ez = vld1q_f32(p.ez + i);
+        uint32x4_t inside = vdupq_n_u32(~0u);
+        for (int k = 0; k < 6; ++k) {
+            const float32x4_t d = vaddq_f32(vaddq_f32(vmulq_n_f32(cx, p.planes[k][0]), vmulq_n_f32(cy, p.planes[k][1])),
+                                            vaddq_f32(vmulq_n_f32(cz, p.planes[k][2]), vdupq_n_f32(p.planes[k][3])));
+            const float32x4_t boxRadius = vaddq_f32(vaddq_f32(vmulq_n_f32(ex, p.absPlanes[k][0]),
+                                                              vmulq_n_f32(ey, p.absPlanes[k][1])),
+                                                    vmulq_n_f32(ez, p.absPlanes[k][2]));
+            inside = vandq_u32(inside, vcgeq_f32(d, vnegq_f32(vminq_f32(r, boxRadius))));
+        }
+        const float32x4_t w = vaddq_f32(vaddq_f32(vmulq_n_f32(cx, p.w[0]), vmulq_n_f32(cy, p.w[1])),
+                                        vaddq_f32(vmulq_n_f32(cz, p.w[2]), vdupq_n_f32(p.w[3])));
+        const float32x4_t size = vbslq_f32(vcgtq_f32(w, minW), vdivq_f32(vmulq_f32(r, ppu), w), huge);
+        inside = vandq_u32(inside, vcgeq_f32(size, minSize));
+        float32x4_t lod = zero;
+        for (int t = 0; t < p.thresholdCount; ++t)
+            lod = vaddq_f32(lod, vbslq_f32(vcltq_f32(size, vdupq_n_f32(p.thresholds[t])), one, zero));
+        lod = vbslq_f32(inside, lod, culled);
+        const uint16x4_t l16 = vmovn_u32(vcvtq_u32_f32(lod));
+        const uint8x8_t l8 = vmovn_u16(vcombine_u16(l16, l16));
+        vst1_lane_u32(reinterpret_cast<uint32_t *>(out + i), vreinterpret_u32_u8(l8), 0);
+    }
+}
+#endif
+
+} // namespace
+
+QQuickRhiItemCuller::QQuickRhiItemCuller()
+    : m_implementation(bestImplementation())
+{
+}
+
+/*!
+    \return the fastest implementation supported by the build and the CPU.
+ */
+QQuickRhiItemCuller::Implementation QQuickRhiItemCuller::bestImplementation()
+{
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+    if (qCpuHasFeature(AVX2))
+        return AVX2;
+#endif
+#if defined(__SSE2__)
+    return SSE2;
+#elif defined(RHIITEMCULLING_NEON)
+    return NEON;
+#else
+    return Scalar;
+#endif
+}
+
+const char *QQuickRhiItemCuller::implementationName(Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return "scalar";
+    case SSE2:
+        return "SSE2";
+    case AVX2:
+        return "AVX2";
+    case NEON:
+        return "NEON";
+    }
+    return "";
+}
+
+/*!
+    Selects the implementation used by cull(), for comparing them. \return
+    false, keeping the current one, when \a implementation is not supported
+    by the build or the CPU.
+ */
+bool QQuickRhiItemCuller::setImplementation(Implementation implementation)
+{
+    bool supported = implementation == Scalar;
+#if defined(__SSE2__)
+    supported |= implementation == SSE2;
+#endif
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+    supported |= implementation == AVX2 && qCpuHasFeature(AVX2);
+#endif
+#ifdef RHIITEMCULLING_NEON
+    supported |= implementation == NEON;
+#endif
+    if (supported)
+        m_implementation = implementation;
+    return supported;
+}
+
+void QQuickRhiItemCuller::reserve(int count)
+{
+    const int padded = (count + 7) & ~7;
+    for (QList<float> *a : { &m_centerX, &m_centerY, &m_centerZ, &m_radius, &m_extentX, &m_extentY, &m_extentZ })
+        a->reserve(padded);
+    m_lods.reserve(padded);
+}
+
+void QQuickRhiItemCuller::clear()
+{
+    resize(0);
+}
+
+void QQuickRhiItemCuller::resize(int count)
+{
+    // the padding is zero-sized objects at the origin, whose results are ignored
+    m_count = count;
+    const int padded = (count + 7) & ~7;
+    for (QList<float> *a : { &m_centerX, &m_centerY, &m_centerZ, &m_radius, &m_extentX, &m_extentY, &m_extentZ })
+        a->resize(padded);
+    m_lods.resize(padded);
+    for (QList<quint32> &v : m_visible)
+        v.clear();
+}
+
+/*!
+    Adds an object with the bounding sphere of \a center and \a radius.
+    \return the index of the object, which is its index in the instance data
+    passed to compact().
+ */
+int QQuickRhiItemCuller::addSphere(const QVector3D &center, float radius)
+{
+    const int index = m_count;
+    resize(m_count + 1);
+    setSphere(index, center, radius);
+    return index;
+}
+
+/*!
+    Adds an object with the axis-aligned bounding box from \a min to \a max.
+ */
+int QQuickRhiItemCuller::addBox(const QVector3D &min, const QVector3D &max)
+{
+    const int index = m_count;
+    resize(m_count + 1);
+    setBox(index, min, max);
+    return index;
+}
+
+void QQuickRhiItemCuller::setSphere(int index, const QVector3D &center, float radius)
+{
+    setCenter(index, center);
+    m_radius[index] = radius;
+    m_extentX[index] = radius;
+    m_extentY[index] = radius;
+    m_extentZ[index] = radius;
+}
+
+void QQuickRhiItemCuller::setBox(int index, const QVector3D &min, const QVector3D &max)
+{
+    const QVector3D extent = (max - min) * 0.5f;
+    setCenter(index, (min + max) * 0.5f);
+    m_radius[index] = extent.length();
+    m_extentX[index] = extent.x();
+    m_extentY[index] = extent.y();
+    m_extentZ[index] = extent.z();
+}
+
+/*!
+    Moves an object, keeping the size of its bounds.
+ */
+void QQuickRhiItemCuller::setCenter(int index, const QVector3D &center)
+{
+    m_centerX[index] = center.x();
+    m_centerY[index] = center.y();
+    m_centerZ[index] = center.z();
+}
+
+/*!
+    Sets the projected sizes, in pixels, at which the LOD switches. Objects
+    of at least \c{pixelSizes[0]} get LOD 0, smaller ones of at least
+    \c{pixelSizes[1]} LOD 1, and so on, the smallest ones get the last LOD.
+    The sizes must be in decreasing order, and there can be at most
+    MaxLodCount LODs. The default is a single LOD.
+ */
+void QQuickRhiItemCuller::setLodThresholds(const QList<float> &pixelSizes)
+{
+    if (pixelSizes.count() >= MaxLodCount) {
+        qWarning("QQuickRhiItemCuller: at most %d LODs are supported", MaxLodCount);
+        return;
+    }
+    m_thresholds = pixelSizes;
+}
+
+/*!
+    \return the scale from world units at a distance of 1 to pixels, for a
+    perspective \a projection and a viewport of \a viewportHeight pixels.
+ */
+float QQuickRhiItemCuller::pixelsPerUnit(const QMatrix4x4 &projection, float viewportHeight)
+{
+    return qAbs(projection(1, 1)) * viewportHeight * 0.5f;
+}
+
+/*!
+    Tests all objects against the frustum of \a viewProjection and selects
+    their LOD. \a pixelsPerUnit scales the radius at a distance of 1 to
+    pixels. \a clipDepthZeroToOne tells the depth range of the clip space,
+    pass QRhi::isClipDepthZeroToOne(), as it is -1 to 1 with OpenGL.
+ */
+void QQuickRhiItemCuller::cull(const QMatrix4x4 &viewProjection, float pixelsPerUnit, bool clipDepthZeroToOne)
+{
+    CullParams p;
+    // planes of the clip space, as in Gribb and Hartmann, pointing inwards
+    const QVector4D r0 = viewProjection.row(0);
+    const QVector4D r1 = viewProjection.row(1);
+    const QVector4D r2 = viewProjection.row(2);
+    const QVector4D r3 = viewProjection.row(3);
+    const QVector4D planes[6] = {
+        r3 + r0, r3 - r0,
+        r3 + r1, r3 - r1,
+        clipDepthZeroToOne ? r2 : r3 + r2, r3 - r2
+    };
+    for (int k = 0; k < 6; ++k) {
+        const float len = planes[k].toVector3D().length();
+        const QVector4D plane = len > 0.0f ? planes[k] / len : QVector4D(0, 0, 0, 1);
+        for (int c = 0; c < 4; ++c)
+            p.planes[k][c] = plane[c];
+        for (int c = 0; c < 3; ++c)
+            p.absPlanes[k][c] = qAbs(plane[c]);
+    }
+    for (int c = 0; c < 4; ++c)
+        p.w[c] = r3[c];
+    p.pixelsPerUnit = pixelsPerUnit;
+    p.minimumSize = m_minimumSize;
+    p.thresholds = m_thresholds.constData();
+    p.thresholdCount = m_thresholds.count();
+    p.cx = m_centerX.constData();
+    p.cy = m_centerY.constData();
+    p.cz = m_centerZ.constData();
+    p.r = m_radius.constData();
+    p.ex = m_extentX.constData();
+    p.ey = m_extentY.constData();
+    p.ez = m_extentZ.constData();
+
+    // the SIMD implementations run over the padding instead of having a tail
+    quint8 *out = m_lods.data();
+    const int padded = m_lods.count();
+    switch (m_implementation) {
+#if defined(__SSE2__)
+    case SSE2:
+        cullSSE2(p, out, padded);
+        break;
+#endif
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+    case AVX2:
+        cullAVX2(p, out, padded);
+        break;
+#endif
+#ifdef RHIITEMCULLING_NEON
+    case NEON:
+        cullNEON(p, out, padded);
+        break;
+#endif
+    default:
+        cullScalar(p, out, m_count);
+        break;
+    }
+
+    for (QList<quint32> &v : m_visible)
+        v.clear();
+    for (int i = 0; i < m_count; ++i) {
+        if (out[i] != Culled)
+            m_visible[out[i]].append(i);
+    }
+}
+
+/*!
+    \return the number of objects not culled by the last cull().
+ */
+int QQuickRhiItemCuller::visibleCount() const
+{
+    int count = 0;
+    for (const QList<quint32> &v : m_visible)
+        count += v.count();
+    return count;
+}
+
+/*!
+    Copies the elements of \a instanceData, an array of \a stride bytes per
+    object, of the visible objects to \a dst, ordered by LOD, and in the
+    order of the objects within each LOD. \return the number of instances.
+
+    The instances of a LOD start at lodOffset().
+ */
+int QQuickRhiItemCuller::compact(QByteArray *dst, const void *instanceData, int stride) const
+{
+    const int count = visibleCount();
+    dst->resize(qsizetype(count) * stride);
+    const char *src = static_cast<const char *>(instanceData);
+    char *p = dst->data();
+    for (const QList<quint32> &v : m_visible) {
+        for (quint32 i : v) {
+            memcpy(p, src + qsizetype(i) * stride, stride);
+            p += stride;
+        }
+    }
+    return count;
+}
+
+/*!
+    \return the index of the first instance of \a lod in the data written by
+    compact().
+ */
+int QQuickRhiItemCuller::lodOffset(int lod) const
+{
+    int offset = 0;
+    for (int i = 0; i < lod; ++i)
+        offset += m_visible[i].count();
+    return offset;
+}
@@ -0,0 +1,79 @@
+#ifndef RHIITEMCULLING_H
+#define RHIITEMCULLING_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMatrix4x4>
+#include <QVector3D>
+
+class QQuickRhiItemCuller
+{
+public:
+    enum Implementation {
+        Scalar,
+        SSE2,
+        AVX2,
+        NEON
+    };
+
+    // the LOD of objects that are not drawn
+    static const quint8 Culled = 0xFF;
+    static const int MaxLodCount = 16;
+
+    QQuickRhiItemCuller();
+
+    void reserve(int count);
+    void clear();
+    int count() const { return m_count; }
+
+    int addSphere(const QVector3D &center, float radius);
+    int addBox(const QVector3D &min, const QVector3D &max);
+    void setSphere(int index, const QVector3D &center, float radius);
+    void setBox(int index, const QVector3D &min, const QVector3D &max);
+    void setCenter(int index, const QVector3D &center);
+
+    // projected sizes in pixels, in decreasing order, one less than the LOD count
+    void setLodThresholds(const QList<float> &pixelSizes);
+    QList<float> lodThresholds() const { return m_thresholds; }
+    int lodCount() const { return m_thresholds.count() + 1; }
+    void setMinimumSize(float pixels) { m_minimumSize = pixels; }
+    float minimumSize() const { return m_minimumSize; }
+
+    static float pixelsPerUnit(const QMatrix4x4 &projection, float viewportHeight);
+
+    void cull(const QMatrix4x4 &viewProjection, float pixelsPerUnit, bool clipDepthZeroToOne = true);
+
+    const quint8 *lods() const { return m_lods.constData(); }
+    const QList<quint32> &visible(int lod) const { return m_visible[lod]; }
+    int visibleCount() const;
+
+    int compact(QByteArray *dst, const void *instanceData, int stride) const;
+    int lodOffset(int lod) const;
+
+    static Implementation bestImplementation();
+    static const char *implementationName(Implementation implementation);
+    Implementation implementation() const { return m_implementation; }
+    bool setImplementation(Implementation implementation);
+
+private:
+    void resize(int count);
+
+    int m_count = 0;
+    // structure of arrays, padded to a multiple of 8 for the SIMD paths
+    QList<float> m_centerX;
+    QList<float> m_centerY;
+    QList<float> m_centerZ;
+    QList<float> m_radius;
+    QList<float> m_extentX;
+    QList<float> m_extentY;
+    QList<float> m_extentZ;
+
+    QList<float> m_thresholds;
+    float m_minimumSize = 0.0f;
+    Implementation m_implementation;
+
+    QList<quint8> m_lods;
+    QList<quint32> m_visible[MaxLodCount];
+};
+
+#endif
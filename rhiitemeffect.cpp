@@ -0,0 +1,441 @@
+#include "rhiitemeffect_p.h"
+#include "rhiitemtexturepool.h"
+#include <QColor>
+#include <QFile>
+#include <QMatrix4x4>
+#include <QMetaProperty>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <QtQml/qqmlfile.h>
+
+using EffectUniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Vec2, QQuickRhiItemStd140::Int>;
+static_assert(offsetof(QQuickRhiItemEffectUniforms, texelSize) == EffectUniformsLayout::offset<0>);
+static_assert(offsetof(QQuickRhiItemEffectUniforms, flipY) == EffectUniformsLayout::offset<1>);
+
+/*!
+    \qmltype RhiItemEffect
+    \nativetype QQuickRhiItemEffect
+    \inqmlmodule TestApp
+
+    \brief A full-screen shader pass applied to the output of a QQuickRhiItem.
+
+    Effects are listed in QQuickRhiItem::effects, and are run by the item's
+    scenegraph node after the renderer, each taking the previous one's result
+    as input. Compared to wrapping the item in a ShaderEffect or enabling
+    \c layer.enabled, this does not add an extra Qt Quick render pass and an
+    extra texture per effect: the passes alternate between two pooled
+    textures, and the last one writes the texture the scenegraph samples,
+    which is also what the item's texture provider, and so RhiItemView,
+    shows.
+
+    \badcode
+    TestRhiItem {
+        effects: [
+            RhiItemEffect {
+                fragmentShader: "qrc:/blur.frag.qsb"
+                property vector2d direction: Qt.vector2d(1, 0)
+                property real radius: 2
+            },
+            RhiItemEffect {
+                fragmentShader: "qrc:/blur.frag.qsb"
+                property vector2d direction: Qt.vector2d(0, 1)
+                property real radius: 2
+            }
+        ]
+    }
+    \endcode
+
+    fragmentShader is a .qsb file, typically generated with qt_add_shaders().
+    The vertex stage is provided, it passes the texture coordinates in
+    location 0. The fragment shader is expected to have the following
+    interface:
+
+    \badcode
+    layout(location = 0) in vec2 v_texcoord;
+    layout(location = 0) out vec4 fragColor;
+    layout(std140, binding = 0) uniform effect {
+        vec2 texelSize;
+        int flipY;
+    };
+    layout(binding = 1) uniform sampler2D source;
+    layout(std140, binding = 2) uniform params {
+        ... // optional
+    };
+    \endcode
+
+    The members of the block at binding 2 are set from the properties of the
+    same name declared on the RhiItemEffect. Float, int, bool, vector and
+    matrix types are supported, colors are passed premultiplied.
+
+    Changing a parameter only runs the effect chain again, without
+    synchronizing the item or rendering its renderer again. When neither the
+    renderer's output nor the parameters change, the effects do not run.
+ */
+
+QQuickRhiItemEffect::QQuickRhiItemEffect(QObject *parent)
+    : QObject(parent)
+{
+}
+
+/*!
+    \qmlproperty url RhiItemEffect::fragmentShader
+
+    The serialized fragment shader (.qsb) of the effect.
+ */
+void QQuickRhiItemEffect::setFragmentShader(const QUrl &url)
+{
+    if (m_fragmentShader == url)
+        return;
+
+    m_fragmentShader = url;
+    m_shader = QShader();
+    if (!url.isEmpty()) {
+        const QString fileName = QQmlFile::urlToLocalFileOrQrc(url);
+        QFile f(fileName);
+        if (f.open(QIODevice::ReadOnly))
+            m_shader = QShader::fromSerialized(f.readAll());
+        if (!m_shader.isValid())
+            qWarning("RhiItemEffect: failed to load shader %s", qPrintable(fileName));
+    }
+    emit fragmentShaderChanged();
+    emit changed();
+}
+
+/*!
+    \qmlproperty bool RhiItemEffect::enabled
+
+    Disabled effects are skipped. The default value is \c true.
+ */
+void QQuickRhiItemEffect::setEnabled(bool enable)
+{
+    if (m_enabled == enable)
+        return;
+
+    m_enabled = enable;
+    emit enabledChanged();
+    emit changed();
+}
+
+void QQuickRhiItemEffect::componentComplete()
+{
+    // the properties declared in QML are the parameters
+    const QMetaObject *mo = metaObject();
+    const int slot = mo->indexOfSlot("parameterChanged()");
+    for (int i = staticMetaObject.propertyCount(); i < mo->propertyCount(); ++i) {
+        const QMetaProperty p = mo->property(i);
+        if (p.hasNotifySignal())
+            QMetaObject::connect(this, p.notifySignalIndex(), this, slot);
+    }
+}
+
+void QQuickRhiItemEffect::parameterChanged()
+{
+    if (isActive())
+        emit parametersChanged();
+}
+
+static void writeUniform(char *dst, QShaderDescription::VariableType type, const QVariant &v)
+{
+    switch (type) {
+    case QShaderDescription::Float: {
+        const float f = v.toFloat();
+        memcpy(dst, &f, 4);
+        break;
+    }
+    case QShaderDescription::Int:
+    case QShaderDescription::Uint:
+    case QShaderDescription::Bool: {
+        const qint32 i = v.toInt();
+        memcpy(dst, &i, 4);
+        break;
+    }
+    case QShaderDescription::Vec2: {
+        QVector2D vec;
+        if (v.metaType().id() == QMetaType::QPointF)
+            vec = QVector2D(v.toPointF());
+        else if (v.metaType().id() == QMetaType::QSizeF)
+            vec = QVector2D(v.toSizeF().width(), v.toSizeF().height());
+        else
+            vec = v.value<QVector2D>();
+        memcpy(dst, &vec, 8);
+        break;
+    }
+    case QShaderDescription::Vec3: {
+        const QVector3D vec = v.value<QVector3D>();
+        memcpy(dst, &vec, 12);
+        break;
+    }
+    case QShaderDescription::Vec4: {
+        if (v.metaType().id() == QMetaType::QColor) {
+            const QQuickRhiItemStd140::Vec4 c = QQuickRhiItemStd140::Vec4::premultiplied(v.value<QColor>());
+            memcpy(dst, c.v, 16);
+        } else {
+            const QVector4D vec = v.value<QVector4D>();
+            memcpy(dst, &vec, 16);
+        }
+        break;
+    }
+    case QShaderDescription::Mat4: {
+        const QMatrix4x4 m = v.value<QMatrix4x4>();
+        memcpy(dst, m.constData(), 64);
+        break;
+    }
+    default:
+        qWarning("RhiItemEffect: unsupported parameter type %d", int(type));
+        break;
+    }
+}
+
+/*!
+    \internal
+
+    \return the contents of the parameter uniform block, packed from the
+    properties with the names of the block members.
+ */
+QByteArray QQuickRhiItemEffect::parameterData() const
+{
+    const QList<QShaderDescription::UniformBlock> blocks = m_shader.description().uniformBlocks();
+    for (const QShaderDescription::UniformBlock &block : blocks) {
+        if (block.binding != ParametersBinding)
+            continue;
+        QByteArray data(block.size, 0);
+        for (const QShaderDescription::BlockVariable &member : block.members) {
+            const QVariant v = property(member.name.constData());
+            if (v.isValid())
+                writeUniform(data.data() + member.offset, member.type, v);
+        }
+        return data;
+    }
+    return QByteArray();
+}
+
+/*
+    Runs the effect passes of a node. The first pass reads the renderer's
+    output, the intermediate ones alternate between two pooled textures, and
+    the last one writes output(), which is what the node shows. The render
+    pass descriptor and the pipelines survive resizing, only the textures,
+    render targets and bindings change.
+ */
+
+QQuickRhiItemEffectChain::QQuickRhiItemEffectChain(QRhi *rhi)
+    : m_rhi(rhi)
+{
+    QFile f(QLatin1String(":/effect.vert.qsb"));
+    if (f.open(QIODevice::ReadOnly))
+        m_vertexShader = QShader::fromSerialized(f.readAll());
+    Q_ASSERT(m_vertexShader.isValid());
+
+    m_sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+    m_sampler->create();
+
+    m_ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, m_uniforms.size()));
+    m_ubuf->create();
+    // y = -1 in NDC is the first row of the framebuffer with OpenGL and
+    // Vulkan, but the last one with Direct 3D and Metal
+    m_uniforms.set(&QQuickRhiItemEffectUniforms::flipY, m_rhi->isYUpInNDC() != m_rhi->isYUpInFramebuffer() ? 1 : 0);
+}
+
+QQuickRhiItemEffectChain::~QQuickRhiItemEffectChain()
+{
+    releasePasses();
+    releaseTextures();
+}
+
+void QQuickRhiItemEffectChain::setEffects(const QList<QShader> &shaders)
+{
+    bool same = shaders.count() == m_passes.count();
+    for (int i = 0; same && i < shaders.count(); ++i)
+        same = shaders[i] == m_passes[i].shader;
+    if (same)
+        return;
+
+    releasePasses();
+    for (const QShader &shader : shaders) {
+        Pass pass;
+        pass.shader = shader;
+        for (const QShaderDescription::UniformBlock &block : shader.description().uniformBlocks()) {
+            if (block.binding == QQuickRhiItemEffect::ParametersBinding) {
+                pass.parameterBuffer = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, block.size);
+                pass.parameterBuffer->create();
+            }
+        }
+        m_passes.append(pass);
+    }
+    ensureTextures();
+    m_bindingsDirty = true;
+    m_dirty = true;
+}
+
+void QQuickRhiItemEffectChain::setParameters(const QList<QByteArray> &data)
+{
+    for (int i = 0; i < qMin(data.count(), m_passes.count()); ++i) {
+        Pass &pass(m_passes[i]);
+        if (pass.parameters != data[i]) {
+            pass.parameters = data[i];
+            pass.parametersDirty = true;
+            m_dirty = true;
+        }
+    }
+}
+
+void QQuickRhiItemEffectChain::resize(const QSize &pixelSize, QRhiTexture::Flags outputFlags)
+{
+    if (pixelSize == m_pixelSize && outputFlags == m_outputFlags && m_output)
+        return;
+
+    releaseTextures();
+    m_pixelSize = pixelSize;
+    m_outputFlags = outputFlags;
+    m_uniforms.set(&QQuickRhiItemEffectUniforms::texelSize,
+                   QQuickRhiItemStd140::Vec2 { { 1.0f / pixelSize.width(), 1.0f / pixelSize.height() } });
+    ensureTextures();
+    m_bindingsDirty = true;
+    m_dirty = true;
+}
+
+bool QQuickRhiItemEffectChain::ensureTextures()
+{
+    if (m_pixelSize.isEmpty())
+        return false;
+
+    QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::get(m_rhi);
+    if (!m_output) {
+        m_output = pool->acquireTexture(QRhiTexture::RGBA8, m_pixelSize, m_outputFlags | QRhiTexture::RenderTarget);
+        if (!m_output)
+            return false;
+        m_outputRt = m_rhi->newTextureRenderTarget({ m_output });
+        if (!m_rp)
+            m_rp.reset(m_outputRt->newCompatibleRenderPassDescriptor());
+        m_outputRt->setRenderPassDescriptor(m_rp.data());
+        m_outputRt->create();
+    }
+
+    // a single pass writes the output directly, more need up to two
+    // intermediate textures
+    const int needed = qMin(2, qMax(0, int(m_passes.count()) - 1));
+    for (int i = 0; i < 2; ++i) {
+        if (i < needed && !m_pingPong[i]) {
+            m_pingPong[i] = pool->acquireTexture(QRhiTexture::RGBA8, m_pixelSize, QRhiTexture::RenderTarget);
+            m_pingPongRt[i] = m_rhi->newTextureRenderTarget({ m_pingPong[i] });
+            m_pingPongRt[i]->setRenderPassDescriptor(m_rp.data());
+            m_pingPongRt[i]->create();
+        } else if (i >= needed && m_pingPong[i]) {
+            delete m_pingPongRt[i];
+            m_pingPongRt[i] = nullptr;
+            pool->releaseTexture(m_pingPong[i]);
+            m_pingPong[i] = nullptr;
+        }
+    }
+    return true;
+}
+
+void QQuickRhiItemEffectChain::updateBindings(QRhiTexture *source)
+{
+    for (int i = 0; i < m_passes.count(); ++i) {
+        Pass &pass(m_passes[i]);
+        QRhiTexture *input = i == 0 ? source : m_pingPong[(i - 1) % 2];
+        QList<QRhiShaderResourceBinding> bindings = {
+            QRhiShaderResourceBinding::uniformBuffer(QQuickRhiItemEffect::EffectUniformsBinding,
+                                                     QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage,
+                                                     m_ubuf.data()),
+            QRhiShaderResourceBinding::sampledTexture(QQuickRhiItemEffect::SourceBinding,
+                                                      QRhiShaderResourceBinding::FragmentStage, input, m_sampler.data())
+        };
+        if (pass.parameterBuffer) {
+            bindings.append(QRhiShaderResourceBinding::uniformBuffer(QQuickRhiItemEffect::ParametersBinding,
+                                                                     QRhiShaderResourceBinding::FragmentStage,
+                                                                     pass.parameterBuffer));
+        }
+        if (!pass.srb)
+            pass.srb = m_rhi->newShaderResourceBindings();
+        pass.srb->setBindings(bindings.cbegin(), bindings.cend());
+        pass.srb->create();
+
+        // the layout of the bindings never changes, the pipeline stays valid
+        if (!pass.ps) {
+            pass.ps = m_rhi->newGraphicsPipeline();
+            pass.ps->setShaderStages({
+                { QRhiShaderStage::Vertex, m_vertexShader },
+                { QRhiShaderStage::Fragment, pass.shader }
+            });
+            pass.ps->setVertexInputLayout(QRhiVertexInputLayout());
+            pass.ps->setShaderResourceBindings(pass.srb);
+            pass.ps->setRenderPassDescriptor(m_rp.data());
+            if (!pass.ps->create())
+                qWarning("Failed to create the pipeline of QQuickRhiItem effect %d", i);
+        }
+    }
+    m_boundSource = source;
+    m_bindingsDirty = false;
+}
+
+void QQuickRhiItemEffectChain::run(QRhiCommandBuffer *cb, QRhiTexture *source)
+{
+    if (m_passes.isEmpty() || !m_output)
+        return;
+
+    if (m_bindingsDirty || source != m_boundSource)
+        updateBindings(source);
+
+    QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+    if (m_uniforms.isDirty())
+        m_uniforms.commit(rub, m_ubuf.data());
+    for (Pass &pass : m_passes) {
+        if (pass.parametersDirty && pass.parameterBuffer && pass.parameters.size() == pass.parameterBuffer->size()) {
+            rub->updateDynamicBuffer(pass.parameterBuffer, 0, pass.parameters.size(), pass.parameters.constData());
+            pass.parametersDirty = false;
+        }
+    }
+
+    for (int i = 0; i < m_passes.count(); ++i) {
+        const Pass &pass(m_passes[i]);
+        QRhiTextureRenderTarget *rt = i == m_passes.count() - 1 ? m_outputRt : m_pingPongRt[i % 2];
+        cb->beginPass(rt, Qt::transparent, { 1.0f, 0 }, rub);
+        rub = nullptr;
+        cb->setGraphicsPipeline(pass.ps);
+        cb->setViewport(QRhiViewport(0, 0, m_pixelSize.width(), m_pixelSize.height()));
+        cb->setShaderResources();
+        cb->draw(3);
+        cb->endPass();
+    }
+
+    m_dirty = false;
+}
+
+void QQuickRhiItemEffectChain::releasePasses()
+{
+    for (Pass &pass : m_passes) {
+        delete pass.ps;
+        delete pass.srb;
+        delete pass.parameterBuffer;
+    }
+    m_passes.clear();
+}
+
+void QQuickRhiItemEffectChain::releaseTextures()
+{
+    // the pool may be gone already when the QRhi's cleanup deletes this
+    QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::find(m_rhi);
+    auto release = [pool](QRhiTexture *texture) {
+        if (pool)
+            pool->releaseTexture(texture);
+        else
+            delete texture;
+    };
+    for (int i = 0; i < 2; ++i) {
+        delete m_pingPongRt[i];
+        m_pingPongRt[i] = nullptr;
+        if (m_pingPong[i]) {
+            release(m_pingPong[i]);
+            m_pingPong[i] = nullptr;
+        }
+    }
+    delete m_outputRt;
+    m_outputRt = nullptr;
+    if (m_output) {
+        release(m_output);
+        m_output = nullptr;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef RHIITEMEFFECT_H
+#define RHIITEMEFFECT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QtQml/qqml.h>
+#include <QtQml/qqmlparserstatus.h>
+#include <QtGui/private/qshader_p.h>
+
+class QQuickRhiItemEffect : public QObject, public QQmlParserStatus
+{
+    Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
+    QML_NAMED_ELEMENT(RhiItemEffect)
+
+    Q_PROPERTY(QUrl fragmentShader READ fragmentShader WRITE setFragmentShader NOTIFY fragmentShaderChanged)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+
+public:
+    // the bindings of the effect shaders
+    enum { EffectUniformsBinding = 0, SourceBinding = 1, ParametersBinding = 2 };
+
+    QQuickRhiItemEffect(QObject *parent = nullptr);
+
+    QUrl fragmentShader() const { return m_fragmentShader; }
+    void setFragmentShader(const QUrl &url);
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enable);
+
+    bool isActive() const { return m_enabled && m_shader.isValid(); }
+    QShader shader() const { return m_shader; }
+    QByteArray parameterData() const;
+
+    void classBegin() override { }
+    void componentComplete() override;
+
+Q_SIGNALS:
+    void fragmentShaderChanged();
+    void enabledChanged();
+    void changed();
+    void parametersChanged();
+
+private Q_SLOTS:
+    void parameterChanged();
+
+private:
+    QUrl m_fragmentShader;
+    QShader m_shader;
+    bool m_enabled = true;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef RHIITEMEFFECT_P_H
+#define RHIITEMEFFECT_P_H
+
+#include "rhiitemeffect.h"
+#include "rhiitemuniformblock.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QMutex>
+
+// The parameter values of the active effects of an item, in chain order.
+// Written on the GUI thread when a parameter changes, read by the node in
+// render(), so that parameter changes do not need a sync.
+struct QQuickRhiItemEffectParams
+{
+    QMutex mutex;
+    QList<QByteArray> data;
+    bool dirty = false;
+};
+
+// the uniform block at EffectUniformsBinding, provided by the chain
+struct QQuickRhiItemEffectUniforms
+{
+    QQuickRhiItemStd140::Vec2 texelSize;
+    QQuickRhiItemStd140::Int flipY;
+};
+
+class QQuickRhiItemEffectChain
+{
+public:
+    QQuickRhiItemEffectChain(QRhi *rhi);
+    ~QQuickRhiItemEffectChain();
+
+    void setEffects(const QList<QShader> &shaders);
+    void setParameters(const QList<QByteArray> &data);
+    void resize(const QSize &pixelSize, QRhiTexture::Flags outputFlags);
+
+    bool isDirty() const { return m_dirty; }
+    QRhiTexture *output() const { return m_output; }
+
+    void run(QRhiCommandBuffer *cb, QRhiTexture *source);
+
+private:
+    struct Pass {
+        QShader shader;
+        QByteArray parameters;
+        bool parametersDirty = true;
+        QRhiBuffer *parameterBuffer = nullptr;
+        QRhiShaderResourceBindings *srb = nullptr;
+        QRhiGraphicsPipeline *ps = nullptr;
+    };
+
+    bool ensureTextures();
+    void updateBindings(QRhiTexture *source);
+    void releasePasses();
+    void releaseTextures();
+
+    QRhi *m_rhi;
+    QShader m_vertexShader;
+    QList<Pass> m_passes;
+    QSize m_pixelSize;
+    QRhiTexture::Flags m_outputFlags;
+    QRhiTexture *m_output = nullptr;
+    QRhiTextureRenderTarget *m_outputRt = nullptr;
+    QRhiTexture *m_pingPong[2] = {};
+    QRhiTextureRenderTarget *m_pingPongRt[2] = {};
+    QScopedPointer<QRhiRenderPassDescriptor> m_rp;
+    QScopedPointer<QRhiSampler> m_sampler;
+    QScopedPointer<QRhiBuffer> m_ubuf;
+    QQuickRhiItemUniformBlock<QQuickRhiItemEffectUniforms> m_uniforms;
+    QRhiTexture *m_boundSource = nullptr;
+    bool m_texturesDirty = true;
+    bool m_bindingsDirty = true;
+    bool m_dirty = true;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "rhiitempipelinecache.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcRhiItemPipelines, "qt.quick.rhiitem.pipelines")
+
+/*!
+    \class QQuickRhiItemPipelineCache
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Builds the graphics pipelines of QQuickRhiItem renderers ahead of
+    time, and shares them between renderers.
+
+    Creating a pipeline compiles its shaders for the GPU, which can take
+    several milliseconds. Renderers typically do that in their initialize(),
+    so the first time an item type is shown, the frame showing it is late,
+    often in the middle of an animation.
+
+    Renderer types instead register named descriptions of their pipelines
+    with registerGraphicsPipeline(), at startup, for example with
+    Q_CONSTRUCTOR_FUNCTION. Once the scenegraph of a window with a
+    QQuickRhiItem is initialized, before its first frame, and after each
+    frame, the registered pipelines are built on the render thread, within a
+    budget of 4 milliseconds per frame, which can be changed with the \c QSG_RHIITEM_PREWARM_BUDGET
+    environment variable, in milliseconds. At least one pipeline is built per
+    frame, and further frames are requested until all are done.
+
+    Renderers then get their pipelines with graphicsPipeline(), which returns
+    the prewarmed pipeline when the render pass descriptor is compatible with
+    the one in the description. Otherwise, or when prewarming has not gotten
+    to it yet, the pipeline is built right away and added to the cache, so
+    that further renderers of the same type share it.
+
+    The pipelines belong to the cache, renderers must not destroy them. They
+    are created with a shader resource bindings object that only describes
+    the layout, so renderers have to pass their own, layout-compatible, one
+    to QRhiCommandBuffer::setShaderResources().
+
+    There is one cache per QRhi, living on its thread and destroyed together
+    with it. Items with QQuickRhiItem::asyncRendering have a QRhi of their
+    own, which is not prewarmed. The number of prewarmed pipelines, the time
+    spent on them, and the cache hits and misses are available via stats(),
+    and are reported when the cache is destroyed when the
+    \c qt.quick.rhiitem.pipelines logging category is enabled.
+ */
+
+struct Registration {
+    QByteArray name;
+    QQuickRhiItemPipelineCache::GraphicsPipelineDescription desc;
+};
+
+// constant initialized, registrations can happen in static initializers
+static QMutex registryMutex;
+
+static QList<Registration> &registry()
+{
+    static QList<Registration> r;
+    return r;
+}
+
+static QMutex cacheMutex;
+static QHash<QRhi *, QQuickRhiItemPipelineCache *> caches;
+
+/*!
+    Registers the graphics pipeline \a desc as \a name. Can be called on any
+    thread, at any time, the caches pick up new registrations when
+    prewarming.
+ */
+void QQuickRhiItemPipelineCache::registerGraphicsPipeline(const QByteArray &name, const GraphicsPipelineDescription &desc)
+{
+    QMutexLocker lock(&registryMutex);
+    for (const Registration &r : std::as_const(registry())) {
+        if (r.name == name) {
+            qWarning("Graphics pipeline %s is already registered", name.constData());
+            return;
+        }
+    }
+    registry().append({ name, desc });
+}
+
+/*!
+    \return the cache for \a rhi, creating it on first use.
+
+    Must be called on the thread \a rhi belongs to.
+ */
+QQuickRhiItemPipelineCache *QQuickRhiItemPipelineCache::get(QRhi *rhi)
+{
+    QMutexLocker lock(&cacheMutex);
+    QQuickRhiItemPipelineCache *&cache = caches[rhi];
+    if (!cache) {
+        cache = new QQuickRhiItemPipelineCache(rhi);
+        rhi->addCleanupCallback([](QRhi *rhi) {
+            QMutexLocker lock(&cacheMutex);
+            delete caches.take(rhi);
+        });
+    }
+    return cache;
+}
+
+QQuickRhiItemPipelineCache::QQuickRhiItemPipelineCache(QRhi *rhi)
+    : m_rhi(rhi)
+{
+}
+
+QQuickRhiItemPipelineCache::~QQuickRhiItemPipelineCache()
+{
+    for (const Entry &e : std::as_const(m_entries)) {
+        delete e.ps;
+        delete e.srb;
+        delete e.rp;
+    }
+
+    qCDebug(lcRhiItemPipelines, "Pipeline cache for QRhi %p destroyed: %d prewarmed in %.1f ms, "
+            "%llu hits, %llu misses built in %.1f ms",
+            m_rhi, m_stats.prewarmCount, m_stats.prewarmTime / 1000000.0,
+            m_stats.hits, m_stats.misses, m_stats.missTime / 1000000.0);
+}
+
+/*!
+    \return the graphics pipeline registered as \a name, for use with render
+    targets compatible with \a rp, building it if it is not in the cache yet.
+    Returns \nullptr when \a name is not registered or creating the pipeline
+    fails.
+ */
+QRhiGraphicsPipeline *QQuickRhiItemPipelineCache::graphicsPipeline(const QByteArray &name, QRhiRenderPassDescriptor *rp)
+{
+    for (const Entry &e : std::as_const(m_entries)) {
+        if (e.name == name && e.rp->isCompatible(rp)) {
+            ++m_stats.hits;
+            return e.ps;
+        }
+    }
+
+    GraphicsPipelineDescription desc;
+    {
+        QMutexLocker lock(&registryMutex);
+        auto it = std::find_if(registry().cbegin(), registry().cend(),
+                               [&name](const Registration &r) { return r.name == name; });
+        if (it == registry().cend()) {
+            qWarning("Graphics pipeline %s is not registered", name.constData());
+            return nullptr;
+        }
+        desc = it->desc;
+    }
+
+    // the renderer's descriptor may go away before the pipeline
+    QElapsedTimer timer;
+    timer.start();
+    QRhiGraphicsPipeline *ps = create(name, desc, rp->newCompatibleRenderPassDescriptor());
+    ++m_stats.misses;
+    m_stats.missTime += timer.nsecsElapsed();
+    return ps;
+}
+
+/*!
+    \return true when pipelines were registered since the last prewarm()
+    that did not get to them.
+ */
+bool QQuickRhiItemPipelineCache::needsPrewarm() const
+{
+    QMutexLocker lock(&registryMutex);
+    return m_prewarmed < registry().count();
+}
+
+/*!
+    Builds registered pipelines that are not in the cache yet, until \a
+    budget nanoseconds have passed, at least one.
+
+    \return true when all registered pipelines are built.
+ */
+bool QQuickRhiItemPipelineCache::prewarm(qint64 budget)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int count = 0;
+    bool done = false;
+    while (count == 0 || timer.nsecsElapsed() < budget) {
+        Registration r;
+        {
+            QMutexLocker lock(&registryMutex);
+            if (m_prewarmed >= registry().count()) {
+                done = true;
+                break;
+            }
+            r = registry().at(m_prewarmed++);
+        }
+
+        QRhiRenderPassDescriptor *rp = newRenderPassDescriptor(r.desc);
+        if (!rp)
+            continue;
+        // a renderer may have asked for it already
+        const bool cached = std::any_of(m_entries.cbegin(), m_entries.cend(), [&r, rp](const Entry &e) {
+            return e.name == r.name && e.rp->isCompatible(rp);
+        });
+        if (cached) {
+            delete rp;
+            continue;
+        }
+        if (create(r.name, r.desc, rp))
+            ++count;
+    }
+
+    if (count) {
+        m_stats.prewarmCount += count;
+        m_stats.prewarmTime += timer.nsecsElapsed();
+        qCDebug(lcRhiItemPipelines, "Prewarmed %d pipelines in %.1f ms", count, timer.nsecsElapsed() / 1000000.0);
+    }
+    return done;
+}
+
+QRhiGraphicsPipeline *QQuickRhiItemPipelineCache::create(const QByteArray &name, const GraphicsPipelineDescription &desc,
+                                                         QRhiRenderPassDescriptor *rp)
+{
+    QRhiShaderResourceBindings *srb = m_rhi->newShaderResourceBindings();
+    srb->setBindings(desc.bindingLayout.cbegin(), desc.bindingLayout.cend());
+    QRhiGraphicsPipeline *ps = m_rhi->newGraphicsPipeline();
+    desc.setup(m_rhi, ps);
+    ps->setShaderResourceBindings(srb);
+    ps->setRenderPassDescriptor(rp);
+    if (!srb->create() || !ps->create()) {
+        qWarning("Failed to create graphics pipeline %s", name.constData());
+        delete ps;
+        delete srb;
+        delete rp;
+        return nullptr;
+    }
+    m_entries.append({ name, ps, srb, rp });
+    return ps;
+}
+
+/*
+    A render pass descriptor for the render target format in desc. Only the
+    formats and sample counts matter, so the attachments are minimal, and
+    only live until the descriptor is created.
+ */
+QRhiRenderPassDescriptor *QQuickRhiItemPipelineCache::newRenderPassDescriptor(const GraphicsPipelineDescription &desc)
+{
+    const QSize size(1, 1);
+    QScopedPointer<QRhiTexture> texture(m_rhi->newTexture(desc.colorFormat, size, 1, QRhiTexture::RenderTarget));
+    QScopedPointer<QRhiRenderBuffer> color;
+    QScopedPointer<QRhiRenderBuffer> depthStencil;
+    if (!texture->create())
+        return nullptr;
+
+    QRhiColorAttachment attachment(texture.data());
+    if (desc.sampleCount > 1) {
+        color.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::Color, size, desc.sampleCount, {}, desc.colorFormat));
+        if (!color->create())
+            return nullptr;
+        attachment = QRhiColorAttachment(color.data());
+        attachment.setResolveTexture(texture.data());
+    }
+    QRhiTextureRenderTargetDescription rtDesc(attachment);
+    if (desc.depthStencil) {
+        depthStencil.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, size, desc.sampleCount));
+        if (!depthStencil->create())
+            return nullptr;
+        rtDesc.setDepthStencilBuffer(depthStencil.data());
+    }
+    QScopedPointer<QRhiTextureRenderTarget> rt(m_rhi->newTextureRenderTarget(rtDesc));
+    return rt->newCompatibleRenderPassDescriptor();
+}
@@ -0,0 +1,62 @@
+#ifndef RHIITEMPIPELINECACHE_H
+#define RHIITEMPIPELINECACHE_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <functional>
+
+class QQuickRhiItemPipelineCache
+{
+public:
+    struct GraphicsPipelineDescription {
+        // shaders, vertex input and states, everything but the shader
+        // resource bindings and the render pass descriptor
+        std::function<void(QRhi *rhi, QRhiGraphicsPipeline *ps)> setup;
+        // the layout, the resources can be nullptr
+        QList<QRhiShaderResourceBinding> bindingLayout;
+        // the render target the pipeline is used with
+        QRhiTexture::Format colorFormat = QRhiTexture::RGBA8;
+        bool depthStencil = false;
+        int sampleCount = 1;
+    };
+
+    struct Stats {
+        int prewarmCount = 0;
+        qint64 prewarmTime = 0;
+        quint64 hits = 0;
+        quint64 misses = 0;
+        qint64 missTime = 0;
+    };
+
+    static void registerGraphicsPipeline(const QByteArray &name, const GraphicsPipelineDescription &desc);
+
+    static QQuickRhiItemPipelineCache *get(QRhi *rhi);
+
+    QRhiGraphicsPipeline *graphicsPipeline(const QByteArray &name, QRhiRenderPassDescriptor *rp);
+
+    bool needsPrewarm() const;
+    bool prewarm(qint64 budget);
+
+    Stats stats() const { return m_stats; }
+
+private:
+    QQuickRhiItemPipelineCache(QRhi *rhi);
+    ~QQuickRhiItemPipelineCache();
+
+    struct Entry {
+        QByteArray name;
+        QRhiGraphicsPipeline *ps;
+        QRhiShaderResourceBindings *srb;
+        QRhiRenderPassDescriptor *rp;
+    };
+
+    QRhiGraphicsPipeline *create(const QByteArray &name, const GraphicsPipelineDescription &desc,
+                                 QRhiRenderPassDescriptor *rp);
+    QRhiRenderPassDescriptor *newRenderPassDescriptor(const GraphicsPipelineDescription &desc);
+
+    QRhi *m_rhi;
+    QList<Entry> m_entries;
+    int m_prewarmed = 0; // of the registered descriptions
+    Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,454 @@
+#include "rhiitemrendergraph.h"
+#include "rhiitemcapture.h"
+#include "rhiitemtexturepool.h"
+#include <algorithm>
+
+/*!
+    \class QQuickRhiItemRenderGraph
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Orders the passes of a multi-pass QQuickRhiItemRenderer and manages
+    their intermediate textures.
+
+    A renderer running, for example, a shadow, a G-buffer, a lighting and a
+    post-processing pass would otherwise have to create and resize each
+    intermediate texture, depth-stencil buffer and render target itself, and
+    keep all of them alive at the same time. With the render graph the
+    renderer only declares the transient resources and, for each pass, which
+    of them it reads and writes:
+
+    \code
+        void MyRenderer::initialize(QRhi *rhi, QRhiTexture *outputTexture)
+        {
+            if (!m_graph) {
+                m_graph.reset(new QQuickRhiItemRenderGraph);
+                const int color = m_graph->addTexture("color", QRhiTexture::RGBA16F);
+                const int depth = m_graph->addDepthStencil("depth");
+                m_graph->addPass({ "scene", {}, { color }, depth, Qt::black,
+                                   [this](QRhiRenderPassDescriptor *rp) { setupScene(rp); },
+                                   [this](QQuickRhiItemCommandRecorder &cb, const QSize &size) { drawScene(cb, size); } });
+                m_graph->addPass({ "tonemap", { color }, { QQuickRhiItemRenderGraph::Output }, -1, Qt::black,
+                                   [this, color](QRhiRenderPassDescriptor *rp) { setupTonemap(rp, m_graph->texture(color)); },
+                                   [this](QQuickRhiItemCommandRecorder &cb, const QSize &size) { drawTonemap(cb, size); } });
+            }
+            m_graph->initialize(rhi, outputTexture);
+        }
+
+        void MyRenderer::render(QRhiCommandBuffer *commandBuffer)
+        {
+            QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+            m_graph->render(cb, m_resourceUpdates);
+        }
+    \endcode
+
+    The passes are recorded through a QQuickRhiItemCommandRecorder, so they
+    are part of the frames captured by QQuickRhiItem::captureFrames().
+
+    The graph starts from the pass writing QQuickRhiItemRenderGraph::Output,
+    that is, the item's texture, and follows the inputs backwards. Passes that
+    do not contribute to the output are culled, the rest is executed in an
+    order where each pass comes after the ones producing its inputs. Each
+    resource must be written by exactly one pass.
+
+    Transient textures and depth-stencil buffers are sized relative to the
+    output, and taken from QQuickRhiItemTexturePool. Resources whose
+    lifetimes, from the first to the last pass using them, do not overlap,
+    and that have the same type, format, size and flags, share the same
+    QRhiTexture or QRhiRenderBuffer. QRhi does not expose memory aliasing
+    below the level of resources, so this is the granularity of the sharing.
+    The contents of transient resources are not preserved between passes
+    beyond the lifetime of the resource, each pass clears its outputs.
+
+    initialize() rebuilds the graph only when the size of the output
+    texture changes. When only its format or the texture object changes, as
+    with a recycled renderer, only the render targets of the passes writing
+    the output are updated, and only their setup functions are called.
+    The setup function of a pass is called after each rebuild of its render
+    target, and must (re)create the pipelines with the given render pass
+    descriptor, and the shader resource bindings referencing the textures of
+    the inputs. The render pass descriptors are kept as long as the output
+    format does not change, so pipelines usually do not need to be rebuilt on
+    resize. When a transient resource cannot be created, initialize() warns
+    and returns \c false, nothing is rendered until the next initialize().
+ */
+
+QQuickRhiItemRenderGraph::QQuickRhiItemRenderGraph()
+{
+    m_resources.append({ QByteArrayLiteral("output"), true, QRhiTexture::UnknownFormat, 1.0, {} });
+}
+
+QQuickRhiItemRenderGraph::~QQuickRhiItemRenderGraph()
+{
+    releaseRenderTargets();
+    releaseAllocations();
+}
+
+/*!
+    Declares a transient texture of \a format, sized \a scale times the size
+    of the output. \return the id of the resource.
+ */
+int QQuickRhiItemRenderGraph::addTexture(const QByteArray &name, QRhiTexture::Format format, qreal scale)
+{
+    m_resources.append({ name, true, format, scale, {} });
+    m_compiled = false;
+    return m_resources.count() - 1;
+}
+
+/*!
+    Declares a transient depth-stencil buffer, sized \a scale times the size
+    of the output. It can only be used as the depthStencil of passes, not as
+    an input. Shadow maps and other sampled depth data need a texture with a
+    depth format instead. \return the id of the resource.
+ */
+int QQuickRhiItemRenderGraph::addDepthStencil(const QByteArray &name, qreal scale)
+{
+    m_resources.append({ name, false, QRhiTexture::UnknownFormat, scale, {} });
+    m_compiled = false;
+    return m_resources.count() - 1;
+}
+
+/*!
+    Declares a pass. \return the id of the pass.
+ */
+int QQuickRhiItemRenderGraph::addPass(const PassDescription &pass)
+{
+    m_passes.append({ pass });
+    m_compiled = false;
+    return m_passes.count() - 1;
+}
+
+void QQuickRhiItemRenderGraph::setClearColor(int pass, const QColor &color)
+{
+    m_passes[pass].desc.clearColor = color;
+}
+
+bool QQuickRhiItemRenderGraph::compile()
+{
+    m_order.clear();
+    for (Resource &r : m_resources) {
+        r.writer = -1;
+        r.firstUse = -1;
+        r.lastUse = -1;
+        r.flags = {};
+    }
+
+    for (int p = 0; p < m_passes.count(); ++p) {
+        const PassDescription &desc(m_passes[p].desc);
+        QList<int> outputs = desc.colorOutputs;
+        if (desc.depthStencil >= 0)
+            outputs.append(desc.depthStencil);
+        for (int id : std::as_const(outputs)) {
+            Resource &r(m_resources[id]);
+            if (r.writer >= 0) {
+                qWarning("Render graph: %s is written by both %s and %s", r.name.constData(),
+                         m_passes[r.writer].desc.name.constData(), desc.name.constData());
+                return false;
+            }
+            r.writer = p;
+            if (r.isTexture)
+                r.flags |= QRhiTexture::RenderTarget;
+        }
+        for (int id : desc.inputs) {
+            if (id == Output || !m_resources[id].isTexture) {
+                qWarning("Render graph: %s cannot be read by %s", m_resources[id].name.constData(), desc.name.constData());
+                return false;
+            }
+        }
+    }
+
+    if (m_resources[Output].writer < 0) {
+        qWarning("Render graph: no pass writes the output");
+        return false;
+    }
+
+    // Depth-first from the pass producing the output. The post-order is a
+    // valid execution order, the passes not reached are culled.
+    enum { Unvisited, Visiting, Visited };
+    QList<int> state(m_passes.count(), Unvisited);
+    std::function<bool(int)> visit = [&](int p) {
+        if (state[p] == Visited)
+            return true;
+        if (state[p] == Visiting) {
+            qWarning("Render graph: cycle at %s", m_passes[p].desc.name.constData());
+            return false;
+        }
+        state[p] = Visiting;
+        for (int id : m_passes[p].desc.inputs) {
+            const int writer = m_resources[id].writer;
+            if (writer < 0) {
+                qWarning("Render graph: %s, read by %s, is never written", m_resources[id].name.constData(),
+                         m_passes[p].desc.name.constData());
+                return false;
+            }
+            if (!visit(writer))
+                return false;
+        }
+        state[p] = Visited;
+        m_order.append(p);
+        return true;
+    };
+    if (!visit(m_resources[Output].writer)) {
+        m_order.clear();
+        return false;
+    }
+
+    for (int i = 0; i < m_order.count(); ++i) {
+        const PassDescription &desc(m_passes[m_order[i]].desc);
+        auto use = [this, i](int id) {
+            Resource &r(m_resources[id]);
+            if (r.firstUse < 0)
+                r.firstUse = i;
+            r.lastUse = i;
+        };
+        for (int id : desc.inputs)
+            use(id);
+        for (int id : desc.colorOutputs)
+            use(id);
+        if (desc.depthStencil >= 0)
+            use(desc.depthStencil);
+    }
+
+    return true;
+}
+
+bool QQuickRhiItemRenderGraph::allocate()
+{
+    releaseAllocations();
+
+    QList<int> transients;
+    for (int id = Output + 1; id < m_resources.count(); ++id) {
+        if (m_resources[id].firstUse >= 0)
+            transients.append(id);
+    }
+    std::stable_sort(transients.begin(), transients.end(), [this](int a, int b) {
+        return m_resources[a].firstUse < m_resources[b].firstUse;
+    });
+
+    QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::get(m_rhi);
+    for (int id : std::as_const(transients)) {
+        Resource &r(m_resources[id]);
+        const QSize pixelSize(qMax(1, qRound(m_outputSize.width() * r.scale)),
+                              qMax(1, qRound(m_outputSize.height() * r.scale)));
+
+        // reuse an allocation whose previous user is done by now
+        for (int a = 0; a < m_allocations.count(); ++a) {
+            Allocation &alloc(m_allocations[a]);
+            if (alloc.lastUse < r.firstUse && alloc.isTexture == r.isTexture && alloc.format == r.format
+                    && alloc.pixelSize == pixelSize && alloc.flags == r.flags) {
+                alloc.lastUse = r.lastUse;
+                r.allocation = a;
+                break;
+            }
+        }
+        if (r.allocation >= 0)
+            continue;
+
+        QRhiResource *resource;
+        if (r.isTexture)
+            resource = pool->acquireTexture(r.format, pixelSize, r.flags);
+        else
+            resource = pool->acquireRenderBuffer(QRhiRenderBuffer::DepthStencil, pixelSize);
+        if (!resource) {
+            qWarning("Render graph: failed to create %s of size %dx%d", r.name.constData(),
+                     pixelSize.width(), pixelSize.height());
+            return false;
+        }
+        r.allocation = m_allocations.count();
+        m_allocations.append({ r.isTexture, r.format, pixelSize, r.flags, resource, r.lastUse });
+    }
+    return true;
+}
+
+void QQuickRhiItemRenderGraph::buildRenderTargets(bool newRenderPasses, bool outputOnly)
+{
+    for (int p : std::as_const(m_order)) {
+        Pass &pass(m_passes[p]);
+        if (outputOnly && pass.rt && !pass.desc.colorOutputs.contains(Output))
+            continue;
+        QList<QRhiColorAttachment> colors;
+        for (int id : std::as_const(pass.desc.colorOutputs))
+            colors.append(QRhiColorAttachment(texture(id)));
+        QRhiTextureRenderTargetDescription rtDesc;
+        rtDesc.setColorAttachments(colors.cbegin(), colors.cend());
+        if (pass.desc.depthStencil >= 0) {
+            if (m_resources[pass.desc.depthStencil].isTexture)
+                rtDesc.setDepthTexture(texture(pass.desc.depthStencil));
+            else
+                rtDesc.setDepthStencilBuffer(renderBuffer(pass.desc.depthStencil));
+        }
+
+        if (!pass.rt)
+            pass.rt = m_rhi->newTextureRenderTarget(rtDesc);
+        else
+            pass.rt->setDescription(rtDesc);
+        if (newRenderPasses || !pass.rp) {
+            delete pass.rp;
+            pass.rp = pass.rt->newCompatibleRenderPassDescriptor();
+        }
+        pass.rt->setRenderPassDescriptor(pass.rp);
+        if (!pass.rt->create())
+            qWarning("Render graph: failed to create the render target of %s", pass.desc.name.constData());
+
+        if (pass.desc.setup)
+            pass.desc.setup(pass.rp);
+    }
+}
+
+void QQuickRhiItemRenderGraph::releaseAllocations()
+{
+    if (m_allocations.isEmpty())
+        return;
+
+    // the pool may be gone already when the QRhi's cleanup deletes a
+    // recycled renderer owning this graph
+    QQuickRhiItemTexturePool *pool = QQuickRhiItemTexturePool::find(m_rhi);
+    for (const Allocation &alloc : std::as_const(m_allocations)) {
+        if (!pool)
+            delete alloc.resource;
+        else if (alloc.isTexture)
+            pool->releaseTexture(static_cast<QRhiTexture *>(alloc.resource));
+        else
+            pool->releaseRenderBuffer(static_cast<QRhiRenderBuffer *>(alloc.resource));
+    }
+    m_allocations.clear();
+    for (Resource &r : m_resources)
+        r.allocation = -1;
+}
+
+void QQuickRhiItemRenderGraph::releaseRenderTargets()
+{
+    for (Pass &pass : m_passes) {
+        delete pass.rt;
+        pass.rt = nullptr;
+        delete pass.rp;
+        pass.rp = nullptr;
+    }
+}
+
+/*!
+    Compiles the graph if needed, and (re)builds the resources and render
+    targets for \a outputTexture. Called from the renderer's initialize().
+
+    \return \c true when the graph was rebuilt, \c false when nothing changed
+    or the graph is invalid.
+ */
+bool QQuickRhiItemRenderGraph::initialize(QRhi *rhi, QRhiTexture *outputTexture)
+{
+    m_rhi = rhi;
+
+    bool newGraph = false;
+    if (!m_compiled) {
+        releaseRenderTargets();
+        releaseAllocations();
+        if (!compile())
+            return false;
+        m_compiled = true;
+        newGraph = true;
+    }
+
+    const bool formatChanged = outputTexture->format() != m_outputFormat;
+    const bool sizeChanged = outputTexture->pixelSize() != m_outputSize;
+    // by id, a texture created at the address of a deleted one is different
+    if (!newGraph && !formatChanged && !sizeChanged && outputTexture->globalResourceId() == m_outputId)
+        return false;
+
+    m_output = outputTexture;
+    m_outputId = outputTexture->globalResourceId();
+    m_outputFormat = outputTexture->format();
+    m_outputSize = outputTexture->pixelSize();
+    if ((newGraph || sizeChanged) && !allocate()) {
+        // nothing is rendered, the next initialize() starts over
+        releaseRenderTargets();
+        releaseAllocations();
+        m_order.clear();
+        m_compiled = false;
+        return false;
+    }
+    // the transient resources only change with the size, otherwise just
+    // the passes writing the output need new render targets
+    buildRenderTargets(newGraph || formatChanged, !newGraph && !sizeChanged);
+    ++m_rebuildCount;
+    return true;
+}
+
+/*!
+    Records the passes, in execution order, to \a cb. \a resourceUpdates, if
+    not null, is committed with the first pass.
+ */
+void QQuickRhiItemRenderGraph::render(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *resourceUpdates)
+{
+    QQuickRhiItemCommandRecorder recorder(cb, nullptr);
+    render(recorder, resourceUpdates);
+}
+
+/*!
+    \overload
+
+    Records the passes through \a cb, so that they become part of an active
+    QQuickRhiItemCapture, together with the commands of the record functions.
+ */
+void QQuickRhiItemRenderGraph::render(QQuickRhiItemCommandRecorder &cb, QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (m_order.isEmpty()) {
+        if (resourceUpdates)
+            resourceUpdates->release();
+        return;
+    }
+
+    for (int p : std::as_const(m_order)) {
+        Pass &pass(m_passes[p]);
+        cb.beginPass(pass.rt, pass.desc.clearColor, { 1.0f, 0 }, resourceUpdates);
+        resourceUpdates = nullptr;
+        if (pass.desc.record)
+            pass.desc.record(cb, pass.rt->pixelSize());
+        cb.endPass();
+    }
+}
+
+/*!
+    \return the texture for \a resource. Valid in the setup functions and
+    until the next rebuild.
+ */
+QRhiTexture *QQuickRhiItemRenderGraph::texture(int resource) const
+{
+    if (resource == Output)
+        return m_output;
+
+    const Resource &r(m_resources[resource]);
+    return r.isTexture && r.allocation >= 0 ? static_cast<QRhiTexture *>(m_allocations[r.allocation].resource) : nullptr;
+}
+
+QRhiRenderBuffer *QQuickRhiItemRenderGraph::renderBuffer(int resource) const
+{
+    const Resource &r(m_resources[resource]);
+    return !r.isTexture && r.allocation >= 0 ? static_cast<QRhiRenderBuffer *>(m_allocations[r.allocation].resource) : nullptr;
+}
+
+QSize QQuickRhiItemRenderGraph::pixelSize(int resource) const
+{
+    if (resource == Output)
+        return m_outputSize;
+
+    const Resource &r(m_resources[resource]);
+    return r.allocation >= 0 ? m_allocations[r.allocation].pixelSize : QSize();
+}
+
+/*!
+    \return the number of declared and culled passes, the number of transient
+    resources in use, and how many actual textures and renderbuffers they
+    needed after aliasing.
+ */
+QQuickRhiItemRenderGraph::Stats QQuickRhiItemRenderGraph::stats() const
+{
+    Stats s;
+    s.passCount = m_passes.count();
+    s.culledPassCount = m_compiled ? m_passes.count() - m_order.count() : 0;
+    for (int id = Output + 1; id < m_resources.count(); ++id) {
+        if (m_resources[id].firstUse >= 0)
+            ++s.transientCount;
+    }
+    s.allocatedCount = m_allocations.count();
+    s.rebuildCount = m_rebuildCount;
+    return s;
+}
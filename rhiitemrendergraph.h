@@ -0,0 +1,102 @@
+#ifndef RHIITEMRENDERGRAPH_H
+#define RHIITEMRENDERGRAPH_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QColor>
+#include <functional>
+
+class QQuickRhiItemCommandRecorder;
+
+class QQuickRhiItemRenderGraph
+{
+public:
+    struct PassDescription {
+        QByteArray name;
+        QList<int> inputs; // sampled in the pass
+        QList<int> colorOutputs;
+        int depthStencil = -1;
+        QColor clearColor = Qt::transparent;
+        // called after (re)building, with the textures of the inputs available via texture()
+        std::function<void(QRhiRenderPassDescriptor *rp)> setup;
+        // called between beginPass() and endPass()
+        std::function<void(QQuickRhiItemCommandRecorder &cb, const QSize &pixelSize)> record;
+    };
+
+    struct Stats {
+        int passCount = 0;
+        int culledPassCount = 0;
+        int transientCount = 0;
+        int allocatedCount = 0; // after aliasing
+        quint64 rebuildCount = 0;
+    };
+
+    // the output texture of the item
+    static const int Output = 0;
+
+    QQuickRhiItemRenderGraph();
+    ~QQuickRhiItemRenderGraph();
+
+    int addTexture(const QByteArray &name, QRhiTexture::Format format, qreal scale = 1.0);
+    int addDepthStencil(const QByteArray &name, qreal scale = 1.0);
+    int addPass(const PassDescription &pass);
+
+    void setClearColor(int pass, const QColor &color);
+
+    bool initialize(QRhi *rhi, QRhiTexture *outputTexture);
+    void render(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *resourceUpdates = nullptr);
+    void render(QQuickRhiItemCommandRecorder &cb, QRhiResourceUpdateBatch *resourceUpdates = nullptr);
+
+    QRhiTexture *texture(int resource) const;
+    QRhiRenderBuffer *renderBuffer(int resource) const;
+    QSize pixelSize(int resource) const;
+
+    Stats stats() const;
+
+private:
+    struct Resource {
+        QByteArray name;
+        bool isTexture;
+        QRhiTexture::Format format;
+        qreal scale;
+        QRhiTexture::Flags flags;
+        int writer = -1;
+        int firstUse = -1;
+        int lastUse = -1;
+        int allocation = -1;
+    };
+
+    struct Allocation {
+        bool isTexture;
+        QRhiTexture::Format format;
+        QSize pixelSize;
+        QRhiTexture::Flags flags;
+        QRhiResource *resource;
+        int lastUse;
+    };
+
+    struct Pass {
+        PassDescription desc;
+        QRhiTextureRenderTarget *rt = nullptr;
+        QRhiRenderPassDescriptor *rp = nullptr;
+    };
+
+    bool compile();
+    bool allocate();
+    void buildRenderTargets(bool newRenderPasses, bool outputOnly);
+    void releaseAllocations();
+    void releaseRenderTargets();
+
+    QRhi *m_rhi = nullptr;
+    QRhiTexture *m_output = nullptr;
+    quint64 m_outputId = 0;
+    QSize m_outputSize;
+    QRhiTexture::Format m_outputFormat = QRhiTexture::UnknownFormat;
+    QList<Resource> m_resources;
+    QList<Pass> m_passes;
+    QList<int> m_order; // the passes to execute, culled and sorted
+    QList<Allocation> m_allocations;
+    bool m_compiled = false;
+    quint64 m_rebuildCount = 0;
+};
+
+#endif
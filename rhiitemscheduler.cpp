@@ -0,0 +1,344 @@
+#include "rhiitemscheduler_p.h"
+#include "rhiitem_p.h"
+#include "rhiitempipelinecache.h"
+#include "rhiitemtexturepool.h"
+#include "rhiitemtrace_p.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QQuickWindow>
+#include <QSet>
+#include <QSGRendererInterface>
+#include <QThreadPool>
+#include <QTimer>
+#include <limits>
+
+/*
+    Per-window coordination of the QQuickRhiItem nodes on the render thread.
+
+    Once all items are synchronized, afterSynchronizing() starts the
+    renderers' prepare() for all nodes with a pending render on a thread
+    pool. Each node then waits for its own prepare() to finish in its
+    render(), so the command recording stays sequential while the CPU work
+    before it is spread over the available cores. The first renders can
+    begin while the prepare() of other nodes is still running.
+
+    The pool is shared by all windows. Its size defaults to the number of
+    cores and can be set with QSG_RHIITEM_PREPARE_THREADS.
+
+    Texture uploads scheduled by the renderers are queued here as well. The
+    first render() of each frame submits them, highest priority first, until
+    the per-frame budget is used up, and notifies the renderers. At least one
+    upload is submitted per frame, so larger ones are not starved. The budget
+    defaults to 4 MB and can be set with QSG_RHIITEM_UPLOAD_BUDGET, in bytes.
+    The remaining uploads are continued in the following frames, which need
+    no sync, so they drain in a static scene as well.
+
+    With QSG_RHIITEM_INIT_BUDGET set, as a count of items or as a time such
+    as "8ms", the nodes leave the first initialize() of their renderers to
+    afterSynchronizing() as well. The GUI thread is still blocked there, so
+    the items are safe to access. The pending ones are initialized visible
+    and largest first, until the per-frame budget is used up, at least one
+    per frame, and the rest in the following frames. These are requested by
+    updating the pending items, as a frame requested on the render thread
+    would not sync. Once all are done, the time since the first one was
+    requested, i.e. the time until the frame in which the page that caused
+    them is complete, is put into the stats of the window's items.
+
+    The pipelines registered with QQuickRhiItemPipelineCache are built in
+    the window's QRhi, until the prewarm budget of 4 ms, set with
+    QSG_RHIITEM_PREWARM_BUDGET in milliseconds, is used up. This starts when
+    the scenegraph is initialized, before the first frame, as the windows
+    get watched once a QQuickRhiItem is added to them, and continues after
+    each frame is submitted, so it only takes time the render thread would
+    otherwise spend waiting for the next vsync. Further frames are requested
+    until all are built, including the ones registered later on.
+
+    The window's QQuickRhiItemTexturePool is trimmed after each frame as
+    well. While it holds idle textures, a frame is requested for when they
+    expire, so that an application that stopped rendering still frees them.
+ */
+
+Q_LOGGING_CATEGORY(lcRhiItemInit, "qt.quick.rhiitem.init")
+
+static QMutex schedulerMutex;
+static QHash<QQuickWindow *, QQuickRhiItemFrameScheduler *> schedulers;
+static QSet<QQuickWindow *> watchedWindows;
+
+QQuickRhiItemFrameScheduler *QQuickRhiItemFrameScheduler::get(QQuickWindow *window)
+{
+    QMutexLocker lock(&schedulerMutex);
+    QQuickRhiItemFrameScheduler *&scheduler = schedulers[window];
+    if (!scheduler)
+        scheduler = new QQuickRhiItemFrameScheduler(window);
+    return scheduler;
+}
+
+/*
+    Creates the scheduler of \a window when its scenegraph is initialized,
+    and prewarms right away, so that the renderers of the first frame find
+    their pipelines. Called on the GUI thread when an item is added to the
+    window.
+ */
+void QQuickRhiItemFrameScheduler::watch(QQuickWindow *window)
+{
+    {
+        QMutexLocker lock(&schedulerMutex);
+        if (watchedWindows.contains(window))
+            return;
+        watchedWindows.insert(window);
+    }
+    connect(window, &QQuickWindow::sceneGraphInitialized, window, [window] {
+        get(window)->prewarm();
+    }, Qt::DirectConnection);
+    connect(window, &QObject::destroyed, window, [window] {
+        QMutexLocker lock(&schedulerMutex);
+        watchedWindows.remove(window);
+    }, Qt::DirectConnection);
+
+    // too late for the first frame, the scheduler takes over from the next
+    if (window->isSceneGraphInitialized()) {
+        get(window);
+        window->update();
+    }
+}
+
+QThreadPool *QQuickRhiItemFrameScheduler::threadPool()
+{
+    static QThreadPool *pool = [] {
+        QThreadPool *p = new QThreadPool;
+        p->setObjectName(QLatin1String("QQuickRhiItem prepare"));
+        const int threads = qEnvironmentVariableIntValue("QSG_RHIITEM_PREPARE_THREADS");
+        if (threads > 0)
+            p->setMaxThreadCount(threads);
+        return p;
+    }();
+    return pool;
+}
+
+QQuickRhiItemFrameScheduler::QQuickRhiItemFrameScheduler(QQuickWindow *window)
+    : m_window(window),
+      m_uploadBudget(4 * 1024 * 1024),
+      m_prewarmBudget(4000000)
+{
+    const quint64 budget = qEnvironmentVariable("QSG_RHIITEM_UPLOAD_BUDGET").toULongLong();
+    if (budget)
+        m_uploadBudget = budget;
+
+    const QByteArray initBudget = qgetenv("QSG_RHIITEM_INIT_BUDGET").trimmed();
+    if (initBudget.endsWith("ms"))
+        m_initBudgetTime = qint64(initBudget.chopped(2).toDouble() * 1000000);
+    else
+        m_initBudgetCount = initBudget.toInt();
+
+    const QByteArray prewarmBudget = qgetenv("QSG_RHIITEM_PREWARM_BUDGET");
+    if (!prewarmBudget.isEmpty())
+        m_prewarmBudget = qint64(prewarmBudget.toDouble() * 1000000);
+
+    connect(m_window, &QQuickWindow::afterSynchronizing, this, &QQuickRhiItemFrameScheduler::afterSynchronizing,
+            Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::afterFrameEnd, this, &QQuickRhiItemFrameScheduler::afterFrameEnd,
+            Qt::DirectConnection);
+    // the nodes are going away, as is the render thread potentially
+    connect(m_window, &QQuickWindow::sceneGraphInvalidated, this, [this] {
+        {
+            QMutexLocker lock(&schedulerMutex);
+            schedulers.remove(m_window);
+        }
+        delete this;
+    }, Qt::DirectConnection);
+}
+
+QQuickRhiItemFrameScheduler::~QQuickRhiItemFrameScheduler()
+{
+}
+
+void QQuickRhiItemFrameScheduler::registerNode(QQuickRhiItemNode *node)
+{
+    m_nodes.append(node);
+}
+
+void QQuickRhiItemFrameScheduler::unregisterNode(QQuickRhiItemNode *node)
+{
+    m_nodes.removeOne(node);
+    cancelUploads(node);
+    cancelInitialization(node);
+}
+
+static quint64 uploadSize(const QRhiTextureUploadDescription &desc)
+{
+    quint64 size = 0;
+    for (auto it = desc.cbeginEntries(); it != desc.cendEntries(); ++it) {
+        const QRhiTextureSubresourceUploadDescription &d(it->description());
+        size += d.image().isNull() ? quint64(d.data().size()) : quint64(d.image().sizeInBytes());
+    }
+    return size;
+}
+
+void QQuickRhiItemFrameScheduler::scheduleUpload(QQuickRhiItemNode *node, QRhiTexture *texture,
+                                                 const QRhiTextureUploadDescription &desc, int priority)
+{
+    auto it = std::find_if(m_uploads.begin(), m_uploads.end(),
+                           [priority](const Upload &u) { return u.priority < priority; });
+    m_uploads.insert(it, { node, texture, desc, uploadSize(desc), priority });
+    m_window->update();
+}
+
+void QQuickRhiItemFrameScheduler::cancelUploads(QQuickRhiItemNode *node, QRhiTexture *texture)
+{
+    m_uploads.removeIf([node, texture](const Upload &u) {
+        return u.node == node && (!texture || u.texture == texture);
+    });
+}
+
+void QQuickRhiItemFrameScheduler::submitUploads(QRhi *rhi, QRhiCommandBuffer *cb)
+{
+    m_uploadsSubmitted = true;
+
+    QQuickRhiItemTraceScope traceScope("uploadSubmit", QByteArrayLiteral("QQuickRhiItemFrameScheduler"));
+    QRhiResourceUpdateBatch *rub = rhi->nextResourceUpdateBatch();
+    QList<Upload> submitted;
+    quint64 bytes = 0;
+    while (!m_uploads.isEmpty()) {
+        if (!submitted.isEmpty() && bytes + m_uploads.first().byteSize > m_uploadBudget)
+            break;
+        const Upload u = m_uploads.takeFirst();
+        rub->uploadTexture(u.texture, u.desc);
+        bytes += u.byteSize;
+        submitted.append(u);
+    }
+    cb->resourceUpdate(rub);
+
+    // the uploads are recorded before any of the render passes that follow
+    // in this frame, so the textures are usable right away
+    for (const Upload &u : std::as_const(submitted))
+        u.node->textureUploaded(u.texture);
+
+    if (!m_uploads.isEmpty())
+        m_window->update();
+}
+
+void QQuickRhiItemFrameScheduler::requestInitialization(QQuickRhiItemNode *node, bool visible, qreal area)
+{
+    // called in each sync() of a pending node, with its current priority
+    if (!m_initBurstStart)
+        m_initBurstStart = QQuickRhiItemTrace::timestamp();
+    auto it = std::find_if(m_initializations.begin(), m_initializations.end(),
+                           [node](const Initialization &i) { return i.node == node; });
+    if (it != m_initializations.end())
+        *it = { node, visible, area };
+    else
+        m_initializations.append({ node, visible, area });
+}
+
+void QQuickRhiItemFrameScheduler::cancelInitialization(QQuickRhiItemNode *node)
+{
+    m_initializations.removeIf([node](const Initialization &i) { return i.node == node; });
+}
+
+void QQuickRhiItemFrameScheduler::runInitializations()
+{
+    QQuickRhiItemTraceScope traceScope("deferredInitialize", QByteArrayLiteral("QQuickRhiItemFrameScheduler"));
+    std::stable_sort(m_initializations.begin(), m_initializations.end(),
+                     [](const Initialization &a, const Initialization &b) {
+        if (a.visible != b.visible)
+            return a.visible;
+        return a.area > b.area;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    int count = 0;
+    while (!m_initializations.isEmpty()) {
+        if (count > 0 && ((m_initBudgetCount > 0 && count >= m_initBudgetCount)
+                          || (m_initBudgetTime > 0 && timer.nsecsElapsed() >= m_initBudgetTime))) {
+            break;
+        }
+        m_initializations.takeFirst().node->initializeDeferred();
+        ++count;
+    }
+    m_initBurstCount += count;
+    ++m_initBurstFrames;
+
+    if (!m_initializations.isEmpty()) {
+        // The pending nodes are only synchronized again when their items
+        // are dirty, and a frame requested here would be a repaint only.
+        for (const Initialization &i : std::as_const(m_initializations))
+            QMetaObject::invokeMethod(i.node->item(), &QQuickItem::update, Qt::QueuedConnection);
+        return;
+    }
+
+    const qint64 burstTime = QQuickRhiItemTrace::timestamp() - m_initBurstStart;
+    for (QQuickRhiItemNode *node : std::as_const(m_nodes))
+        node->stats().initializeBurstTime = burstTime;
+    qCDebug(lcRhiItemInit, "Initialized %d items over %d frames, %.1f ms until the last one",
+            m_initBurstCount, m_initBurstFrames, burstTime / 1000000.0);
+    m_initBurstStart = 0;
+    m_initBurstCount = 0;
+    m_initBurstFrames = 0;
+}
+
+void QQuickRhiItemFrameScheduler::afterSynchronizing()
+{
+    if (!m_initializations.isEmpty())
+        runInitializations();
+
+    QThreadPool *pool = threadPool();
+    for (QQuickRhiItemNode *node : std::as_const(m_nodes))
+        node->launchPrepare(pool);
+}
+
+void QQuickRhiItemFrameScheduler::afterFrameEnd()
+{
+    // Frames requested from the render thread, such as the ones continuing
+    // the uploads, are not preceded by a sync, so this is the only place
+    // that is reached once per frame.
+    m_uploadsSubmitted = false;
+
+    trimTexturePool();
+    prewarm();
+}
+
+void QQuickRhiItemFrameScheduler::trimTexturePool()
+{
+    QRhi *rhi = static_cast<QRhi *>(m_window->rendererInterface()->getResource(m_window, QSGRendererInterface::RhiResource));
+    QQuickRhiItemTexturePool *pool = rhi ? QQuickRhiItemTexturePool::find(rhi) : nullptr;
+    if (!pool)
+        return;
+
+    // the pool otherwise only trims itself when it is used
+    pool->trim();
+
+    // A window with nothing changing renders no more frames, so one is
+    // requested for when the remaining idle textures have expired. At most
+    // one request is outstanding per window.
+    if (!pool->stats().idleCount || pool->maxIdleTime() < 0)
+        return;
+    const qint64 delay = qint64(pool->maxIdleTime()) + 100;
+    const qint64 now = QQuickRhiItemTrace::timestamp();
+    if (delay > std::numeric_limits<int>::max() || now < m_trimFrameDue)
+        return;
+    m_trimFrameDue = now + delay * 1000000;
+    QQuickWindow *window = m_window;
+    QTimer::singleShot(int(delay), window, [window] { window->update(); });
+}
+
+void QQuickRhiItemFrameScheduler::prewarm()
+{
+    if (m_prewarmBudget <= 0)
+        return;
+
+    QRhi *rhi = static_cast<QRhi *>(m_window->rendererInterface()->getResource(m_window, QSGRendererInterface::RhiResource));
+    if (!rhi)
+        return;
+
+    // not latched, pipelines may be registered at any time
+    QQuickRhiItemPipelineCache *cache = QQuickRhiItemPipelineCache::get(rhi);
+    if (!cache->needsPrewarm())
+        return;
+
+    QQuickRhiItemTraceScope traceScope("pipelinePrewarm", QByteArrayLiteral("QQuickRhiItemFrameScheduler"));
+    if (!cache->prewarm(m_prewarmBudget))
+        m_window->update();
+}
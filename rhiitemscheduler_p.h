@@ -0,0 +1,76 @@
+#ifndef RHIITEMSCHEDULER_P_H
+#define RHIITEMSCHEDULER_P_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QObject>
+#include <QList>
+
+class QQuickWindow;
+class QQuickRhiItemNode;
+class QThreadPool;
+
+class QQuickRhiItemFrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QQuickRhiItemFrameScheduler *get(QQuickWindow *window);
+    static void watch(QQuickWindow *window);
+
+    void registerNode(QQuickRhiItemNode *node);
+    void unregisterNode(QQuickRhiItemNode *node);
+
+    static QThreadPool *threadPool();
+
+    void scheduleUpload(QQuickRhiItemNode *node, QRhiTexture *texture,
+                        const QRhiTextureUploadDescription &desc, int priority);
+    void cancelUploads(QQuickRhiItemNode *node, QRhiTexture *texture = nullptr);
+    bool needsUploadSubmit() const { return !m_uploadsSubmitted && !m_uploads.isEmpty(); }
+    void submitUploads(QRhi *rhi, QRhiCommandBuffer *cb);
+
+    bool hasInitializationBudget() const { return m_initBudgetCount > 0 || m_initBudgetTime > 0; }
+    void requestInitialization(QQuickRhiItemNode *node, bool visible, qreal area);
+    void cancelInitialization(QQuickRhiItemNode *node);
+
+private slots:
+    void afterSynchronizing();
+    void afterFrameEnd();
+
+private:
+    QQuickRhiItemFrameScheduler(QQuickWindow *window);
+    ~QQuickRhiItemFrameScheduler();
+
+    void runInitializations();
+    void prewarm();
+    void trimTexturePool();
+
+    struct Upload {
+        QQuickRhiItemNode *node;
+        QRhiTexture *texture;
+        QRhiTextureUploadDescription desc;
+        quint64 byteSize;
+        int priority;
+    };
+
+    struct Initialization {
+        QQuickRhiItemNode *node;
+        bool visible;
+        qreal area;
+    };
+
+    QQuickWindow *m_window;
+    QList<QQuickRhiItemNode *> m_nodes;
+    QList<Upload> m_uploads; // highest priority first, then in order
+    quint64 m_uploadBudget;
+    bool m_uploadsSubmitted = false;
+    QList<Initialization> m_initializations;
+    int m_initBudgetCount = 0;
+    qint64 m_initBudgetTime = 0;
+    qint64 m_initBurstStart = 0; // of the first pending initialization
+    int m_initBurstCount = 0;
+    int m_initBurstFrames = 0;
+    qint64 m_prewarmBudget;
+    qint64 m_trimFrameDue = 0; // of the frame requested for trimming the pool
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "rhiitemstreambuffer.h"
+#include <limits>
+
+/*!
+    \class QQuickRhiItemStreamBuffer
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief A GPU ring buffer for streaming data, such as the vertices of a
+    real-time plot, from a QQuickRhiItemRenderer.
+
+    Renderers that visualize a continuously growing data set should only
+    upload the data that is new in each frame, instead of re-uploading the
+    entire visible history. QQuickRhiItemStreamBuffer manages a device local
+    QRhiBuffer holding the last capacity() elements of a stream. append()
+    queues the upload of the new elements only, wrapping around at the end of
+    the ring.
+
+    Each element is stored twice, at its slot and at the slot plus capacity().
+    This way the last \c N elements, for any \c N up to capacity(), are always
+    available as one contiguous range in the buffer, starting at
+    firstElement(N). Drawing the visible window is therefore a single draw
+    call, even after the ring has wrapped around, at the expense of uploading
+    each element twice.
+
+    The uploads are recorded into the frame's command buffer, so the GPU
+    finishes reading the previous contents, as used by the frames still in
+    flight, before they are overwritten; QRhi inserts the necessary barriers.
+    Within a frame, the elements that get overwritten by an append() are
+    always older than the last capacity() elements, so a window of at most
+    capacity() elements drawn after the append() never refers to data that is
+    being replaced. When more than capacity() elements are appended at once,
+    only the last capacity() of them are uploaded.
+
+    \code
+        m_stream.reset(new QQuickRhiItemStreamBuffer(m_rhi, sizeof(float), 1000000));
+        m_stream->create();
+        ...
+        // in render()
+        QRhiResourceUpdateBatch *rub = m_rhi->nextResourceUpdateBatch();
+        m_stream->append(rub, newSamples.constData(), newSamples.count());
+        cb->beginPass(m_rt, Qt::black, { 1.0f, 0 }, rub);
+        ...
+        const quint32 n = m_stream->available();
+        const QRhiCommandBuffer::VertexInput vbufBinding(m_stream->buffer(), 0);
+        cb->setVertexInput(0, 1, &vbufBinding);
+        cb->draw(n, 1, m_stream->firstElement(n));
+    \endcode
+ */
+
+QQuickRhiItemStreamBuffer::QQuickRhiItemStreamBuffer(QRhi *rhi, quint32 elementSize, quint32 capacity,
+                                                     QRhiBuffer::UsageFlags usage)
+    : m_rhi(rhi),
+      m_usage(usage),
+      m_elementSize(elementSize),
+      m_capacity(capacity)
+{
+}
+
+QQuickRhiItemStreamBuffer::~QQuickRhiItemStreamBuffer()
+{
+    delete m_buffer;
+}
+
+/*!
+    Creates the underlying buffer, with a size of two times capacity()
+    elements. Returns \c false on failure, including when the capacity or the
+    element size is 0, or the buffer would exceed the 32-bit sizes of QRhi.
+ */
+bool QQuickRhiItemStreamBuffer::create()
+{
+    delete m_buffer;
+    m_buffer = nullptr;
+    m_count = 0;
+
+    // QRhiBuffer sizes are 32-bit
+    qsizetype size = 0;
+    if (qMulOverflow(qsizetype(m_capacity), qsizetype(m_elementSize), &size)
+            || qMulOverflow(size, qsizetype(2), &size)
+            || size <= 0 || size > qsizetype(std::numeric_limits<quint32>::max())) {
+        qWarning("Invalid QQuickRhiItemStreamBuffer of %u elements of %u bytes", m_capacity, m_elementSize);
+        return false;
+    }
+
+    m_buffer = m_rhi->newBuffer(QRhiBuffer::Static, m_usage, quint32(size));
+    if (!m_buffer->create()) {
+        qWarning("Failed to create QQuickRhiItemStreamBuffer of %u elements", m_capacity);
+        delete m_buffer;
+        m_buffer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void QQuickRhiItemStreamBuffer::write(QRhiResourceUpdateBatch *rub, quint32 slot, const char *data, quint32 elementCount)
+{
+    const quint32 size = elementCount * m_elementSize;
+    rub->uploadStaticBuffer(m_buffer, slot * m_elementSize, size, data);
+    rub->uploadStaticBuffer(m_buffer, (slot + m_capacity) * m_elementSize, size, data);
+}
+
+/*!
+    Queues the upload of \a elementCount elements from \a data into \a rub.
+
+    Only the new elements are uploaded, the previously appended ones stay in
+    place, apart from the oldest ones that fall out of the ring.
+ */
+void QQuickRhiItemStreamBuffer::append(QRhiResourceUpdateBatch *rub, const void *data, quint32 elementCount)
+{
+    if (!m_buffer || !elementCount)
+        return;
+
+    const char *p = static_cast<const char *>(data);
+    if (elementCount > m_capacity) {
+        // the older ones would be overwritten by the newer ones anyway
+        const quint32 skip = elementCount - m_capacity;
+        p += skip * m_elementSize;
+        m_count += skip;
+        elementCount = m_capacity;
+    }
+
+    const quint32 slot = quint32(m_count % m_capacity);
+    const quint32 untilWrap = qMin(elementCount, m_capacity - slot);
+    write(rub, slot, p, untilWrap);
+    if (untilWrap < elementCount)
+        write(rub, 0, p + untilWrap * m_elementSize, elementCount - untilWrap);
+
+    m_count += elementCount;
+}
+
+/*!
+    Forgets all previously appended elements, without touching the buffer.
+ */
+void QQuickRhiItemStreamBuffer::reset()
+{
+    m_count = 0;
+}
+
+/*!
+    \return the index of the first element of the contiguous range holding
+    the last \a windowSize elements. \a windowSize is clamped to available().
+ */
+quint32 QQuickRhiItemStreamBuffer::firstElement(quint32 windowSize) const
+{
+    windowSize = qMin(windowSize, available());
+    if (!windowSize)
+        return 0;
+
+    // the slot of the oldest element in the window, that is always followed
+    // by windowSize - 1 elements due to the mirrored second half
+    return quint32((m_count - windowSize) % m_capacity);
+}
@@ -0,0 +1,38 @@
+#ifndef RHIITEMSTREAMBUFFER_H
+#define RHIITEMSTREAMBUFFER_H
+
+#include <QtGui/private/qrhi_p.h>
+
+class QQuickRhiItemStreamBuffer
+{
+public:
+    QQuickRhiItemStreamBuffer(QRhi *rhi, quint32 elementSize, quint32 capacity,
+                              QRhiBuffer::UsageFlags usage = QRhiBuffer::VertexBuffer);
+    ~QQuickRhiItemStreamBuffer();
+
+    bool create();
+
+    QRhiBuffer *buffer() const { return m_buffer; }
+    quint32 elementSize() const { return m_elementSize; }
+    quint32 capacity() const { return m_capacity; }
+    quint64 count() const { return m_count; }
+    quint32 available() const { return quint32(qMin<quint64>(m_count, m_capacity)); }
+
+    void append(QRhiResourceUpdateBatch *rub, const void *data, quint32 elementCount);
+    void reset();
+
+    quint32 firstElement(quint32 windowSize) const;
+    quint32 firstElementOffset(quint32 windowSize) const { return firstElement(windowSize) * m_elementSize; }
+
+private:
+    void write(QRhiResourceUpdateBatch *rub, quint32 slot, const char *data, quint32 elementCount);
+
+    QRhi *m_rhi;
+    QRhiBuffer *m_buffer = nullptr;
+    QRhiBuffer::UsageFlags m_usage;
+    quint32 m_elementSize;
+    quint32 m_capacity;
+    quint64 m_count = 0;
+};
+
+#endif
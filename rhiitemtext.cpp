@@ -0,0 +1,491 @@
+#include "rhiitemtext.h"
+#include "rhiitemcapture.h"
+#include <QFile>
+#include <QFontMetricsF>
+#include <QGlyphRun>
+#include <QMutex>
+#include <QPainter>
+#include <QPainterPath>
+#include <QTextLayout>
+#include <QVarLengthArray>
+#include <QtMath>
+
+/*!
+    \class QQuickRhiItemGlyphAtlas
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief A distance field glyph atlas, shared by the QQuickRhiItemText
+    instances using the same QRhi.
+
+    Glyphs are rasterized on first use, at BASE_PIXEL_SIZE, into a signed
+    distance field, and stored in a single channel texture. The distance
+    field allows drawing the glyphs at any size, and under the perspective
+    transforms an item may be rendered with, while keeping the edges sharp.
+
+    Rasterizing a glyph happens only once per QRhi, so changing a text in the
+    common case only involves new vertex data. The new glyphs are uploaded by
+    commitUploads(). When the atlas is full, further glyphs are not drawn and
+    a warning is printed.
+
+    There is one atlas per QRhi, it is destroyed together with the QRhi.
+ */
+
+static const int ATLAS_SIZE = 1024;
+
+// the distance, in base size pixels, covered by the field around the outline
+static const int SPREAD = 4;
+
+// the glyph outline is rasterized at this many times the base size, and the
+// distance field sampled from that
+static const int OVERSAMPLE = 4;
+
+static QMutex atlasMutex;
+static QHash<QRhi *, QQuickRhiItemGlyphAtlas *> atlases;
+
+/*!
+    \return the atlas for \a rhi, creating it on first use.
+
+    Must be called on the thread \a rhi belongs to.
+ */
+QQuickRhiItemGlyphAtlas *QQuickRhiItemGlyphAtlas::get(QRhi *rhi)
+{
+    QMutexLocker lock(&atlasMutex);
+    QQuickRhiItemGlyphAtlas *&atlas = atlases[rhi];
+    if (!atlas) {
+        atlas = new QQuickRhiItemGlyphAtlas(rhi);
+        rhi->addCleanupCallback([](QRhi *rhi) {
+            QMutexLocker lock(&atlasMutex);
+            delete atlases.take(rhi);
+        });
+    }
+    return atlas;
+}
+
+QQuickRhiItemGlyphAtlas::QQuickRhiItemGlyphAtlas(QRhi *rhi)
+    : m_rhi(rhi)
+{
+    m_texture = m_rhi->newTexture(QRhiTexture::R8, QSize(ATLAS_SIZE, ATLAS_SIZE));
+    if (!m_texture->create())
+        qWarning("Failed to create glyph atlas texture");
+
+    // the areas between the glyphs must be outside of any outline when
+    // sampled with linear filtering
+    QImage empty(ATLAS_SIZE, ATLAS_SIZE, QImage::Format_Alpha8);
+    empty.fill(0);
+    m_pendingUploads.append(QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(empty)));
+}
+
+QQuickRhiItemGlyphAtlas::~QQuickRhiItemGlyphAtlas()
+{
+    delete m_texture;
+}
+
+// Squared Euclidean distance transform of one row or column, the algorithm
+// from Felzenszwalb and Huttenlocher: "Distance Transforms of Sampled
+// Functions". f is both the input and the output.
+static void distanceTransform(float *f, int count, int stride, float *d, int *v, float *z)
+{
+    const float inf = 1e20f;
+    int k = 0;
+    v[0] = 0;
+    z[0] = -inf;
+    z[1] = inf;
+    for (int q = 1; q < count; ++q) {
+        float s;
+        for (;;) {
+            const int p = v[k];
+            s = ((f[q * stride] + q * q) - (f[p * stride] + p * p)) / float(2 * q - 2 * p);
+            if (s > z[k])
+                break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = inf;
+    }
+    k = 0;
+    for (int q = 0; q < count; ++q) {
+        while (z[k + 1] < q)
+            ++k;
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k] * stride];
+    }
+    for (int q = 0; q < count; ++q)
+        f[q * stride] = d[q];
+}
+
+static void distanceTransform(QList<float> &f, int w, int h)
+{
+    const int n = qMax(w, h);
+    QVarLengthArray<float, 512> d(n);
+    QVarLengthArray<int, 512> v(n);
+    QVarLengthArray<float, 512> z(n + 1);
+    for (int x = 0; x < w; ++x)
+        distanceTransform(f.data() + x, h, w, d.data(), v.data(), z.data());
+    for (int y = 0; y < h; ++y)
+        distanceTransform(f.data() + y * w, w, 1, d.data(), v.data(), z.data());
+}
+
+static QImage distanceField(const QPainterPath &path, const QPointF &origin, const QSize &size)
+{
+    const int w = size.width() * OVERSAMPLE;
+    const int h = size.height() * OVERSAMPLE;
+    QImage mask(w, h, QImage::Format_Alpha8);
+    mask.fill(0);
+    QPainter p(&mask);
+    p.scale(OVERSAMPLE, OVERSAMPLE);
+    p.translate(-origin);
+    p.fillPath(path, Qt::black);
+    p.end();
+
+    // the distance to the closest pixel inside, and to the closest outside
+    const float inf = 1e20f;
+    QList<float> outside(w * h);
+    QList<float> inside(w * h);
+    for (int y = 0; y < h; ++y) {
+        const uchar *src = mask.constScanLine(y);
+        for (int x = 0; x < w; ++x) {
+            const bool in = src[x] > 127;
+            outside[y * w + x] = in ? 0.0f : inf;
+            inside[y * w + x] = in ? inf : 0.0f;
+        }
+    }
+    distanceTransform(outside, w, h);
+    distanceTransform(inside, w, h);
+
+    // 0.5 is the outline, larger values are inside
+    QImage result(size, QImage::Format_Alpha8);
+    for (int y = 0; y < size.height(); ++y) {
+        uchar *dst = result.scanLine(y);
+        const int sy = y * OVERSAMPLE + OVERSAMPLE / 2;
+        for (int x = 0; x < size.width(); ++x) {
+            const int i = sy * w + x * OVERSAMPLE + OVERSAMPLE / 2;
+            const float distance = (qSqrt(outside[i]) - qSqrt(inside[i])) / OVERSAMPLE;
+            const float value = qBound(0.0f, 0.5f - distance / (2 * SPREAD), 1.0f);
+            dst[x] = uchar(qRound(value * 255));
+        }
+    }
+    return result;
+}
+
+bool QQuickRhiItemGlyphAtlas::allocate(const QSize &size, QPoint *pos)
+{
+    // one pixel gap so that linear filtering never picks up the neighbor
+    if (m_shelfX + size.width() > ATLAS_SIZE) {
+        m_shelfY += m_shelfHeight + 1;
+        m_shelfX = 0;
+        m_shelfHeight = 0;
+    }
+    if (size.width() > ATLAS_SIZE || m_shelfY + size.height() > ATLAS_SIZE)
+        return false;
+
+    *pos = QPoint(m_shelfX, m_shelfY);
+    m_shelfX += size.width() + 1;
+    m_shelfHeight = qMax(m_shelfHeight, size.height());
+    return true;
+}
+
+/*!
+    \return the placement and the texture coordinates of the glyph
+    \a glyphIndex from \a font, rasterizing it if not yet in the atlas. The
+    returned rectangle is empty for glyphs without an outline, such as
+    spaces.
+ */
+QQuickRhiItemGlyphAtlas::Glyph QQuickRhiItemGlyphAtlas::glyph(const QRawFont &font, quint32 glyphIndex)
+{
+    const Key key { font.familyName() + QLatin1Char(' ') + font.styleName(), glyphIndex };
+    auto it = m_glyphs.constFind(key);
+    if (it != m_glyphs.cend())
+        return *it;
+
+    QRawFont baseFont(font);
+    baseFont.setPixelSize(BASE_PIXEL_SIZE);
+    const QPainterPath path = baseFont.pathForGlyph(glyphIndex);
+
+    Glyph g;
+    if (!path.isEmpty()) {
+        const QRectF br = path.boundingRect();
+        const QPoint origin(qFloor(br.x()) - SPREAD, qFloor(br.y()) - SPREAD);
+        const QSize size(qCeil(br.right()) + SPREAD - origin.x(), qCeil(br.bottom()) + SPREAD - origin.y());
+        QPoint pos;
+        if (allocate(size, &pos)) {
+            QRhiTextureSubresourceUploadDescription image(distanceField(path, origin, size));
+            image.setDestinationTopLeft(pos);
+            m_pendingUploads.append(QRhiTextureUploadEntry(0, 0, image));
+            g.rect = QRectF(origin, size);
+            g.texCoords = QRectF(pos.x() / qreal(ATLAS_SIZE), pos.y() / qreal(ATLAS_SIZE),
+                                 size.width() / qreal(ATLAS_SIZE), size.height() / qreal(ATLAS_SIZE));
+        } else if (!m_full) {
+            m_full = true;
+            qWarning("QQuickRhiItemGlyphAtlas is full, some glyphs will not be shown");
+        }
+    }
+
+    m_glyphs.insert(key, g);
+    return g;
+}
+
+/*!
+    Queues the upload of the glyphs rasterized since the last call into
+    \a rub. Must be called before drawing with glyphs that have not been
+    committed yet.
+ */
+void QQuickRhiItemGlyphAtlas::commitUploads(QRhiResourceUpdateBatch *rub)
+{
+    if (m_pendingUploads.isEmpty())
+        return;
+
+    QRhiTextureUploadDescription desc;
+    desc.setEntries(m_pendingUploads.cbegin(), m_pendingUploads.cend());
+    rub->uploadTexture(m_texture, desc);
+    m_pendingUploads.clear();
+}
+
+/*!
+    \class QQuickRhiItemText
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Draws text with the QRhi APIs from a QQuickRhiItemRenderer.
+
+    The glyphs come from the QQuickRhiItemGlyphAtlas of the QRhi, and are
+    drawn as textured quads with a distance field shader. Changing the text
+    therefore only updates a small vertex buffer, with 96 bytes per visible
+    glyph, instead of rasterizing and uploading an image. The text can be
+    drawn into any render target, including the texture of an item, and with
+    any transform, including the model-view-projection matrix of a 3D scene.
+
+    The text is laid out with QTextLayout, with \c{\n} starting a new line,
+    in a coordinate system with the origin at the top-left corner and the y
+    axis pointing down, in the pixel units of font(). matrix() maps this to
+    clip space.
+
+    \code
+        // in initialize()
+        m_text.reset(new QQuickRhiItemText(m_rhi));
+        m_text->create(m_rt->renderPassDescriptor());
+        QMatrix4x4 m = m_rhi->clipSpaceCorrMatrix();
+        m.ortho(0, outputSize.width(), outputSize.height(), 0, -1, 1);
+        m_text->setMatrix(m);
+        ...
+        // in synchronize()
+        m_text->setText(item->label());
+        ...
+        // in render()
+        m_text->prepare(rub);
+        cb->beginPass(m_rt, Qt::black, { 1.0f, 0 }, rub);
+        m_text->draw(cb, QRhiViewport(0, 0, outputSize.width(), outputSize.height()));
+        cb->endPass();
+    \endcode
+ */
+
+QQuickRhiItemText::QQuickRhiItemText(QRhi *rhi)
+    : m_rhi(rhi),
+      m_atlas(QQuickRhiItemGlyphAtlas::get(rhi))
+{
+}
+
+QQuickRhiItemText::~QQuickRhiItemText()
+{
+}
+
+void QQuickRhiItemText::setFont(const QFont &font)
+{
+    if (m_font == font)
+        return;
+
+    m_font = font;
+    m_verticesDirty = true;
+}
+
+void QQuickRhiItemText::setText(const QString &text)
+{
+    if (m_text == text)
+        return;
+
+    m_text = text;
+    m_verticesDirty = true;
+}
+
+void QQuickRhiItemText::setColor(const QColor &color)
+{
+    if (m_color == color)
+        return;
+
+    m_color = color;
+    m_uniformsDirty = true;
+}
+
+void QQuickRhiItemText::setMatrix(const QMatrix4x4 &matrix)
+{
+    if (m_matrix == matrix)
+        return;
+
+    m_matrix = matrix;
+    m_uniformsDirty = true;
+}
+
+static QShader getShader(const QString &name)
+{
+    QFile f(name);
+    if (f.open(QIODevice::ReadOnly))
+        return QShader::fromSerialized(f.readAll());
+
+    return QShader();
+}
+
+/*!
+    Creates the graphics resources for drawing in render passes compatible
+    with \a rp, with \a sampleCount samples. Returns \c false on failure.
+ */
+bool QQuickRhiItemText::create(QRhiRenderPassDescriptor *rp, int sampleCount)
+{
+    // matrix, color
+    m_ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, 80));
+    m_ubuf->create();
+    m_uniformsDirty = true;
+
+    m_sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+    m_sampler->create();
+
+    m_srb.reset(m_rhi->newShaderResourceBindings());
+    m_srb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, m_ubuf.data()),
+        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, m_atlas->texture(), m_sampler.data())
+    });
+    m_srb->create();
+
+    m_ps.reset(m_rhi->newGraphicsPipeline());
+    QRhiGraphicsPipeline::TargetBlend premulAlphaBlend;
+    premulAlphaBlend.enable = true;
+    m_ps->setTargetBlends({ premulAlphaBlend });
+    m_ps->setSampleCount(sampleCount);
+    QShader vs = getShader(QLatin1String(":/text.vert.qsb"));
+    Q_ASSERT(vs.isValid());
+    QShader fs = getShader(QLatin1String(":/text.frag.qsb"));
+    Q_ASSERT(fs.isValid());
+    m_ps->setShaderStages({
+        { QRhiShaderStage::Vertex, vs },
+        { QRhiShaderStage::Fragment, fs }
+    });
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({
+        { 4 * sizeof(float) }
+    });
+    inputLayout.setAttributes({
+        { 0, 0, QRhiVertexInputAttribute::Float2, 0 },
+        { 0, 1, QRhiVertexInputAttribute::Float2, 2 * sizeof(float) }
+    });
+    m_ps->setVertexInputLayout(inputLayout);
+    m_ps->setShaderResourceBindings(m_srb.data());
+    m_ps->setRenderPassDescriptor(rp);
+    return m_ps->create();
+}
+
+void QQuickRhiItemText::layout()
+{
+    m_vertices.clear();
+
+    QTextOption option;
+    option.setWrapMode(QTextOption::NoWrap);
+    qreal y = 0;
+    const QStringList lines = m_text.split(QLatin1Char('\n'));
+    for (const QString &text : lines) {
+        QTextLayout textLayout(text, m_font);
+        textLayout.setTextOption(option);
+        textLayout.beginLayout();
+        QTextLine line = textLayout.createLine();
+        if (line.isValid())
+            line.setPosition(QPointF(0, y));
+        textLayout.endLayout();
+        y += line.isValid() ? line.height() : QFontMetricsF(m_font).height();
+
+        const QList<QGlyphRun> runs = textLayout.glyphRuns();
+        for (const QGlyphRun &run : runs) {
+            const QRawFont rawFont = run.rawFont();
+            const qreal scale = rawFont.pixelSize() / QQuickRhiItemGlyphAtlas::BASE_PIXEL_SIZE;
+            const QList<quint32> indexes = run.glyphIndexes();
+            const QList<QPointF> positions = run.positions();
+            for (qsizetype i = 0; i < indexes.count(); ++i) {
+                const QQuickRhiItemGlyphAtlas::Glyph g = m_atlas->glyph(rawFont, indexes[i]);
+                if (g.rect.isEmpty())
+                    continue;
+
+                const QRectF r(positions[i] + g.rect.topLeft() * scale, g.rect.size() * scale);
+                const QRectF &t(g.texCoords);
+                const float quad[] = {
+                    float(r.left()), float(r.top()), float(t.left()), float(t.top()),
+                    float(r.left()), float(r.bottom()), float(t.left()), float(t.bottom()),
+                    float(r.right()), float(r.top()), float(t.right()), float(t.top()),
+                    float(r.right()), float(r.top()), float(t.right()), float(t.top()),
+                    float(r.left()), float(r.bottom()), float(t.left()), float(t.bottom()),
+                    float(r.right()), float(r.bottom()), float(t.right()), float(t.bottom())
+                };
+                m_vertices.append(quad, std::size(quad));
+            }
+        }
+    }
+}
+
+/*!
+    Queues the resource updates needed for draw() into \a rub: new glyphs in
+    the atlas, and the vertex and uniform data when the text, the font, the
+    color, or the matrix changed since the last call.
+ */
+void QQuickRhiItemText::prepare(QRhiResourceUpdateBatch *rub)
+{
+    if (m_verticesDirty) {
+        m_verticesDirty = false;
+        layout();
+        m_vertexCount = quint32(m_vertices.count() / 4);
+        const quint32 size = quint32(m_vertices.count() * sizeof(float));
+        if (size && (!m_vbuf || m_vbuf->size() < size)) {
+            m_vbuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, qNextPowerOfTwo(size)));
+            m_vbuf->create();
+        }
+        if (size)
+            rub->updateDynamicBuffer(m_vbuf.data(), 0, size, m_vertices.constData());
+    }
+
+    // the layout may have added new glyphs
+    m_atlas->commitUploads(rub);
+
+    if (m_uniformsDirty && m_ubuf) {
+        m_uniformsDirty = false;
+        rub->updateDynamicBuffer(m_ubuf.data(), 0, 64, m_matrix.constData());
+        const float color[4] = { float(m_color.redF() * m_color.alphaF()), float(m_color.greenF() * m_color.alphaF()),
+                                 float(m_color.blueF() * m_color.alphaF()), float(m_color.alphaF()) };
+        rub->updateDynamicBuffer(m_ubuf.data(), 64, 16, color);
+    }
+}
+
+/*!
+    Records the draw call for the text. Must be called within a render pass,
+    after the batch passed to prepare() has been submitted.
+ */
+void QQuickRhiItemText::draw(QRhiCommandBuffer *cb, const QRhiViewport &viewport)
+{
+    QQuickRhiItemCommandRecorder recorder(cb, nullptr);
+    draw(recorder, viewport);
+}
+
+/*!
+    \overload
+
+    Records the draw call through \a cb, so that it becomes part of an
+    active QQuickRhiItemCapture.
+ */
+void QQuickRhiItemText::draw(QQuickRhiItemCommandRecorder &cb, const QRhiViewport &viewport)
+{
+    if (!m_ps || !m_vertexCount)
+        return;
+
+    cb.setGraphicsPipeline(m_ps.data());
+    cb.setViewport(viewport);
+    cb.setShaderResources();
+    const QRhiCommandBuffer::VertexInput vbufBinding(m_vbuf.data(), 0);
+    cb.setVertexInput(0, 1, &vbufBinding);
+    cb.draw(m_vertexCount);
+}
@@ -0,0 +1,99 @@
+#ifndef RHIITEMTEXT_H
+#define RHIITEMTEXT_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QMatrix4x4>
+#include <QRawFont>
+
+class QQuickRhiItemCommandRecorder;
+
+class QQuickRhiItemGlyphAtlas
+{
+public:
+    struct Glyph {
+        QRectF rect; // relative to the pen position, in base size pixels
+        QRectF texCoords;
+    };
+
+    static const int BASE_PIXEL_SIZE = 32;
+
+    static QQuickRhiItemGlyphAtlas *get(QRhi *rhi);
+
+    QRhiTexture *texture() const { return m_texture; }
+
+    Glyph glyph(const QRawFont &font, quint32 glyphIndex);
+    void commitUploads(QRhiResourceUpdateBatch *rub);
+
+private:
+    QQuickRhiItemGlyphAtlas(QRhi *rhi);
+    ~QQuickRhiItemGlyphAtlas();
+
+    bool allocate(const QSize &size, QPoint *pos);
+
+    struct Key {
+        QString fontName;
+        quint32 glyphIndex;
+        bool operator==(const Key &other) const
+        {
+            return glyphIndex == other.glyphIndex && fontName == other.fontName;
+        }
+    };
+    friend size_t qHash(const Key &key, size_t seed) { return qHashMulti(seed, key.fontName, key.glyphIndex); }
+
+    QRhi *m_rhi;
+    QRhiTexture *m_texture = nullptr;
+    QHash<Key, Glyph> m_glyphs;
+    QList<QRhiTextureUploadEntry> m_pendingUploads;
+    bool m_full = false;
+    int m_shelfX = 0;
+    int m_shelfY = 0;
+    int m_shelfHeight = 0;
+};
+
+class QQuickRhiItemText
+{
+public:
+    QQuickRhiItemText(QRhi *rhi);
+    ~QQuickRhiItemText();
+
+    QFont font() const { return m_font; }
+    void setFont(const QFont &font);
+
+    QString text() const { return m_text; }
+    void setText(const QString &text);
+
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+
+    QMatrix4x4 matrix() const { return m_matrix; }
+    void setMatrix(const QMatrix4x4 &matrix);
+
+    bool create(QRhiRenderPassDescriptor *rp, int sampleCount = 1);
+    void prepare(QRhiResourceUpdateBatch *rub);
+    void draw(QRhiCommandBuffer *cb, const QRhiViewport &viewport);
+    void draw(QQuickRhiItemCommandRecorder &cb, const QRhiViewport &viewport);
+
+private:
+    void layout();
+
+    QRhi *m_rhi;
+    QQuickRhiItemGlyphAtlas *m_atlas;
+    QFont m_font;
+    QString m_text;
+    QColor m_color = Qt::white;
+    QMatrix4x4 m_matrix;
+    QList<float> m_vertices;
+    bool m_verticesDirty = true;
+    bool m_uniformsDirty = true;
+    quint32 m_vertexCount = 0;
+    QScopedPointer<QRhiBuffer> m_vbuf;
+    QScopedPointer<QRhiBuffer> m_ubuf;
+    QScopedPointer<QRhiSampler> m_sampler;
+    QScopedPointer<QRhiShaderResourceBindings> m_srb;
+    QScopedPointer<QRhiGraphicsPipeline> m_ps;
+};
+
+#endif
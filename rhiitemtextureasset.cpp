@@ -0,0 +1,803 @@
+#include "rhiitemtextureasset.h"
+#include <QtEndian>
+
+/*!
+    \class QQuickRhiItemTextureAsset
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Loads static textures for QQuickRhiItem renderers from KTX and
+    KTX2 files, in GPU block-compressed formats where supported.
+
+    Block-compressed formats, such as BC1 to BC7, ETC2 and ASTC, take 4 to 8
+    times less memory and sampling bandwidth than RGBA8, and the data is
+    uploaded as it is stored, with all its mip levels, without decoding into
+    a QImage first.
+
+    Which formats a QRhi supports depends on the graphics API and the GPU,
+    desktop GPUs typically have BC, mobile ones ETC2 and ASTC. Applications
+    therefore ship the same texture in several formats, and open() picks the
+    first of the given files whose format is reported as supported by
+    QRhi::isTextureFormatSupported(), so the list is in order of preference:
+
+    \code
+        m_asset.open(rhi, { ":/stone.astc.ktx2", ":/stone.bc7.ktx2", ":/stone.etc2.ktx" });
+        m_texture.reset(m_asset.newTexture(rhi));
+        m_texture->create();
+        scheduleTextureUpload(m_texture.data(), m_asset.uploadDescription());
+    \endcode
+
+    When none is supported, the first one in BC1 to BC5 or ETC2 format is
+    decoded on the CPU into RGBA8, in uploadDescription(). That does not
+    save GPU memory, but the texture looks the same on every GPU. BC6H, BC7
+    and ASTC are not decoded, a list for GPUs without any compressed
+    formats should end with one of the other formats, or an uncompressed
+    RGBA8 file.
+
+    The file is mapped into memory, and without decoding, the upload refers
+    to the mapping instead of copying it. The asset must therefore stay open
+    until the frame that submits the upload has ended, for example as a
+    member of the renderer next to the texture.
+
+    2D textures and cube maps are supported, not arrays or 3D textures, and
+    not supercompressed KTX2 files (Basis Universal or Zstandard). Setting
+    \c QSG_INFO prints the picked file and the memory saved compared to
+    RGBA8 for each asset that is opened.
+ */
+
+static const uchar KTX1_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const uchar KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const int KTX1_HEADER_SIZE = 64;
+static const int KTX2_HEADER_SIZE = 80;
+static const int KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+struct TextureFormat {
+    QRhiTexture::Format format;
+    bool srgb;
+    quint32 glInternalFormat; // KTX 1
+    quint32 vkFormat; // KTX2
+    const char *name;
+};
+
+// BC1 with and without punch-through alpha both map to QRhi's BC1, which
+// is RGB.
+static const TextureFormat FORMATS[] = {
+    { QRhiTexture::RGBA8, false, 0x8058, 37, "RGBA8" },
+    { QRhiTexture::RGBA8, true, 0x8C43, 43, "RGBA8" },
+    { QRhiTexture::RGBA8, false, 0x1908, 0, "RGBA8" }, // unsized GL_RGBA
+    { QRhiTexture::BGRA8, false, 0, 44, "BGRA8" },
+    { QRhiTexture::BGRA8, true, 0, 50, "BGRA8" },
+    { QRhiTexture::BC1, false, 0x83F0, 131, "BC1" },
+    { QRhiTexture::BC1, true, 0x8C4C, 132, "BC1" },
+    { QRhiTexture::BC1, false, 0x83F1, 133, "BC1" },
+    { QRhiTexture::BC1, true, 0x8C4D, 134, "BC1" },
+    { QRhiTexture::BC2, false, 0x83F2, 135, "BC2" },
+    { QRhiTexture::BC2, true, 0x8C4E, 136, "BC2" },
+    { QRhiTexture::BC3, false, 0x83F3, 137, "BC3" },
+    { QRhiTexture::BC3, true, 0x8C4F, 138, "BC3" },
+    { QRhiTexture::BC4, false, 0x8DBB, 139, "BC4" },
+    { QRhiTexture::BC5, false, 0x8DBD, 141, "BC5" },
+    { QRhiTexture::BC6H, false, 0x8E8F, 143, "BC6H" },
+    { QRhiTexture::BC7, false, 0x8E8C, 145, "BC7" },
+    { QRhiTexture::BC7, true, 0x8E8D, 146, "BC7" },
+    { QRhiTexture::ETC2_RGB8, false, 0x9274, 147, "ETC2_RGB8" },
+    { QRhiTexture::ETC2_RGB8, true, 0x9275, 148, "ETC2_RGB8" },
+    { QRhiTexture::ETC2_RGB8, false, 0x8D64, 0, "ETC1" },
+    { QRhiTexture::ETC2_RGB8A1, false, 0x9276, 149, "ETC2_RGB8A1" },
+    { QRhiTexture::ETC2_RGB8A1, true, 0x9277, 150, "ETC2_RGB8A1" },
+    { QRhiTexture::ETC2_RGBA8, false, 0x9278, 151, "ETC2_RGBA8" },
+    { QRhiTexture::ETC2_RGBA8, true, 0x9279, 152, "ETC2_RGBA8" },
+    { QRhiTexture::ASTC_4x4, false, 0x93B0, 157, "ASTC_4x4" },
+    { QRhiTexture::ASTC_4x4, true, 0x93D0, 158, "ASTC_4x4" },
+    { QRhiTexture::ASTC_5x4, false, 0x93B1, 159, "ASTC_5x4" },
+    { QRhiTexture::ASTC_5x4, true, 0x93D1, 160, "ASTC_5x4" },
+    { QRhiTexture::ASTC_5x5, false, 0x93B2, 161, "ASTC_5x5" },
+    { QRhiTexture::ASTC_5x5, true, 0x93D2, 162, "ASTC_5x5" },
+    { QRhiTexture::ASTC_6x5, false, 0x93B3, 163, "ASTC_6x5" },
+    { QRhiTexture::ASTC_6x5, true, 0x93D3, 164, "ASTC_6x5" },
+    { QRhiTexture::ASTC_6x6, false, 0x93B4, 165, "ASTC_6x6" },
+    { QRhiTexture::ASTC_6x6, true, 0x93D4, 166, "ASTC_6x6" },
+    { QRhiTexture::ASTC_8x5, false, 0x93B5, 167, "ASTC_8x5" },
+    { QRhiTexture::ASTC_8x5, true, 0x93D5, 168, "ASTC_8x5" },
+    { QRhiTexture::ASTC_8x6, false, 0x93B6, 169, "ASTC_8x6" },
+    { QRhiTexture::ASTC_8x6, true, 0x93D6, 170, "ASTC_8x6" },
+    { QRhiTexture::ASTC_8x8, false, 0x93B7, 171, "ASTC_8x8" },
+    { QRhiTexture::ASTC_8x8, true, 0x93D7, 172, "ASTC_8x8" },
+    { QRhiTexture::ASTC_10x5, false, 0x93B8, 173, "ASTC_10x5" },
+    { QRhiTexture::ASTC_10x5, true, 0x93D8, 174, "ASTC_10x5" },
+    { QRhiTexture::ASTC_10x6, false, 0x93B9, 175, "ASTC_10x6" },
+    { QRhiTexture::ASTC_10x6, true, 0x93D9, 176, "ASTC_10x6" },
+    { QRhiTexture::ASTC_10x8, false, 0x93BA, 177, "ASTC_10x8" },
+    { QRhiTexture::ASTC_10x8, true, 0x93DA, 178, "ASTC_10x8" },
+    { QRhiTexture::ASTC_10x10, false, 0x93BB, 179, "ASTC_10x10" },
+    { QRhiTexture::ASTC_10x10, true, 0x93DB, 180, "ASTC_10x10" },
+    { QRhiTexture::ASTC_12x10, false, 0x93BC, 181, "ASTC_12x10" },
+    { QRhiTexture::ASTC_12x10, true, 0x93DC, 182, "ASTC_12x10" },
+    { QRhiTexture::ASTC_12x12, false, 0x93BD, 183, "ASTC_12x12" },
+    { QRhiTexture::ASTC_12x12, true, 0x93DD, 184, "ASTC_12x12" },
+};
+
+static const char *formatName(QRhiTexture::Format format)
+{
+    for (const TextureFormat &f : FORMATS) {
+        if (f.format == format)
+            return f.name;
+    }
+    return "unknown";
+}
+
+static QSize blockSize(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::RGBA8:
+    case QRhiTexture::BGRA8:
+        return QSize(1, 1);
+    case QRhiTexture::ASTC_5x4:
+        return QSize(5, 4);
+    case QRhiTexture::ASTC_5x5:
+        return QSize(5, 5);
+    case QRhiTexture::ASTC_6x5:
+        return QSize(6, 5);
+    case QRhiTexture::ASTC_6x6:
+        return QSize(6, 6);
+    case QRhiTexture::ASTC_8x5:
+        return QSize(8, 5);
+    case QRhiTexture::ASTC_8x6:
+        return QSize(8, 6);
+    case QRhiTexture::ASTC_8x8:
+        return QSize(8, 8);
+    case QRhiTexture::ASTC_10x5:
+        return QSize(10, 5);
+    case QRhiTexture::ASTC_10x6:
+        return QSize(10, 6);
+    case QRhiTexture::ASTC_10x8:
+        return QSize(10, 8);
+    case QRhiTexture::ASTC_10x10:
+        return QSize(10, 10);
+    case QRhiTexture::ASTC_12x10:
+        return QSize(12, 10);
+    case QRhiTexture::ASTC_12x12:
+        return QSize(12, 12);
+    default:
+        return QSize(4, 4);
+    }
+}
+
+static int blockBytes(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::RGBA8:
+    case QRhiTexture::BGRA8:
+        return 4;
+    case QRhiTexture::BC1:
+    case QRhiTexture::BC4:
+    case QRhiTexture::ETC2_RGB8:
+    case QRhiTexture::ETC2_RGB8A1:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+static quint64 imageByteSize(QRhiTexture::Format format, const QSize &size)
+{
+    const QSize block = blockSize(format);
+    const quint64 columns = (size.width() + block.width() - 1) / block.width();
+    const quint64 rows = (size.height() + block.height() - 1) / block.height();
+    return columns * rows * blockBytes(format);
+}
+
+QQuickRhiItemTextureAsset::~QQuickRhiItemTextureAsset()
+{
+    close();
+}
+
+/*!
+    Opens \a fileName, a KTX or KTX2 file, and reads its headers. The
+    texture data is only read by uploadDescription().
+
+    \return false if the file cannot be opened, or its contents are not
+    supported.
+ */
+bool QQuickRhiItemTextureAsset::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open texture asset %s", qPrintable(fileName));
+        return false;
+    }
+    m_fileSize = m_file.size();
+    m_data = m_file.map(0, m_fileSize);
+    if (!m_data) {
+        // e.g. compressed resources
+        m_buffer = m_file.readAll();
+        m_data = reinterpret_cast<const uchar *>(m_buffer.constData());
+    }
+
+    bool ok = false;
+    if (m_fileSize >= KTX1_HEADER_SIZE && !memcmp(m_data, KTX1_IDENTIFIER, 12))
+        ok = parseKtx1();
+    else if (m_fileSize >= KTX2_HEADER_SIZE && !memcmp(m_data, KTX2_IDENTIFIER, 12))
+        ok = parseKtx2();
+    else
+        qWarning("%s is not a KTX file", qPrintable(fileName));
+
+    if (!ok) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Opens the first of \a fileNames whose format is supported by \a rhi. If
+    there is none, the first one that can be decoded on the CPU is opened,
+    and needsDecoding() returns true.
+ */
+bool QQuickRhiItemTextureAsset::open(QRhi *rhi, const QStringList &fileNames)
+{
+    QString decodable;
+    for (const QString &fileName : fileNames) {
+        if (!open(fileName))
+            continue;
+        const QRhiTexture::Flags flags = m_srgb ? QRhiTexture::sRGB : QRhiTexture::Flags();
+        if (rhi->isTextureFormatSupported(m_format, flags))
+            break;
+        if (decodable.isEmpty() && isDecodable(m_format))
+            decodable = fileName;
+        close();
+    }
+    if (!isOpen() && !decodable.isEmpty() && open(decodable))
+        m_decode = true;
+
+    if (!isOpen()) {
+        qWarning("None of the texture assets %s is usable", qPrintable(fileNames.join(QLatin1String(", "))));
+        return false;
+    }
+
+    if (qEnvironmentVariableIntValue("QSG_INFO")) {
+        qInfo("QQuickRhiItemTextureAsset: %s, %s%s, %dx%d, %d levels: %llu KB instead of %llu KB, saves %llu KB",
+              qPrintable(fileName()), formatName(m_format), m_decode ? " decoded to RGBA8" : "",
+              m_size.width(), m_size.height(), levelCount(), byteSize() / 1024, uncompressedByteSize() / 1024,
+              (uncompressedByteSize() - byteSize()) / 1024);
+    }
+    return true;
+}
+
+void QQuickRhiItemTextureAsset::close()
+{
+    if (m_data && m_buffer.isEmpty())
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_file.close();
+    m_buffer.clear();
+    m_data = nullptr;
+    m_fileSize = 0;
+    m_format = QRhiTexture::UnknownFormat;
+    m_srgb = false;
+    m_decode = false;
+    m_size = QSize();
+    m_faceCount = 1;
+    m_levelOffsets.clear();
+    m_faceSizes.clear();
+    m_faceStrides.clear();
+}
+
+bool QQuickRhiItemTextureAsset::parseKtx1()
+{
+    // the writer's endianness, the compressed data is not affected
+    const bool swap = qFromLittleEndian<quint32>(m_data + 12) != 0x04030201;
+    auto field = [this, swap](int index) {
+        const quint32 v = qFromLittleEndian<quint32>(m_data + 12 + index * 4);
+        return swap ? qbswap(v) : v;
+    };
+    const quint32 glInternalFormat = field(4);
+    const QSize size(field(6), field(7));
+    const quint32 depth = field(8);
+    const quint32 arrayElements = field(9);
+    const quint32 faces = field(10);
+    const int levels = qMax<quint32>(1, field(11));
+    const quint32 keyValueBytes = field(12);
+
+    const TextureFormat *format = nullptr;
+    for (const TextureFormat &f : FORMATS) {
+        if (f.glInternalFormat && f.glInternalFormat == glInternalFormat)
+            format = &f;
+    }
+    if (!format) {
+        qWarning("Unsupported format 0x%x in %s", glInternalFormat, qPrintable(fileName()));
+        return false;
+    }
+    if (size.isEmpty() || depth > 1 || arrayElements || (faces != 1 && faces != 6) || levels > 32) {
+        qWarning("Only 2D textures and cube maps are supported, %s is not one", qPrintable(fileName()));
+        return false;
+    }
+    m_format = format->format;
+    m_srgb = format->srgb;
+    m_size = size;
+    m_faceCount = faces;
+
+    // per level: the image size of one face, then the faces, each padded to
+    // 4 bytes
+    qint64 offset = KTX1_HEADER_SIZE + qint64(keyValueBytes);
+    for (int level = 0; level < levels; ++level) {
+        if (offset + 4 > m_fileSize)
+            break;
+        quint32 faceSize = qFromLittleEndian<quint32>(m_data + offset);
+        if (swap)
+            faceSize = qbswap(faceSize);
+        const qint64 stride = (qint64(faceSize) + 3) & ~qint64(3);
+        if (faceSize < imageByteSize(m_format, levelSize(level)) || offset + 4 + stride * faces > m_fileSize)
+            break;
+        m_levelOffsets.append(offset + 4);
+        m_faceSizes.append(faceSize);
+        m_faceStrides.append(stride);
+        offset += 4 + stride * faces;
+    }
+    if (m_levelOffsets.count() != levels) {
+        qWarning("Truncated or corrupt KTX file %s", qPrintable(fileName()));
+        return false;
+    }
+    return true;
+}
+
+bool QQuickRhiItemTextureAsset::parseKtx2()
+{
+    auto field = [this](int index) {
+        return qFromLittleEndian<quint32>(m_data + 12 + index * 4);
+    };
+    const quint32 vkFormat = field(0);
+    const QSize size(field(2), field(3));
+    const quint32 depth = field(4);
+    const quint32 layers = field(5);
+    const quint32 faces = field(6);
+    const int levels = qMax<quint32>(1, field(7));
+    const quint32 supercompression = field(8);
+
+    const TextureFormat *format = nullptr;
+    for (const TextureFormat &f : FORMATS) {
+        if (f.vkFormat && f.vkFormat == vkFormat)
+            format = &f;
+    }
+    if (!format || supercompression) {
+        qWarning("Unsupported format %u or supercompression %u in %s", vkFormat, supercompression, qPrintable(fileName()));
+        return false;
+    }
+    if (size.isEmpty() || depth > 1 || layers || (faces != 1 && faces != 6) || levels > 32
+            || KTX2_HEADER_SIZE + qint64(levels) * KTX2_LEVEL_INDEX_ENTRY_SIZE > m_fileSize) {
+        qWarning("Only 2D textures and cube maps are supported, %s is not one", qPrintable(fileName()));
+        return false;
+    }
+    m_format = format->format;
+    m_srgb = format->srgb;
+    m_size = size;
+    m_faceCount = faces;
+
+    // the index has level 0 first, the faces are consecutive in each level
+    for (int level = 0; level < levels; ++level) {
+        const uchar *entry = m_data + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        const qint64 offset = qFromLittleEndian<quint64>(entry);
+        const qint64 length = qFromLittleEndian<quint64>(entry + 8);
+        const qint64 faceSize = length / faces;
+        if (offset < 0 || length < 0 || offset > m_fileSize || length > m_fileSize - offset
+                || quint64(faceSize) < imageByteSize(m_format, levelSize(level))) {
+            qWarning("Truncated or corrupt KTX2 file %s", qPrintable(fileName()));
+            return false;
+        }
+        m_levelOffsets.append(offset);
+        m_faceSizes.append(faceSize);
+        m_faceStrides.append(faceSize);
+    }
+    return true;
+}
+
+QSize QQuickRhiItemTextureAsset::levelSize(int level) const
+{
+    return QSize(qMax(1, m_size.width() >> level), qMax(1, m_size.height() >> level));
+}
+
+/*!
+    \return a new, not yet created, texture for the asset, with \a flags,
+    plus the ones needed for its mip levels, sRGB and cube maps.
+ */
+QRhiTexture *QQuickRhiItemTextureAsset::newTexture(QRhi *rhi, QRhiTexture::Flags flags) const
+{
+    if (levelCount() > 1)
+        flags |= QRhiTexture::MipMapped;
+    if (m_srgb)
+        flags |= QRhiTexture::sRGB;
+    if (isCubeMap())
+        flags |= QRhiTexture::CubeMap;
+    return rhi->newTexture(textureFormat(), m_size, 1, flags);
+}
+
+/*!
+    \return the upload of all faces and mip levels of the asset. Without
+    decoding, the data refers to the file mapping, so the asset must stay
+    open until the upload is submitted and the frame has ended.
+
+    Only the file is read, so this can be called on any thread, e.g. in
+    QQuickRhiItemRenderer::prepare() when decoding is needed.
+ */
+QRhiTextureUploadDescription QQuickRhiItemTextureAsset::uploadDescription() const
+{
+    QList<QRhiTextureUploadEntry> entries;
+    for (int level = 0; level < levelCount(); ++level) {
+        for (int face = 0; face < m_faceCount; ++face) {
+            const uchar *data = m_data + m_levelOffsets[level] + face * m_faceStrides[level];
+            QByteArray bytes;
+            if (m_decode) {
+                bytes = decode(m_format, levelSize(level), data);
+            } else {
+                const qint64 size = imageByteSize(m_format, levelSize(level));
+                bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+            }
+            entries.append(QRhiTextureUploadEntry(face, level, QRhiTextureSubresourceUploadDescription(bytes)));
+        }
+    }
+    QRhiTextureUploadDescription desc;
+    desc.setEntries(entries.cbegin(), entries.cend());
+    return desc;
+}
+
+/*!
+    \return the size of the texture on the GPU, i.e. in RGBA8 when decoded
+ */
+quint64 QQuickRhiItemTextureAsset::byteSize() const
+{
+    if (m_decode)
+        return uncompressedByteSize();
+    quint64 size = 0;
+    for (int level = 0; level < levelCount(); ++level)
+        size += imageByteSize(m_format, levelSize(level)) * m_faceCount;
+    return size;
+}
+
+/*!
+    \return the size the texture would have in RGBA8
+ */
+quint64 QQuickRhiItemTextureAsset::uncompressedByteSize() const
+{
+    quint64 size = 0;
+    for (int level = 0; level < levelCount(); ++level)
+        size += imageByteSize(QRhiTexture::RGBA8, levelSize(level)) * m_faceCount;
+    return size;
+}
+
+bool QQuickRhiItemTextureAsset::isCompressed(QRhiTexture::Format format)
+{
+    return format >= QRhiTexture::BC1 && format <= QRhiTexture::ASTC_12x12;
+}
+
+bool QQuickRhiItemTextureAsset::isDecodable(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::BC1:
+    case QRhiTexture::BC2:
+    case QRhiTexture::BC3:
+    case QRhiTexture::BC4:
+    case QRhiTexture::BC5:
+    case QRhiTexture::ETC2_RGB8:
+    case QRhiTexture::ETC2_RGB8A1:
+    case QRhiTexture::ETC2_RGBA8:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Block decoders, each writing a 4x4 block of RGBA8 pixels, with a stride of
+// 4 pixels.
+
+static void decodeBc1(const uchar *block, uchar *out, bool alwaysFourColors)
+{
+    const quint16 c0 = qFromLittleEndian<quint16>(block);
+    const quint16 c1 = qFromLittleEndian<quint16>(block + 2);
+    const quint32 indices = qFromLittleEndian<quint32>(block + 4);
+
+    int colors[4][3];
+    for (int i = 0; i < 2; ++i) {
+        const quint16 c = i ? c1 : c0;
+        colors[i][0] = ((c >> 11) & 0x1F) * 255 / 31;
+        colors[i][1] = ((c >> 5) & 0x3F) * 255 / 63;
+        colors[i][2] = (c & 0x1F) * 255 / 31;
+    }
+    // QRhi's BC1 is RGB, the fourth color of the three-color mode is black
+    for (int ch = 0; ch < 3; ++ch) {
+        if (c0 > c1 || alwaysFourColors) {
+            colors[2][ch] = (2 * colors[0][ch] + colors[1][ch]) / 3;
+            colors[3][ch] = (colors[0][ch] + 2 * colors[1][ch]) / 3;
+        } else {
+            colors[2][ch] = (colors[0][ch] + colors[1][ch]) / 2;
+            colors[3][ch] = 0;
+        }
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        const int *c = colors[(indices >> (2 * i)) & 3];
+        uchar *p = out + i * 4;
+        p[0] = c[0];
+        p[1] = c[1];
+        p[2] = c[2];
+        p[3] = 255;
+    }
+}
+
+// BC4 and the alpha of BC3, into channel 0 of \a out
+static void decodeBc4(const uchar *block, uchar *out)
+{
+    const int a0 = block[0];
+    const int a1 = block[1];
+    int values[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (int i = 1; i < 7; ++i)
+            values[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; ++i)
+            values[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    quint64 indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= quint64(block[2 + i]) << (8 * i);
+    for (int i = 0; i < 16; ++i)
+        out[i * 4] = values[(indices >> (3 * i)) & 7];
+}
+
+static const int ETC_MODIFIERS[8][4] = {
+    { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 }
+};
+
+static const int ETC_DISTANCES[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static inline uchar clampByte(int v)
+{
+    return uchar(qBound(0, v, 255));
+}
+
+static inline int extend4(int v) { return v * 17; }
+static inline int extend5(int v) { return (v << 3) | (v >> 2); }
+static inline int extend6(int v) { return (v << 2) | (v >> 4); }
+static inline int extend7(int v) { return (v << 1) | (v >> 6); }
+
+// ETC1 and ETC2 RGB, with \a punchThrough for ETC2_RGB8A1
+static void decodeEtc2(const uchar *block, uchar *out, bool punchThrough)
+{
+    const quint32 hi = qFromBigEndian<quint32>(block);
+    const quint32 lo = qFromBigEndian<quint32>(block + 4);
+    const bool diff = punchThrough || (hi & 2);
+    const bool opaque = !punchThrough || (hi & 2);
+    const bool flip = hi & 1;
+
+    auto pixelIndex = [lo](int x, int y) {
+        const int k = x * 4 + y;
+        return int(((lo >> (k + 16)) & 1) << 1 | ((lo >> k) & 1));
+    };
+    auto write = [out](int x, int y, int r, int g, int b, int a) {
+        uchar *p = out + (y * 4 + x) * 4;
+        p[0] = clampByte(r);
+        p[1] = clampByte(g);
+        p[2] = clampByte(b);
+        p[3] = a;
+    };
+
+    int base[2][3];
+    if (!diff) {
+        for (int ch = 0; ch < 3; ++ch) {
+            base[0][ch] = extend4((hi >> (28 - ch * 8)) & 0xF);
+            base[1][ch] = extend4((hi >> (24 - ch * 8)) & 0xF);
+        }
+    } else {
+        int c[3], d[3], c2[3];
+        for (int ch = 0; ch < 3; ++ch) {
+            c[ch] = (hi >> (27 - ch * 8)) & 0x1F;
+            d[ch] = (hi >> (24 - ch * 8)) & 0x7;
+            if (d[ch] >= 4)
+                d[ch] -= 8;
+            c2[ch] = c[ch] + d[ch];
+        }
+
+        if (c2[0] < 0 || c2[0] > 31) {
+            // T mode
+            const int r1 = ((hi >> 27) & 0x3) << 2 | ((hi >> 24) & 0x3);
+            const int c1[3] = { extend4(r1), extend4((hi >> 20) & 0xF), extend4((hi >> 16) & 0xF) };
+            const int cb[3] = { extend4((hi >> 12) & 0xF), extend4((hi >> 8) & 0xF), extend4((hi >> 4) & 0xF) };
+            const int dist = ETC_DISTANCES[((hi >> 2) & 0x3) << 1 | (hi & 1)];
+            const int paint[4][3] = {
+                { c1[0], c1[1], c1[2] },
+                { cb[0] + dist, cb[1] + dist, cb[2] + dist },
+                { cb[0], cb[1], cb[2] },
+                { cb[0] - dist, cb[1] - dist, cb[2] - dist }
+            };
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    const int i = pixelIndex(x, y);
+                    if (!opaque && i == 2)
+                        write(x, y, 0, 0, 0, 0);
+                    else
+                        write(x, y, paint[i][0], paint[i][1], paint[i][2], 255);
+                }
+            }
+            return;
+        }
+
+        if (c2[1] < 0 || c2[1] > 31) {
+            // H mode
+            const int r1 = (hi >> 27) & 0xF;
+            const int g1 = ((hi >> 24) & 0x7) << 1 | ((hi >> 20) & 1);
+            const int b1 = ((hi >> 19) & 1) << 3 | ((hi >> 15) & 0x7);
+            const int r2 = (hi >> 11) & 0xF;
+            const int g2 = (hi >> 7) & 0xF;
+            const int b2 = (hi >> 3) & 0xF;
+            const int ordering = ((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2) ? 1 : 0;
+            const int dist = ETC_DISTANCES[((hi >> 2) & 1) << 2 | (hi & 1) << 1 | ordering];
+            const int ca[3] = { extend4(r1), extend4(g1), extend4(b1) };
+            const int cb[3] = { extend4(r2), extend4(g2), extend4(b2) };
+            const int paint[4][3] = {
+                { ca[0] + dist, ca[1] + dist, ca[2] + dist },
+                { ca[0] - dist, ca[1] - dist, ca[2] - dist },
+                { cb[0] + dist, cb[1] + dist, cb[2] + dist },
+                { cb[0] - dist, cb[1] - dist, cb[2] - dist }
+            };
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    const int i = pixelIndex(x, y);
+                    if (!opaque && i == 2)
+                        write(x, y, 0, 0, 0, 0);
+                    else
+                        write(x, y, paint[i][0], paint[i][1], paint[i][2], 255);
+                }
+            }
+            return;
+        }
+
+        if (c2[2] < 0 || c2[2] > 31) {
+            // planar mode, always opaque
+            const int o[3] = {
+                extend6((hi >> 25) & 0x3F),
+                extend7(((hi >> 24) & 1) << 6 | ((hi >> 17) & 0x3F)),
+                extend6(((hi >> 16) & 1) << 5 | ((hi >> 11) & 0x3) << 3 | ((hi >> 7) & 0x7))
+            };
+            const int h[3] = {
+                extend6(((hi >> 2) & 0x1F) << 1 | (hi & 1)),
+                extend7((lo >> 25) & 0x7F),
+                extend6((lo >> 19) & 0x3F)
+            };
+            const int v[3] = {
+                extend6((lo >> 13) & 0x3F),
+                extend7((lo >> 6) & 0x7F),
+                extend6(lo & 0x3F)
+            };
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    int c[3];
+                    for (int ch = 0; ch < 3; ++ch)
+                        c[ch] = (x * (h[ch] - o[ch]) + y * (v[ch] - o[ch]) + 4 * o[ch] + 2) >> 2;
+                    write(x, y, c[0], c[1], c[2], 255);
+                }
+            }
+            return;
+        }
+
+        for (int ch = 0; ch < 3; ++ch) {
+            base[0][ch] = extend5(c[ch]);
+            base[1][ch] = extend5(c2[ch]);
+        }
+    }
+
+    // individual or differential mode, two sub-blocks of 2x4 or 4x2
+    const int tables[2] = { int((hi >> 5) & 0x7), int((hi >> 2) & 0x7) };
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            const int sub = flip ? (y >= 2) : (x >= 2);
+            const int i = pixelIndex(x, y);
+            if (!opaque && i == 2) {
+                write(x, y, 0, 0, 0, 0);
+                continue;
+            }
+            // without the opaque bit, the smaller modifiers are 0
+            const int m = !opaque && (i & 1) == 0 ? 0 : ETC_MODIFIERS[tables[sub]][i];
+            write(x, y, base[sub][0] + m, base[sub][1] + m, base[sub][2] + m, 255);
+        }
+    }
+}
+
+static const int EAC_MODIFIERS[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+// the alpha of ETC2_RGBA8, into channel 3 of \a out
+static void decodeEac(const uchar *block, uchar *out)
+{
+    const int base = block[0];
+    const int multiplier = block[1] >> 4;
+    const int *modifiers = EAC_MODIFIERS[block[1] & 0xF];
+    quint64 indices = 0;
+    for (int i = 2; i < 8; ++i)
+        indices = indices << 8 | block[i];
+    for (int x = 0; x < 4; ++x) {
+        for (int y = 0; y < 4; ++y) {
+            const int k = x * 4 + y;
+            const int i = (indices >> (45 - 3 * k)) & 7;
+            out[(y * 4 + x) * 4 + 3] = clampByte(base + modifiers[i] * multiplier);
+        }
+    }
+}
+
+/*!
+    \return the RGBA8 pixels of an image of \a size in \a format, one of the
+    formats for which isDecodable() returns true, decoded from \a data.
+ */
+QByteArray QQuickRhiItemTextureAsset::decode(QRhiTexture::Format format, const QSize &size, const uchar *data)
+{
+    if (!isDecodable(format))
+        return QByteArray();
+
+    QByteArray result(size.width() * size.height() * 4, Qt::Uninitialized);
+    uchar *pixels = reinterpret_cast<uchar *>(result.data());
+    const int columns = (size.width() + 3) / 4;
+    const int rows = (size.height() + 3) / 4;
+    const int bytes = blockBytes(format);
+    uchar block[64];
+    for (int by = 0; by < rows; ++by) {
+        for (int bx = 0; bx < columns; ++bx) {
+            const uchar *src = data + (by * columns + bx) * bytes;
+            switch (format) {
+            case QRhiTexture::BC1:
+                decodeBc1(src, block, false);
+                break;
+            case QRhiTexture::BC2:
+                decodeBc1(src + 8, block, true);
+                for (int i = 0; i < 16; ++i)
+                    block[i * 4 + 3] = ((src[i / 2] >> (4 * (i & 1))) & 0xF) * 17;
+                break;
+            case QRhiTexture::BC3:
+                decodeBc1(src + 8, block, true);
+                decodeBc4(src, block + 3);
+                break;
+            case QRhiTexture::BC4:
+            case QRhiTexture::BC5:
+                // as sampled from R8 and RG8
+                for (int i = 0; i < 16; ++i) {
+                    block[i * 4 + 1] = 0;
+                    block[i * 4 + 2] = 0;
+                    block[i * 4 + 3] = 255;
+                }
+                decodeBc4(src, block);
+                if (format == QRhiTexture::BC5)
+                    decodeBc4(src + 8, block + 1);
+                break;
+            case QRhiTexture::ETC2_RGB8:
+                decodeEtc2(src, block, false);
+                break;
+            case QRhiTexture::ETC2_RGB8A1:
+                decodeEtc2(src, block, true);
+                break;
+            case QRhiTexture::ETC2_RGBA8:
+                decodeEtc2(src + 8, block, false);
+                decodeEac(src, block);
+                break;
+            default:
+                break;
+            }
+
+            // the blocks at the right and bottom edges may be partial
+            const int w = qMin(4, size.width() - bx * 4);
+            const int h = qMin(4, size.height() - by * 4);
+            for (int y = 0; y < h; ++y)
+                memcpy(pixels + ((by * 4 + y) * size.width() + bx * 4) * 4, block + y * 16, w * 4);
+        }
+    }
+    return result;
+}
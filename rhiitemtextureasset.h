@@ -0,0 +1,57 @@
+#ifndef RHIITEMTEXTUREASSET_H
+#define RHIITEMTEXTUREASSET_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QFile>
+#include <QStringList>
+
+class QQuickRhiItemTextureAsset
+{
+public:
+    QQuickRhiItemTextureAsset() = default;
+    ~QQuickRhiItemTextureAsset();
+
+    bool open(const QString &fileName);
+    bool open(QRhi *rhi, const QStringList &fileNames);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    QString fileName() const { return m_file.fileName(); }
+    QRhiTexture::Format format() const { return m_format; }
+    QRhiTexture::Format textureFormat() const { return m_decode ? QRhiTexture::RGBA8 : m_format; }
+    bool isSRGB() const { return m_srgb; }
+    bool isCubeMap() const { return m_faceCount == 6; }
+    bool needsDecoding() const { return m_decode; }
+    QSize size() const { return m_size; }
+    int levelCount() const { return m_levelOffsets.count(); }
+
+    QRhiTexture *newTexture(QRhi *rhi, QRhiTexture::Flags flags = {}) const;
+    QRhiTextureUploadDescription uploadDescription() const;
+
+    quint64 byteSize() const;
+    quint64 uncompressedByteSize() const;
+
+    static bool isCompressed(QRhiTexture::Format format);
+    static bool isDecodable(QRhiTexture::Format format);
+    static QByteArray decode(QRhiTexture::Format format, const QSize &size, const uchar *data);
+
+private:
+    bool parseKtx1();
+    bool parseKtx2();
+    QSize levelSize(int level) const;
+
+    QFile m_file;
+    QByteArray m_buffer; // when the file cannot be mapped
+    const uchar *m_data = nullptr;
+    qint64 m_fileSize = 0;
+    QRhiTexture::Format m_format = QRhiTexture::UnknownFormat;
+    bool m_srgb = false;
+    bool m_decode = false;
+    QSize m_size;
+    int m_faceCount = 1;
+    QList<qint64> m_levelOffsets; // of the first face of each level
+    QList<qint64> m_faceSizes; // per level
+    QList<qint64> m_faceStrides; // per level, with the padding of KTX 1
+};
+
+#endif
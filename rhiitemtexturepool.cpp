@@ -0,0 +1,280 @@
+#include "rhiitemtexturepool.h"
+#include <QHash>
+#include <QMutex>
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcRhiItemPool, "qt.quick.rhiitem.pool")
+
+/*!
+    \class QQuickRhiItemTexturePool
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Recycles the textures and renderbuffers used by QQuickRhiItem and
+    its renderers.
+
+    When items are created and destroyed at a high rate, for example as the
+    delegates of a scrolling ListView, each new item would create a new
+    QRhiTexture and each renderer a new depth-stencil QRhiRenderBuffer, while
+    the ones belonging to the destroyed items get released. The pool keeps the
+    released resources around instead, keyed by type, format, size, sample
+    count and flags, and hands them out again to the next acquire call with a
+    matching key. Once the pool is warm, no new graphics resources need to be
+    created.
+
+    There is one pool per QRhi. It lives on the render thread of the Qt Quick
+    scenegraph, and is destroyed together with the QRhi.
+
+    Idle resources are destroyed once they have not been reused for
+    maxIdleTime() milliseconds, or when the total size of the idle resources
+    exceeds maxIdleBytes(), oldest first. The defaults are 5 seconds and 64 MB,
+    and can be overridden by the \c QSG_RHIITEM_POOL_IDLE_TIME and
+    \c QSG_RHIITEM_POOL_MAX_BYTES environment variables.
+
+    The number of hits and misses is available via stats(), and is reported
+    when the pool is destroyed when the \c qt.quick.rhiitem.pool logging
+    category is enabled.
+ */
+
+static QMutex poolMutex;
+static QHash<QRhi *, QQuickRhiItemTexturePool *> pools;
+
+static quint64 bytesPerPixel(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::R8:
+    case QRhiTexture::RED_OR_ALPHA8:
+        return 1;
+    case QRhiTexture::R16:
+    case QRhiTexture::RG8:
+    case QRhiTexture::D16:
+        return 2;
+    case QRhiTexture::RGBA16F:
+        return 8;
+    case QRhiTexture::RGBA32F:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+/*!
+    \return the pool for \a rhi, creating it on first use.
+
+    Must be called on the thread \a rhi belongs to.
+ */
+QQuickRhiItemTexturePool *QQuickRhiItemTexturePool::get(QRhi *rhi)
+{
+    QMutexLocker lock(&poolMutex);
+    QQuickRhiItemTexturePool *&pool = pools[rhi];
+    if (!pool) {
+        pool = new QQuickRhiItemTexturePool(rhi);
+        rhi->addCleanupCallback([](QRhi *rhi) {
+            QMutexLocker lock(&poolMutex);
+            delete pools.take(rhi);
+        });
+    }
+    return pool;
+}
+
+/*!
+    \return the pool for \a rhi, or \nullptr when there is none.
+
+    For releasing resources, which may happen from other cleanup callbacks
+    of \a rhi, e.g. for recycled renderers, after the pool is gone. get()
+    would create a new pool then, and register its callback while the
+    callbacks are running. Without a pool, the resources are to be deleted.
+ */
+QQuickRhiItemTexturePool *QQuickRhiItemTexturePool::find(QRhi *rhi)
+{
+    QMutexLocker lock(&poolMutex);
+    return pools.value(rhi);
+}
+
+QQuickRhiItemTexturePool::QQuickRhiItemTexturePool(QRhi *rhi)
+    : m_rhi(rhi)
+{
+    m_clock.start();
+
+    bool ok = false;
+    m_maxIdleTime = qEnvironmentVariableIntValue("QSG_RHIITEM_POOL_IDLE_TIME", &ok);
+    if (!ok)
+        m_maxIdleTime = 5000;
+
+    const quint64 maxBytes = qgetenv("QSG_RHIITEM_POOL_MAX_BYTES").toULongLong(&ok);
+    m_maxIdleBytes = ok ? maxBytes : quint64(64) * 1024 * 1024;
+}
+
+QQuickRhiItemTexturePool::~QQuickRhiItemTexturePool()
+{
+    // called from the QRhi's cleanup callback, the resources cannot be
+    // deleteLater()'ed anymore at this point
+    for (const Entry &e : std::as_const(m_idle))
+        delete e.resource;
+
+    qCDebug(lcRhiItemPool, "Texture pool for QRhi %p destroyed: %llu hits, %llu misses (hit rate %.1f%%)",
+            m_rhi, m_hits, m_misses, stats().hitRate() * 100.0);
+}
+
+/*!
+    \return a created texture with the given \a format, \a pixelSize and \a
+    flags, either a recycled one or a newly created one. Returns \nullptr when
+    creating the texture fails.
+
+    Pass the texture to releaseTexture() instead of destroying it once it is
+    no longer needed.
+ */
+QRhiTexture *QQuickRhiItemTexturePool::acquireTexture(QRhiTexture::Format format, const QSize &pixelSize, QRhiTexture::Flags flags)
+{
+    const Key key { true, int(format), pixelSize, 1, int(flags) };
+    if (QRhiResource *r = acquire(key))
+        return static_cast<QRhiTexture *>(r);
+
+    QRhiTexture *t = m_rhi->newTexture(format, pixelSize, 1, flags);
+    if (!t->create()) {
+        delete t;
+        return nullptr;
+    }
+    return t;
+}
+
+/*!
+    Returns \a texture to the pool. The texture may have been resized or
+    rebuilt by the user since acquiring it, its current properties define what
+    it will be reused for.
+ */
+void QQuickRhiItemTexturePool::releaseTexture(QRhiTexture *texture)
+{
+    if (!texture)
+        return;
+
+    const Key key { true, int(texture->format()), texture->pixelSize(), 1, int(texture->flags()) };
+    release(key, texture);
+}
+
+/*!
+    \return a created renderbuffer with the given \a type, \a pixelSize, \a
+    sampleCount and \a flags, either a recycled one or a newly created one.
+    Returns \nullptr when creating the renderbuffer fails.
+
+    Pass the renderbuffer to releaseRenderBuffer() instead of destroying it
+    once it is no longer needed.
+ */
+QRhiRenderBuffer *QQuickRhiItemTexturePool::acquireRenderBuffer(QRhiRenderBuffer::Type type, const QSize &pixelSize,
+                                                                int sampleCount, QRhiRenderBuffer::Flags flags)
+{
+    const Key key { false, int(type), pixelSize, sampleCount, int(flags) };
+    if (QRhiResource *r = acquire(key))
+        return static_cast<QRhiRenderBuffer *>(r);
+
+    QRhiRenderBuffer *rb = m_rhi->newRenderBuffer(type, pixelSize, sampleCount, flags);
+    if (!rb->create()) {
+        delete rb;
+        return nullptr;
+    }
+    return rb;
+}
+
+/*!
+    Returns \a renderBuffer to the pool.
+ */
+void QQuickRhiItemTexturePool::releaseRenderBuffer(QRhiRenderBuffer *renderBuffer)
+{
+    if (!renderBuffer)
+        return;
+
+    const Key key { false, int(renderBuffer->type()), renderBuffer->pixelSize(),
+                    renderBuffer->sampleCount(), int(renderBuffer->flags()) };
+    release(key, renderBuffer);
+}
+
+QRhiResource *QQuickRhiItemTexturePool::acquire(const Key &key)
+{
+    trim();
+
+    // prefer the most recently released match, that is the least likely to
+    // get trimmed soon anyway
+    for (int i = m_idle.count() - 1; i >= 0; --i) {
+        if (m_idle[i].key == key) {
+            QRhiResource *r = m_idle[i].resource;
+            m_idleBytes -= m_idle[i].byteSize;
+            m_idle.removeAt(i);
+            ++m_hits;
+            return r;
+        }
+    }
+
+    ++m_misses;
+    return nullptr;
+}
+
+void QQuickRhiItemTexturePool::release(const Key &key, QRhiResource *resource)
+{
+    quint64 byteSize = quint64(key.pixelSize.width()) * key.pixelSize.height() * key.sampleCount;
+    if (key.isTexture) {
+        byteSize *= bytesPerPixel(QRhiTexture::Format(key.format));
+        if (QRhiTexture::Flags(key.flags).testFlag(QRhiTexture::MipMapped))
+            byteSize = byteSize * 4 / 3;
+    } else {
+        byteSize *= 4;
+    }
+
+    m_idle.append({ key, resource, byteSize, m_clock.elapsed() });
+    m_idleBytes += byteSize;
+
+    trim();
+}
+
+void QQuickRhiItemTexturePool::evict(int index)
+{
+    // the resource may still be referenced by frames in flight
+    m_idle[index].resource->deleteLater();
+    m_idleBytes -= m_idle[index].byteSize;
+    m_idle.removeAt(index);
+}
+
+/*!
+    Destroys the idle resources that exceed the time or size limits. This is
+    done implicitly whenever resources are acquired or released, and after
+    each frame of the windows with a QQuickRhiItem.
+ */
+void QQuickRhiItemTexturePool::trim()
+{
+    const qint64 now = m_clock.elapsed();
+    while (!m_idle.isEmpty() && now - m_idle.first().releaseTime > m_maxIdleTime)
+        evict(0);
+    while (!m_idle.isEmpty() && m_idleBytes > m_maxIdleBytes)
+        evict(0);
+}
+
+/*!
+    Sets the time after which an unused resource is destroyed to \a msecs.
+ */
+void QQuickRhiItemTexturePool::setMaxIdleTime(int msecs)
+{
+    m_maxIdleTime = msecs;
+    trim();
+}
+
+/*!
+    Sets the maximum total size of the unused resources kept in the pool to \a
+    bytes. The sizes are estimates, based on the format and pixel size.
+ */
+void QQuickRhiItemTexturePool::setMaxIdleBytes(quint64 bytes)
+{
+    m_maxIdleBytes = bytes;
+    trim();
+}
+
+/*!
+    \return the hit and miss counters and the current state of the idle list.
+ */
+QQuickRhiItemTexturePool::Stats QQuickRhiItemTexturePool::stats() const
+{
+    Stats s;
+    s.hits = m_hits;
+    s.misses = m_misses;
+    s.idleCount = m_idle.count();
+    s.idleBytes = m_idleBytes;
+    return s;
+}
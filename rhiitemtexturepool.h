@@ -0,0 +1,78 @@
+#ifndef RHIITEMTEXTUREPOOL_H
+#define RHIITEMTEXTUREPOOL_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QElapsedTimer>
+
+class QQuickRhiItemTexturePool
+{
+public:
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        int idleCount = 0;
+        quint64 idleBytes = 0;
+
+        qreal hitRate() const { return hits + misses ? hits / qreal(hits + misses) : 0.0; }
+        qreal missRate() const { return hits + misses ? misses / qreal(hits + misses) : 0.0; }
+    };
+
+    static QQuickRhiItemTexturePool *get(QRhi *rhi);
+    static QQuickRhiItemTexturePool *find(QRhi *rhi);
+
+    QRhiTexture *acquireTexture(QRhiTexture::Format format, const QSize &pixelSize, QRhiTexture::Flags flags);
+    void releaseTexture(QRhiTexture *texture);
+
+    QRhiRenderBuffer *acquireRenderBuffer(QRhiRenderBuffer::Type type, const QSize &pixelSize,
+                                          int sampleCount = 1, QRhiRenderBuffer::Flags flags = {});
+    void releaseRenderBuffer(QRhiRenderBuffer *renderBuffer);
+
+    int maxIdleTime() const { return m_maxIdleTime; }
+    void setMaxIdleTime(int msecs);
+
+    quint64 maxIdleBytes() const { return m_maxIdleBytes; }
+    void setMaxIdleBytes(quint64 bytes);
+
+    void trim();
+
+    Stats stats() const;
+
+private:
+    QQuickRhiItemTexturePool(QRhi *rhi);
+    ~QQuickRhiItemTexturePool();
+
+    struct Key {
+        bool isTexture;
+        int format;
+        QSize pixelSize;
+        int sampleCount;
+        int flags;
+        bool operator==(const Key &other) const
+        {
+            return isTexture == other.isTexture && format == other.format && pixelSize == other.pixelSize
+                    && sampleCount == other.sampleCount && flags == other.flags;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        QRhiResource *resource;
+        quint64 byteSize;
+        qint64 releaseTime;
+    };
+
+    QRhiResource *acquire(const Key &key);
+    void release(const Key &key, QRhiResource *resource);
+    void evict(int index);
+
+    QRhi *m_rhi;
+    QElapsedTimer m_clock;
+    QList<Entry> m_idle; // oldest first
+    quint64 m_idleBytes = 0;
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+    int m_maxIdleTime;
+    quint64 m_maxIdleBytes;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "rhiitemtilepyramid.h"
+#include <QBuffer>
+#include <QtEndian>
+
+/*!
+    \class QQuickRhiItemTilePyramid
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Reads and writes multi-resolution tiled images, accessed through a
+    memory mapping.
+
+    Level 0 is the full resolution image, each further level halves the size
+    of the previous one, until the whole image fits in a single tile. Each
+    level is split into square tiles of tileSize() pixels, the last column
+    and row may be smaller. Tiles are stored individually encoded, as PNG or
+    JPEG, so that they can be decoded independently of each other, on any
+    thread.
+
+    The file is mapped into memory by open(), nothing is read upfront other
+    than the headers, so the memory usage does not depend on the image size.
+    tileData() and decodeTile() only read the mapping and are safe to call
+    from multiple threads at the same time.
+
+    The format, all integers little endian:
+
+    \list
+    \li header: "QRTP", version (1), width, height, tile size, level count,
+    all 32-bit
+    \li per level: width, height, columns, rows (32-bit), offset of the tile
+    index (64-bit)
+    \li tile index, per level, row by row: offset (64-bit), size (32-bit),
+    reserved (32-bit)
+    \li the encoded tiles
+    \endlist
+
+    The tilegen tool creates such files from images, or synthetic ones of
+    arbitrary size for testing.
+ */
+
+static const char MAGIC[4] = { 'Q', 'R', 'T', 'P' };
+static const quint32 VERSION = 1;
+static const int HEADER_SIZE = 24;
+static const int LEVEL_HEADER_SIZE = 24;
+static const int INDEX_ENTRY_SIZE = 16;
+
+static QList<QQuickRhiItemTilePyramid::Level> levelsFor(const QSize &size, int tileSize)
+{
+    QList<QQuickRhiItemTilePyramid::Level> levels;
+    for (int i = 0; ; ++i) {
+        QQuickRhiItemTilePyramid::Level l;
+        // in 64 bits, the sizes come from the file and may be up to INT_MAX
+        l.width = qMax(1, int((qint64(size.width()) + (qint64(1) << i) - 1) >> i));
+        l.height = qMax(1, int((qint64(size.height()) + (qint64(1) << i) - 1) >> i));
+        l.columns = int((qint64(l.width) + tileSize - 1) / tileSize);
+        l.rows = int((qint64(l.height) + tileSize - 1) / tileSize);
+        levels.append(l);
+        if (l.columns == 1 && l.rows == 1)
+            break;
+    }
+    return levels;
+}
+
+QQuickRhiItemTilePyramid::~QQuickRhiItemTilePyramid()
+{
+    close();
+}
+
+bool QQuickRhiItemTilePyramid::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open tile pyramid %s", qPrintable(fileName));
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data || m_size < HEADER_SIZE || memcmp(m_data, MAGIC, 4)
+            || qFromLittleEndian<quint32>(m_data + 4) != VERSION) {
+        qWarning("%s is not a tile pyramid", qPrintable(fileName));
+        close();
+        return false;
+    }
+
+    const QSize size(qFromLittleEndian<quint32>(m_data + 8), qFromLittleEndian<quint32>(m_data + 12));
+    m_tileSize = qFromLittleEndian<quint32>(m_data + 16);
+    const quint32 levelCount = qFromLittleEndian<quint32>(m_data + 20);
+    if (size.isEmpty() || m_tileSize <= 0) {
+        qWarning("Corrupt tile pyramid %s", qPrintable(fileName));
+        close();
+        return false;
+    }
+
+    // only accept what this size and tile size would give, down to the
+    // single tile the viewers fall back to
+    const QList<Level> expected = levelsFor(size, m_tileSize);
+    if (levelCount != quint32(expected.count()) || m_size < HEADER_SIZE + qint64(levelCount) * LEVEL_HEADER_SIZE) {
+        qWarning("Corrupt tile pyramid %s", qPrintable(fileName));
+        close();
+        return false;
+    }
+    for (int i = 0; i < expected.count(); ++i) {
+        const uchar *p = m_data + HEADER_SIZE + i * LEVEL_HEADER_SIZE;
+        Level l;
+        l.width = qFromLittleEndian<quint32>(p);
+        l.height = qFromLittleEndian<quint32>(p + 4);
+        l.columns = qFromLittleEndian<quint32>(p + 8);
+        l.rows = qFromLittleEndian<quint32>(p + 12);
+        const qint64 indexOffset = qFromLittleEndian<quint64>(p + 16);
+        if (l.width != expected[i].width || l.height != expected[i].height
+                || l.columns != expected[i].columns || l.rows != expected[i].rows
+                || indexOffset < HEADER_SIZE || indexOffset > m_size
+                || qint64(l.columns) * l.rows > (m_size - indexOffset) / INDEX_ENTRY_SIZE) {
+            qWarning("Corrupt tile pyramid %s", qPrintable(fileName));
+            close();
+            return false;
+        }
+        m_levels.append(l);
+        m_indexOffsets.append(indexOffset);
+    }
+    return true;
+}
+
+void QQuickRhiItemTilePyramid::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_tileSize = 0;
+    m_levels.clear();
+    m_indexOffsets.clear();
+}
+
+/*!
+    \return the rectangle of the tile in the pixels of \a level.
+ */
+QRect QQuickRhiItemTilePyramid::tileRect(int level, int x, int y) const
+{
+    const Level &l(m_levels[level]);
+    const QRect r(x * m_tileSize, y * m_tileSize, m_tileSize, m_tileSize);
+    return r & QRect(0, 0, l.width, l.height);
+}
+
+/*!
+    \return the encoded data of a tile, without copying. The data is valid as
+    long as the file is open.
+ */
+QByteArray QQuickRhiItemTilePyramid::tileData(int level, int x, int y) const
+{
+    if (level < 0 || level >= m_levels.count())
+        return QByteArray();
+    const Level &l(m_levels[level]);
+    if (x < 0 || y < 0 || x >= l.columns || y >= l.rows)
+        return QByteArray();
+
+    const uchar *entry = m_data + m_indexOffsets[level] + (qint64(y) * l.columns + x) * INDEX_ENTRY_SIZE;
+    const qint64 offset = qFromLittleEndian<quint64>(entry);
+    const qint64 size = qFromLittleEndian<quint32>(entry + 8);
+    if (offset < 0 || offset > m_size || size > m_size - offset)
+        return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data + offset), size);
+}
+
+/*!
+    \return the decoded tile, as premultiplied RGBA8888.
+ */
+QImage QQuickRhiItemTilePyramid::decodeTile(int level, int x, int y) const
+{
+    const QByteArray data = tileData(level, x, y);
+    if (data.isEmpty())
+        return QImage();
+
+    return QImage::fromData(data).convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+}
+
+/*!
+    Writes a pyramid of an image of \a size to \a fileName, with tiles encoded
+    as \a format. The pixels are requested from \a source tile by tile, level
+    by level starting from 0, so that the image does not have to be in memory
+    at once. \a size must not be empty and \a tileSize must be positive, otherwise
+    nothing is written and \c false is returned.
+ */
+bool QQuickRhiItemTilePyramid::write(const QString &fileName, const QSize &size, int tileSize, const char *format,
+                                     const TileSource &source)
+{
+    if (size.isEmpty() || tileSize <= 0) {
+        qWarning("Invalid tile pyramid of size %dx%d with tiles of %d pixels", size.width(), size.height(), tileSize);
+        return false;
+    }
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Failed to open %s for writing", qPrintable(fileName));
+        return false;
+    }
+
+    const QList<Level> levels = levelsFor(size, tileSize);
+    auto put32 = [](QByteArray *dst, quint32 v) {
+        char b[4];
+        qToLittleEndian(v, b);
+        dst->append(b, 4);
+    };
+    auto put64 = [](QByteArray *dst, quint64 v) {
+        char b[8];
+        qToLittleEndian(v, b);
+        dst->append(b, 8);
+    };
+
+    QByteArray header(MAGIC, 4);
+    put32(&header, VERSION);
+    put32(&header, size.width());
+    put32(&header, size.height());
+    put32(&header, tileSize);
+    put32(&header, levels.count());
+
+    qint64 indexOffset = HEADER_SIZE + levels.count() * LEVEL_HEADER_SIZE;
+    for (const Level &l : levels) {
+        put32(&header, l.width);
+        put32(&header, l.height);
+        put32(&header, l.columns);
+        put32(&header, l.rows);
+        put64(&header, indexOffset);
+        indexOffset += qint64(l.columns) * l.rows * INDEX_ENTRY_SIZE;
+    }
+    f.write(header);
+
+    // the index is written once all tiles are
+    f.seek(indexOffset);
+    QByteArray index;
+    for (int level = 0; level < levels.count(); ++level) {
+        const Level &l(levels[level]);
+        for (int y = 0; y < l.rows; ++y) {
+            for (int x = 0; x < l.columns; ++x) {
+                const QRect r = QRect(x * tileSize, y * tileSize, tileSize, tileSize) & QRect(0, 0, l.width, l.height);
+                QByteArray encoded;
+                QBuffer buf(&encoded);
+                buf.open(QIODevice::WriteOnly);
+                if (!source(level, r).save(&buf, format)) {
+                    qWarning("Failed to encode tile %d,%d of level %d", x, y, level);
+                    return false;
+                }
+                put64(&index, f.pos());
+                put32(&index, encoded.size());
+                put32(&index, 0);
+                f.write(encoded);
+            }
+        }
+    }
+    f.seek(HEADER_SIZE + levels.count() * LEVEL_HEADER_SIZE);
+    f.write(index);
+    return f.error() == QFileDevice::NoError;
+}
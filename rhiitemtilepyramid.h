@@ -0,0 +1,49 @@
+#ifndef RHIITEMTILEPYRAMID_H
+#define RHIITEMTILEPYRAMID_H
+
+#include <QFile>
+#include <QImage>
+#include <QRect>
+#include <functional>
+
+class QQuickRhiItemTilePyramid
+{
+public:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int columns = 0;
+        int rows = 0;
+    };
+
+    QQuickRhiItemTilePyramid() = default;
+    ~QQuickRhiItemTilePyramid();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    QSize size() const { return m_levels.isEmpty() ? QSize() : QSize(m_levels[0].width, m_levels[0].height); }
+    int tileSize() const { return m_tileSize; }
+    int levelCount() const { return m_levels.count(); }
+    Level level(int index) const { return m_levels[index]; }
+    QRect tileRect(int level, int x, int y) const;
+
+    QByteArray tileData(int level, int x, int y) const;
+    QImage decodeTile(int level, int x, int y) const;
+
+    // the pixels of a rectangle of a level, e.g. taken from a source image
+    using TileSource = std::function<QImage(int level, const QRect &rect)>;
+    static bool write(const QString &fileName, const QSize &size, int tileSize, const char *format,
+                      const TileSource &source);
+
+private:
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    int m_tileSize = 0;
+    QList<Level> m_levels;
+    QList<qint64> m_indexOffsets; // per level
+};
+
+#endif
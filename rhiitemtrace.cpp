@@ -0,0 +1,137 @@
+#include "rhiitemtrace_p.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QQuickItem>
+#include <QThread>
+
+/*
+    Timeline tracing for QQuickRhiItem, enabled by setting QSG_RHIITEM_TRACE
+    to a file name. The file is written in the Chrome trace event format
+    (chrome://tracing, Perfetto) when the application exits.
+
+    Each thread appends to its own buffer, so recording an event takes no
+    locks. The buffers are registered in a global list, under a mutex, only
+    once per thread, and are never freed before the application exits, so
+    that events from threads that have finished are still written out. When
+    tracing is disabled, the cost at each event site is a single relaxed
+    atomic load.
+ */
+
+std::atomic<bool> QQuickRhiItemTrace::enabled { !qEnvironmentVariableIsEmpty("QSG_RHIITEM_TRACE") };
+
+namespace {
+
+struct TraceEvent
+{
+    const char *phase;
+    QByteArray name;
+    qint64 begin;
+    qint64 end;
+};
+
+struct TraceBuffer
+{
+    int tid;
+    QByteArray threadName;
+    QList<TraceEvent> events;
+};
+
+// an upper limit per thread so that forgetting about the env.var. does not
+// lead to unbounded memory usage
+const qsizetype MAX_EVENTS_PER_THREAD = 1 << 20;
+
+QElapsedTimer *traceClock()
+{
+    static QElapsedTimer c = [] { QElapsedTimer t; t.start(); return t; }();
+    return &c;
+}
+
+QMutex buffersMutex;
+QList<TraceBuffer *> buffers;
+thread_local TraceBuffer *threadBuffer = nullptr;
+
+QByteArray escaped(const QByteArray &s)
+{
+    QByteArray result;
+    result.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if (uchar(c) < 0x20)
+            continue;
+        result += c;
+    }
+    return result;
+}
+
+void writeTrace()
+{
+    const QString fileName = qEnvironmentVariable("QSG_RHIITEM_TRACE");
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Failed to open %s for writing the QQuickRhiItem trace", qPrintable(fileName));
+        return;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QMutexLocker lock(&buffersMutex);
+    f.write("{\"traceEvents\":[\n");
+    bool first = true;
+    for (const TraceBuffer *b : std::as_const(buffers)) {
+        f.write(QByteArray(first ? "" : ",\n")
+                + "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(pid)
+                + ",\"tid\":" + QByteArray::number(b->tid)
+                + ",\"args\":{\"name\":\"" + escaped(b->threadName) + "\"}}");
+        first = false;
+        for (const TraceEvent &e : b->events) {
+            f.write(",\n{\"name\":\"" + QByteArray(e.phase)
+                    + "\",\"cat\":\"rhiitem\",\"ph\":\"X\",\"pid\":" + QByteArray::number(pid)
+                    + ",\"tid\":" + QByteArray::number(b->tid)
+                    + ",\"ts\":" + QByteArray::number(e.begin / 1000.0, 'f', 3)
+                    + ",\"dur\":" + QByteArray::number((e.end - e.begin) / 1000.0, 'f', 3)
+                    + ",\"args\":{\"item\":\"" + escaped(e.name) + "\"}}");
+        }
+    }
+    f.write("\n]}\n");
+}
+
+TraceBuffer *registerThread()
+{
+    TraceBuffer *b = new TraceBuffer;
+    QThread *t = QThread::currentThread();
+    b->threadName = t->objectName().isEmpty() ? QByteArray(t->metaObject()->className()) : t->objectName().toUtf8();
+
+    QMutexLocker lock(&buffersMutex);
+    b->tid = buffers.count() + 1;
+    if (buffers.isEmpty())
+        qAddPostRoutine(writeTrace);
+    buffers.append(b);
+    return b;
+}
+
+} // namespace
+
+qint64 QQuickRhiItemTrace::timestamp()
+{
+    return traceClock()->nsecsElapsed();
+}
+
+void QQuickRhiItemTrace::record(const char *phase, const QByteArray &name, qint64 begin, qint64 end)
+{
+    if (!threadBuffer)
+        threadBuffer = registerThread();
+
+    if (threadBuffer->events.count() < MAX_EVENTS_PER_THREAD)
+        threadBuffer->events.append({ phase, name, begin, end });
+}
+
+QByteArray QQuickRhiItemTrace::itemName(const QQuickItem *item)
+{
+    const QString name = item->objectName();
+    if (!name.isEmpty())
+        return name.toUtf8();
+
+    return QByteArray(item->metaObject()->className()) + '(' + QByteArray::number(quintptr(item), 16) + ')';
+}
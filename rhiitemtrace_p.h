@@ -0,0 +1,58 @@
+#ifndef RHIITEMTRACE_P_H
+#define RHIITEMTRACE_P_H
+
+#include <QByteArray>
+#include <atomic>
+
+class QQuickItem;
+
+class QQuickRhiItemTrace
+{
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static qint64 timestamp();
+    static void record(const char *phase, const QByteArray &name, qint64 begin, qint64 end);
+    static QByteArray itemName(const QQuickItem *item);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class QQuickRhiItemTraceScope
+{
+public:
+    QQuickRhiItemTraceScope(const char *phase, const QByteArray &name)
+        : m_active(QQuickRhiItemTrace::isEnabled())
+    {
+        if (m_active)
+            start(phase, name);
+    }
+
+    QQuickRhiItemTraceScope(const char *phase, const QQuickItem *item)
+        : m_active(QQuickRhiItemTrace::isEnabled())
+    {
+        if (m_active)
+            start(phase, QQuickRhiItemTrace::itemName(item));
+    }
+
+    ~QQuickRhiItemTraceScope()
+    {
+        if (m_active)
+            QQuickRhiItemTrace::record(m_phase, m_name, m_begin, QQuickRhiItemTrace::timestamp());
+    }
+
+private:
+    void start(const char *phase, const QByteArray &name)
+    {
+        m_phase = phase;
+        m_name = name;
+        m_begin = QQuickRhiItemTrace::timestamp();
+    }
+
+    bool m_active;
+    const char *m_phase = nullptr;
+    QByteArray m_name;
+    qint64 m_begin = 0;
+};
+
+#endif
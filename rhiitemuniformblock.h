@@ -0,0 +1,170 @@
+#ifndef RHIITEMUNIFORMBLOCK_H
+#define RHIITEMUNIFORMBLOCK_H
+
+#include <QtGui/private/qrhi_p.h>
+#include <QColor>
+#include <QMatrix4x4>
+#include <QVector4D>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+/*
+    Helpers for declaring uniform blocks as C++ structs matching the std140
+    layout of the shader, and for uploading only what changed.
+
+    The member types mirror the GLSL ones. C++ does not lay them out by the
+    std140 rules on its own, so the offsets are to be verified at compile
+    time against Layout, which calculates the std140 offsets of a list of
+    types:
+
+        struct Uniforms {
+            QQuickRhiItemStd140::Mat4 mvp;
+            QQuickRhiItemStd140::Int flip;
+        };
+        using UniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Mat4, QQuickRhiItemStd140::Int>;
+        static_assert(offsetof(Uniforms, mvp) == UniformsLayout::offset<0>);
+        static_assert(offsetof(Uniforms, flip) == UniformsLayout::offset<1>);
+
+    Explicit padding members are needed where std140 leaves a gap that C++
+    does not, for example before a Vec4 that follows a Vec2 and a Float.
+    Arrays are not covered, std140 pads each element to 16 bytes.
+ */
+
+namespace QQuickRhiItemStd140 {
+
+using Float = float;
+using Int = qint32;
+using UInt = quint32;
+
+struct Vec2 { float v[2] = {}; };
+struct Vec3 { float v[3] = {}; };
+
+struct Vec4
+{
+    float v[4] = {};
+    Vec4() = default;
+    Vec4(const QVector4D &vec) : v { vec.x(), vec.y(), vec.z(), vec.w() } { }
+    Vec4(float x, float y, float z, float w) : v { x, y, z, w } { }
+    static Vec4 premultiplied(const QColor &c)
+    {
+        const float a = float(c.alphaF());
+        return Vec4(float(c.redF()) * a, float(c.greenF()) * a, float(c.blueF()) * a, a);
+    }
+};
+
+struct Mat4
+{
+    float m[16] = {};
+    Mat4() = default;
+    Mat4(const QMatrix4x4 &matrix) { std::memcpy(m, matrix.constData(), sizeof(m)); }
+};
+
+template <typename T> struct Traits;
+template <> struct Traits<Float> { static constexpr quint32 alignment = 4; static constexpr quint32 size = 4; };
+template <> struct Traits<Int> { static constexpr quint32 alignment = 4; static constexpr quint32 size = 4; };
+template <> struct Traits<UInt> { static constexpr quint32 alignment = 4; static constexpr quint32 size = 4; };
+template <> struct Traits<Vec2> { static constexpr quint32 alignment = 8; static constexpr quint32 size = 8; };
+template <> struct Traits<Vec3> { static constexpr quint32 alignment = 16; static constexpr quint32 size = 12; };
+template <> struct Traits<Vec4> { static constexpr quint32 alignment = 16; static constexpr quint32 size = 16; };
+template <> struct Traits<Mat4> { static constexpr quint32 alignment = 16; static constexpr quint32 size = 64; };
+
+constexpr quint32 alignUp(quint32 v, quint32 a) { return (v + a - 1) & ~(a - 1); }
+
+template <typename... Ts>
+constexpr std::array<quint32, sizeof...(Ts) + 1> offsets()
+{
+    // the offsets of the members, followed by the end of the last one
+    std::array<quint32, sizeof...(Ts) + 1> result {};
+    const quint32 alignments[] = { Traits<Ts>::alignment... };
+    const quint32 sizes[] = { Traits<Ts>::size... };
+    quint32 offset = 0;
+    for (size_t i = 0; i < sizeof...(Ts); ++i) {
+        offset = alignUp(offset, alignments[i]);
+        result[i] = offset;
+        offset += sizes[i];
+    }
+    result[sizeof...(Ts)] = offset;
+    return result;
+}
+
+template <typename... Ts>
+struct Layout
+{
+    template <size_t I>
+    static constexpr quint32 offset = offsets<Ts...>()[I];
+
+    // the minimum size of the buffer
+    static constexpr quint32 size = offsets<Ts...>()[sizeof...(Ts)];
+};
+
+} // namespace QQuickRhiItemStd140
+
+template <typename Block>
+class QQuickRhiItemUniformBlock
+{
+    static_assert(std::is_standard_layout_v<Block> && std::is_trivially_copyable_v<Block>,
+                  "Uniform blocks must be plain structs");
+
+public:
+    QQuickRhiItemUniformBlock() { m_dirty.set(); }
+
+    static constexpr quint32 size() { return sizeof(Block); }
+
+    const Block &data() const { return m_data; }
+
+    // Updates a member and marks it dirty, unless the value is unchanged.
+    template <typename T, typename V>
+    void set(T Block::*member, const V &value)
+    {
+        const T v(value);
+        T &dst(m_data.*member);
+        if (std::memcmp(&dst, &v, sizeof(T)) == 0)
+            return;
+
+        dst = v;
+        const quint32 offset = quint32(reinterpret_cast<const char *>(&dst) - reinterpret_cast<const char *>(&m_data));
+        markDirty(offset, sizeof(T));
+    }
+
+    void markDirty(quint32 offset, quint32 byteSize)
+    {
+        for (quint32 chunk = offset / CHUNK; chunk * CHUNK < offset + byteSize; ++chunk)
+            m_dirty.set(chunk);
+    }
+
+    void markAllDirty() { m_dirty.set(); }
+    bool isDirty() const { return m_dirty.any(); }
+
+    // Queues the dirty parts into rub, one updateDynamicBuffer() per
+    // contiguous range.
+    void commit(QRhiResourceUpdateBatch *rub, QRhiBuffer *buffer, quint32 bufferOffset = 0)
+    {
+        const char *p = reinterpret_cast<const char *>(&m_data);
+        size_t chunk = 0;
+        while (chunk < CHUNK_COUNT) {
+            if (!m_dirty.test(chunk)) {
+                ++chunk;
+                continue;
+            }
+            const size_t first = chunk;
+            while (chunk < CHUNK_COUNT && m_dirty.test(chunk))
+                ++chunk;
+            const quint32 begin = quint32(first * CHUNK);
+            const quint32 end = qMin(quint32(chunk * CHUNK), size());
+            rub->updateDynamicBuffer(buffer, bufferOffset + begin, end - begin, p + begin);
+        }
+        m_dirty.reset();
+    }
+
+private:
+    static constexpr quint32 CHUNK = 16;
+    static constexpr size_t CHUNK_COUNT = (sizeof(Block) + CHUNK - 1) / CHUNK;
+
+    Block m_data {};
+    std::bitset<CHUNK_COUNT> m_dirty;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "rhiitemview.h"
+#include "rhiitem_p.h"
+#include <QSGTextureMaterial>
+
+/*!
+    \class QQuickRhiItemView
+    \inmodule QtQuick
+    \since 6.x
+
+    \brief Shows the texture of a QQuickRhiItem, without rendering it again.
+
+    A view has no renderer of its own. It draws the texture of the source
+    QQuickRhiItem, as rendered by the source's QQuickRhiItemRenderer in the
+    same frame, with its own geometry, filtering and mirroring. This makes
+    showing the same content multiple times, for example as a main view plus
+    a mini-map and thumbnails, as cheap as drawing a textured quad per copy.
+
+    \badcode
+    TestRhiItem {
+        id: mainView
+        anchors.fill: parent
+        mipmap: true
+    }
+    RhiItemView {
+        source: mainView
+        width: 160
+        height: 90
+        mipmap: true
+    }
+    \endcode
+
+    The source must be in the same window as the view. The source is not
+    required to be visible, but it still needs to be part of the scene for its
+    texture to be rendered, for example with \c{opacity: 0}, although that is
+    not efficient.
+
+    sourceRect selects a part of the source, in the source item's coordinate
+    system. The default, an empty rectangle, means the entire item.
+
+    Enabling mipmap makes views that are much smaller than the source both
+    better looking and cheaper to draw. This requires QQuickRhiItem::mipmap to
+    be enabled on the source. The source then generates the mip levels after
+    each render, even when it is not minified itself.
+ */
+
+class QQuickRhiItemViewNode : public QObject, public QSGSimpleTextureNode
+{
+    Q_OBJECT
+
+public:
+    QQuickRhiItemViewNode(QQuickWindow *window);
+    ~QQuickRhiItemViewNode();
+
+    void setProvider(QSGTextureProvider *provider, bool mipmap);
+    void setNormalizedSourceRect(const QRectF &rect);
+
+private slots:
+    void sourceTextureChanged();
+    void providerDestroyed();
+
+private:
+    void setMipmapUser(bool enable);
+    void updateSourceRect();
+
+    QQuickWindow *m_window;
+    QSGTextureProvider *m_provider = nullptr;
+    QPointer<QQuickRhiItemNode> m_mipmapSource;
+    QSGTexture *m_placeholder = nullptr;
+    QRectF m_normalizedSourceRect { 0, 0, 1, 1 };
+};
+
+QQuickRhiItemViewNode::QQuickRhiItemViewNode(QQuickWindow *window)
+    : m_window(window)
+{
+}
+
+QQuickRhiItemViewNode::~QQuickRhiItemViewNode()
+{
+    setMipmapUser(false);
+    delete m_placeholder;
+}
+
+void QQuickRhiItemViewNode::setProvider(QSGTextureProvider *provider, bool mipmap)
+{
+    if (provider != m_provider) {
+        setMipmapUser(false);
+        if (m_provider)
+            disconnect(m_provider, nullptr, this, nullptr);
+        m_provider = provider;
+        // The source re-renders into the same texture in the beforeRendering
+        // phase. If the texture object itself is replaced, for example on a
+        // resize, that needs to be picked up in the same frame, before the
+        // old one gets drawn.
+        connect(m_provider, &QSGTextureProvider::textureChanged, this, &QQuickRhiItemViewNode::sourceTextureChanged);
+        connect(m_provider, &QObject::destroyed, this, &QQuickRhiItemViewNode::providerDestroyed);
+    }
+
+    setMipmapUser(mipmap);
+    const QSGTexture::Filtering mipmapFiltering = m_mipmapSource ? QSGTexture::Linear : QSGTexture::None;
+    static_cast<QSGOpaqueTextureMaterial *>(material())->setMipmapFiltering(mipmapFiltering);
+    static_cast<QSGOpaqueTextureMaterial *>(opaqueMaterial())->setMipmapFiltering(mipmapFiltering);
+
+    sourceTextureChanged();
+}
+
+void QQuickRhiItemViewNode::setMipmapUser(bool enable)
+{
+    // only QQuickRhiItem's own provider knows about mipmaps, not for
+    // example the one of a layer
+    QQuickRhiItemNode *source = enable ? qobject_cast<QQuickRhiItemNode *>(m_provider) : nullptr;
+    if (source == m_mipmapSource)
+        return;
+
+    if (m_mipmapSource)
+        m_mipmapSource->removeMipmapUser();
+    m_mipmapSource = source;
+    if (m_mipmapSource)
+        m_mipmapSource->addMipmapUser();
+}
+
+void QQuickRhiItemViewNode::setNormalizedSourceRect(const QRectF &rect)
+{
+    m_normalizedSourceRect = rect;
+    updateSourceRect();
+}
+
+void QQuickRhiItemViewNode::updateSourceRect()
+{
+    // in pixels of the current texture, which may have been resized
+    const QSize size = texture()->textureSize();
+    setSourceRect(QRectF(m_normalizedSourceRect.x() * size.width(), m_normalizedSourceRect.y() * size.height(),
+                         m_normalizedSourceRect.width() * size.width(), m_normalizedSourceRect.height() * size.height()));
+}
+
+void QQuickRhiItemViewNode::sourceTextureChanged()
+{
+    QSGTexture *t = m_provider ? m_provider->texture() : nullptr;
+    if (!t)
+        return;
+    if (t != texture()) {
+        setTexture(t);
+        // the material holds the texture's hasAlphaChannel as its blending state
+        markDirty(QSGNode::DirtyMaterial);
+    }
+    // also for a texture resized in place, the source rect is in pixels
+    updateSourceRect();
+}
+
+void QQuickRhiItemViewNode::providerDestroyed()
+{
+    // the source's texture is gone as well, draw nothing until the item
+    // gets around to updating the node
+    m_provider = nullptr;
+    m_mipmapSource = nullptr;
+    if (!m_placeholder) {
+        QImage image(1, 1, QImage::Format_RGBA8888_Premultiplied);
+        image.fill(Qt::transparent);
+        m_placeholder = m_window->createTextureFromImage(image);
+    }
+    setTexture(m_placeholder);
+    setRect(QRectF());
+}
+
+QQuickRhiItemView::QQuickRhiItemView(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+}
+
+/*!
+    \property QQuickRhiItemView::source
+
+    The QQuickRhiItem whose texture is shown.
+ */
+void QQuickRhiItemView::setSource(QQuickRhiItem *item)
+{
+    if (m_source == item)
+        return;
+
+    if (m_source)
+        disconnect(m_source, nullptr, this, nullptr);
+    m_source = item;
+    if (m_source) {
+        // resizing the source or toggling mipmaps leads to a new texture,
+        // also the node may be gone while the item still exists
+        connect(m_source, &QQuickRhiItem::effectiveTextureSizeChanged, this, &QQuickItem::update);
+        connect(m_source, &QQuickRhiItem::mipmapChanged, this, &QQuickItem::update);
+        connect(m_source, &QQuickItem::windowChanged, this, &QQuickItem::update);
+        connect(m_source, &QObject::destroyed, this, &QQuickItem::update);
+    }
+    emit sourceChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItemView::sourceRect
+
+    The area of the source that is shown, in the source item's coordinate
+    system. The default is an empty rectangle, meaning the entire item.
+ */
+void QQuickRhiItemView::setSourceRect(const QRectF &rect)
+{
+    if (m_sourceRect == rect)
+        return;
+
+    m_sourceRect = rect;
+    emit sourceRectChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItemView::mirrorVertically
+
+    Controls if the texture is mirrored vertically, independently of the
+    source's own QQuickRhiItem::mirrorVertically. The default is false.
+ */
+void QQuickRhiItemView::setMirrorVertically(bool enable)
+{
+    if (m_mirrorVertically == enable)
+        return;
+
+    m_mirrorVertically = enable;
+    emit mirrorVerticallyChanged();
+    update();
+}
+
+/*!
+    \property QQuickRhiItemView::mipmap
+
+    Controls if the view samples the mip levels of the source's texture. Has
+    no effect unless QQuickRhiItem::mipmap is enabled on the source. The
+    default is false.
+ */
+void QQuickRhiItemView::setMipmap(bool enable)
+{
+    if (m_mipmap == enable)
+        return;
+
+    m_mipmap = enable;
+    emit mipmapChanged();
+    update();
+}
+
+/*!
+    \internal
+ */
+QSGNode *QQuickRhiItemView::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
+{
+    QQuickRhiItemViewNode *n = static_cast<QQuickRhiItemViewNode *>(node);
+
+    if (!m_source || m_source->window() != window() || width() <= 0 || height() <= 0) {
+        if (m_source && m_source->window() && m_source->window() != window())
+            qWarning("RhiItemView: the source must be in the same window");
+        delete n;
+        return nullptr;
+    }
+
+    QSGTextureProvider *provider = m_source->textureProvider();
+    // The source's node may not have a texture yet, try again once it has.
+    // Until then, further calls reuse the pending connection.
+    if (!provider || !provider->texture()) {
+        delete n;
+        if (m_textureWait && m_textureWaitProvider != provider)
+            disconnect(m_textureWait);
+        if (provider && !m_textureWait) {
+            m_textureWait = connect(provider, &QSGTextureProvider::textureChanged, this, &QQuickItem::update,
+                                    Qt::ConnectionType(Qt::QueuedConnection | Qt::SingleShotConnection));
+            m_textureWaitProvider = provider;
+        }
+        return nullptr;
+    }
+
+    if (!n) {
+        n = new QQuickRhiItemViewNode(window());
+        n->setOwnsTexture(false);
+    }
+
+    n->setProvider(provider, m_mipmap);
+    n->setFiltering(smooth() ? QSGTexture::Linear : QSGTexture::Nearest);
+    n->setTextureCoordinatesTransform(m_mirrorVertically ? QSGSimpleTextureNode::MirrorVertically
+                                                         : QSGSimpleTextureNode::NoTransform);
+    n->setRect(0, 0, width(), height());
+
+    // relative to the source, the node maps it to the pixels of each
+    // texture it gets, also when the source replaces it on the render thread
+    const QSizeF sourceSize = m_source->size();
+    if (m_sourceRect.isEmpty() || sourceSize.isEmpty()) {
+        n->setNormalizedSourceRect(QRectF(0, 0, 1, 1));
+    } else {
+        n->setNormalizedSourceRect(QRectF(m_sourceRect.x() / sourceSize.width(), m_sourceRect.y() / sourceSize.height(),
+                                          m_sourceRect.width() / sourceSize.width(),
+                                          m_sourceRect.height() / sourceSize.height()));
+    }
+
+    return n;
+}
+
+#include "rhiitemview.moc"
@@ -0,0 +1,51 @@
+#ifndef RHIITEMVIEW_H
+#define RHIITEMVIEW_H
+
+#include "rhiitem.h"
+#include <QPointer>
+
+class QQuickRhiItemView : public QQuickItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(RhiItemView)
+
+    Q_PROPERTY(QQuickRhiItem *source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(QRectF sourceRect READ sourceRect WRITE setSourceRect NOTIFY sourceRectChanged)
+    Q_PROPERTY(bool mirrorVertically READ mirrorVertically WRITE setMirrorVertically NOTIFY mirrorVerticallyChanged)
+    Q_PROPERTY(bool mipmap READ mipmap WRITE setMipmap NOTIFY mipmapChanged)
+
+public:
+    QQuickRhiItemView(QQuickItem *parent = nullptr);
+
+    QQuickRhiItem *source() const { return m_source; }
+    void setSource(QQuickRhiItem *item);
+
+    QRectF sourceRect() const { return m_sourceRect; }
+    void setSourceRect(const QRectF &rect);
+
+    bool mirrorVertically() const { return m_mirrorVertically; }
+    void setMirrorVertically(bool enable);
+
+    bool mipmap() const { return m_mipmap; }
+    void setMipmap(bool enable);
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *, UpdatePaintNodeData *) override;
+
+Q_SIGNALS:
+    void sourceChanged();
+    void sourceRectChanged();
+    void mirrorVerticallyChanged();
+    void mipmapChanged();
+
+private:
+    QPointer<QQuickRhiItem> m_source;
+    QRectF m_sourceRect;
+    bool m_mirrorVertically = false;
+    bool m_mipmap = false;
+    // waiting for the source's first texture, single-shot
+    QMetaObject::Connection m_textureWait;
+    const QSGTextureProvider *m_textureWaitProvider = nullptr; // only compared
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "rhiitemcapture.h"
+#include <QFile>
+#include <QImage>
+#include <QMatrix4x4>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <memory>
+
+/*
+    Records a textured quad on the Null backend, which creates every
+    resource and accepts every command without a GPU, so that what is
+    checked is the capture itself: its file format and its replay.
+ */
+
+static const int FRAME_COUNT = 2;
+// beginPass, setGraphicsPipeline, setViewport, setShaderResources,
+// setVertexInput, draw, endPass
+static const int COMMANDS_PER_FRAME = 7;
+
+static const float VERTICES[] = {
+    -1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+     1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     1.0f,  1.0f, 0.0f, 1.0f, 1.0f, 1.0f
+};
+
+static QShader shader(const QString &name)
+{
+    QFile f(name);
+    return f.open(QIODevice::ReadOnly) ? QShader::fromSerialized(f.readAll()) : QShader();
+}
+
+class tst_Capture : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void saveLoadReplay();
+    void saveEmpty();
+    void loadTruncated();
+
+private:
+    bool record(QQuickRhiItemCapture *capture);
+
+    std::unique_ptr<QRhi> m_rhi;
+    QTemporaryDir m_dir;
+};
+
+void tst_Capture::initTestCase()
+{
+    QRhiNullInitParams params;
+    m_rhi.reset(QRhi::create(QRhi::Null, &params));
+    QVERIFY(m_rhi);
+    QVERIFY(m_dir.isValid());
+}
+
+void tst_Capture::cleanupTestCase()
+{
+    m_rhi.reset();
+}
+
+bool tst_Capture::record(QQuickRhiItemCapture *capture)
+{
+    QRhi *rhi = m_rhi.get();
+    std::unique_ptr<QRhiTexture> target(rhi->newTexture(QRhiTexture::RGBA8, QSize(64, 64), 1,
+                                                        QRhiTexture::RenderTarget));
+    if (!target->create())
+        return false;
+    std::unique_ptr<QRhiTextureRenderTarget> rt(rhi->newTextureRenderTarget({ target.get() }));
+    std::unique_ptr<QRhiRenderPassDescriptor> rp(rt->newCompatibleRenderPassDescriptor());
+    rt->setRenderPassDescriptor(rp.get());
+    if (!rt->create())
+        return false;
+
+    std::unique_ptr<QRhiBuffer> vbuf(rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer,
+                                                    sizeof(VERTICES)));
+    std::unique_ptr<QRhiBuffer> ubuf(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, 68));
+    std::unique_ptr<QRhiTexture> texture(rhi->newTexture(QRhiTexture::RGBA8, QSize(16, 16)));
+    std::unique_ptr<QRhiSampler> sampler(rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear,
+                                                         QRhiSampler::None, QRhiSampler::ClampToEdge,
+                                                         QRhiSampler::ClampToEdge));
+    if (!vbuf->create() || !ubuf->create() || !texture->create() || !sampler->create())
+        return false;
+
+    std::unique_ptr<QRhiShaderResourceBindings> srb(rhi->newShaderResourceBindings());
+    srb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage
+                                                     | QRhiShaderResourceBinding::FragmentStage,
+                                                 ubuf.get()),
+        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                  texture.get(), sampler.get())
+    });
+    if (!srb->create())
+        return false;
+
+    std::unique_ptr<QRhiGraphicsPipeline> ps(rhi->newGraphicsPipeline());
+    ps->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+    ps->setShaderStages({
+        { QRhiShaderStage::Vertex, shader(QLatin1String(":/texture.vert.qsb")) },
+        { QRhiShaderStage::Fragment, shader(QLatin1String(":/texture.frag.qsb")) }
+    });
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({ { 6 * sizeof(float) } });
+    inputLayout.setAttributes({
+        { 0, 0, QRhiVertexInputAttribute::Float4, 0 },
+        { 0, 1, QRhiVertexInputAttribute::Float2, 4 * sizeof(float) }
+    });
+    ps->setVertexInputLayout(inputLayout);
+    ps->setShaderResourceBindings(srb.get());
+    ps->setRenderPassDescriptor(rp.get());
+    if (!ps->create())
+        return false;
+
+    QImage image(16, 16, QImage::Format_RGBA8888);
+    image.fill(Qt::red);
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+        QRhiCommandBuffer *commandBuffer = nullptr;
+        if (rhi->beginOffscreenFrame(&commandBuffer) != QRhi::FrameOpSuccess)
+            return false;
+        capture->beginFrame(rhi);
+
+        QRhiResourceUpdateBatch *rub = rhi->nextResourceUpdateBatch();
+        if (frame == 0) {
+            rub->uploadStaticBuffer(vbuf.get(), VERTICES);
+            rub->uploadTexture(texture.get(), image);
+        }
+        QMatrix4x4 mvp;
+        mvp.rotate(frame * 10.0f, 0, 0, 1);
+        const qint32 flip = 0;
+        rub->updateDynamicBuffer(ubuf.get(), 0, 64, mvp.constData());
+        rub->updateDynamicBuffer(ubuf.get(), 64, 4, &flip);
+
+        QQuickRhiItemCommandRecorder cb(commandBuffer, capture);
+        cb.beginPass(rt.get(), Qt::black, { 1.0f, 0 }, rub);
+        cb.setGraphicsPipeline(ps.get());
+        cb.setViewport({ 0, 0, 64, 64 });
+        cb.setShaderResources();
+        const QRhiCommandBuffer::VertexInput vertexInput(vbuf.get(), 0);
+        cb.setVertexInput(0, 1, &vertexInput);
+        cb.draw(4);
+        cb.endPass();
+
+        capture->endFrame();
+        rhi->endOffscreenFrame();
+    }
+    return true;
+}
+
+void tst_Capture::saveLoadReplay()
+{
+    QQuickRhiItemCapture capture;
+    QVERIFY(record(&capture));
+    QCOMPARE(capture.frameCount(), FRAME_COUNT);
+    for (int frame = 0; frame < FRAME_COUNT; ++frame)
+        QCOMPARE(capture.commandCount(frame), COMMANDS_PER_FRAME);
+    QVERIFY(capture.resourceCount() > 0);
+    QVERIFY(capture.validate());
+
+    const QString fileName = m_dir.filePath(QLatin1String("quad.qric"));
+    QVERIFY(capture.save(fileName));
+
+    QQuickRhiItemCapture loaded;
+    QVERIFY(loaded.load(fileName));
+    QVERIFY(loaded.validate());
+    QCOMPARE(loaded.backendName(), capture.backendName());
+    QCOMPARE(loaded.frameCount(), capture.frameCount());
+    QCOMPARE(loaded.resourceCount(), capture.resourceCount());
+    for (int frame = 0; frame < loaded.frameCount(); ++frame)
+        QCOMPARE(loaded.commandCount(frame), capture.commandCount(frame));
+
+    QVERIFY(loaded.createResources(m_rhi.get()));
+    for (int frame = 0; frame < loaded.frameCount(); ++frame) {
+        QRhiCommandBuffer *cb = nullptr;
+        QCOMPARE(m_rhi->beginOffscreenFrame(&cb), QRhi::FrameOpSuccess);
+        loaded.replayFrame(cb, frame);
+        QCOMPARE(m_rhi->endOffscreenFrame(), QRhi::FrameOpSuccess);
+    }
+    loaded.releaseResources();
+}
+
+void tst_Capture::saveEmpty()
+{
+    QQuickRhiItemCapture capture;
+    capture.beginFrame(m_rhi.get());
+    capture.endFrame();
+    const QString fileName = m_dir.filePath(QLatin1String("empty.qric"));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QLatin1String("^No commands were recorded")));
+    QVERIFY(!capture.save(fileName));
+}
+
+void tst_Capture::loadTruncated()
+{
+    QQuickRhiItemCapture capture;
+    QVERIFY(record(&capture));
+    const QString fileName = m_dir.filePath(QLatin1String("truncated.qric"));
+    QVERIFY(capture.save(fileName));
+    QFile f(fileName);
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    QVERIFY(f.resize(f.size() / 2));
+    f.close();
+
+    QQuickRhiItemCapture loaded;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QLatin1String("^Corrupt capture")));
+    QVERIFY(!loaded.load(fileName));
+    QCOMPARE(loaded.frameCount(), 0);
+    QCOMPARE(loaded.resourceCount(), 0);
+}
+
+QTEST_MAIN(tst_Capture)
+
+#include "tst_capture.moc"
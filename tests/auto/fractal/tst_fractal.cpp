@@ -0,0 +1,81 @@
+#include "fractalrhiitem.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QtTest>
+
+// Float precision differs between the compute and fragment stages, pixels
+// near the set's boundary may take a different iteration count.
+static const int CHANNEL_TOLERANCE = 8;
+static const qreal MISMATCH_TOLERANCE = 0.01;
+
+class tst_Fractal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void computeMatchesRaster();
+};
+
+void tst_Fractal::initTestCase()
+{
+    // the basic render loop, so that the window's QRhi can be queried
+    // on the GUI thread
+    qputenv("QSG_RHI_BACKEND", "opengl");
+    qputenv("QSG_RENDER_LOOP", "basic");
+}
+
+void tst_Fractal::computeMatchesRaster()
+{
+    QQuickWindow window;
+    window.resize(160, 120);
+    FractalRhiItem *item = new FractalRhiItem;
+    item->setParentItem(window.contentItem());
+    item->setSize(QSizeF(160, 120));
+    item->setCenter(QPointF(-0.75, 0.1));
+    item->setZoom(2.0);
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+
+    const QImage compute = window.grabWindow().convertToFormat(QImage::Format_RGBA8888);
+    if (compute.isNull())
+        QSKIP("The scenegraph cannot render with OpenGL here");
+    QRhi *rhi = static_cast<QRhi *>(window.rendererInterface()->getResource(&window, QSGRendererInterface::RhiResource));
+    QVERIFY(rhi);
+    if (!rhi->isFeatureSupported(QRhi::Compute))
+        QSKIP("Compute is not supported");
+
+    item->setComputeOutput(false);
+    const QImage raster = window.grabWindow().convertToFormat(QImage::Format_RGBA8888);
+    QCOMPARE(raster.size(), compute.size());
+
+    qsizetype mismatches = 0;
+    for (int y = 0; y < compute.height(); ++y) {
+        const uchar *a = compute.constScanLine(y);
+        const uchar *b = raster.constScanLine(y);
+        for (int x = 0; x < compute.width(); ++x) {
+            for (int c = 0; c < 4; ++c) {
+                if (qAbs(int(a[x * 4 + c]) - int(b[x * 4 + c])) > CHANNEL_TOLERANCE) {
+                    ++mismatches;
+                    break;
+                }
+            }
+        }
+    }
+    const qreal ratio = qreal(mismatches) / (compute.width() * compute.height());
+    QVERIFY2(ratio <= MISMATCH_TOLERANCE,
+             qPrintable(QStringLiteral("%1 of %2 pixels differ").arg(mismatches).arg(compute.width() * compute.height())));
+
+    // not trivially equal, such as both cleared only
+    QSet<QRgb> colors;
+    for (int y = 0; y < compute.height(); y += 8) {
+        for (int x = 0; x < compute.width(); x += 8)
+            colors.insert(compute.pixel(x, y));
+    }
+    QVERIFY(colors.count() > 2);
+}
+
+QTEST_MAIN(tst_Fractal)
+
+#include "tst_fractal.moc"
@@ -0,0 +1,109 @@
+#include "rhiitem.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QMutex>
+#include <QQuickWindow>
+#include <QSet>
+#include <QtTest>
+#include <atomic>
+
+// Each upload is exactly the budget, so one is submitted per frame.
+static const QSize UPLOAD_SIZE(512, 512);
+static const int UPLOAD_BYTES = 512 * 512 * 4;
+static const int UPLOAD_COUNT = 10;
+
+struct UploadLog
+{
+    std::atomic<int> frame = 0;
+    QMutex mutex;
+    QList<int> uploadFrames;
+};
+
+class UploadRenderer : public QQuickRhiItemRenderer
+{
+public:
+    UploadRenderer(UploadLog *log) : m_log(log) { }
+    ~UploadRenderer() { qDeleteAll(m_textures); }
+
+    void initialize(QRhi *rhi, QRhiTexture *) override
+    {
+        if (!m_textures.isEmpty())
+            return;
+        QImage image(UPLOAD_SIZE, QImage::Format_RGBA8888);
+        image.fill(Qt::red);
+        for (int i = 0; i < UPLOAD_COUNT; ++i) {
+            QRhiTexture *t = rhi->newTexture(QRhiTexture::RGBA8, UPLOAD_SIZE);
+            QVERIFY(t->create());
+            m_textures.append(t);
+            scheduleTextureUpload(t, QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(image)));
+        }
+    }
+
+    void textureUploaded(QRhiTexture *) override
+    {
+        // no update(), the scheduler alone has to keep the frames coming
+        QMutexLocker lock(&m_log->mutex);
+        m_log->uploadFrames.append(m_log->frame.load());
+    }
+
+private:
+    UploadLog *m_log;
+    QList<QRhiTexture *> m_textures;
+};
+
+class UploadItem : public QQuickRhiItem
+{
+    Q_OBJECT
+
+public:
+    UploadItem(UploadLog *log) : m_log(log) { }
+    QQuickRhiItemRenderer *createRenderer() override { return new UploadRenderer(m_log); }
+
+private:
+    UploadLog *m_log;
+};
+
+class tst_RhiItemScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void uploadsDrainInStaticScene();
+};
+
+void tst_RhiItemScheduler::initTestCase()
+{
+    // frames requested from the render thread come without a sync with the
+    // threaded render loop only
+    qputenv("QSG_RHI_BACKEND", "null");
+    qputenv("QSG_RENDER_LOOP", "threaded");
+    qputenv("QSG_RHIITEM_UPLOAD_BUDGET", QByteArray::number(UPLOAD_BYTES));
+}
+
+void tst_RhiItemScheduler::uploadsDrainInStaticScene()
+{
+    UploadLog log;
+    QQuickWindow window;
+    window.resize(200, 200);
+    connect(&window, &QQuickWindow::afterFrameEnd, &window, [&log] { ++log.frame; }, Qt::DirectConnection);
+    UploadItem *item = new UploadItem(&log);
+    item->setParentItem(window.contentItem());
+    item->setSize(QSizeF(100, 100));
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+
+    // nothing changes on the GUI thread from here on
+    auto uploadCount = [&log] {
+        QMutexLocker lock(&log.mutex);
+        return log.uploadFrames.count();
+    };
+    QTRY_COMPARE(uploadCount(), UPLOAD_COUNT);
+
+    QMutexLocker lock(&log.mutex);
+    const QSet<int> frames(log.uploadFrames.cbegin(), log.uploadFrames.cend());
+    QCOMPARE(frames.count(), UPLOAD_COUNT);
+}
+
+QTEST_MAIN(tst_RhiItemScheduler)
+
+#include "tst_rhiitemscheduler.moc"
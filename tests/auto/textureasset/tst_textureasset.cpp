@@ -0,0 +1,311 @@
+#include "rhiitemtextureasset.h"
+#include <QColor>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include <functional>
+
+/*
+    The CPU decoders are tested one 4x4 block per format, built by hand so
+    that each index, mode and modifier of interest appears, against the
+    pixels the format specifications give for them.
+ */
+
+using PixelFunction = std::function<QColor(int x, int y)>;
+
+static QList<QColor> image(const QSize &size, const PixelFunction &pixel)
+{
+    QList<QColor> pixels;
+    for (int y = 0; y < size.height(); ++y) {
+        for (int x = 0; x < size.width(); ++x)
+            pixels.append(pixel(x, y));
+    }
+    return pixels;
+}
+
+static QList<QColor> block(const PixelFunction &pixel)
+{
+    return image(QSize(4, 4), pixel);
+}
+
+// the alpha of BC3, and the red of BC4 and BC5, for 3-bit index i of a
+// block with a0 = 255 and a1 = 0: the eight value mode
+static const int EIGHT_VALUES[8] = { 255, 0, 218, 182, 145, 109, 72, 36 };
+// a0 = 0 and a1 = 255: the six value mode, with 0 and 255
+static const int SIX_VALUES[8] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+
+// the pixel indices of the BC3 to BC5 blocks, i & 7 for pixel i
+static const char *BC4_INDICES = "88C6FA88C6FA";
+
+static const int KTX2_HEADER_SIZE = 80;
+static const int KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+static const quint32 VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+
+// a KTX2 file of one level, by default with the level index pointing at
+// data
+static QByteArray ktx2(quint32 vkFormat, const QSize &size, const QByteArray &data,
+                       quint64 offset = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_ENTRY_SIZE,
+                       quint64 length = ~quint64(0))
+{
+    static const uchar identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    QByteArray file(KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_ENTRY_SIZE, 0);
+    uchar *p = reinterpret_cast<uchar *>(file.data());
+    memcpy(p, identifier, 12);
+    const quint32 fields[9] = { vkFormat, 1, quint32(size.width()), quint32(size.height()), 0, 0, 1, 1, 0 };
+    for (int i = 0; i < 9; ++i)
+        qToLittleEndian<quint32>(fields[i], p + 12 + i * 4);
+    qToLittleEndian<quint64>(offset, p + KTX2_HEADER_SIZE);
+    qToLittleEndian<quint64>(length == ~quint64(0) ? quint64(data.size()) : length, p + KTX2_HEADER_SIZE + 8);
+    qToLittleEndian<quint64>(quint64(data.size()), p + KTX2_HEADER_SIZE + 16);
+    return file + data;
+}
+
+class tst_TextureAsset : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void decode_data();
+    void decode();
+    void notDecodable();
+
+    void openKtx2();
+    void corruptKtx2_data();
+    void corruptKtx2();
+    void checkerboard();
+};
+
+void tst_TextureAsset::decode_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QList<QColor>>("expected");
+
+    // c0 red > c1 blue: four colors, the index is x
+    QTest::newRow("BC1") << int(QRhiTexture::BC1) << QSize(4, 4)
+                         << QByteArray::fromHex("00F81F00E4E4E4E4")
+                         << block([](int x, int) {
+        static const QColor colors[4] = { QColor(255, 0, 0), QColor(0, 0, 255), QColor(170, 0, 85), QColor(85, 0, 170) };
+        return colors[x];
+    });
+
+    // c0 <= c1: three colors and black, opaque since QRhi's BC1 is RGB
+    QTest::newRow("BC1 three colors") << int(QRhiTexture::BC1) << QSize(4, 4)
+                                      << QByteArray::fromHex("00080010E4E4E4E4")
+                                      << block([](int x, int) {
+        static const QColor colors[4] = { QColor(8, 0, 0), QColor(16, 0, 0), QColor(12, 0, 0), QColor(0, 0, 0) };
+        return colors[x];
+    });
+
+    // only the pixels inside the image are written
+    QTest::newRow("BC1 partial block") << int(QRhiTexture::BC1) << QSize(3, 2)
+                                       << QByteArray::fromHex("00F81F00E4E4E4E4")
+                                       << image(QSize(3, 2), [](int x, int) {
+        static const QColor colors[3] = { QColor(255, 0, 0), QColor(0, 0, 255), QColor(170, 0, 85) };
+        return colors[x];
+    });
+
+    // explicit 4-bit alpha, pixel i has alpha i, the color block is white
+    // and always in four color mode
+    QTest::newRow("BC2") << int(QRhiTexture::BC2) << QSize(4, 4)
+                         << QByteArray::fromHex("1032547698BADCFE" "FFFF000000000000")
+                         << block([](int x, int y) {
+        return QColor(255, 255, 255, (y * 4 + x) * 17);
+    });
+
+    QTest::newRow("BC3") << int(QRhiTexture::BC3) << QSize(4, 4)
+                         << QByteArray::fromHex(QByteArray("FF00") + BC4_INDICES + "E007000000000000")
+                         << block([](int x, int y) {
+        return QColor(0, 255, 0, EIGHT_VALUES[(y * 4 + x) & 7]);
+    });
+
+    // as sampled from R8
+    QTest::newRow("BC4") << int(QRhiTexture::BC4) << QSize(4, 4)
+                         << QByteArray::fromHex(QByteArray("FF00") + BC4_INDICES)
+                         << block([](int x, int y) {
+        return QColor(EIGHT_VALUES[(y * 4 + x) & 7], 0, 0);
+    });
+
+    // as sampled from RG8, green in the six value mode
+    QTest::newRow("BC5") << int(QRhiTexture::BC5) << QSize(4, 4)
+                         << QByteArray::fromHex(QByteArray("FF00") + BC4_INDICES + "00FF" + BC4_INDICES)
+                         << block([](int x, int y) {
+        const int i = (y * 4 + x) & 7;
+        return QColor(EIGHT_VALUES[i], SIX_VALUES[i], 0);
+    });
+
+    // individual mode, not flipped: the left 2x4 sub-block is 136 with
+    // table 0, the right one 68 with table 1, the index is y
+    const PixelFunction individual = [](int x, int y) {
+        static const int left[4] = { 136 + 2, 136 + 8, 136 - 2, 136 - 8 };
+        static const int right[4] = { 68 + 5, 68 + 17, 68 - 5, 68 - 17 };
+        const int v = x < 2 ? left[y] : right[y];
+        return QColor(v, v, v);
+    };
+    QTest::newRow("ETC2_RGB8") << int(QRhiTexture::ETC2_RGB8) << QSize(4, 4)
+                               << QByteArray::fromHex("84848404CCCCAAAA")
+                               << block(individual);
+
+    // differential mode without the opaque bit: index 2 is transparent
+    // black, index 0 has no modifier
+    QTest::newRow("ETC2_RGB8A1") << int(QRhiTexture::ETC2_RGB8A1) << QSize(4, 4)
+                                 << QByteArray::fromHex("80808000CCCCAAAA")
+                                 << block([](int, int y) {
+        static const QColor colors[4] = { QColor(132, 132, 132), QColor(140, 140, 140),
+                                          QColor(0, 0, 0, 0), QColor(124, 124, 124) };
+        return colors[y];
+    });
+
+    // EAC alpha: base 128, multiplier 1, table 13, the index is y
+    QTest::newRow("ETC2_RGBA8") << int(QRhiTexture::ETC2_RGBA8) << QSize(4, 4)
+                                << QByteArray::fromHex("801D053053053053" "84848404CCCCAAAA")
+                                << block([individual](int x, int y) {
+        static const int alpha[4] = { 128 - 1, 128 - 2, 128 - 3, 128 - 10 };
+        QColor c = individual(x, y);
+        c.setAlpha(alpha[y]);
+        return c;
+    });
+}
+
+void tst_TextureAsset::decode()
+{
+    QFETCH(int, format);
+    QFETCH(QSize, size);
+    QFETCH(QByteArray, data);
+    QFETCH(QList<QColor>, expected);
+
+    const QRhiTexture::Format f = QRhiTexture::Format(format);
+    QVERIFY(QQuickRhiItemTextureAsset::isDecodable(f));
+    const QByteArray pixels = QQuickRhiItemTextureAsset::decode(f, size, reinterpret_cast<const uchar *>(data.constData()));
+    QCOMPARE(pixels.size(), size.width() * size.height() * 4);
+
+    const uchar *p = reinterpret_cast<const uchar *>(pixels.constData());
+    for (int i = 0; i < expected.count(); ++i, p += 4) {
+        const QColor actual(p[0], p[1], p[2], p[3]);
+        const QColor &e(expected.at(i));
+        QVERIFY2(actual == e, qPrintable(QString::asprintf("pixel (%d, %d) is (%d, %d, %d, %d) instead of (%d, %d, %d, %d)",
+                                                           i % size.width(), i / size.width(),
+                                                           p[0], p[1], p[2], p[3],
+                                                           e.red(), e.green(), e.blue(), e.alpha())));
+    }
+}
+
+void tst_TextureAsset::notDecodable()
+{
+    const QByteArray data(16, 0);
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    for (QRhiTexture::Format f : { QRhiTexture::BC6H, QRhiTexture::BC7, QRhiTexture::ASTC_4x4 }) {
+        QVERIFY(!QQuickRhiItemTextureAsset::isDecodable(f));
+        QVERIFY(QQuickRhiItemTextureAsset::decode(f, QSize(4, 4), p).isEmpty());
+    }
+}
+
+void tst_TextureAsset::openKtx2()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QLatin1String("bc1.ktx2"));
+    const QByteArray data = QByteArray::fromHex("00F81F00E4E4E4E4");
+    {
+        QFile f(fileName);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(ktx2(VK_FORMAT_BC1_RGB_UNORM_BLOCK, QSize(4, 4), data));
+    }
+
+    QQuickRhiItemTextureAsset asset;
+    QVERIFY(asset.open(fileName));
+    QCOMPARE(asset.format(), QRhiTexture::BC1);
+    QVERIFY(!asset.isSRGB());
+    QVERIFY(!asset.isCubeMap());
+    QVERIFY(!asset.needsDecoding());
+    QCOMPARE(asset.size(), QSize(4, 4));
+    QCOMPARE(asset.levelCount(), 1);
+    QCOMPARE(asset.byteSize(), quint64(8));
+    QCOMPARE(asset.uncompressedByteSize(), quint64(64));
+
+    const QRhiTextureUploadDescription desc = asset.uploadDescription();
+    QCOMPARE(desc.entryCount(), 1);
+    QCOMPARE(desc.entryAt(0).level(), 0);
+    QCOMPARE(desc.entryAt(0).layer(), 0);
+    QCOMPARE(desc.entryAt(0).description().data(), data);
+}
+
+void tst_TextureAsset::corruptKtx2_data()
+{
+    const qint64 fileSize = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_ENTRY_SIZE + 8;
+
+    QTest::addColumn<quint64>("offset");
+    QTest::addColumn<quint64>("length");
+
+    QTest::newRow("offset past the end") << quint64(fileSize) << quint64(8);
+    QTest::newRow("length past the end") << quint64(fileSize - 8) << quint64(16);
+    QTest::newRow("negative offset") << ~quint64(7) << quint64(8);
+    // offset + length would overflow to a negative number
+    QTest::newRow("offset overflowing") << quint64(0x7FFFFFFFFFFFFFF8) << quint64(16);
+    QTest::newRow("length overflowing") << quint64(fileSize - 8) << quint64(0x7FFFFFFFFFFFFFFF);
+}
+
+void tst_TextureAsset::corruptKtx2()
+{
+    QFETCH(quint64, offset);
+    QFETCH(quint64, length);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QLatin1String("corrupt.ktx2"));
+    {
+        QFile f(fileName);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(ktx2(VK_FORMAT_BC1_RGB_UNORM_BLOCK, QSize(4, 4), QByteArray(8, 0), offset, length));
+    }
+
+    QQuickRhiItemTextureAsset asset;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QLatin1String("^Truncated or corrupt KTX2 file")));
+    QVERIFY(!asset.open(fileName));
+    QVERIFY(!asset.isOpen());
+}
+
+// the backdrop of TiledImageRhiItem
+void tst_TextureAsset::checkerboard()
+{
+    QQuickRhiItemTextureAsset asset;
+    QVERIFY(asset.open(QLatin1String(":/checker.bc1.ktx2")));
+    QCOMPARE(asset.format(), QRhiTexture::BC1);
+    QCOMPARE(asset.size(), QSize(64, 64));
+    QCOMPARE(asset.levelCount(), 7);
+
+    const QRhiTextureUploadDescription desc = asset.uploadDescription();
+    QCOMPARE(desc.entryCount(), 7);
+
+    // 8x8 squares on level 0
+    const QByteArray level0 = desc.entryAt(0).description().data();
+    QCOMPARE(level0.size(), 16 * 16 * 8);
+    const QByteArray pixels = QQuickRhiItemTextureAsset::decode(QRhiTexture::BC1, QSize(64, 64),
+                                                                reinterpret_cast<const uchar *>(level0.constData()));
+    auto pixel = [&pixels](int x, int y) {
+        const uchar *p = reinterpret_cast<const uchar *>(pixels.constData()) + (y * 64 + x) * 4;
+        return QColor(p[0], p[1], p[2], p[3]);
+    };
+    const QColor light(98, 101, 98);
+    const QColor dark(74, 72, 74);
+    QCOMPARE(pixel(0, 0), light);
+    QCOMPARE(pixel(7, 7), light);
+    QCOMPARE(pixel(8, 0), dark);
+    QCOMPARE(pixel(0, 8), dark);
+    QCOMPARE(pixel(8, 8), light);
+    QCOMPARE(pixel(63, 63), light);
+
+    // the levels with squares smaller than a pixel are the average
+    const QByteArray level6 = desc.entryAt(6).description().data();
+    QCOMPARE(level6.size(), 8);
+    const QByteArray average = QQuickRhiItemTextureAsset::decode(QRhiTexture::BC1, QSize(1, 1),
+                                                                 reinterpret_cast<const uchar *>(level6.constData()));
+    QCOMPARE(average.size(), 4);
+    const uchar *p = reinterpret_cast<const uchar *>(average.constData());
+    QCOMPARE(QColor(p[0], p[1], p[2], p[3]), QColor(82, 85, 82));
+}
+
+QTEST_GUILESS_MAIN(tst_TextureAsset)
+
+#include "tst_textureasset.moc"
@@ -0,0 +1,339 @@
+#include "customrhiitem.h"
+#include "rhiitemtilepyramid.h"
+#include "tiledimagerhiitem.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QEventLoop>
+#include <QQuickWindow>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QtTest>
+
+/*
+    Benchmarks of the CPU side of QQuickRhiItem and TestRenderer, on the
+    Null QRhi backend with the basic render loop, so that the frames are
+    rendered on the GUI thread and nothing waits for a GPU.
+
+    The item and node paths are measured over whole frames in which only
+    the path in question has work to do. The renderer's synchronize() and
+    updateMvp() are called directly, on a QRhi of their own. Without an
+    item, the renderer's background is uploaded right away in an offscreen
+    frame instead of through the frame scheduler.
+
+    allocations() is a plain test: it fails when a frame in a steady state,
+    where the item size is stable, creates graphics resources.
+ */
+
+static const QSize ITEM_SIZE(64, 64);
+static const QSize RESIZED_ITEM_SIZE(48, 48);
+
+class Scene
+{
+public:
+    Scene(int itemCount)
+    {
+        window.resize(1280, 720);
+        for (int i = 0; i < itemCount; ++i) {
+            TestRhiItem *item = new TestRhiItem;
+            item->setParentItem(window.contentItem());
+            item->setPosition(QPointF((i % 20) * ITEM_SIZE.width(), (i / 20 % 11) * ITEM_SIZE.height()));
+            item->setSize(ITEM_SIZE);
+            item->setMessage(QLatin1String("benchmark"));
+            items.append(item);
+        }
+    }
+
+    // the first frames create the textures and renderers, and upload the
+    // backgrounds within the upload budget
+    bool start()
+    {
+        window.show();
+        quint64 renderCount = 0;
+        for (int i = 0; i < 1000; ++i) {
+            if (!renderFrame())
+                return false;
+            const quint64 n = stats().renderCount;
+            if (i > 2 && n == renderCount)
+                return true;
+            renderCount = n;
+        }
+        return false;
+    }
+
+    bool renderFrame()
+    {
+        QEventLoop loop;
+        QObject::connect(&window, &QQuickWindow::frameSwapped, &loop, &QEventLoop::quit);
+        QTimer::singleShot(5000, &loop, [&loop] { loop.exit(1); });
+        window.update();
+        return loop.exec() == 0;
+    }
+
+    QQuickRhiItem::Stats stats() const
+    {
+        QQuickRhiItem::Stats total;
+        for (const TestRhiItem *item : items) {
+            const QQuickRhiItem::Stats s = item->stats();
+            total.renderCount += s.renderCount;
+            total.resourceAllocationCount += s.resourceAllocationCount;
+        }
+        return total;
+    }
+
+    QQuickWindow window;
+    QList<TestRhiItem *> items;
+};
+
+using Step = void (*)(TestRhiItem *item, int frame);
+Q_DECLARE_METATYPE(Step)
+
+static void rotate(TestRhiItem *item, int frame)
+{
+    item->setCubeRotation(QVector3D(30, frame % 360, 0));
+}
+
+static void latch(TestRhiItem *item, int frame)
+{
+    item->dragRotation.publish(QVector3D(0, frame % 360, 0));
+}
+
+static void changeMessage(TestRhiItem *item, int frame)
+{
+    item->setMessage(QString::number(frame));
+}
+
+static void touch(TestRhiItem *item, int)
+{
+    item->update();
+}
+
+static void resize(TestRhiItem *item, int frame)
+{
+    item->setSize(frame % 2 ? ITEM_SIZE : RESIZED_ITEM_SIZE);
+}
+
+static void toggleMipmap(TestRhiItem *item, int frame)
+{
+    item->setMipmap(frame % 2);
+}
+
+class tst_BenchRhiItem : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void nodeSync_data();
+    void nodeSync();
+    void texture_data();
+    void texture();
+    void rendererSynchronize_data();
+    void rendererSynchronize();
+    void updateMvp();
+    void updatePaintNode_data();
+    void updatePaintNode();
+    void tiles();
+
+    void allocations_data();
+    void allocations();
+
+private:
+    void benchmarkFrames(int itemCount, Step step);
+};
+
+void tst_BenchRhiItem::initTestCase()
+{
+    qputenv("QSG_RHI_BACKEND", "null");
+    qputenv("QSG_RENDER_LOOP", "basic");
+}
+
+void tst_BenchRhiItem::benchmarkFrames(int itemCount, Step step)
+{
+    Scene scene(itemCount);
+    QVERIFY(scene.start());
+
+    int frame = 0;
+    QBENCHMARK {
+        ++frame;
+        for (TestRhiItem *item : std::as_const(scene.items))
+            step(item, frame);
+        QVERIFY(scene.renderFrame());
+    }
+}
+
+void tst_BenchRhiItem::nodeSync_data()
+{
+    QTest::addColumn<Step>("step");
+    QTest::newRow("unchanged size") << Step(touch);
+    QTest::newRow("changed size") << Step(resize);
+}
+
+void tst_BenchRhiItem::nodeSync()
+{
+    QFETCH(Step, step);
+    benchmarkFrames(100, step);
+}
+
+void tst_BenchRhiItem::texture_data()
+{
+    QTest::addColumn<Step>("step");
+    // a texture from the pool each frame, initialize() rebuilds the targets
+    QTest::newRow("recreate") << Step(toggleMipmap);
+    QTest::newRow("resize in place") << Step(resize);
+}
+
+void tst_BenchRhiItem::texture()
+{
+    QFETCH(Step, step);
+    benchmarkFrames(100, step);
+}
+
+void tst_BenchRhiItem::rendererSynchronize_data()
+{
+    QTest::addColumn<Step>("step");
+    QTest::newRow("rotation") << Step(rotate);
+    // updateCubeTexture()
+    QTest::newRow("message") << Step(changeMessage);
+}
+
+void tst_BenchRhiItem::rendererSynchronize()
+{
+    QFETCH(Step, step);
+
+    QRhiNullInitParams params;
+    QScopedPointer<QRhi> rhi(QRhi::create(QRhi::Null, &params));
+    QVERIFY(rhi);
+    QScopedPointer<QRhiTexture> output(rhi->newTexture(QRhiTexture::RGBA8, ITEM_SIZE, 1, QRhiTexture::RenderTarget));
+    QVERIFY(output->create());
+    TestRhiItem item;
+    {
+        TestRenderer renderer;
+        renderer.initialize(rhi.data(), output.data());
+        renderer.synchronize(&item);
+
+        int frame = 0;
+        QBENCHMARK {
+            step(&item, ++frame);
+            renderer.synchronize(&item);
+        }
+    }
+}
+
+void tst_BenchRhiItem::updateMvp()
+{
+    QRhiNullInitParams params;
+    QScopedPointer<QRhi> rhi(QRhi::create(QRhi::Null, &params));
+    QVERIFY(rhi);
+    QScopedPointer<QRhiTexture> output(rhi->newTexture(QRhiTexture::RGBA8, ITEM_SIZE, 1, QRhiTexture::RenderTarget));
+    QVERIFY(output->create());
+    TestRhiItem item;
+    {
+        TestRenderer renderer;
+        renderer.initialize(rhi.data(), output.data());
+        rotate(&item, 1);
+        renderer.synchronize(&item);
+
+        // the rotation stays dirty until render(), so each prepare()
+        // computes the matrix again
+        QBENCHMARK {
+            renderer.prepare();
+        }
+    }
+}
+
+void tst_BenchRhiItem::updatePaintNode_data()
+{
+    QTest::addColumn<int>("itemCount");
+    QTest::newRow("1 item") << 1;
+    QTest::newRow("100 items") << 100;
+    QTest::newRow("1000 items") << 1000;
+}
+
+void tst_BenchRhiItem::updatePaintNode()
+{
+    QFETCH(int, itemCount);
+    benchmarkFrames(itemCount, rotate);
+}
+
+void tst_BenchRhiItem::tiles()
+{
+    // panning and zooming over a pyramid, the tiles are decoded on the
+    // thread pool and uploaded through the frame scheduler
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QLatin1String("bench.qrtp"));
+    const QSize imageSize(4096, 4096);
+    const bool written = QQuickRhiItemTilePyramid::write(fileName, imageSize, 256, "png",
+                                                         [](int level, const QRect &rect) {
+        QImage image(rect.size(), QImage::Format_RGB32);
+        image.fill(QColor::fromHsv((level * 60 + rect.x() / 16 + rect.y() / 16) % 360, 128, 255));
+        return image;
+    });
+    QVERIFY(written);
+
+    QQuickWindow window;
+    window.resize(1280, 720);
+    TiledImageRhiItem *item = new TiledImageRhiItem;
+    item->setParentItem(window.contentItem());
+    item->setSize(window.size());
+    item->setSource(QUrl::fromLocalFile(fileName));
+    QCOMPARE(item->imageSize(), imageSize);
+    window.show();
+
+    auto renderFrame = [&window] {
+        QEventLoop loop;
+        QObject::connect(&window, &QQuickWindow::frameSwapped, &loop, &QEventLoop::quit);
+        QTimer::singleShot(5000, &loop, [&loop] { loop.exit(1); });
+        window.update();
+        return loop.exec() == 0;
+    };
+
+    // from fitting the whole image to 1:1 and back, along a diagonal
+    const qreal fitZoom = qMin(window.width() / qreal(imageSize.width()), window.height() / qreal(imageSize.height()));
+    const int period = 200;
+    int frame = 0;
+    QBENCHMARK {
+        const qreal t = 1.0 - qAbs(1.0 - 2.0 * (frame++ % period) / period);
+        item->setZoom(fitZoom + t * (1.0 - fitZoom));
+        item->setCenter(QPointF(imageSize.width() * (0.25 + 0.5 * t), imageSize.height() * (0.25 + 0.5 * t)));
+        QVERIFY(renderFrame());
+    }
+}
+
+void tst_BenchRhiItem::allocations_data()
+{
+    QTest::addColumn<Step>("step");
+    QTest::newRow("unchanged") << Step(touch);
+    QTest::newRow("rotation") << Step(rotate);
+    QTest::newRow("latch") << Step(latch);
+    QTest::newRow("message") << Step(changeMessage);
+}
+
+void tst_BenchRhiItem::allocations()
+{
+    QFETCH(Step, step);
+
+    Scene scene(100);
+    QVERIFY(scene.start());
+    // one frame for the transition, the stats lag one frame behind
+    for (TestRhiItem *item : std::as_const(scene.items))
+        step(item, 0);
+    QVERIFY(scene.renderFrame());
+    QVERIFY(scene.renderFrame());
+    const QQuickRhiItem::Stats before = scene.stats();
+
+    for (int frame = 1; frame <= 50; ++frame) {
+        for (TestRhiItem *item : std::as_const(scene.items))
+            step(item, frame);
+        QVERIFY(scene.renderFrame());
+    }
+    QVERIFY(scene.renderFrame());
+    const QQuickRhiItem::Stats after = scene.stats();
+
+    QVERIFY(after.renderCount > before.renderCount);
+    QCOMPARE(after.resourceAllocationCount - before.resourceAllocationCount, quint64(0));
+}
+
+QTEST_MAIN(tst_BenchRhiItem)
+
+#include "tst_bench_rhiitem.moc"
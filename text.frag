@@ -0,0 +1,21 @@
+#version 440
+
+layout(location = 0) in vec2 v_texcoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 matrix;
+    vec4 color;
+};
+
+layout(binding = 1) uniform sampler2D atlas;
+
+void main()
+{
+    // 0.5 is the outline, the width of the transition follows the
+    // screen space derivatives so that the edges stay sharp at any scale
+    float d = texture(atlas, v_texcoord).r;
+    float w = max(fwidth(d), 0.0001);
+    fragColor = color * smoothstep(0.5 - w, 0.5 + w, d);
+}
@@ -0,0 +1,19 @@
+import QtQuick
+import TestApp
+
+// A scene for the batch rendering mode, see batchrender.cpp.
+Rectangle {
+    id: root
+    color: "lightGray"
+
+    property alias message: renderer.message
+
+    TestRhiItem {
+        id: renderer
+        anchors.fill: parent
+        anchors.margins: 16
+        cubeRotation.x: 30
+        NumberAnimation on cubeRotation.y { from: 0; to: 360; duration: 2000; loops: -1 }
+        message: "Batch"
+    }
+}
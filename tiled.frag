@@ -0,0 +1,12 @@
+#version 440
+
+layout(location = 0) in vec2 v_uv;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(binding = 1) uniform sampler2D cache;
+
+void main()
+{
+    fragColor = texture(cache, v_uv);
+}
@@ -0,0 +1,17 @@
+#version 440
+
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 rect;
+layout(location = 2) in vec4 uvRect;
+
+layout(location = 0) out vec2 v_uv;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 mvp;
+};
+
+void main()
+{
+    v_uv = uvRect.xy + corner * uvRect.zw;
+    gl_Position = mvp * vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+}
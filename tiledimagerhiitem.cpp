@@ -0,0 +1,536 @@
+#include "tiledimagerhiitem.h"
+#include "rhiitemcapture.h"
+#include <QFile>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QtMath>
+#include <cmath>
+#include <QtQml/qqmlfile.h>
+
+/*
+    A viewer for images of any size, e.g. gigapixel scans, panned by dragging
+    and zoomed with the mouse wheel. The image is a tile pyramid created with
+    the tilegen tool, memory-mapped by QQuickRhiItemTilePyramid.
+
+    The GPU memory used is constant: tiles live in the slots of a fixed-size
+    cache texture, only larger for pyramids with tiles above its size, with a page table mapping the tiles to the slots and the
+    least recently used slots being reused. Only the tiles visible at the
+    level of detail matching the zoom are requested. They are decoded on
+    worker threads and uploaded via QQuickRhiItemRenderer::scheduleTextureUpload(),
+    so the per-frame upload budget of the window applies. Until a tile is
+    resident, the corresponding part of its nearest resident ancestor is
+    shown instead. The top level tile, covering the whole image, is never
+    evicted, so something is always shown once it is loaded. The render
+    thread never waits for decoding or the file.
+
+    Around the image, and where no tile is loaded yet, a checkerboard is
+    drawn. It is a BC1 compressed KTX2 file loaded by QQuickRhiItemTextureAsset,
+    decoded on the CPU only when the GPU has no BC formats.
+ */
+
+// 256 slots of 256x256 tiles, enough for the tiles covering a 4K output
+static const int CACHE_SIZE = 4096;
+static const int MAX_DECODES_IN_FLIGHT = 16;
+
+using TiledImageUniformsLayout = QQuickRhiItemStd140::Layout<QQuickRhiItemStd140::Mat4>;
+static_assert(offsetof(TiledImageUniforms, mvp) == TiledImageUniformsLayout::offset<0>);
+
+TiledImageTileStore::TiledImageTileStore(const QString &fileName)
+{
+    m_pyramid.open(fileName);
+    m_pool.setObjectName(QLatin1String("TiledImageRhiItem decode"));
+}
+
+TiledImageTileStore::~TiledImageTileStore()
+{
+    // the decodes read the mapping
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+/*
+    Called on the render thread. Returns false when too many decodes are
+    running already, the tile is to be requested again in a later frame.
+ */
+bool TiledImageTileStore::request(int level, int x, int y)
+{
+    if (m_inFlight.load(std::memory_order_relaxed) >= MAX_DECODES_IN_FLIGHT)
+        return false;
+
+    m_inFlight.fetch_add(1, std::memory_order_relaxed);
+    m_pool.start([this, level, x, y] {
+        Tile tile { key(level, x, y), m_pyramid.decodeTile(level, x, y) };
+        {
+            QMutexLocker lock(&m_mutex);
+            m_decoded.append(std::move(tile));
+        }
+        m_inFlight.fetch_sub(1, std::memory_order_relaxed);
+        // queued to the item's thread, coalesced until the renderer takes the tiles
+        if (!m_notifyPending.exchange(true, std::memory_order_acq_rel))
+            emit tilesDecoded();
+    });
+    return true;
+}
+
+QList<TiledImageTileStore::Tile> TiledImageTileStore::takeDecoded()
+{
+    m_notifyPending.store(false, std::memory_order_release);
+    QMutexLocker lock(&m_mutex);
+    return std::exchange(m_decoded, {});
+}
+
+static QShader getShader(const QString &name)
+{
+    QFile f(name);
+    if (f.open(QIODevice::ReadOnly))
+        return QShader::fromSerialized(f.readAll());
+
+    return QShader();
+}
+
+void TiledImageRenderer::initialize(QRhi *rhi, QRhiTexture *outputTexture)
+{
+    m_rhi = rhi;
+    m_output = outputTexture;
+
+    if (!m_rt) {
+        m_rt.reset(m_rhi->newTextureRenderTarget({ m_output }));
+        m_rp.reset(m_rt->newCompatibleRenderPassDescriptor());
+        m_rt->setRenderPassDescriptor(m_rp.data());
+    } else {
+        m_rt->setDescription({ m_output });
+    }
+    m_rt->create();
+
+    if (!scene.ps)
+        initScene();
+}
+
+void TiledImageRenderer::initScene()
+{
+    const int cacheSize = qMin(CACHE_SIZE, m_rhi->resourceLimit(QRhi::TextureSizeMax));
+    scene.cache.reset(m_rhi->newTexture(QRhiTexture::RGBA8, QSize(cacheSize, cacheSize)));
+    scene.cache->create();
+    resetCache();
+
+    static const float quad[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    scene.quad.reset(m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(quad)));
+    scene.quad->create();
+    scene.resourceUpdates = m_rhi->nextResourceUpdateBatch();
+    scene.resourceUpdates->uploadStaticBuffer(scene.quad.data(), quad);
+
+    scene.instances.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, 64 * sizeof(Instance)));
+    scene.instances->create();
+
+    scene.ubuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, scene.uniforms.size()));
+    scene.ubuf->create();
+    scene.uniforms.markAllDirty();
+
+    scene.sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                          QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+    scene.sampler->create();
+
+    scene.srb.reset(m_rhi->newShaderResourceBindings());
+    scene.srb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, scene.ubuf.data()),
+        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, scene.cache.data(), scene.sampler.data())
+    });
+    scene.srb->create();
+
+    scene.ps.reset(m_rhi->newGraphicsPipeline());
+    scene.ps->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+    QShader vs = getShader(QLatin1String(":/tiled.vert.qsb"));
+    Q_ASSERT(vs.isValid());
+    QShader fs = getShader(QLatin1String(":/tiled.frag.qsb"));
+    Q_ASSERT(fs.isValid());
+    scene.ps->setShaderStages({
+        { QRhiShaderStage::Vertex, vs },
+        { QRhiShaderStage::Fragment, fs }
+    });
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({
+        { 2 * sizeof(float) },
+        { sizeof(Instance), QRhiVertexInputBinding::PerInstance }
+    });
+    inputLayout.setAttributes({
+        { 0, 0, QRhiVertexInputAttribute::Float2, 0 },
+        { 1, 1, QRhiVertexInputAttribute::Float4, 0 },
+        { 1, 2, QRhiVertexInputAttribute::Float4, 4 * sizeof(float) }
+    });
+    scene.ps->setVertexInputLayout(inputLayout);
+    scene.ps->setShaderResourceBindings(scene.srb.data());
+    scene.ps->setRenderPassDescriptor(m_rp.data());
+    scene.ps->create();
+
+    initBackdrop();
+}
+
+void TiledImageRenderer::initBackdrop()
+{
+    if (!scene.backdrop.open(m_rhi, { QLatin1String(":/checker.bc1.ktx2") }))
+        return;
+
+    scene.backdropTexture.reset(scene.backdrop.newTexture(m_rhi));
+    scene.backdropTexture->create();
+    scheduleTextureUpload(scene.backdropTexture.data(), scene.backdrop.uploadDescription());
+
+    scene.backdropSampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Linear,
+                                                  QRhiSampler::Repeat, QRhiSampler::Repeat));
+    scene.backdropSampler->create();
+
+    // layout compatible with scene.srb, for the same pipeline
+    scene.backdropSrb.reset(m_rhi->newShaderResourceBindings());
+    scene.backdropSrb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, scene.ubuf.data()),
+        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                  scene.backdropTexture.data(), scene.backdropSampler.data())
+    });
+    scene.backdropSrb->create();
+}
+
+void TiledImageRenderer::resetCache()
+{
+    const int tileSize = itemData.store ? itemData.store->pyramid().tileSize() : 0;
+
+    // a pyramid with tiles larger than the cache gets a cache of one tile,
+    // as far as the GPU allows
+    const int maxSize = m_rhi->resourceLimit(QRhi::TextureSizeMax);
+    const int cacheSize = qMin(qMax(CACHE_SIZE, tileSize), maxSize);
+    if (scene.cache->pixelSize().width() != cacheSize) {
+        scene.cache->setPixelSize(QSize(cacheSize, cacheSize));
+        scene.cache->create();
+        if (scene.srb)
+            scene.srb->create();
+    }
+    if (tileSize > cacheSize)
+        qWarning("TiledImageRhiItem: tiles of %d pixels exceed the maximum texture size of %d, nothing is shown",
+                 tileSize, cacheSize);
+
+    m_slotsPerRow = tileSize > 0 ? cacheSize / tileSize : 0;
+    m_slots = QList<Slot>(m_slotsPerRow * m_slotsPerRow);
+    m_resident.clear();
+    m_pending.clear();
+    m_uploading.clear();
+}
+
+QPoint TiledImageRenderer::slotPosition(int slot) const
+{
+    const int tileSize = itemData.store->pyramid().tileSize();
+    return QPoint((slot % m_slotsPerRow) * tileSize, (slot / m_slotsPerRow) * tileSize);
+}
+
+/*
+    Returns a free slot, or evicts the least recently used tile that was not
+    drawn in this frame. Returns -1 when all slots are in use.
+ */
+int TiledImageRenderer::allocateSlot()
+{
+    const QQuickRhiItemTilePyramid &pyramid(itemData.store->pyramid());
+    const quint64 topKey = TiledImageTileStore::key(pyramid.levelCount() - 1, 0, 0);
+    int lru = -1;
+    for (int i = 0; i < m_slots.count(); ++i) {
+        const Slot &s(m_slots[i]);
+        if (s.key == NO_TILE && !s.uploading)
+            return i;
+        if (s.uploading || s.lastUsed == m_frame || s.key == topKey)
+            continue;
+        if (lru < 0 || s.lastUsed < m_slots[lru].lastUsed)
+            lru = i;
+    }
+    if (lru >= 0) {
+        m_resident.remove(m_slots[lru].key);
+        m_slots[lru].key = NO_TILE;
+    }
+    return lru;
+}
+
+void TiledImageRenderer::synchronize(QQuickRhiItem *rhiItem)
+{
+    TiledImageRhiItem *item = static_cast<TiledImageRhiItem *>(rhiItem);
+
+    QSharedPointer<TiledImageTileStore> store = item->store();
+    if (itemData.store != store) {
+        if (scene.cache)
+            cancelTextureUploads(scene.cache.data());
+        itemData.store = store;
+        if (scene.cache)
+            resetCache();
+    }
+
+    itemData.source = item->source().toString();
+    itemData.center = item->center();
+    itemData.zoom = item->zoom();
+    itemData.itemWidth = item->width();
+}
+
+/*
+    Adds the instance drawing the tile, or the part of its nearest resident
+    ancestor covering it, and requests the tile when it is not resident.
+ */
+void TiledImageRenderer::addTile(int level, int x, int y)
+{
+    TiledImageTileStore *store = itemData.store.data();
+    const QQuickRhiItemTilePyramid &pyramid(store->pyramid());
+
+    const quint64 key = TiledImageTileStore::key(level, x, y);
+    if (!m_resident.contains(key) && !m_pending.contains(key) && store->request(level, x, y))
+        m_pending.insert(key);
+
+    // the tile in image pixels
+    const QRectF levelRect = pyramid.tileRect(level, x, y).toRectF();
+    const QRectF imageRect = QRectF(levelRect.topLeft() * (1 << level), levelRect.size() * (1 << level))
+            & QRectF(QPointF(0, 0), pyramid.size());
+
+    for (int l = level; l < pyramid.levelCount(); ++l) {
+        const int shift = l - level;
+        const auto it = m_resident.constFind(TiledImageTileStore::key(l, x >> shift, y >> shift));
+        if (it == m_resident.cend())
+            continue;
+
+        Slot &slot(m_slots[*it]);
+        slot.lastUsed = m_frame;
+
+        // the tile's texels in the cache, inset by half a texel so that
+        // linear filtering does not pick up the neighbouring slots
+        const QRect tileRect = pyramid.tileRect(l, x >> shift, y >> shift);
+        const QPointF slotPos = slotPosition(*it);
+        const QRectF texels = QRectF(slotPos, tileRect.size()).adjusted(0.5, 0.5, -0.5, -0.5);
+
+        // imageRect in the texels of the slot
+        const qreal scale = 1.0 / (1 << l);
+        QRectF r(imageRect.topLeft() * scale - tileRect.topLeft() + slotPos, imageRect.size() * scale);
+        r.setLeft(qMax(r.left(), texels.left()));
+        r.setTop(qMax(r.top(), texels.top()));
+        r.setRight(qMin(r.right(), texels.right()));
+        r.setBottom(qMin(r.bottom(), texels.bottom()));
+
+        const float cacheSize = float(scene.cache->pixelSize().width());
+        const QPointF topLeft = (imageRect.topLeft() - itemData.center) * m_scale
+                + QPointF(m_output->pixelSize().width(), m_output->pixelSize().height()) / 2;
+        m_instances.append({
+            { float(topLeft.x()), float(topLeft.y()),
+              float(imageRect.width() * m_scale), float(imageRect.height() * m_scale) },
+            { float(r.x()) / cacheSize, float(r.y()) / cacheSize,
+              float(r.width()) / cacheSize, float(r.height()) / cacheSize }
+        });
+        return;
+    }
+}
+
+void TiledImageRenderer::render(QRhiCommandBuffer *commandBuffer)
+{
+    QQuickRhiItemCommandRecorder cb(commandBuffer, capture());
+    ++m_frame;
+    m_instances.clear();
+
+    QRhiResourceUpdateBatch *rub = scene.resourceUpdates;
+    if (rub)
+        scene.resourceUpdates = nullptr;
+    else
+        rub = m_rhi->nextResourceUpdateBatch();
+
+    TiledImageTileStore *store = itemData.store.data();
+    const QSize outputSize = m_output->pixelSize();
+
+    // the backdrop is the first instance, repeated at one texel per pixel
+    if (scene.backdropUploaded) {
+        const QSize texels = scene.backdrop.size();
+        m_instances.append({
+            { 0, 0, float(outputSize.width()), float(outputSize.height()) },
+            { 0, 0, float(outputSize.width()) / texels.width(), float(outputSize.height()) / texels.height() }
+        });
+    }
+    const int firstTile = m_instances.count();
+
+    if (store && store->pyramid().isOpen() && m_slotsPerRow > 0) {
+        const QQuickRhiItemTilePyramid &pyramid(store->pyramid());
+        const int tileSize = pyramid.tileSize();
+
+        // output pixels per image pixel, and the level with about as many
+        m_scale = itemData.zoom * (itemData.itemWidth > 0 ? outputSize.width() / itemData.itemWidth : 1.0);
+        const int level = qBound(0, int(qFloor(std::log2(1.0 / m_scale))), pyramid.levelCount() - 1);
+
+        // the top level is what is shown while nothing else is loaded
+        const quint64 topKey = TiledImageTileStore::key(pyramid.levelCount() - 1, 0, 0);
+        if (!m_resident.contains(topKey) && !m_pending.contains(topKey) && store->request(pyramid.levelCount() - 1, 0, 0))
+            m_pending.insert(topKey);
+
+        // the visible part of the image, in the pixels of the level
+        const QSizeF halfExtent = QSizeF(outputSize.width(), outputSize.height()) / (2 * m_scale);
+        const QRectF visible = QRectF(itemData.center - QPointF(halfExtent.width(), halfExtent.height()), 2 * halfExtent)
+                & QRectF(QPointF(0, 0), pyramid.size());
+        if (!visible.isEmpty()) {
+            const qreal levelScale = 1.0 / (1 << level);
+            const QQuickRhiItemTilePyramid::Level l = pyramid.level(level);
+            const int x0 = qBound(0, int(visible.left() * levelScale) / tileSize, l.columns - 1);
+            const int x1 = qBound(0, int(visible.right() * levelScale) / tileSize, l.columns - 1);
+            const int y0 = qBound(0, int(visible.top() * levelScale) / tileSize, l.rows - 1);
+            const int y1 = qBound(0, int(visible.bottom() * levelScale) / tileSize, l.rows - 1);
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x)
+                    addTile(level, x, y);
+            }
+        }
+
+        // Upload what got decoded since the last frame. The slots drawn in
+        // this frame are not reused, so nothing visible is overwritten.
+        const QList<TiledImageTileStore::Tile> decoded = store->takeDecoded();
+        for (const TiledImageTileStore::Tile &tile : decoded) {
+            if (tile.image.isNull()) {
+                // stays pending, a broken tile is not requested again
+                qWarning("Failed to decode a tile of %s", qPrintable(itemData.source));
+                continue;
+            }
+            const int slot = allocateSlot();
+            if (slot < 0) {
+                m_pending.remove(tile.key); // requested again while visible
+                continue;
+            }
+            m_slots[slot].key = tile.key;
+            m_slots[slot].lastUsed = m_frame;
+            m_slots[slot].uploading = true;
+            m_uploading.append(slot);
+            QRhiTextureSubresourceUploadDescription desc(tile.image);
+            desc.setDestinationTopLeft(slotPosition(slot));
+            scheduleTextureUpload(scene.cache.data(), QRhiTextureUploadEntry(0, 0, desc));
+        }
+    }
+
+    if (!m_instances.isEmpty()) {
+        const quint32 bytes = quint32(m_instances.count() * sizeof(Instance));
+        if (bytes > scene.instances->size()) {
+            scene.instances->setSize(qNextPowerOfTwo(bytes));
+            scene.instances->create();
+        }
+        rub->updateDynamicBuffer(scene.instances.data(), 0, bytes, m_instances.constData());
+    }
+
+    QMatrix4x4 mvp = m_rhi->clipSpaceCorrMatrix();
+    mvp.ortho(0, outputSize.width(), outputSize.height(), 0, -1, 1);
+    scene.uniforms.set(&TiledImageUniforms::mvp, mvp);
+    scene.uniforms.commit(rub, scene.ubuf.data());
+
+    cb.beginPass(m_rt.data(), QColor::fromRgbF(0.2f, 0.2f, 0.2f), { 1.0f, 0 }, rub);
+
+    if (!m_instances.isEmpty()) {
+        cb.setGraphicsPipeline(scene.ps.data());
+        cb.setViewport(QRhiViewport(0, 0, outputSize.width(), outputSize.height()));
+        if (firstTile > 0) {
+            cb.setShaderResources(scene.backdropSrb.data());
+            const QRhiCommandBuffer::VertexInput vbufBindings[] = {
+                { scene.quad.data(), 0 },
+                { scene.instances.data(), 0 }
+            };
+            cb.setVertexInput(0, 2, vbufBindings);
+            cb.draw(4);
+        }
+        const int tileCount = m_instances.count() - firstTile;
+        if (tileCount > 0) {
+            // offset to the first tile instead of a first instance, which
+            // not every backend supports
+            cb.setShaderResources();
+            const QRhiCommandBuffer::VertexInput vbufBindings[] = {
+                { scene.quad.data(), 0 },
+                { scene.instances.data(), quint32(firstTile * sizeof(Instance)) }
+            };
+            cb.setVertexInput(0, 2, vbufBindings);
+            cb.draw(4, quint32(tileCount));
+        }
+    }
+
+    cb.endPass();
+}
+
+void TiledImageRenderer::textureUploaded(QRhiTexture *texture)
+{
+    if (texture == scene.backdropTexture.data()) {
+        scene.backdropUploaded = true;
+        update();
+        return;
+    }
+
+    if (texture != scene.cache.data() || m_uploading.isEmpty())
+        return;
+
+    // the uploads of a texture are submitted in the order they were scheduled
+    const int index = m_uploading.takeFirst();
+    Slot &slot(m_slots[index]);
+    slot.uploading = false;
+    m_resident.insert(slot.key, index);
+    m_pending.remove(slot.key);
+    update();
+}
+
+TiledImageRhiItem::TiledImageRhiItem(QQuickItem *parent)
+    : QQuickRhiItem(parent)
+{
+    setAcceptedMouseButtons(Qt::LeftButton);
+}
+
+void TiledImageRhiItem::setSource(const QUrl &url)
+{
+    if (m_source == url)
+        return;
+
+    m_source = url;
+    m_store.reset();
+    if (!url.isEmpty()) {
+        // deleted on the item's thread, the renderer may drop the last reference
+        m_store.reset(new TiledImageTileStore(QQmlFile::urlToLocalFileOrQrc(url)), &QObject::deleteLater);
+        connect(m_store.data(), &TiledImageTileStore::tilesDecoded, this, &QQuickItem::update);
+    }
+    emit sourceChanged();
+
+    const QSize size = imageSize();
+    setCenter(QPointF(size.width(), size.height()) / 2);
+    if (!size.isEmpty() && width() > 0 && height() > 0)
+        setZoom(qMin(width() / size.width(), height() / size.height()));
+    update();
+}
+
+QSize TiledImageRhiItem::imageSize() const
+{
+    return m_store ? m_store->pyramid().size() : QSize();
+}
+
+void TiledImageRhiItem::setCenter(const QPointF &c)
+{
+    if (m_center == c)
+        return;
+
+    m_center = c;
+    emit centerChanged();
+    update();
+}
+
+void TiledImageRhiItem::setZoom(qreal z)
+{
+    z = qBound(1.0 / 1024, z, 64.0);
+    if (qFuzzyCompare(m_zoom, z))
+        return;
+
+    m_zoom = z;
+    emit zoomChanged();
+    update();
+}
+
+void TiledImageRhiItem::mousePressEvent(QMouseEvent *event)
+{
+    m_dragPos = event->position();
+}
+
+void TiledImageRhiItem::mouseMoveEvent(QMouseEvent *event)
+{
+    const QPointF delta = event->position() - m_dragPos;
+    m_dragPos = event->position();
+    setCenter(m_center - delta / m_zoom);
+}
+
+void TiledImageRhiItem::wheelEvent(QWheelEvent *event)
+{
+    // keep the image pixel under the cursor where it is
+    const QPointF pos = event->position() - QPointF(width(), height()) / 2;
+    const QPointF imagePos = m_center + pos / m_zoom;
+    setZoom(m_zoom * qPow(2.0, event->angleDelta().y() / 480.0));
+    setCenter(imagePos - pos / m_zoom);
+}
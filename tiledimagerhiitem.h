@@ -0,0 +1,171 @@
+#ifndef TILEDIMAGERHIITEM_H
+#define TILEDIMAGERHIITEM_H
+
+#include "rhiitem.h"
+#include "rhiitemtextureasset.h"
+#include "rhiitemtilepyramid.h"
+#include "rhiitemuniformblock.h"
+#include <QtGui/private/qrhi_p.h>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+#include <atomic>
+
+// Decodes tiles on worker threads. Shared by the item, which opens the file,
+// and the renderer, which requests tiles and takes the decoded ones.
+class TiledImageTileStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Tile {
+        quint64 key;
+        QImage image;
+    };
+
+    static quint64 key(int level, int x, int y) { return (quint64(level) << 48) | (quint64(y) << 24) | quint64(x); }
+
+    TiledImageTileStore(const QString &fileName);
+    ~TiledImageTileStore();
+
+    const QQuickRhiItemTilePyramid &pyramid() const { return m_pyramid; }
+
+    bool request(int level, int x, int y);
+    QList<Tile> takeDecoded();
+
+signals:
+    void tilesDecoded();
+
+private:
+    QQuickRhiItemTilePyramid m_pyramid;
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QList<Tile> m_decoded;
+    std::atomic<int> m_inFlight { 0 };
+    std::atomic<bool> m_notifyPending { false };
+};
+
+// the uniform block of tiled.vert
+struct TiledImageUniforms
+{
+    QQuickRhiItemStd140::Mat4 mvp;
+};
+
+class TiledImageRenderer : public QQuickRhiItemRenderer
+{
+public:
+    void initialize(QRhi *rhi, QRhiTexture *outputTexture) override;
+    void synchronize(QQuickRhiItem *item) override;
+    void render(QRhiCommandBuffer *cb) override;
+    void textureUploaded(QRhiTexture *texture) override;
+
+private:
+    struct Slot {
+        quint64 key = NO_TILE;
+        quint64 lastUsed = 0;
+        bool uploading = false;
+    };
+    struct Instance {
+        float rect[4]; // in output pixels
+        float uv[4];
+    };
+    static const quint64 NO_TILE = ~quint64(0);
+
+    void initScene();
+    void initBackdrop();
+    void resetCache();
+    int allocateSlot();
+    QPoint slotPosition(int slot) const;
+    void addTile(int level, int x, int y);
+
+    QRhi *m_rhi = nullptr;
+    QRhiTexture *m_output = nullptr;
+    QScopedPointer<QRhiTextureRenderTarget> m_rt;
+    QScopedPointer<QRhiRenderPassDescriptor> m_rp;
+
+    struct {
+        QRhiResourceUpdateBatch *resourceUpdates = nullptr;
+        QScopedPointer<QRhiTexture> cache;
+        QScopedPointer<QRhiBuffer> quad;
+        QScopedPointer<QRhiBuffer> instances;
+        QScopedPointer<QRhiBuffer> ubuf;
+        QQuickRhiItemUniformBlock<TiledImageUniforms> uniforms;
+        QScopedPointer<QRhiSampler> sampler;
+        QScopedPointer<QRhiShaderResourceBindings> srb;
+        QScopedPointer<QRhiGraphicsPipeline> ps;
+        // the checkerboard shown where no tile is drawn
+        QQuickRhiItemTextureAsset backdrop;
+        QScopedPointer<QRhiTexture> backdropTexture;
+        QScopedPointer<QRhiSampler> backdropSampler;
+        QScopedPointer<QRhiShaderResourceBindings> backdropSrb;
+        bool backdropUploaded = false;
+    } scene;
+
+    // the page table: which tile is in which slot of the cache texture
+    QList<Slot> m_slots;
+    QHash<quint64, int> m_resident;
+    QSet<quint64> m_pending; // requested, decoded or uploading
+    QList<int> m_uploading; // in the order the uploads were scheduled
+    QList<Instance> m_instances;
+    quint64 m_frame = 0;
+    int m_slotsPerRow = 0;
+    qreal m_scale = 1.0; // output pixels per image pixel
+
+    struct {
+        QSharedPointer<TiledImageTileStore> store;
+        QString source;
+        QPointF center;
+        qreal zoom = 1.0;
+        qreal itemWidth = 0;
+    } itemData;
+};
+
+class TiledImageRhiItem : public QQuickRhiItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(TiledImageRhiItem)
+
+    Q_PROPERTY(QUrl source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(QSize imageSize READ imageSize NOTIFY sourceChanged)
+    Q_PROPERTY(QPointF center READ center WRITE setCenter NOTIFY centerChanged)
+    Q_PROPERTY(qreal zoom READ zoom WRITE setZoom NOTIFY zoomChanged)
+
+public:
+    TiledImageRhiItem(QQuickItem *parent = nullptr);
+
+    QQuickRhiItemRenderer *createRenderer() override { return new TiledImageRenderer; }
+
+    QUrl source() const { return m_source; }
+    void setSource(const QUrl &url);
+
+    QSize imageSize() const;
+
+    QPointF center() const { return m_center; }
+    void setCenter(const QPointF &c);
+
+    qreal zoom() const { return m_zoom; }
+    void setZoom(qreal z);
+
+    QSharedPointer<TiledImageTileStore> store() const { return m_store; }
+
+protected:
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+signals:
+    void sourceChanged();
+    void centerChanged();
+    void zoomChanged();
+
+private:
+    QUrl m_source;
+    QSharedPointer<TiledImageTileStore> m_store;
+    QPointF m_center;
+    qreal m_zoom = 1.0;
+    QPointF m_dragPos;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#version 440
+
+layout(location = 0) in vec2 v_texcoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform effect {
+    vec2 texelSize;
+    int flipY;
+};
+
+layout(binding = 1) uniform sampler2D source;
+
+layout(std140, binding = 2) uniform params {
+    float exposure;
+};
+
+void main()
+{
+    // Reinhard, on the unpremultiplied color
+    vec4 c = texture(source, v_texcoord);
+    vec3 rgb = c.a > 0.0 ? c.rgb / c.a : vec3(0.0);
+    rgb *= exposure;
+    rgb = rgb / (1.0 + rgb);
+    fragColor = vec4(rgb * c.a, c.a);
+}
@@ -0,0 +1,134 @@
+#include "rhiitemculling.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <algorithm>
+
+/*
+    Compares the implementations of QQuickRhiItemCuller, with the scalar one
+    as the baseline, on a random field of spheres and boxes around a camera
+    turning in place:
+
+    cullbench
+    cullbench --counts 50000,2000000 --iterations 50
+
+    Reports the median time of cull() and of compact() with 64 byte instances,
+    and checks that each implementation selects the same LODs as the scalar
+    one.
+ */
+
+static const int INSTANCE_SIZE = 64; // e.g. a model matrix
+
+static void populate(QQuickRhiItemCuller *culler, int count)
+{
+    QRandomGenerator rng(1234);
+    auto random = [&rng](float from, float to) { return from + float(rng.generateDouble()) * (to - from); };
+    culler->clear();
+    culler->reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QVector3D center(random(-500, 500), random(-50, 50), random(-500, 500));
+        if (i & 1) {
+            culler->addSphere(center, random(0.5f, 4.0f));
+        } else {
+            const QVector3D extent(random(0.5f, 4.0f), random(0.5f, 4.0f), random(0.5f, 4.0f));
+            culler->addBox(center - extent, center + extent);
+        }
+    }
+    culler->setLodThresholds({ 64.0f, 16.0f, 4.0f });
+    culler->setMinimumSize(1.0f);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Benchmarks the frustum culling of QQuickRhiItemCuller"));
+    parser.addHelpOption();
+    QCommandLineOption countsOption(QStringLiteral("counts"), QStringLiteral("Comma separated object counts."),
+                                    QStringLiteral("counts"), QStringLiteral("10000,100000,1000000"));
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("Frames per measurement."),
+                                        QStringLiteral("n"), QStringLiteral("100"));
+    parser.addOptions({ countsOption, iterationsOption });
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    QList<int> counts;
+    for (const QString &s : parser.value(countsOption).split(QLatin1Char(','))) {
+        const int count = s.toInt();
+        if (count <= 0) {
+            qWarning("Invalid object count %s", qPrintable(s));
+            return 1;
+        }
+        counts.append(count);
+    }
+
+    // a 1080p view, with OpenGL's clip space
+    const float viewportHeight = 1080.0f;
+    QMatrix4x4 projection;
+    projection.perspective(60.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    const float pixelsPerUnit = QQuickRhiItemCuller::pixelsPerUnit(projection, viewportHeight);
+    QList<QMatrix4x4> viewProjections;
+    for (int i = 0; i < iterations; ++i) {
+        QMatrix4x4 view;
+        view.rotate(360.0f * i / iterations, 0, 1, 0);
+        viewProjections.append(projection * view);
+    }
+
+    const QList<QQuickRhiItemCuller::Implementation> implementations = {
+        QQuickRhiItemCuller::Scalar, QQuickRhiItemCuller::SSE2, QQuickRhiItemCuller::AVX2, QQuickRhiItemCuller::NEON
+    };
+
+    int result = 0;
+    for (int count : counts) {
+        QQuickRhiItemCuller culler;
+        populate(&culler, count);
+        const QByteArray instances(qsizetype(count) * INSTANCE_SIZE, 0);
+        QByteArray compacted;
+
+        QList<QByteArray> reference; // the scalar LODs of each frame
+        qint64 scalarTime = 0;
+        for (QQuickRhiItemCuller::Implementation implementation : implementations) {
+            if (!culler.setImplementation(implementation))
+                continue;
+
+            QList<qint64> cullTimes;
+            QList<qint64> compactTimes;
+            qint64 visible = 0;
+            int mismatches = 0;
+            QElapsedTimer timer;
+            for (int i = 0; i < iterations; ++i) {
+                timer.start();
+                culler.cull(viewProjections[i], pixelsPerUnit, false);
+                cullTimes.append(timer.nsecsElapsed());
+                timer.start();
+                visible += culler.compact(&compacted, instances.constData(), INSTANCE_SIZE);
+                compactTimes.append(timer.nsecsElapsed());
+
+                const QByteArray lods(reinterpret_cast<const char *>(culler.lods()), count);
+                if (implementation == QQuickRhiItemCuller::Scalar)
+                    reference.append(lods);
+                else if (lods != reference[i])
+                    ++mismatches;
+            }
+            std::sort(cullTimes.begin(), cullTimes.end());
+            std::sort(compactTimes.begin(), compactTimes.end());
+            const qint64 cullTime = cullTimes[iterations / 2];
+            if (implementation == QQuickRhiItemCuller::Scalar)
+                scalarTime = cullTime;
+
+            qInfo("%8d objects, %-6s cull %8.3f ms (%5.2fx), compact %8.3f ms, %lld visible per frame",
+                  count, QQuickRhiItemCuller::implementationName(implementation), cullTime / 1000000.0,
+                  cullTime ? double(scalarTime) / cullTime : 0.0, compactTimes[iterations / 2] / 1000000.0,
+                  visible / iterations);
+            if (mismatches) {
+                qWarning("%s selected different LODs than the scalar implementation in %d frames",
+                         QQuickRhiItemCuller::implementationName(implementation), mismatches);
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
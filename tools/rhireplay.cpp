@@ -0,0 +1,125 @@
+#include "rhiitemcapture.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <algorithm>
+
+/*
+    Replays a capture written by QQuickRhiItem::captureFrames() against an
+    offscreen QRhi, and reports the CPU cost per frame, without Qt Quick and
+    without the scene the capture came from:
+
+    rhireplay capture.qric
+    rhireplay --backend gl-software --iterations 500 capture.qric
+
+    The null backend measures the cost of QRhi and of the renderer's command
+    stream alone, OpenGL adds the driver. For each captured frame, the
+    median and the 95th percentile of recording the commands, and of the
+    whole offscreen frame, including the submission, are printed.
+ */
+
+static void printTimes(const char *name, QList<qint64> times)
+{
+    std::sort(times.begin(), times.end());
+    qint64 sum = 0;
+    for (qint64 t : std::as_const(times))
+        sum += t;
+    qInfo("    %-8s median %8.3f ms, p95 %8.3f ms, mean %8.3f ms", name, times[times.count() / 2] / 1000000.0,
+          times[qMin(times.count() - 1, times.count() * 95 / 100)] / 1000000.0, sum / times.count() / 1000000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    // the offscreen platform is enough for both backends
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    for (int i = 1; i < argc; ++i) {
+        if (!qstrcmp(argv[i], "gl-software") || !qstrcmp(argv[i], "--backend=gl-software")) {
+            QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+            qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+        }
+    }
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replays QQuickRhiItem captures and measures them"));
+    parser.addHelpOption();
+    QCommandLineOption backendOption(QStringLiteral("backend"), QStringLiteral("null, gl or gl-software."),
+                                     QStringLiteral("backend"), QStringLiteral("null"));
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("How many times to replay the capture."),
+                                        QStringLiteral("n"), QStringLiteral("100"));
+    parser.addOptions({ backendOption, iterationsOption });
+    parser.addPositionalArgument(QStringLiteral("capture"), QStringLiteral("The capture to replay."));
+    parser.process(app);
+
+    if (parser.positionalArguments().count() != 1)
+        parser.showHelp(1);
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    QQuickRhiItemCapture capture;
+    if (!capture.load(parser.positionalArguments().first()))
+        return 1;
+    if (!capture.frameCount()) {
+        qWarning("The capture has no frames");
+        return 1;
+    }
+
+    const QString backend = parser.value(backendOption);
+    QScopedPointer<QOffscreenSurface> fallbackSurface;
+    QScopedPointer<QRhi> rhi;
+    if (backend == QLatin1String("null")) {
+        QRhiNullInitParams params;
+        rhi.reset(QRhi::create(QRhi::Null, &params));
+    } else if (backend == QLatin1String("gl") || backend == QLatin1String("gl-software")) {
+#if QT_CONFIG(opengl)
+        fallbackSurface.reset(QRhiGles2InitParams::newFallbackSurface());
+        QRhiGles2InitParams params;
+        params.fallbackSurface = fallbackSurface.data();
+        rhi.reset(QRhi::create(QRhi::OpenGLES2, &params));
+#endif
+    } else {
+        qWarning("Unknown backend %s", qPrintable(backend));
+        return 1;
+    }
+    if (!rhi) {
+        qWarning("Failed to create a QRhi for %s", qPrintable(backend));
+        return 1;
+    }
+
+    qInfo("Replaying %d frames, %d resources, captured with %s, on %s (%s), %d times",
+          capture.frameCount(), capture.resourceCount(), capture.backendName().constData(),
+          rhi->backendName(), rhi->driverInfo().deviceName.constData(), iterations);
+
+    if (!capture.createResources(rhi.data()))
+        return 1;
+
+    QList<QList<qint64>> recordTimes(capture.frameCount());
+    QList<QList<qint64>> frameTimes(capture.frameCount());
+    QElapsedTimer frameTimer;
+    QElapsedTimer recordTimer;
+    for (int i = 0; i < iterations; ++i) {
+        for (int frame = 0; frame < capture.frameCount(); ++frame) {
+            frameTimer.start();
+            QRhiCommandBuffer *cb = nullptr;
+            if (rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+                qWarning("Failed to begin a frame");
+                return 1;
+            }
+            recordTimer.start();
+            capture.replayFrame(cb, frame);
+            recordTimes[frame].append(recordTimer.nsecsElapsed());
+            rhi->endOffscreenFrame();
+            frameTimes[frame].append(frameTimer.nsecsElapsed());
+        }
+    }
+
+    for (int frame = 0; frame < capture.frameCount(); ++frame) {
+        qInfo("Frame %d, %d commands:", frame, capture.commandCount(frame));
+        printTimes("record", recordTimes[frame]);
+        printTimes("frame", frameTimes[frame]);
+    }
+
+    capture.releaseResources();
+    return 0;
+}
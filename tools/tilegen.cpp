@@ -0,0 +1,116 @@
+#include "rhiitemtilepyramid.h"
+#include <QCommandLineParser>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QPainter>
+
+/*
+    Creates a tile pyramid for TiledImageRhiItem, either from an image file,
+    or a synthetic one of any size, for testing and benchmarking without
+    needing gigapixel source images:
+
+    tilegen photo.jpg photo.qrtp
+    tilegen --synthetic 100000x60000 --format jpg big.qrtp
+
+    Image files are loaded in full, and the levels are downscaled from each
+    other, so their memory usage follows the image size. Synthetic images are
+    generated tile by tile, in constant memory.
+ */
+
+static QImage syntheticTile(const QQuickRhiItemTilePyramid::Level &level, int levelIndex, const QRect &rect)
+{
+    // a gradient over the whole image, a grid with a period of 256 level 0
+    // pixels, and the coordinates of the tile
+    QImage image(rect.size(), QImage::Format_RGB32);
+    const int scale = 1 << levelIndex;
+    for (int y = 0; y < rect.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        const int gy = (rect.y() + y) * scale;
+        for (int x = 0; x < rect.width(); ++x) {
+            const int gx = (rect.x() + x) * scale;
+            const int r = 255 * (rect.x() + x) / qMax(1, level.width - 1);
+            const int g = 255 * (rect.y() + y) / qMax(1, level.height - 1);
+            const bool gridLine = gx % 256 < scale || gy % 256 < scale;
+            line[x] = gridLine ? qRgb(255, 255, 255) : qRgb(r, g, 128 + 64 * (((gx >> 8) + (gy >> 8)) & 1));
+        }
+    }
+    QPainter p(&image);
+    p.setPen(Qt::black);
+    p.drawText(image.rect().adjusted(4, 4, -4, -4), Qt::AlignLeft | Qt::AlignTop,
+               QStringLiteral("L%1 %2,%3").arg(levelIndex).arg(rect.x()).arg(rect.y()));
+    return image;
+}
+
+int main(int argc, char *argv[])
+{
+    // QPainter needs the fonts
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Creates tile pyramids for TiledImageRhiItem"));
+    parser.addHelpOption();
+    QCommandLineOption tileSizeOption(QStringLiteral("tile-size"), QStringLiteral("Tile size in pixels."),
+                                      QStringLiteral("size"), QStringLiteral("256"));
+    QCommandLineOption formatOption(QStringLiteral("format"), QStringLiteral("Tile format, png or jpg."),
+                                    QStringLiteral("format"), QStringLiteral("png"));
+    QCommandLineOption syntheticOption(QStringLiteral("synthetic"), QStringLiteral("Generate an image of this size."),
+                                       QStringLiteral("WxH"));
+    parser.addOptions({ tileSizeOption, formatOption, syntheticOption });
+    parser.addPositionalArgument(QStringLiteral("[input]"), QStringLiteral("The source image."));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("The tile pyramid to write."));
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    const bool synthetic = parser.isSet(syntheticOption);
+    if (args.count() != (synthetic ? 1 : 2))
+        parser.showHelp(1);
+
+    const int tileSize = parser.value(tileSizeOption).toInt();
+    if (tileSize < 16 || tileSize > 1024) {
+        qWarning("Tile size must be between 16 and 1024");
+        return 1;
+    }
+    const QByteArray format = parser.value(formatOption).toLatin1();
+
+    QSize size;
+    QImage image; // the current level, when not synthetic
+    int imageLevel = 0;
+    if (synthetic) {
+        const QStringList wh = parser.value(syntheticOption).split(QLatin1Char('x'));
+        if (wh.count() == 2)
+            size = QSize(wh[0].toInt(), wh[1].toInt());
+        if (size.isEmpty()) {
+            qWarning("Invalid size %s", qPrintable(parser.value(syntheticOption)));
+            return 1;
+        }
+    } else {
+        QImageReader::setAllocationLimit(0);
+        QImageReader reader(args[0]);
+        if (!reader.read(&image)) {
+            qWarning("Failed to read %s: %s", qPrintable(args[0]), qPrintable(reader.errorString()));
+            return 1;
+        }
+        size = image.size();
+    }
+
+    QQuickRhiItemTilePyramid::Level level;
+    int levelIndex = -1;
+    const bool ok = QQuickRhiItemTilePyramid::write(args.last(), size, tileSize, format.constData(),
+                                                    [&](int l, const QRect &rect) {
+        if (l != levelIndex) {
+            levelIndex = l;
+            level.width = qMax(1, (size.width() + (1 << l) - 1) >> l);
+            level.height = qMax(1, (size.height() + (1 << l) - 1) >> l);
+            qInfo("Level %d: %dx%d", l, level.width, level.height);
+        }
+        if (synthetic)
+            return syntheticTile(level, l, rect);
+        while (imageLevel < l) {
+            image = image.scaled(level.width, level.height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            ++imageLevel;
+        }
+        return image.copy(rect);
+    });
+
+    return ok ? 0 : 1;
+}